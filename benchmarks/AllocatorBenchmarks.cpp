@@ -0,0 +1,48 @@
+#include "Benchmark.h"
+#include <string.h>
+
+namespace
+{
+	double BenchmarkScale = 1.0;
+}
+
+std::vector<THostBenchmark>& GetHostBenchmarks()
+{
+	static std::vector<THostBenchmark> Benchmarks;
+	return Benchmarks;
+}
+
+double GetBenchmarkScale()
+{
+	return BenchmarkScale;
+}
+
+// AllocatorBenchmarks [--quick] [name filter]
+int main(int argc, char** argv)
+{
+	const char* Filter = nullptr;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--quick") == 0)
+		{
+			BenchmarkScale = 0.01;
+		}
+		else
+		{
+			Filter = argv[i];
+		}
+	}
+
+	for (const THostBenchmark& Benchmark : GetHostBenchmarks())
+	{
+		if (Filter && !strstr(Benchmark.Name, Filter))
+		{
+			continue;
+		}
+
+		printf("== %s\n", Benchmark.Name);
+		Benchmark.Func();
+	}
+
+	return 0;
+}
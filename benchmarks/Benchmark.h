@@ -0,0 +1,82 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+// Registration and timing helpers for the host benchmarks.
+// Every benchmark reads GetBenchmarkScale() to shrink its iteration counts under --quick.
+
+struct THostBenchmark
+{
+	const char* Name;
+
+	void (*Func)();
+};
+
+std::vector<THostBenchmark>& GetHostBenchmarks();
+
+// 1 normally, a small fraction under --quick
+double GetBenchmarkScale();
+
+inline uint32_t ScaleIterations(uint32_t Iterations)
+{
+	const double Scaled = Iterations * GetBenchmarkScale();
+	return Scaled < 1.0 ? 1 : (uint32_t)Scaled;
+}
+
+struct THostBenchmarkRegistrar
+{
+	THostBenchmarkRegistrar(const char* Name, void (*Func)())
+	{
+		GetHostBenchmarks().push_back({ Name, Func });
+	}
+};
+
+#define HOST_BENCHMARK(Name) \
+	static void Name(); \
+	static THostBenchmarkRegistrar Name##Registrar(#Name, Name); \
+	static void Name()
+
+class TBenchmarkTimer
+{
+public:
+	TBenchmarkTimer() : Start(std::chrono::steady_clock::now()) {}
+
+	double GetSeconds() const
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+	}
+
+private:
+	std::chrono::steady_clock::time_point Start;
+};
+
+// keeps the optimizer from dropping a result
+template<typename T>
+inline void KeepAlive(const T& Value)
+{
+	static volatile uint64_t Sink;
+	Sink = Sink + (uint64_t)Value;
+}
+
+// deterministic LCG, every run replays the same sequence
+class TBenchmarkRandom
+{
+public:
+	explicit TBenchmarkRandom(uint64_t Seed) : State(Seed) {}
+
+	uint32_t Next()
+	{
+		State = State * 6364136223846793005ull + 1442695040888963407ull;
+		return (uint32_t)(State >> 33);
+	}
+
+	uint32_t Uniform(uint32_t Range)
+	{
+		return Next() % Range;
+	}
+
+private:
+	uint64_t State;
+};
@@ -0,0 +1,72 @@
+#include "Benchmark.h"
+#include "BuddyAllocator.h"
+
+namespace
+{
+	// default geometry of the D3D12 pools, see DEFAULT_POOL_SIZE and DEFAULT_MIN_BLOCK_SIZE
+	const uint64_t POOL_SIZE = 512ull * 1024 * 1024;
+	const uint64_t MIN_BLOCK_SIZE = 256;
+
+	// sizes of buffers and small textures, 256B to 256KB
+	uint64_t RandomSize(TBenchmarkRandom& Random)
+	{
+		return (uint64_t)256 << Random.Uniform(11);
+	}
+}
+
+// random alloc/free with a steady number of live blocks, the pattern of a streaming level
+HOST_BENCHMARK(BuddyRandomChurn)
+{
+	const uint32_t NumLive = 20000;
+	const uint32_t NumOperations = ScaleIterations(4000000);
+
+	TBuddyAllocator<THostBackingStore> Allocator(POOL_SIZE, MIN_BLOCK_SIZE, 0);
+	TBenchmarkRandom Random(1);
+
+	std::vector<TBuddyAllocation> Live(NumLive);
+	for (TBuddyAllocation& Allocation : Live)
+	{
+		Allocator.Allocate(RandomSize(Random), 0, Allocation);
+	}
+
+	TBenchmarkTimer Timer;
+	for (uint32_t i = 0; i < NumOperations; ++i)
+	{
+		TBuddyAllocation& Allocation = Live[Random.Uniform(NumLive)];
+		Allocator.Deallocate(Allocation.Offset, Allocation.Order);
+		Allocator.Allocate(RandomSize(Random), 0, Allocation);
+	}
+	const double Seconds = Timer.GetSeconds();
+
+	KeepAlive(Allocator.GetTotalAllocSize());
+	printf("%u alloc/free pairs with %u live blocks: %.1f ns per pair\n", NumOperations, NumLive, Seconds * 1e9 / NumOperations);
+}
+
+// fill the pool with minimum blocks then free them all, the worst case for splitting and merging
+HOST_BENCHMARK(BuddyFillAndDrain)
+{
+	const uint32_t NumRounds = ScaleIterations(20);
+	const uint64_t PoolSize = 64ull * 1024 * 1024;
+	const uint32_t NumBlocks = (uint32_t)(PoolSize / MIN_BLOCK_SIZE);
+
+	TBuddyAllocator<THostBackingStore> Allocator(PoolSize, MIN_BLOCK_SIZE, 0);
+	std::vector<TBuddyAllocation> Blocks(NumBlocks);
+
+	TBenchmarkTimer Timer;
+	for (uint32_t Round = 0; Round < NumRounds; ++Round)
+	{
+		for (TBuddyAllocation& Allocation : Blocks)
+		{
+			Allocator.Allocate(MIN_BLOCK_SIZE, 0, Allocation);
+		}
+
+		for (const TBuddyAllocation& Allocation : Blocks)
+		{
+			Allocator.Deallocate(Allocation.Offset, Allocation.Order);
+		}
+	}
+	const double Seconds = Timer.GetSeconds();
+
+	const double NumOperations = (double)NumRounds * NumBlocks * 2;
+	printf("%u rounds of %u blocks: %.1f ns per operation\n", NumRounds, NumBlocks, Seconds * 1e9 / NumOperations);
+}
@@ -0,0 +1,187 @@
+#include "Benchmark.h"
+#include "DescriptorSlotIndex.h"
+#include <list>
+
+namespace
+{
+	// heap geometry of the CPU descriptor heaps, see TD3D12HeapSlotAllocator
+	const uint32_t NUM_DESCRIPTORS_PER_HEAP = 1024;
+	const uint32_t DESCRIPTOR_SIZE = 32;
+
+	// heap starts as far apart as the real CPU handles
+	uint64_t HeapBaseHandle(uint32_t HeapIndex)
+	{
+		return 0x10000000ull * (HeapIndex + 1);
+	}
+
+	// The heap slot bookkeeping before the bitmaps: one std::list of free handle ranges per heap,
+	// a linear scan for the first heap with a free range and a walk of the list on every free.
+	// Kept here only as the baseline of the comparison below, single descriptors only like the original
+	class TListSlotAllocator
+	{
+	public:
+		struct TSlot
+		{
+			uint32_t HeapIndex = 0;
+
+			uint64_t Handle = 0;
+		};
+
+		TSlot Allocate()
+		{
+			int EntryIndex = -1;
+			for (int i = 0; i < (int)Heaps.size(); ++i)
+			{
+				if (Heaps[i].size() > 0)
+				{
+					EntryIndex = i;
+					break;
+				}
+			}
+
+			if (EntryIndex == -1)
+			{
+				const uint64_t Base = HeapBaseHandle((uint32_t)Heaps.size());
+				Heaps.emplace_back().push_back({ Base, Base + (uint64_t)NUM_DESCRIPTORS_PER_HEAP * DESCRIPTOR_SIZE });
+				EntryIndex = (int)Heaps.size() - 1;
+			}
+
+			std::list<TFreeRange>& FreeList = Heaps[EntryIndex];
+			TFreeRange& Range = FreeList.front();
+			TSlot Slot = { (uint32_t)EntryIndex, Range.Start };
+
+			Range.Start += DESCRIPTOR_SIZE;
+			if (Range.Start == Range.End)
+			{
+				FreeList.pop_front();
+			}
+
+			return Slot;
+		}
+
+		// the original merged a range ending at the freed slot into nothing, here it grows the range
+		void Free(const TSlot& Slot)
+		{
+			std::list<TFreeRange>& FreeList = Heaps[Slot.HeapIndex];
+			const TFreeRange NewRange = { Slot.Handle, Slot.Handle + DESCRIPTOR_SIZE };
+
+			for (auto Node = FreeList.begin(); Node != FreeList.end(); ++Node)
+			{
+				if (Node->Start == NewRange.End)
+				{
+					Node->Start = NewRange.Start;
+					return;
+				}
+				if (Node->End == NewRange.Start)
+				{
+					Node->End = NewRange.End;
+					return;
+				}
+				if (Node->Start > NewRange.Start)
+				{
+					FreeList.insert(Node, NewRange);
+					return;
+				}
+			}
+
+			FreeList.push_back(NewRange);
+		}
+
+	private:
+		struct TFreeRange
+		{
+			uint64_t Start;
+
+			uint64_t End;
+		};
+
+		std::vector<std::list<TFreeRange>> Heaps;
+	};
+
+	// keep NumLive blocks of Count descriptors alive and replace a pseudo random one per step,
+	// returns the nanoseconds per free and allocation pair
+	double TimeSlotIndex(uint32_t Count, uint32_t NumLive, uint32_t NumOperations)
+	{
+		TDescriptorSlotIndex SlotIndex(NUM_DESCRIPTORS_PER_HEAP, DESCRIPTOR_SIZE);
+		std::vector<TDescriptorSlotIndex::TSlot> Live(NumLive);
+
+		auto Allocate = [&SlotIndex, Count](TDescriptorSlotIndex::TSlot& Slot)
+		{
+			if (!SlotIndex.Allocate(Count, Slot))
+			{
+				SlotIndex.AddHeap(HeapBaseHandle(SlotIndex.GetNumHeaps()));
+				SlotIndex.Allocate(Count, Slot);
+			}
+		};
+
+		for (TDescriptorSlotIndex::TSlot& Slot : Live)
+		{
+			Allocate(Slot);
+		}
+
+		TBenchmarkRandom Random(12345);
+
+		TBenchmarkTimer Timer;
+		for (uint32_t i = 0; i < NumOperations; ++i)
+		{
+			TDescriptorSlotIndex::TSlot& Slot = Live[Random.Uniform(NumLive)];
+			SlotIndex.Free(Slot, Count);
+			Allocate(Slot);
+		}
+		const double Seconds = Timer.GetSeconds();
+
+		KeepAlive(SlotIndex.GetNumHeaps());
+		return Seconds * 1e9 / NumOperations;
+	}
+
+	double TimeListSlots(uint32_t NumLive, uint32_t NumOperations)
+	{
+		TListSlotAllocator Allocator;
+		std::vector<TListSlotAllocator::TSlot> Live(NumLive);
+
+		for (TListSlotAllocator::TSlot& Slot : Live)
+		{
+			Slot = Allocator.Allocate();
+		}
+
+		TBenchmarkRandom Random(12345);
+
+		TBenchmarkTimer Timer;
+		for (uint32_t i = 0; i < NumOperations; ++i)
+		{
+			TListSlotAllocator::TSlot& Slot = Live[Random.Uniform(NumLive)];
+			Allocator.Free(Slot);
+			Slot = Allocator.Allocate();
+		}
+		const double Seconds = Timer.GetSeconds();
+
+		KeepAlive(Live[0].Handle);
+		return Seconds * 1e9 / NumOperations;
+	}
+}
+
+// single descriptors, bitmaps against the old range lists on the same random churn over about 16 heaps
+HOST_BENCHMARK(DescriptorSlotsBitmapVsList)
+{
+	const uint32_t NumOperations = ScaleIterations(1000000);
+	const uint32_t NumLive = 16 * NUM_DESCRIPTORS_PER_HEAP;
+
+	const double ListNs = TimeListSlots(NumLive, NumOperations);
+	const double BitmapNs = TimeSlotIndex(1, NumLive, NumOperations);
+
+	printf("%u live descriptors: list %.1f ns, bitmap %.1f ns per free and allocation (%.2fx)\n",
+		NumLive, ListNs, BitmapNs, ListNs / BitmapNs);
+}
+
+// descriptor table ranges placed best fit, the same number of live descriptors as above
+HOST_BENCHMARK(DescriptorSlotRanges)
+{
+	const uint32_t NumOperations = ScaleIterations(1000000);
+	const uint32_t Counts[] = { 4, 16 };
+
+	for (uint32_t Count : Counts)
+	{
+		const uint32_t NumLive = 16 * NUM_DESCRIPTORS_PER_HEAP / Count;
+		printf("%2u descriptors, %5u live ranges: %.1f ns per free and allocation\n", Count, NumLive, TimeSlotIndex(Count, NumLive, NumOperations));
+	}
+}
@@ -0,0 +1,203 @@
+#include "Benchmark.h"
+#include "BuddyAllocator.h"
+#include <set>
+
+namespace
+{
+	// The buddy bookkeeping before the free lists became bitmaps: one std::set of offsets per order,
+	// recursive split and merge, and a scan from the top order in CanAllocate.
+	// Kept here only as the baseline of the comparison below.
+	class TSetBuddyAllocator
+	{
+	public:
+		TSetBuddyAllocator(uint64_t InPoolSize, uint64_t InMinBlockSize)
+			: PoolSize(InPoolSize), MinBlockSize(InMinBlockSize)
+		{
+			MaxOrder = UnitSizeToOrder(SizeToUnitSize(PoolSize));
+			FreeBlocks.resize(MaxOrder + 1);
+			FreeBlocks[MaxOrder].insert(0);
+		}
+
+		bool Allocate(uint64_t Size, TBuddyAllocation& OutAllocation)
+		{
+			if (!CanAllocate(Size))
+			{
+				return false;
+			}
+
+			const uint32_t Order = UnitSizeToOrder(SizeToUnitSize(Size));
+			const uint32_t Offset = AllocateBlock(Order);
+			TotalAllocSize += ((uint64_t)1 << Order) * MinBlockSize;
+
+			OutAllocation.Offset = Offset;
+			OutAllocation.Order = Order;
+			OutAllocation.AlignedOffset = Offset * MinBlockSize;
+
+			return true;
+		}
+
+		void Deallocate(uint32_t Offset, uint32_t Order)
+		{
+			DeallocateBlock(Offset, Order);
+			TotalAllocSize -= ((uint64_t)1 << Order) * MinBlockSize;
+		}
+
+		uint64_t GetTotalAllocSize() const { return TotalAllocSize; }
+
+	private:
+		uint64_t SizeToUnitSize(uint64_t Size) const
+		{
+			return (Size + (MinBlockSize - 1)) / MinBlockSize;
+		}
+
+		static uint32_t UnitSizeToOrder(uint64_t Size)
+		{
+			return Size <= 1 ? 0 : FindHighestSetBit(Size - 1) + 1;
+		}
+
+		bool CanAllocate(uint64_t SizeToAllocate) const
+		{
+			if (TotalAllocSize == PoolSize)
+			{
+				return false;
+			}
+
+			uint64_t BlockSize = PoolSize;
+			for (int32_t i = (int32_t)FreeBlocks.size() - 1; i >= 0; i--)
+			{
+				if (FreeBlocks[i].size() && BlockSize >= SizeToAllocate)
+				{
+					return true;
+				}
+
+				BlockSize = BlockSize >> 1;
+				if (BlockSize < SizeToAllocate)
+				{
+					return false;
+				}
+			}
+
+			return false;
+		}
+
+		uint32_t AllocateBlock(uint32_t Order)
+		{
+			uint32_t Offset;
+
+			if (FreeBlocks[Order].empty())
+			{
+				const uint32_t Left = AllocateBlock(Order + 1);
+				FreeBlocks[Order].insert(Left + (1u << Order));
+				Offset = Left;
+			}
+			else
+			{
+				auto It = FreeBlocks[Order].begin();
+				Offset = *It;
+				FreeBlocks[Order].erase(It);
+			}
+
+			return Offset;
+		}
+
+		void DeallocateBlock(uint32_t Offset, uint32_t Order)
+		{
+			const uint32_t Buddy = Offset ^ (1u << Order);
+
+			auto It = FreeBlocks[Order].find(Buddy);
+			if (It != FreeBlocks[Order].end())
+			{
+				FreeBlocks[Order].erase(It);
+				DeallocateBlock(Offset < Buddy ? Offset : Buddy, Order + 1);
+			}
+			else
+			{
+				FreeBlocks[Order].insert(Offset);
+			}
+		}
+
+	private:
+		uint64_t PoolSize;
+
+		uint64_t MinBlockSize;
+
+		uint32_t MaxOrder;
+
+		uint64_t TotalAllocSize = 0;
+
+		std::vector<std::set<uint32_t>> FreeBlocks;
+	};
+
+	struct TFreeListBenchmarkSettings
+	{
+		uint64_t PoolSize;
+
+		uint32_t NumLive;
+
+		// requests are 256B << [0, MaxSizeShift)
+		uint32_t MaxSizeShift;
+	};
+
+	// alloc/free pairs with a steady live count, both allocators see the same sequence
+	template<typename TAllocateFunc, typename TDeallocateFunc>
+	double TimeChurn(const TFreeListBenchmarkSettings& Settings, uint32_t NumOperations, TAllocateFunc&& Allocate, TDeallocateFunc&& Deallocate)
+	{
+		TBenchmarkRandom Random(42);
+
+		std::vector<TBuddyAllocation> Live(Settings.NumLive);
+		std::vector<bool> bValid(Settings.NumLive);
+		for (uint32_t i = 0; i < Settings.NumLive; ++i)
+		{
+			bValid[i] = Allocate((uint64_t)256 << Random.Uniform(Settings.MaxSizeShift), Live[i]);
+		}
+
+		TBenchmarkTimer Timer;
+		for (uint32_t i = 0; i < NumOperations; ++i)
+		{
+			const uint32_t Index = Random.Uniform(Settings.NumLive);
+			if (bValid[Index])
+			{
+				Deallocate(Live[Index]);
+			}
+			bValid[Index] = Allocate((uint64_t)256 << Random.Uniform(Settings.MaxSizeShift), Live[Index]);
+		}
+
+		return Timer.GetSeconds() * 1e9 / NumOperations;
+	}
+}
+
+// bitmap free lists against the old std::set free lists on the same random churn
+HOST_BENCHMARK(FreeListBitmapVsSet)
+{
+	const uint32_t NumOperations = ScaleIterations(2000000);
+
+	const TFreeListBenchmarkSettings Cases[] =
+	{
+		{ 64ull * 1024 * 1024, 2000, 8 },
+		{ 512ull * 1024 * 1024, 20000, 11 },
+		{ 512ull * 1024 * 1024, 200000, 4 },
+	};
+
+	for (const TFreeListBenchmarkSettings& Settings : Cases)
+	{
+		TSetBuddyAllocator SetAllocator(Settings.PoolSize, 256);
+		const double SetNs = TimeChurn(Settings, NumOperations,
+			[&](uint64_t Size, TBuddyAllocation& Out) { return SetAllocator.Allocate(Size, Out); },
+			[&](const TBuddyAllocation& Allocation) { SetAllocator.Deallocate(Allocation.Offset, Allocation.Order); });
+
+		TBuddyAllocator<THostBackingStore> BitmapAllocator(Settings.PoolSize, 256, 0);
+		const double BitmapNs = TimeChurn(Settings, NumOperations,
+			[&](uint64_t Size, TBuddyAllocation& Out) { return BitmapAllocator.Allocate(Size, 0, Out); },
+			[&](const TBuddyAllocation& Allocation) { BitmapAllocator.Deallocate(Allocation.Offset, Allocation.Order); });
+
+		// the same sequence has to end in the same state
+		if (SetAllocator.GetTotalAllocSize() != BitmapAllocator.GetTotalAllocSize())
+		{
+			printf("  allocators diverged\n");
+		}
+
+		printf("pool %4lluMB, %6u live, up to %6lluB: std::set %6.1f ns, bitmap %6.1f ns per pair (%.2fx)\n",
+			(unsigned long long)(Settings.PoolSize >> 20), Settings.NumLive, (unsigned long long)(256ull << (Settings.MaxSizeShift - 1)),
+			SetNs, BitmapNs, SetNs / BitmapNs);
+	}
+}
@@ -0,0 +1,376 @@
+#include "Benchmark.h"
+#include "BuddyAllocator.h"
+#include <memory>
+#include <mutex>
+
+// The allocation path of TD3D12MultiBuddyAllocator on host pools, once as it was before the pool policies
+// and once specialized with TD3D12PoolPolicy. The D3D12 pools need a device, so both are mirrored here
+// on TBuddyAllocator<THostBackingStore> with the same calls, locks and branches, see D3D12MemoryAllocator.h
+namespace
+{
+	// D3D12_HEAP_TYPE values
+	enum EHostHeapType
+	{
+		HOST_HEAP_TYPE_DEFAULT = 1,
+		HOST_HEAP_TYPE_UPLOAD = 2,
+	};
+
+	enum class EHostAllocationStrategy
+	{
+		PlacedResource,
+		ManualSubAllocation,
+	};
+
+	struct THostInitData
+	{
+		EHostHeapType HeapType = HOST_HEAP_TYPE_DEFAULT;
+
+		EHostAllocationStrategy AllocatioStrategy = EHostAllocationStrategy::PlacedResource;
+
+		uint64_t PoolSize = 64ull * 1024 * 1024;
+
+		uint64_t MinBlockSize = 256;
+	};
+
+	class THostSubAllocator;
+
+	// the fields of TD3D12ResourceLocation the allocation path writes
+	struct THostResourceLocation
+	{
+		bool bSubAllocation = false;
+
+		uint32_t Order = 0;
+		uint32_t Offset = 0;
+		uint64_t ActualUsedSize = 0;
+
+		THostSubAllocator* Allocator = nullptr;
+
+		const uint8_t* UnderlyingResource = nullptr;
+
+		uint64_t OffsetFromBaseOfResource = 0;
+		uint64_t OffsetFromBaseOfHeap = 0;
+		uint64_t GPUVirtualAddress = 0;
+
+		void* MappedAddress = nullptr;
+	};
+
+	// TD3D12PoolPolicy
+	template<EHostHeapType InHeapType, EHostAllocationStrategy InStrategy>
+	struct THostPoolPolicy
+	{
+		static constexpr EHostHeapType HeapType = InHeapType;
+
+		static constexpr EHostAllocationStrategy Strategy = InStrategy;
+
+		static constexpr bool bPlaced = InStrategy == EHostAllocationStrategy::PlacedResource;
+	};
+
+	typedef THostPoolPolicy<HOST_HEAP_TYPE_UPLOAD, EHostAllocationStrategy::ManualSubAllocation> THostUploadBufferPolicy;
+	typedef THostPoolPolicy<HOST_HEAP_TYPE_DEFAULT, EHostAllocationStrategy::ManualSubAllocation> THostDefaultBufferPolicy;
+	typedef THostPoolPolicy<HOST_HEAP_TYPE_DEFAULT, EHostAllocationStrategy::PlacedResource> THostTexturePolicy;
+	typedef THostPoolPolicy<HOST_HEAP_TYPE_DEFAULT, EHostAllocationStrategy::PlacedResource> THostRenderTargetPolicy;
+
+	// TD3D12SubAllocator with a buddy pool, AssignLocation is the runtime path as it was before the policies
+	class THostSubAllocator
+	{
+	public:
+		explicit THostSubAllocator(const THostInitData& InInitData)
+			: InitData(InInitData), Buddy(InInitData.PoolSize, InInitData.MinBlockSize, 0)
+		{
+			BackingBase = Buddy.GetBackingStore().GetBaseAddress();
+		}
+
+		virtual ~THostSubAllocator() = default;
+
+		virtual bool AllocResource(uint64_t Size, uint64_t Alignment, THostResourceLocation& ResourceLocation) = 0;
+
+		virtual int32_t GetLargestFreeOrder() const = 0;
+
+		void Deallocate(THostResourceLocation& ResourceLocation)
+		{
+			std::lock_guard<std::mutex> Lock(DeletionMutex);
+
+			Buddy.Deallocate(ResourceLocation.Offset, ResourceLocation.Order);
+			--NumBlocks;
+			RequestedSize -= ResourceLocation.ActualUsedSize;
+		}
+
+	protected:
+		void AssignLocation(uint32_t Offset, uint32_t Order, uint64_t AlignedOffset, uint64_t Size, THostResourceLocation& ResourceLocation)
+		{
+			const uint64_t AlignedOffsetFromResourceBase = AlignedOffset;
+
+			ResourceLocation.bSubAllocation = true;
+			ResourceLocation.Order = Order;
+			ResourceLocation.Offset = Offset;
+			ResourceLocation.ActualUsedSize = Size;
+			ResourceLocation.Allocator = this;
+
+			if (InitData.AllocatioStrategy == EHostAllocationStrategy::ManualSubAllocation)
+			{
+				ResourceLocation.UnderlyingResource = BackingBase;
+				ResourceLocation.OffsetFromBaseOfResource = AlignedOffsetFromResourceBase;
+				ResourceLocation.GPUVirtualAddress = (uint64_t)BackingBase + AlignedOffsetFromResourceBase;
+
+				if (InitData.HeapType == HOST_HEAP_TYPE_UPLOAD)
+				{
+					ResourceLocation.MappedAddress = BackingBase + AlignedOffsetFromResourceBase;
+				}
+			}
+			else
+			{
+				ResourceLocation.OffsetFromBaseOfHeap = AlignedOffsetFromResourceBase;
+			}
+
+			TrackLocation(Size);
+		}
+
+		template<typename TPolicy>
+		void AssignPoolLocation(uint32_t Offset, uint32_t Order, uint64_t AlignedOffset, uint64_t Size, THostResourceLocation& ResourceLocation)
+		{
+			const uint64_t AlignedOffsetFromResourceBase = AlignedOffset;
+
+			ResourceLocation.bSubAllocation = true;
+			ResourceLocation.Order = Order;
+			ResourceLocation.Offset = Offset;
+			ResourceLocation.ActualUsedSize = Size;
+			ResourceLocation.Allocator = this;
+
+			if constexpr (TPolicy::bPlaced)
+			{
+				ResourceLocation.OffsetFromBaseOfHeap = AlignedOffsetFromResourceBase;
+			}
+			else
+			{
+				ResourceLocation.UnderlyingResource = BackingBase;
+				ResourceLocation.OffsetFromBaseOfResource = AlignedOffsetFromResourceBase;
+				ResourceLocation.GPUVirtualAddress = (uint64_t)BackingBase + AlignedOffsetFromResourceBase;
+
+				if constexpr (TPolicy::HeapType == HOST_HEAP_TYPE_UPLOAD)
+				{
+					ResourceLocation.MappedAddress = BackingBase + AlignedOffsetFromResourceBase;
+				}
+			}
+
+			TrackLocation(Size);
+		}
+
+	private:
+		// the live location set of the D3D12 pools is left out, both paths would pay the same insert
+		void TrackLocation(uint64_t Size)
+		{
+			std::lock_guard<std::mutex> Lock(DeletionMutex);
+
+			++NumBlocks;
+			RequestedSize += Size;
+		}
+
+	protected:
+		const THostInitData InitData;
+
+		TBuddyAllocator<THostBackingStore> Buddy;
+
+		uint8_t* BackingBase = nullptr;
+
+	private:
+		std::mutex DeletionMutex;
+
+		uint32_t NumBlocks = 0;
+
+		uint64_t RequestedSize = 0;
+	};
+
+	// TD3D12BuddyAllocator before the policies
+	class THostRuntimePool : public THostSubAllocator
+	{
+	public:
+		using THostSubAllocator::THostSubAllocator;
+
+		bool AllocResource(uint64_t Size, uint64_t Alignment, THostResourceLocation& ResourceLocation) override
+		{
+			TBuddyAllocation Allocation;
+
+			if (!Buddy.Allocate(Size, Alignment, Allocation))
+			{
+				return false;
+			}
+
+			AssignLocation(Allocation.Offset, Allocation.Order, Allocation.AlignedOffset, Size, ResourceLocation);
+
+			return true;
+		}
+
+		int32_t GetLargestFreeOrder() const override { return Buddy.GetLargestFreeOrder(); }
+	};
+
+	// TD3D12BuddyPool<TPolicy>
+	template<typename TPolicy>
+	class THostPolicyPool final : public THostSubAllocator
+	{
+	public:
+		using THostSubAllocator::THostSubAllocator;
+
+		bool AllocPoolResource(uint64_t Size, uint64_t Alignment, THostResourceLocation& ResourceLocation)
+		{
+			TBuddyAllocation Allocation;
+
+			if (!Buddy.Allocate(Size, Alignment, Allocation))
+			{
+				return false;
+			}
+
+			AssignPoolLocation<TPolicy>(Allocation.Offset, Allocation.Order, Allocation.AlignedOffset, Size, ResourceLocation);
+
+			return true;
+		}
+
+		bool AllocResource(uint64_t Size, uint64_t Alignment, THostResourceLocation& ResourceLocation) override
+		{
+			return AllocPoolResource(Size, Alignment, ResourceLocation);
+		}
+
+		int32_t GetLargestFreeOrder() const override { return Buddy.GetLargestFreeOrder(); }
+	};
+
+	// TD3D12MultiBuddyAllocator::AllocResource, through the base class or through the typed pool
+	template<typename TPolicy, bool bSpecialized>
+	class THostMultiPool
+	{
+	public:
+		explicit THostMultiPool(const THostInitData& InInitData)
+			: InitData(InInitData)
+		{
+		}
+
+		bool AllocResource(uint64_t Size, uint64_t Alignment, THostResourceLocation& ResourceLocation)
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+
+			const uint32_t Order = TBuddyAllocator<THostBackingStore>::GetAllocationOrder(Size, Alignment, InitData.MinBlockSize);
+
+			uint32_t Slot = 0;
+			if (!Index.Find(Order, Slot))
+			{
+				Slot = CreatePool();
+			}
+
+			THostSubAllocator* Allocator = Pools[Slot].get();
+
+			if constexpr (bSpecialized)
+			{
+				// final class, neither call goes through the vtable
+				THostPolicyPool<TPolicy>* Pool = static_cast<THostPolicyPool<TPolicy>*>(Allocator);
+				Pool->AllocPoolResource(Size, Alignment, ResourceLocation);
+				Index.Update(Slot, Pool->GetLargestFreeOrder());
+			}
+			else
+			{
+				Allocator->AllocResource(Size, Alignment, ResourceLocation);
+				Index.Update(Slot, Allocator->GetLargestFreeOrder());
+			}
+
+			return true;
+		}
+
+		// not timed, the same for both paths
+		void Free(THostResourceLocation& ResourceLocation)
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+
+			for (uint32_t Slot = 0; Slot < Pools.size(); ++Slot)
+			{
+				if (Pools[Slot].get() == ResourceLocation.Allocator)
+				{
+					Pools[Slot]->Deallocate(ResourceLocation);
+					Index.Update(Slot, Pools[Slot]->GetLargestFreeOrder());
+					break;
+				}
+			}
+		}
+
+	private:
+		uint32_t CreatePool()
+		{
+			if constexpr (bSpecialized)
+			{
+				Pools.push_back(std::make_unique<THostPolicyPool<TPolicy>>(InitData));
+			}
+			else
+			{
+				Pools.push_back(std::make_unique<THostRuntimePool>(InitData));
+			}
+
+			return (uint32_t)Pools.size() - 1;
+		}
+
+	private:
+		const THostInitData InitData;
+
+		std::mutex Mutex;
+
+		std::vector<std::unique_ptr<THostSubAllocator>> Pools;
+
+		TBuddyPoolIndex Index;
+	};
+
+	// allocate NumAllocations blocks of one minimum block in batches, returns the nanoseconds per allocation.
+	// the batches are freed outside the timed loop, like BenchmarkAllocationPaths did
+	template<typename TPolicy, bool bSpecialized>
+	double TimeAllocationPath(const THostInitData& InitData, uint32_t NumAllocations)
+	{
+		const uint32_t BatchSize = 1024;
+
+		THostMultiPool<TPolicy, bSpecialized> MultiPool(InitData);
+		std::vector<THostResourceLocation> Batch(BatchSize);
+
+		double Seconds = 0.0;
+		uint64_t Checksum = 0;
+
+		for (uint32_t Done = 0; Done < NumAllocations; Done += BatchSize)
+		{
+			TBenchmarkTimer Timer;
+			for (THostResourceLocation& Location : Batch)
+			{
+				MultiPool.AllocResource(InitData.MinBlockSize, InitData.MinBlockSize, Location);
+			}
+			Seconds += Timer.GetSeconds();
+
+			for (THostResourceLocation& Location : Batch)
+			{
+				Checksum += Location.OffsetFromBaseOfResource + Location.OffsetFromBaseOfHeap;
+				MultiPool.Free(Location);
+			}
+		}
+
+		KeepAlive(Checksum);
+
+		const uint32_t NumTimed = (NumAllocations + BatchSize - 1) / BatchSize * BatchSize;
+		return Seconds * 1e9 / NumTimed;
+	}
+
+	template<typename TPolicy>
+	void BenchmarkPolicy(const char* Name, uint64_t MinBlockSize, uint32_t NumAllocations)
+	{
+		THostInitData InitData;
+		InitData.HeapType = TPolicy::HeapType;
+		InitData.AllocatioStrategy = TPolicy::Strategy;
+		InitData.MinBlockSize = MinBlockSize;
+
+		const double RuntimeNs = TimeAllocationPath<TPolicy, false>(InitData, NumAllocations);
+		const double SpecializedNs = TimeAllocationPath<TPolicy, true>(InitData, NumAllocations);
+
+		printf("%-14s runtime %6.1f ns, specialized %6.1f ns per allocation\n", Name, RuntimeNs, SpecializedNs);
+	}
+}
+
+// the pool allocation path before and after TD3D12PoolPolicy, one pool kind at a time
+HOST_BENCHMARK(PoolPolicyAllocationPath)
+{
+	const uint32_t NumAllocations = ScaleIterations(2000000);
+
+	// buffers in 256 byte blocks, placed resources at the 64KB placement alignment
+	BenchmarkPolicy<THostUploadBufferPolicy>("Upload", 256, NumAllocations);
+	BenchmarkPolicy<THostDefaultBufferPolicy>("DefaultBuffer", 256, NumAllocations);
+	BenchmarkPolicy<THostTexturePolicy>("Texture", 65536, NumAllocations);
+	BenchmarkPolicy<THostRenderTargetPolicy>("RenderTarget", 65536, NumAllocations);
+}
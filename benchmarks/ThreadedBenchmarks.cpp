@@ -0,0 +1,193 @@
+#include "Benchmark.h"
+#include "BuddyAllocator.h"
+#include "FencedDeletionQueue.h"
+#include "RingAllocator.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+	struct THostBlock
+	{
+		uint32_t Pool = 0;
+
+		TBuddyAllocation Allocation;
+	};
+
+	// The locking of TD3D12MultiBuddyAllocator and TD3D12SubAllocator on host pools:
+	// one mutex around the pool index and the pools for allocation, frees are queued under a second mutex
+	// with the fence value read inside it and retired by the render thread.
+	class THostPoolSet
+	{
+	public:
+		THostPoolSet(uint64_t InPoolSize, uint64_t InMinBlockSize)
+			: PoolSize(InPoolSize), MinBlockSize(InMinBlockSize)
+		{
+		}
+
+		void Allocate(uint64_t Size, THostBlock& OutBlock)
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+
+			const uint32_t Order = TBuddyAllocator<THostBackingStore>::GetAllocationOrder(Size, 0, MinBlockSize);
+
+			uint32_t Slot = 0;
+			if (!Index.Find(Order, Slot))
+			{
+				Slot = (uint32_t)Pools.size();
+				Pools.push_back(std::make_unique<TBuddyAllocator<THostBackingStore>>(PoolSize, MinBlockSize, 0));
+			}
+
+			Pools[Slot]->Allocate(Size, 0, OutBlock.Allocation);
+			OutBlock.Pool = Slot;
+			Index.Update(Slot, Pools[Slot]->GetLargestFreeOrder());
+		}
+
+		void Free(const THostBlock& Block, const std::atomic<uint64_t>& NextFenceValue)
+		{
+			std::lock_guard<std::mutex> Lock(DeletionMutex);
+
+			PendingFrees.Enqueue(Block, NextFenceValue.load(std::memory_order_acquire));
+		}
+
+		// render thread
+		void Retire(uint64_t CompletedFenceValue)
+		{
+			std::vector<THostBlock> Retired;
+			{
+				std::lock_guard<std::mutex> Lock(DeletionMutex);
+				PendingFrees.Retire(CompletedFenceValue, [&Retired](const THostBlock& Block) { Retired.push_back(Block); });
+			}
+
+			std::lock_guard<std::mutex> Lock(Mutex);
+			for (const THostBlock& Block : Retired)
+			{
+				Pools[Block.Pool]->Deallocate(Block.Allocation.Offset, Block.Allocation.Order);
+				Index.Update(Block.Pool, Pools[Block.Pool]->GetLargestFreeOrder());
+			}
+		}
+
+	private:
+		const uint64_t PoolSize;
+
+		const uint64_t MinBlockSize;
+
+		std::mutex Mutex;
+
+		std::vector<std::unique_ptr<TBuddyAllocator<THostBackingStore>>> Pools;
+
+		TBuddyPoolIndex Index;
+
+		std::mutex DeletionMutex;
+
+		TFencedDeletionQueue<THostBlock> PendingFrees;
+	};
+
+	// runs Worker(ThreadIndex) on NumThreads loader threads while the calling thread plays the render thread:
+	// it advances the fence and calls Retire with the GPU two frames behind until the workers are done
+	template<typename TWorker, typename TRetire>
+	double RunWithRenderThread(uint32_t NumThreads, std::atomic<uint64_t>& NextFenceValue, TWorker&& Worker, TRetire&& Retire)
+	{
+		std::atomic<uint32_t> NumRunning = NumThreads;
+		std::vector<std::thread> Threads;
+
+		TBenchmarkTimer Timer;
+
+		for (uint32_t ThreadIndex = 0; ThreadIndex < NumThreads; ++ThreadIndex)
+		{
+			Threads.emplace_back([&, ThreadIndex]()
+			{
+				Worker(ThreadIndex);
+				--NumRunning;
+			});
+		}
+
+		while (NumRunning.load() != 0)
+		{
+			const uint64_t Frame = NextFenceValue.fetch_add(1);
+			Retire(Frame, Frame > 2 ? Frame - 2 : 0);
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+
+		for (std::thread& Thread : Threads)
+		{
+			Thread.join();
+		}
+
+		return Timer.GetSeconds();
+	}
+}
+
+// buffer sized blocks from loader threads through the locked pool set, every thread keeps a window of live blocks
+HOST_BENCHMARK(ThreadedPoolAllocation)
+{
+	const uint32_t AllocationsPerThread = ScaleIterations(200000);
+	const uint32_t WindowSize = 64;
+
+	for (uint32_t NumThreads = 1; NumThreads <= 8; NumThreads *= 2)
+	{
+		THostPoolSet PoolSet(64ull * 1024 * 1024, 256);
+		std::atomic<uint64_t> NextFenceValue = 1;
+
+		const double Seconds = RunWithRenderThread(NumThreads, NextFenceValue, [&](uint32_t ThreadIndex)
+		{
+			std::vector<THostBlock> Window(WindowSize);
+			std::vector<bool> bLive(WindowSize, false);
+
+			for (uint32_t i = 0; i < AllocationsPerThread; ++i)
+			{
+				const uint32_t Slot = i % WindowSize;
+				if (bLive[Slot])
+				{
+					PoolSet.Free(Window[Slot], NextFenceValue);
+				}
+
+				const uint64_t Size = 64 + (i * 97 + ThreadIndex * 31) % (64 * 1024);
+				PoolSet.Allocate(Size, Window[Slot]);
+				bLive[Slot] = true;
+			}
+		},
+		[&](uint64_t, uint64_t CompletedFenceValue)
+		{
+			PoolSet.Retire(CompletedFenceValue);
+		});
+
+		printf("%u threads: %.0f allocations/s\n", NumThreads, NumThreads * AllocationsPerThread / Seconds);
+	}
+}
+
+// constant buffer sized allocations from loader threads on the lock free ring while the render thread retires
+HOST_BENCHMARK(ThreadedRingAllocation)
+{
+	const uint32_t AllocationsPerThread = ScaleIterations(1000000);
+
+	for (uint32_t NumThreads = 1; NumThreads <= 8; NumThreads *= 2)
+	{
+		// the ring is only bookkeeping, a huge capacity keeps it from filling up so the numbers are the cost of Allocate
+		TRingAllocator Ring(1ull << 40);
+		std::atomic<uint64_t> NextFenceValue = 1;
+		std::atomic<uint64_t> NumFull = 0;
+
+		const double Seconds = RunWithRenderThread(NumThreads, NextFenceValue, [&](uint32_t ThreadIndex)
+		{
+			uint64_t Offset = 0;
+			for (uint32_t i = 0; i < AllocationsPerThread; ++i)
+			{
+				const uint64_t Size = 256 * (1 + (i + ThreadIndex) % 4);
+				if (!Ring.Allocate(Size, 256, Offset))
+				{
+					NumFull.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+		},
+		[&](uint64_t Frame, uint64_t CompletedFenceValue)
+		{
+			Ring.FinishFrame(Frame);
+			Ring.Retire(CompletedFenceValue);
+		});
+
+		printf("%u threads: %.0f allocations/s, %llu failed\n", NumThreads, NumThreads * AllocationsPerThread / Seconds, (unsigned long long)NumFull.load());
+	}
+}
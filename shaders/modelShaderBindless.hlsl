@@ -0,0 +1,74 @@
+
+cbuffer objCBuffer : register(b0)
+{
+    float4x4 ModelMat;
+}
+
+cbuffer passCBuffer : register(b1)
+{
+    float4x4 ViewMat;
+    float4x4 ProjMat;
+    float3 gEyePosW;
+    float pad0;
+}
+
+// root constants, set per draw
+cbuffer drawConstants : register(b0, space1)
+{
+    uint DiffuseIndex;
+}
+
+// every texture of TD3D12RHI::BindlessHeap
+Texture2D BindlessTextures[] : register(t0, space1);
+
+SamplerState PointWrapSampler : register(s0);
+SamplerState PointClampSampler : register(s1);
+SamplerState LinearWrapSampler : register(s2);
+SamplerState LinearClampSampler : register(s3);
+SamplerState AnisotropicWrapSampler : register(s4);
+SamplerState AnisotropicClampSampler : register(s5);
+
+struct VSInput
+{
+    float4 position : POSITION;
+    float3 normal : NORMAL;
+    float3 tangent : TANGENT;
+    float2 tex : TEXCOORD;
+};
+
+struct PSInput
+{
+    float4 position : SV_Position;
+    float3 positionW : POSITION;
+    float3 normal : NORMAL;
+    float2 tex : TEXCOORD;
+};
+
+PSInput VSMain(VSInput vin)
+{
+    PSInput vout;
+    vout.positionW = mul(float4(vin.position.xyz, 1.0f), ModelMat);
+    vout.position = mul(mul(float4(vout.positionW, 1.0f), ViewMat), ProjMat);
+    vout.tex = vin.tex;
+    vout.normal = vin.normal;
+    return vout;
+}
+
+float4 PSMain(PSInput pin) : SV_Target
+{
+    float3 lightPos = float3(0, 200.0, -50.0);
+    
+    // the index is the same for the whole draw
+    float3 diffuse = BindlessTextures[DiffuseIndex].Sample(LinearWrapSampler, pin.tex).xyz;
+    pin.normal = normalize(pin.normal);
+    
+    float3 lightDir = normalize(lightPos - pin.positionW);
+    
+    float NdotL = max(dot(lightDir, pin.normal), 0.0);
+    
+    float3 ambient = diffuse * 0.2;
+    
+    float3 color = diffuse * NdotL + ambient;
+    
+    return float4(color, 1.0);
+}
@@ -9,6 +9,7 @@
 #include "PSOManager.h"
 #include "ModelManager.h"
 #include "TextureManager.h"
+#include <fstream>
 
 using namespace TD3D12RHI;
 using TD3D12RHI::g_CommandContext;
@@ -24,12 +25,52 @@ GameCore::GameCore(uint32_t width, uint32_t height, std::wstring name)
 	g_DisplayHeight = height;
 }
 
+// 32 bit BMP of a R8G8B8A8_UNORM back buffer, written from the readback callback
+static void SaveScreenshot(const char* FileName, const TD3D12ReadbackData& Data)
+{
+	if (Data.Format != DXGI_FORMAT_R8G8B8A8_UNORM)
+	{
+		return;
+	}
+
+	BITMAPINFOHEADER Info = {};
+	Info.biSize = sizeof(Info);
+	Info.biWidth = Data.Width;
+	Info.biHeight = -(LONG)Data.Height; // top down
+	Info.biPlanes = 1;
+	Info.biBitCount = 32;
+	Info.biCompression = BI_RGB;
+	Info.biSizeImage = Data.Width * Data.Height * 4;
+
+	BITMAPFILEHEADER Header = {};
+	Header.bfType = 0x4D42; // "BM"
+	Header.bfOffBits = sizeof(Header) + sizeof(Info);
+	Header.bfSize = Header.bfOffBits + Info.biSizeImage;
+
+	std::ofstream File(FileName, std::ios::binary);
+	File.write((const char*)&Header, sizeof(Header));
+	File.write((const char*)&Info, sizeof(Info));
+
+	// BMP stores BGRA, the readback rows are padded to RowPitch
+	std::vector<uint8_t> Row(Data.Width * 4);
+	for (uint32_t y = 0; y < Data.Height; ++y)
+	{
+		const uint8_t* Src = (const uint8_t*)Data.Data + (uint64_t)y * Data.RowPitch;
+		for (uint32_t x = 0; x < Data.Width; ++x)
+		{
+			Row[x * 4 + 0] = Src[x * 4 + 2];
+			Row[x * 4 + 1] = Src[x * 4 + 1];
+			Row[x * 4 + 2] = Src[x * 4 + 0];
+			Row[x * 4 + 3] = Src[x * 4 + 3];
+		}
+		File.write((const char*)Row.data(), Row.size());
+	}
+}
+
 void GameCore::OnInit()
 {
 	LoadPipeline();
 	LoadAssets();
-
-	
 }
 
 void GameCore::OnUpdate(const GameTimer& gt)
@@ -61,7 +102,7 @@ void GameCore::OnUpdate(const GameTimer& gt)
 	XMStoreFloat4x4(&passCB.ProjMat, XMMatrixTranspose(m_Camera.GetProjMat()));
 
 	passCB.EyePosition = m_Camera.GetPosition3f();
-	passCBufferRef = TD3D12RHI::CreateConstantBuffer(&passCB, sizeof(PassCBuffer));
+	passCBufferRef = TD3D12RHI::CreateConstantBuffer(&passCB, sizeof(PassCBuffer), true);
 }
 
 void GameCore::OnRender()
@@ -74,16 +115,38 @@ void GameCore::OnRender()
 	if (ImGuiManager::show_demo_window)
 		ImGui::ShowDemoWindow(&ImGuiManager::show_demo_window);
 
+	// pool usage over time, recorded even while the window is closed
+	ImGuiManager::AllocatorStatsWindow(&ImGuiManager::show_allocator_stats);
+
 	// 2. Show a simple window that we create ourselves. We use a Begin/End pair to create a named window.
 	{
 		//static int counter = 0;
 		//static char buffer[1024];
 		ImGui::Begin("ImGui!");                          // Create a window called "ImGui!" and append into it.
 		ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+		ImGui::Text("GPU %.3f ms/frame", TD3D12RHI::GetGpuFrameTime());
+		const TD3D12DescriptorCacheStats& DescriptorStats = g_CommandContext.GetDescriptorCache()->GetLastFrameStats();
+		ImGui::Text("Descriptor tables %u reused, %u copied (%u descriptors)", DescriptorStats.NumTableHits, DescriptorStats.NumTableMisses, DescriptorStats.NumCopiedDescriptors);
 
 		               // Display some text (you can use a format strings too)
 		ImGui::Checkbox("Demo Window", &ImGuiManager::show_demo_window);      // Edit bools storing our window open/close state
+		ImGui::Checkbox("Allocator Stats", &ImGuiManager::show_allocator_stats);
+		ImGui::SameLine();
+		if (ImGui::Button("Screenshot"))
+		{
+			bScreenshotRequested = true;
+		}
 		//ImGui::Checkbox("Another Window", &show_another_window);
+		// textures indexed from one persistent heap, no descriptor copies per draw
+		if (TD3D12RHI::BindlessHeap)
+		{
+			ImGui::Checkbox("Bindless", &bBindless);
+		}
+		// the reserved texture only pays for the mips it has, the list is closed here so the uploads can submit
+		if (TextureManager::m_StreamedTexture && ImGui::SliderInt("Streamed Mip", &StreamedMip, 0, STREAMED_TEXTURE_MAX_MIP))
+		{
+			TextureManager::StreamTexture((uint32_t)StreamedMip);
+		}
 		ImGui::Text("Model Control Parameters");
 		ImGui::SliderFloat("RotationY", &RotationY, 0.0f, 1.0f);            // Edit 1 float using a slider from 0.0f to 1.0f
 		ImGui::SliderFloat("Scale", &scale, 0.0f, 10.0f);            // Edit 1 float using a slider from 0.0f to 1.0f
@@ -134,12 +197,17 @@ void GameCore::OnDestroy()
 	ModelManager::DestroyModel();
 
 	TextureManager::DestroyTexture();
+
+#if ALLOCATION_TRACKING
+	// the managers have released their resources, anything left here is owned by a global or leaked
+	TD3D12AllocationTracker::Get().ReportLiveAllocations();
+#endif
 }
 
 void GameCore::DrawMesh(TD3D12CommandContext& gfxContext, ModelLoader& model, TShader& shader)
 {
 	auto obj = model.GetObjCBuffer();
-	objCBufferRef = TD3D12RHI::CreateConstantBuffer(&obj, sizeof(ObjCBuffer));
+	objCBufferRef = TD3D12RHI::CreateConstantBuffer(&obj, sizeof(ObjCBuffer), true);
 	auto meshes = model.GetMeshes();
 	for (UINT i = 0; i < meshes.size(); ++i)
 	{
@@ -156,12 +224,28 @@ void GameCore::DrawMesh(TD3D12CommandContext& gfxContext, ModelLoader& model, TS
 		//m_shader->SetParameter("specularMap", SRV[1]);
 		//m_shader->SetParameter("normalMap", SRV[2]);
 
-		shader.SetDescriptorCache(meshes[i].GetTD3D12DescriptorCache());
 		shader.BindParameters();
 		meshes[i].DrawMesh(g_CommandContext);
 	}
 }
 
+void GameCore::DrawMeshBindless(TD3D12CommandContext& gfxContext, ModelLoader& model, TShader& shader)
+{
+	auto obj = model.GetObjCBuffer();
+	objCBufferRef = TD3D12RHI::CreateConstantBuffer(&obj, sizeof(ObjCBuffer), true);
+	auto meshes = model.GetMeshes();
+	for (UINT i = 0; i < meshes.size(); ++i)
+	{
+		shader.SetParameter("objCBuffer", objCBufferRef);
+		shader.SetParameter("passCBuffer", passCBufferRef);
+		// a root constant instead of copying the SRV, meshes without textures read the null view
+		shader.SetParameter("DiffuseIndex", meshes[i].GetBindlessIndex(0));
+
+		shader.BindParameters();
+		meshes[i].DrawMesh(gfxContext);
+	}
+}
+
 void GameCore::LoadPipeline()
 {
 	uint32_t dxgiFactoryFlags = 0;
@@ -243,6 +327,9 @@ void GameCore::LoadAssets()
 	TextureManager::LoadTexture();
 
 	g_CommandContext.FlushCommandQueue();
+
+	// the staging buffers used for loading are idle now
+	TD3D12RHI::Trim();
 }
 
 void GameCore::PopulateCommandList()
@@ -253,6 +340,14 @@ void GameCore::PopulateCommandList()
 	g_CommandContext.ResetCommandAllocator();
 	g_CommandContext.ResetCommandList();
 
+	TD3D12RHI::BeginGpuFrame();
+
+	// compact the texture pools a little every frame, the copies run ahead of this frame's draws
+	TD3D12RHI::Defragment();
+
+	// the transients of the scene pass take over their memory from the previous passes
+	TD3D12RHI::AliasingBarriers(SCENE_PASS);
+
 	// set necessary state
 	g_CommandContext.GetCommandList()->SetGraphicsRootSignature(PSOManager::m_gfxPSOMap["pso"].GetRootSignature());
 	g_CommandContext.GetCommandList()->RSSetViewports(1, &m_viewport);
@@ -271,8 +366,21 @@ void GameCore::PopulateCommandList()
 	// Record commands
 	g_CommandContext.GetCommandList()->SetPipelineState(PSOManager::m_gfxPSOMap["pso"].GetPSO());
 
-	DrawMesh(g_CommandContext, ModelManager::m_ModelMaps["nanosuit"], m_shaderMap["modelShader"]);
-	DrawMesh(g_CommandContext, ModelManager::m_ModelMaps["wall"], m_shaderMap["modelShader"]);
+	if (bBindless)
+	{
+		// the heap stays bound for every model draw
+		g_CommandContext.SetDescriptorHeap(TD3D12RHI::BindlessHeap->GetHeap());
+		g_CommandContext.GetCommandList()->SetGraphicsRootSignature(PSOManager::m_gfxPSOMap["bindlessPSO"].GetRootSignature());
+		g_CommandContext.GetCommandList()->SetPipelineState(PSOManager::m_gfxPSOMap["bindlessPSO"].GetPSO());
+
+		DrawMeshBindless(g_CommandContext, ModelManager::m_ModelMaps["nanosuit"], m_shaderMap["modelShaderBindless"]);
+		DrawMeshBindless(g_CommandContext, ModelManager::m_ModelMaps["wall"], m_shaderMap["modelShaderBindless"]);
+	}
+	else
+	{
+		DrawMesh(g_CommandContext, ModelManager::m_ModelMaps["nanosuit"], m_shaderMap["modelShader"]);
+		DrawMesh(g_CommandContext, ModelManager::m_ModelMaps["wall"], m_shaderMap["modelShader"]);
+	}
 
 	// sky box
 	g_CommandContext.GetCommandList()->SetGraphicsRootSignature(PSOManager::m_gfxPSOMap["skyboxPSO"].GetRootSignature());
@@ -281,25 +389,40 @@ void GameCore::PopulateCommandList()
 	m_shaderMap["skyboxShader"].SetParameter("objCBuffer", objCBufferRef);
 	m_shaderMap["skyboxShader"].SetParameter("passCBuffer", passCBufferRef);
 	m_shaderMap["skyboxShader"].SetParameter("CubeMap", TextureManager::m_SrvMaps["skybox"]);
-	m_shaderMap["skyboxShader"].SetDescriptorCache(boxMeshes.GetTD3D12DescriptorCache());
+	TextureManager::m_TextureMaps["skybox"].MarkUsed();
 	m_shaderMap["skyboxShader"].BindParameters();
 	boxMeshes.DrawMesh(g_CommandContext);
 
+	// the scene without the UI, saved once the GPU has finished the frame. a full readback ring retries next frame
+	if (bScreenshotRequested)
+	{
+		bScreenshotRequested = !TD3D12RHI::Readback(m_renderTragetrs[m_frameIndex].GetD3D12Resource(), [](const TD3D12ReadbackData& Data)
+		{
+			SaveScreenshot("Screenshot.bmp", Data);
+		});
+	}
+
 	// ImGui
-	ID3D12DescriptorHeap* Heaps2[] = { g_ImGuiSrvHeap.Get() };
-	g_CommandContext.GetCommandList()->SetDescriptorHeaps(1, Heaps2);
+	g_CommandContext.SetDescriptorHeap(g_ImGuiSrvHeap.Get());
 	ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), g_CommandContext.GetCommandList());
 
 	// indicate that the back buffer will now be used to present
 	g_CommandContext.Transition(m_renderTragetrs[m_frameIndex].GetD3D12Resource(), D3D12_RESOURCE_STATE_PRESENT);
 	g_CommandContext.Transition(g_DepthBuffer.GetD3D12Resource(), D3D12_RESOURCE_STATE_COMMON);
+
+	TD3D12RHI::EndGpuFrame();
 }
 
 void GameCore::WaitForPreviousFrame()
 {
+	TD3D12RHI::EndFrame();
+
 	g_CommandContext.FlushCommandQueue();
-	
-	DescriptorCache->Reset();
+
+	// recycle the allocations released before the fence we just waited on
+	TD3D12RHI::CleanUpAllocations();
+
+	TD3D12RHI::UpdateResidency();
 
 	m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
 }
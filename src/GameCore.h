@@ -8,6 +8,7 @@
 #include "ModelLoader.h"
 #include "Mesh.h"
 #include "Shader.h"
+#include "TextureManager.h"
 
 using namespace DirectX;
 
@@ -37,6 +38,9 @@ private:
 
 	void DrawMesh(TD3D12CommandContext& gfxContext, ModelLoader& model, TShader& shader);
 
+	// the model shader reading the textures through TD3D12RHI::BindlessHeap
+	void DrawMeshBindless(TD3D12CommandContext& gfxContext, ModelLoader& model, TShader& shader);
+
 	// pipleline objects
 	CD3DX12_VIEWPORT m_viewport;;
 	CD3DX12_RECT m_scissorRect;
@@ -92,6 +96,15 @@ private:
 	float RotationY = 0.5;
 	float clearColor[4] = {0.9, 0.9, 0.9, 1.0};
 
+	// the back buffer is read back after the scene of the next frame is drawn
+	bool bScreenshotRequested = false;
+
+	// draw the models with modelShaderBindless, only offered with a bindless heap
+	bool bBindless = false;
+
+	// most detailed mip of TextureManager::m_StreamedTexture that has tiles
+	int StreamedMip = STREAMED_TEXTURE_MAX_MIP;
+
 	void LoadPipeline();
 	void LoadAssets();
 	void PopulateCommandList();
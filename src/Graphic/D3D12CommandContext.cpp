@@ -69,6 +69,21 @@ void TD3D12CommandContext::ResetCommandList()
 	// Before an app calls reset, the commandlist must be in the "closed" state.
 	// After Reset succeds, the command list is left in the "recording" state.
 	ThrowIfFailed(CommandList->Reset(CommandListAlloc.Get(), nullptr));
+
+	// a reset command list has no heaps bound
+	BoundDescriptorHeap = nullptr;
+}
+
+void TD3D12CommandContext::SetDescriptorHeap(ID3D12DescriptorHeap* Heap)
+{
+	if (Heap == BoundDescriptorHeap)
+	{
+		return;
+	}
+
+	ID3D12DescriptorHeap* Heaps[] = { Heap };
+	CommandList->SetDescriptorHeaps(1, Heaps);
+	BoundDescriptorHeap = Heap;
 }
 
 void TD3D12CommandContext::ExecuteCommandLists()
@@ -107,7 +122,12 @@ void TD3D12CommandContext::FlushCommandQueue()
 
 void TD3D12CommandContext::EndFrame()
 {
-	DescriptorCache->Reset();
+	DescriptorCache->FinishFrame(GetNextFenceValue());
+}
+
+void TD3D12CommandContext::CleanUpAllocations(uint64_t CompletedFenceValue)
+{
+	DescriptorCache->CleanUpAllocations(CompletedFenceValue);
 }
 
 
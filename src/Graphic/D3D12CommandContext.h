@@ -2,6 +2,7 @@
 #include "stdafx.h"
 #include "D3D12DescriptorCache.h"
 #include "D3D12Resource.h"
+#include <atomic>
 
 class TD3D12CommandContext
 {
@@ -20,6 +21,9 @@ public:
 
 	TD3D12DescriptorCache* GetDescriptorCache() { return DescriptorCache.get(); }
 
+	// SetDescriptorHeaps can flush the GPU pipeline, binding the heap that is already bound is skipped
+	void SetDescriptorHeap(ID3D12DescriptorHeap* Heap);
+
 	void Transition(TD3D12Resource* resource, D3D12_RESOURCE_STATES afterState);
 
 	void ResetCommandAllocator();
@@ -30,8 +34,16 @@ public:
 
 	void FlushCommandQueue();
 
+	// fence value the next Signal will write, resources released now are safe to reuse once it completes
+	uint64_t GetNextFenceValue() const { return CurrentFenceValue + 1; }
+
+	uint64_t GetCompletedFenceValue() const { return Fence->GetCompletedValue(); }
+
+	// the descriptor cache entries of the frame are reused once its fence completes
 	void EndFrame();
 
+	void CleanUpAllocations(uint64_t CompletedFenceValue);
+
 private:
 	
 	Microsoft::WRL::ComPtr<ID3D12CommandQueue> CommandQueue = nullptr;
@@ -40,9 +52,13 @@ private:
 
 	std::unique_ptr<TD3D12DescriptorCache> DescriptorCache = nullptr;
 
+	// since the last ResetCommandList
+	ID3D12DescriptorHeap* BoundDescriptorHeap = nullptr;
+
 private:
 	Microsoft::WRL::ComPtr<ID3D12Fence> Fence = nullptr;
 
-	UINT64 CurrentFenceValue = 0;
+	// read by allocators on any thread that releases a resource
+	std::atomic<UINT64> CurrentFenceValue = 0;
 };
 
@@ -2,6 +2,8 @@
 #include "stdafx.h"
 #include "DXSample.h"
 #include "D3D12PixelBuffer.h"
+#include "AllocationTrace.h"
+#include <chrono>
 
 using namespace Microsoft::WRL;
 
@@ -12,14 +14,21 @@ namespace TD3D12RHI
     ComPtr<IDXGISwapChain1> g_SwapCHain;
     Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> g_ImGuiSrvHeap;
 
-    // buffer
-    D3D12DepthBuffer g_DepthBuffer;
+    // residency, destroyed after the allocators that register their heaps
+    static std::unique_ptr<IMemoryBudgetProvider> BudgetProvider = nullptr;
+    std::unique_ptr<TD3D12ResidencyManager> ResidencyManager = nullptr;
 
     // memory allocator
     std::unique_ptr<TD3D12UploadBufferAllocator> UploadBufferAllocator = nullptr;
     std::unique_ptr<TD3D12DefaultBufferAllocator> DefaultBufferAllocator = nullptr;
     std::unique_ptr<TD3D12TextureResourceAllocator> TextureResourceAllocator = nullptr;
     std::unique_ptr<TD3D12PixelResourceAllocator> PixelResourceAllocator = nullptr;
+    std::unique_ptr<TD3D12UploadRingAllocator> UploadRingAllocator = nullptr;
+    std::unique_ptr<TD3D12ReadbackAllocator> ReadbackAllocator = nullptr;
+    std::unique_ptr<TD3D12TilePoolAllocator> TilePoolAllocator = nullptr;
+
+    // buffer, a transient of PixelResourceAllocator: destroyed before the allocators
+    D3D12DepthBuffer g_DepthBuffer;
 
     // heapSlot allocator
     std::unique_ptr<TD3D12HeapSlotAllocator> RTVHeapSlotAllocator = nullptr;
@@ -27,11 +36,15 @@ namespace TD3D12RHI
     std::unique_ptr<TD3D12HeapSlotAllocator> SRVHeapSlotAllocator = nullptr;
     std::unique_ptr<TD3D12HeapSlotAllocator> ImGuiSRVHeapAllocator = nullptr;
 
-    // cache descriptor handle
-    std::unique_ptr<TD3D12DescriptorCache> DescriptorCache = nullptr;
+    std::unique_ptr<TD3D12BindlessHeap> BindlessHeap = nullptr;
 
     D3D12_CPU_DESCRIPTOR_HANDLE NullDescriptor;
 
+    // begin and end timestamp of the frame, resolved through ReadbackAllocator
+    static ComPtr<ID3D12QueryHeap> TimestampQueryHeap;
+    static uint64_t TimestampFrequency = 0;
+    static float GpuFrameTime = 0.0f;
+
     void Initialze()
     {
         // initialize CommandContext
@@ -49,22 +62,264 @@ namespace TD3D12RHI
 
     void InitialzeBuffer()
     {
+        // the depth buffer is cleared at the start of the scene pass, it can share memory with the targets of other passes
+        g_DepthBuffer.DeclareTransient(g_DisplayWidth, g_DisplayHeight, DXGI_FORMAT_D32_FLOAT, SCENE_PASS, SCENE_PASS);
+        CommitTransients();
+
         // create the dsv
-        g_DepthBuffer.Create(L"Depth Buffer", g_DisplayWidth, g_DisplayHeight, DXGI_FORMAT_D32_FLOAT);
+        g_DepthBuffer.CreateTransientViews(L"Depth Buffer");
     }
 
     void InitialzeAllocator()
     {
+        BudgetProvider = std::make_unique<TDXGIBudgetProvider>(g_Device);
+        ResidencyManager = std::make_unique<TD3D12ResidencyManager>(g_Device, *BudgetProvider);
+
         UploadBufferAllocator = std::make_unique<TD3D12UploadBufferAllocator>(g_Device);
         DefaultBufferAllocator = std::make_unique<TD3D12DefaultBufferAllocator>(g_Device);
-        TextureResourceAllocator = std::make_unique<TD3D12TextureResourceAllocator>(g_Device);
+        TextureResourceAllocator = std::make_unique<TD3D12TextureResourceAllocator>(g_Device, ResidencyManager.get());
+        PixelResourceAllocator = std::make_unique<TD3D12PixelResourceAllocator>(g_Device);
+        UploadRingAllocator = std::make_unique<TD3D12UploadRingAllocator>(g_Device);
+        ReadbackAllocator = std::make_unique<TD3D12ReadbackAllocator>(g_Device);
+
+        D3D12_QUERY_HEAP_DESC QueryHeapDesc = {};
+        QueryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+        QueryHeapDesc.Count = 2;
+        ThrowIfFailed(g_Device->CreateQueryHeap(&QueryHeapDesc, IID_PPV_ARGS(&TimestampQueryHeap)));
+        ThrowIfFailed(g_CommandContext.GetCommandQueue()->GetTimestampFrequency(&TimestampFrequency));
+
+        // tier 2 reads zeros from unmapped tiles, partly committed mips can be sampled
+        D3D12_FEATURE_DATA_D3D12_OPTIONS Options = {};
+        g_Device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &Options, sizeof(Options));
+        if (Options.TiledResourcesTier >= D3D12_TILED_RESOURCES_TIER_2)
+        {
+            TilePoolAllocator = std::make_unique<TD3D12TilePoolAllocator>(g_Device);
+        }
+
+        // tier 1 limits a descriptor table to 128 SRVs, bindless needs the unbounded table of tier 2
+        if (Options.ResourceBindingTier >= D3D12_RESOURCE_BINDING_TIER_2)
+        {
+            BindlessHeap = std::make_unique<TD3D12BindlessHeap>(g_Device);
+        }
 
         RTVHeapSlotAllocator = std::make_unique<TD3D12HeapSlotAllocator>(g_Device, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, 256);
         DSVHeapSlotAllocator = std::make_unique<TD3D12HeapSlotAllocator>(g_Device, D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 256);
         SRVHeapSlotAllocator = std::make_unique<TD3D12HeapSlotAllocator>(g_Device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 128);
         ImGuiSRVHeapAllocator = std::make_unique<TD3D12HeapSlotAllocator>(g_Device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 1);
+    }
+
+    void EndFrame()
+    {
+        // the frame's commands are covered by the next fence signal
+        UploadRingAllocator->FinishFrame(g_CommandContext.GetNextFenceValue());
+        ReadbackAllocator->FinishFrame(g_CommandContext.GetNextFenceValue());
+        g_CommandContext.EndFrame();
+    }
+
+    void CleanUpAllocations()
+    {
+        const uint64_t CompletedFenceValue = g_CommandContext.GetCompletedFenceValue();
+
+        if (TAllocationTraceRecorder::Get().IsRecording())
+        {
+            TAllocationTraceRecorder::Get().RecordCleanUp(CompletedFenceValue);
+        }
+
+        UploadBufferAllocator->CleanUpAllocations(CompletedFenceValue);
+        DefaultBufferAllocator->CleanUpAllocations(CompletedFenceValue);
+        TextureResourceAllocator->CleanUpAllocations(CompletedFenceValue);
+        UploadRingAllocator->CleanUpAllocations(CompletedFenceValue);
+        ReadbackAllocator->CleanUpAllocations(CompletedFenceValue);
+        g_CommandContext.CleanUpAllocations(CompletedFenceValue);
+
+        if (PixelResourceAllocator)
+        {
+            PixelResourceAllocator->CleanUpAllocations(CompletedFenceValue);
+        }
+
+        if (TilePoolAllocator)
+        {
+            TilePoolAllocator->CleanUpAllocations(CompletedFenceValue);
+        }
+
+        if (BindlessHeap)
+        {
+            BindlessHeap->CleanUpAllocations(CompletedFenceValue);
+        }
+    }
+
+    void UpdateResidency()
+    {
+        ResidencyManager->Update(g_CommandContext.GetCompletedFenceValue());
+    }
+
+    uint64_t Trim()
+    {
+        // blocks waiting for their fence keep a pool alive, recycle what we can first
+        CleanUpAllocations();
+
+        uint64_t BytesFreed = 0;
+        BytesFreed += UploadBufferAllocator->Trim();
+        BytesFreed += DefaultBufferAllocator->Trim();
+        BytesFreed += TextureResourceAllocator->Trim();
+
+        if (PixelResourceAllocator)
+        {
+            BytesFreed += PixelResourceAllocator->Trim();
+        }
+
+        if (TilePoolAllocator)
+        {
+            BytesFreed += TilePoolAllocator->Trim();
+        }
+
+        return BytesFreed;
+    }
+
+    uint64_t Defragment(uint64_t ByteBudget)
+    {
+        // recorded into the open frame list, the frame's fence covers the copies and the freed source blocks
+        uint64_t BytesMoved = TextureResourceAllocator->Defragment(ByteBudget, g_CommandContext);
+
+        if (PixelResourceAllocator && BytesMoved < ByteBudget)
+        {
+            BytesMoved += PixelResourceAllocator->Defragment(ByteBudget - BytesMoved, g_CommandContext);
+        }
+
+        return BytesMoved;
+    }
+
+    void DeclareTransient(const D3D12_RESOURCE_DESC& ResourceDesc, const D3D12_CLEAR_VALUE& ClearValue, uint32_t FirstPass, uint32_t LastPass, TD3D12ResourceLocation& ResourceLocation)
+    {
+        PixelResourceAllocator->DeclareTransient(ResourceDesc, ClearValue, FirstPass, LastPass, ResourceLocation);
+    }
+
+    uint64_t CommitTransients()
+    {
+        return PixelResourceAllocator->CommitTransients();
+    }
+
+    void AliasingBarriers(uint32_t Pass)
+    {
+        PixelResourceAllocator->AliasingBarriers(Pass, g_CommandContext);
+    }
+
+    void GetAllocatorStats(std::vector<TD3D12AllocatorStats>& OutStats)
+    {
+        UploadBufferAllocator->GetStats(OutStats);
+        UploadRingAllocator->GetStats(OutStats);
+        ReadbackAllocator->GetStats(OutStats);
+        DefaultBufferAllocator->GetStats(OutStats);
+        TextureResourceAllocator->GetStats(OutStats);
+
+        if (PixelResourceAllocator)
+        {
+            PixelResourceAllocator->GetStats(OutStats);
+        }
+
+        if (TilePoolAllocator)
+        {
+            TilePoolAllocator->GetStats(OutStats);
+        }
+    }
+
+    std::string DumpAllocatorsJson()
+    {
+        std::string Json = "{\"allocators\":[";
+
+        UploadBufferAllocator->WriteJson(Json);
+        UploadRingAllocator->WriteJson(Json);
+        ReadbackAllocator->WriteJson(Json);
+        DefaultBufferAllocator->WriteJson(Json);
+        TextureResourceAllocator->WriteJson(Json);
+
+        if (PixelResourceAllocator)
+        {
+            PixelResourceAllocator->WriteJson(Json);
+        }
+
+        if (TilePoolAllocator)
+        {
+            TilePoolAllocator->WriteJson(Json);
+        }
+
+        Json += "]}";
+
+        return Json;
+    }
+
+    bool Readback(TD3D12Resource* Resource, TD3D12ReadbackCallback Callback, uint32_t Subresource)
+    {
+        return ReadbackAllocator->Readback(Resource, Subresource, std::move(Callback), g_CommandContext);
+    }
+
+    void BeginGpuFrame()
+    {
+        g_CommandContext.GetCommandList()->EndQuery(TimestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0);
+    }
+
+    void EndGpuFrame()
+    {
+        g_CommandContext.GetCommandList()->EndQuery(TimestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 1);
+
+        // the queries are reused next frame, the resolve is ordered before them on the queue.
+        // a full ring skips the frame
+        ReadbackAllocator->ReadbackQueries(TimestampQueryHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, 0, 2, [](const TD3D12ReadbackData& Data)
+        {
+            const uint64_t* Timestamps = (const uint64_t*)Data.Data;
+            if (TimestampFrequency != 0 && Timestamps[1] >= Timestamps[0])
+            {
+                GpuFrameTime = (float)((Timestamps[1] - Timestamps[0]) * 1000.0 / TimestampFrequency);
+            }
+        }, g_CommandContext);
+    }
+
+    float GetGpuFrameTime()
+    {
+        return GpuFrameTime;
+    }
+
+    void BeginAllocationTrace()
+    {
+        TAllocationTraceRecorder::Get().Begin(g_CommandContext.GetNextFenceValue());
+    }
+
+    bool EndAllocationTrace(const char* FileName)
+    {
+        std::vector<TAllocationTraceEvent> Events;
+        TAllocationTraceRecorder::Get().End(Events);
+
+        return SaveAllocationTrace(FileName, Events);
+    }
+
+    void BenchmarkAllocationTrace(const char* FileName)
+    {
+        std::vector<TAllocationTraceEvent> Events;
+        if (!LoadAllocationTrace(FileName, Events))
+        {
+            OutputDebugStringA("BenchmarkAllocationTrace: can't read the trace\n");
+            return;
+        }
+
+        const struct
+        {
+            const char* Name;
+            EReplayAlgorithm Algorithm;
+        } Variants[] = { { "Buddy", EReplayAlgorithm::Buddy }, { "TLSF", EReplayAlgorithm::TLSF }, { "SlabBuddy", EReplayAlgorithm::SlabBuddy } };
+
+        for (const auto& Variant : Variants)
+        {
+            TAllocationReplaySettings Settings;
+            Settings.Algorithm = Variant.Algorithm;
+
+            const TAllocationReplayResult Result = ReplayAllocationTrace(Events, Settings);
 
-        DescriptorCache = std::make_unique<TD3D12DescriptorCache>(g_Device);
+            char Buffer[256];
+            sprintf_s(Buffer, "BenchmarkAllocationTrace: %s, %.0f allocations/s, peak reserved %.2f MB, allocated %.2f MB, requested %.2f MB, fragmentation %.2f (max %.2f)\n",
+                Variant.Name, Result.AllocationsPerSecond, Result.PeakReservedSize / (1024.0 * 1024.0), Result.PeakAllocatedSize / (1024.0 * 1024.0),
+                Result.PeakRequestedSize / (1024.0 * 1024.0), Result.AverageFragmentation, Result.MaxFragmentation);
+            OutputDebugStringA(Buffer);
+        }
     }
 }
 
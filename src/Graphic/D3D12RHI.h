@@ -2,9 +2,11 @@
 
 #include "D3D12Resource.h"
 #include "D3D12MemoryAllocator.h"
+#include "D3D12ResidencyManager.h"
 #include "D3D12Buffer.h"
 #include "D3D12HeapSlotAllocator.h"
 #include "D3D12DescriptorCache.h"
+#include "D3D12BindlessHeap.h"
 #include "D3D12CommandContext.h"
 #include "D3D12PixelBuffer.h"
 #include "Shader.h"
@@ -12,6 +14,9 @@
 #include <memory>
 #define FrameCount 2
 
+// passes of a frame, transient render targets are aliased by the passes they live through
+#define SCENE_PASS 0
+
 namespace TD3D12RHI
 {
 	extern ID3D12Device* g_Device;
@@ -25,10 +30,20 @@ namespace TD3D12RHI
 	// Buffer
 	extern D3D12DepthBuffer g_DepthBuffer;
 
+	// evicts texture pools when the video memory budget is exceeded, created before the allocators
+	extern std::unique_ptr<TD3D12ResidencyManager> ResidencyManager;
+
 	// memory allocator
 	extern std::unique_ptr<TD3D12UploadBufferAllocator> UploadBufferAllocator;
 	extern std::unique_ptr<TD3D12DefaultBufferAllocator> DefaultBufferAllocator;
 	extern std::unique_ptr<TD3D12TextureResourceAllocator> TextureResourceAllocator;
+	extern std::unique_ptr<TD3D12UploadRingAllocator> UploadRingAllocator;
+
+	// GPU to CPU copies, the results arrive in CleanUpAllocations
+	extern std::unique_ptr<TD3D12ReadbackAllocator> ReadbackAllocator;
+
+	// tiles of reserved textures, null when the device doesn't support tiled resources tier 2
+	extern std::unique_ptr<TD3D12TilePoolAllocator> TilePoolAllocator;
 
 	// heapSlot allocator
 	extern std::unique_ptr<TD3D12HeapSlotAllocator> RTVHeapSlotAllocator;
@@ -36,8 +51,8 @@ namespace TD3D12RHI
 	extern std::unique_ptr<TD3D12HeapSlotAllocator> SRVHeapSlotAllocator;
 	extern std::unique_ptr<TD3D12HeapSlotAllocator> ImGuiSRVHeapAllocator;
 
-	// cache descriptor for GPU
-	extern std::unique_ptr<TD3D12DescriptorCache> DescriptorCache;
+	// persistent SRVs of every texture, null when the device doesn't support resource binding tier 2
+	extern std::unique_ptr<TD3D12BindlessHeap> BindlessHeap;
 
 	extern D3D12_CPU_DESCRIPTOR_HANDLE NullDescriptor;
 
@@ -45,11 +60,63 @@ namespace TD3D12RHI
 	void InitialzeBuffer();
 	void Initialze();
 
+	// close the frame's transient allocations, call before the frame's fence is signaled
+	void EndFrame();
+
+	// recycle released allocations whose GPU work has completed, call once per frame
+	void CleanUpAllocations();
+
+	// evict the least recently used texture pools while the video memory usage is above the budget, call once per frame
+	void UpdateResidency();
+
+	// release every idle pool of the buffer and texture allocators, returns the number of bytes given back.
+	// the empty upload slabs are released too, but their pools only come back on a call after the next fence
+	uint64_t Trim();
+
+	// move up to ByteBudget bytes of placed textures out of the least used pools, returns the number of bytes moved.
+	// the copies are recorded on g_CommandContext: call it on the open frame list, after the previous frame has completed
+	// and before anything that uses the moved textures is recorded. nothing is recorded when there is nothing to move
+	uint64_t Defragment(uint64_t ByteBudget = DEFRAG_BYTES_PER_FRAME);
+
+	// render targets that live through passes [FirstPass, LastPass] of every frame share one heap with the targets of
+	// other passes. declare all of them, then CommitTransients creates the heap and their resources at once
+	void DeclareTransient(const D3D12_RESOURCE_DESC& ResourceDesc, const D3D12_CLEAR_VALUE& ClearValue, uint32_t FirstPass, uint32_t LastPass, TD3D12ResourceLocation& ResourceLocation);
+	uint64_t CommitTransients();
+
+	// aliasing barriers of the transients that start at Pass, record them on g_CommandContext before the pass
+	void AliasingBarriers(uint32_t Pass);
+
+	// live statistics of every buffer and texture allocator, cheap enough to call every frame
+	void GetAllocatorStats(std::vector<TD3D12AllocatorStats>& OutStats);
+
+	// statistics and the block map of every pool as JSON: {"allocators": [{"name", "stats", "pools"}...]}
+	std::string DumpAllocatorsJson();
+
+	// record every buffer and texture allocation, free and clean up until EndAllocationTrace writes them to FileName
+	void BeginAllocationTrace();
+	bool EndAllocationTrace(const char* FileName);
+
+	// replay a trace with the buddy, TLSF and slab variants on the CPU and write the throughput, peak footprint and
+	// fragmentation of each to the debugger output
+	void BenchmarkAllocationTrace(const char* FileName);
+
+	// copy a texture subresource or a whole buffer back to the CPU on g_CommandContext without waiting for the GPU.
+	// Callback runs in CleanUpAllocations once the frame has completed, returns false when the readback ring is full
+	bool Readback(TD3D12Resource* Resource, TD3D12ReadbackCallback Callback, uint32_t Subresource = 0);
+
+	// timestamps around the commands of a frame, call after the command list is reset and before it is closed
+	void BeginGpuFrame();
+	void EndGpuFrame();
+
+	// milliseconds between the timestamps of the last frame that has been read back
+	float GetGpuFrameTime();
+
 	TD3D12VertexBufferRef CreateVertexBuffer(const void* Contents, uint32_t Size, uint32_t Stride);
 
 	TD3D12IndexBufferRef CreateIndexBuffer(const void* Contents, uint32_t Size, DXGI_FORMAT Format);
 
-	TD3D12ConstantBufferRef CreateConstantBuffer(const void* Contents, uint32_t Size);
+	// transient constant buffers are only valid for the current frame
+	TD3D12ConstantBufferRef CreateConstantBuffer(const void* Contents, uint32_t Size, bool bTransient = false);
 
 	void CreateDefaultBuffer(uint32_t Size, uint32_t Alignment, D3D12_RESOURCE_FLAGS Flags, TD3D12ResourceLocation& ResourceLocation);
 
@@ -1,6 +1,52 @@
 #include "Mesh.h"
 #include "GeometryGenerator.h"
 
+void Mesh::CreateSRVTable()
+{
+	if (m_textures.empty())
+	{
+		return;
+	}
+
+	const uint32_t NumSRVs = (uint32_t)m_textures.size();
+	TD3D12HeapSlotAllocator* Allocator = TD3D12RHI::SRVHeapSlotAllocator.get();
+
+	m_SRVTable = std::shared_ptr<TD3D12HeapSlotAllocator::HeapSlot>(new TD3D12HeapSlotAllocator::HeapSlot(Allocator->AllocateRange(NumSRVs)),
+		[NumSRVs](TD3D12HeapSlotAllocator::HeapSlot* Range)
+		{
+			if (TD3D12RHI::SRVHeapSlotAllocator)
+			{
+				TD3D12RHI::SRVHeapSlotAllocator->FreeRange(*Range, NumSRVs);
+			}
+			delete Range;
+		});
+
+	for (uint32_t i = 0; i < NumSRVs; ++i)
+	{
+		const D3D12_CPU_DESCRIPTOR_HANDLE Src = m_textures[i].GetSRV();
+		const D3D12_CPU_DESCRIPTOR_HANDLE Dst = { m_SRVTable->Handle.ptr + (SIZE_T)i * Allocator->GetDescriptorSize() };
+
+		TD3D12RHI::g_Device->CopyDescriptorsSimple(1, Dst, Src, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		m_SRV.push_back(Dst);
+
+		// defragmentation rewrites the texture's own SRV, refresh the copy while the table is alive
+		std::shared_ptr<TD3D12ResourceLocation>& Location = m_textures[i].ResourceLocation;
+		std::weak_ptr<TD3D12HeapSlotAllocator::HeapSlot> Table = m_SRVTable;
+		Location->OnRelocated = [OnRelocated = Location->OnRelocated, Table, Src, Dst](TD3D12ResourceLocation& Relocated)
+		{
+			if (OnRelocated)
+			{
+				OnRelocated(Relocated);
+			}
+
+			if (!Table.expired())
+			{
+				TD3D12RHI::g_Device->CopyDescriptorsSimple(1, Dst, Src, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+			}
+		};
+	}
+}
+
 void Mesh::CreateBox(float width, float height, float depth, uint32_t numSubdivisions)
 {
 	GeometryGenerator geoGen;
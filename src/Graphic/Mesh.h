@@ -26,12 +26,10 @@ public:
 
 	void DrawMesh(TD3D12CommandContext& gfxContext)
 	{
-		//if (!m_SRV.empty())
-		//{
-			//gfxContext.GetCommandList()->SetDescriptorHeaps(1, &Heaps);
-			//D3D12_GPU_DESCRIPTOR_HANDLE srvHandle = m_descriptorCache->GetCacheCbvSrvUavDescriptorHeap()->GetGPUDescriptorHandleForHeapStart();
-			//gfxContext.GetCommandList()->SetGraphicsRootDescriptorTable(1, m_GpuHandle);
-		//}
+		for (auto& tex : m_textures)
+		{
+			tex.MarkUsed();
+		}
 
 		gfxContext.GetCommandList()->IASetPrimitiveTopology(D3D10_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 		gfxContext.GetCommandList()->IASetVertexBuffers(0, 1, &m_vertexBufferRef->GetVBV());
@@ -44,11 +42,12 @@ public:
 		// empty
 	}
 
-	std::shared_ptr<TD3D12DescriptorCache> GetTD3D12DescriptorCache() { return m_descriptorCache; }
-
 	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> GetSRV() { return m_SRV; }
 	const std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> GetSRV() const { return m_SRV; }
 
+	// bindless index of the texture at Slot of the material, the null view when there is none
+	uint32_t GetBindlessIndex(uint32_t Slot) const { return Slot < m_textures.size() ? m_textures[Slot].GetBindlessIndex() : BINDLESS_NULL_INDEX; }
+
 	const std::vector<Vertex>& GetVertices() const { return m_vertices; }
 	const std::vector<int16_t>& GetIndices16() const { return m_indices16; }
 
@@ -80,33 +79,23 @@ private:
 	// initialize buffer
 	void setupMesh()
 	{
-		m_descriptorCache = std::make_unique<TD3D12DescriptorCache>(TD3D12RHI::g_Device);
-
 		m_vertexBufferRef = TD3D12RHI::CreateVertexBuffer(m_vertices.data(), m_vertices.size() * sizeof(Vertex), sizeof(Vertex));
 		m_indexBufferRef = TD3D12RHI::CreateIndexBuffer(m_indices16.data(), m_indices16.size() * sizeof(int16_t), DXGI_FORMAT_R16_UINT);
 
-		for (auto& tex : m_textures)
-		{
-			m_SRV.push_back(tex.GetSRV());
-		}
-		//if (!m_SRV.empty())
-		//{
-		//	m_GpuHandle = m_descriptorCache->AppendCbvSrvUavDescriptors(m_SRV);
-		//
-		//	Heaps = { m_descriptorCache->GetCacheCbvSrvUavDescriptorHeap().Get() };
-		//}
+		CreateSRVTable();
 	}
 
+	// copy the textures' SRVs side by side into one range, m_SRV points into it
+	void CreateSRVTable();
+
 	std::vector<Vertex>	m_vertices;
 	std::vector<uint32_t> m_indices32;
 	std::vector<int16_t> m_indices16;
 	std::vector<TD3D12Texture> m_textures;
 
 	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> m_SRV;
-	std::shared_ptr<TD3D12DescriptorCache> m_descriptorCache = nullptr;
-
-	D3D12_GPU_DESCRIPTOR_HANDLE m_GpuHandle;
-	ID3D12DescriptorHeap* Heaps;
+	// meshes are copied by value, the last copy frees the range
+	std::shared_ptr<TD3D12HeapSlotAllocator::HeapSlot> m_SRVTable;
 
 	// vertex buffer
 	TD3D12VertexBufferRef m_vertexBufferRef;
@@ -40,7 +40,6 @@ void ModelLoader::Draw(TD3D12CommandContext& gfxContext, TShader* shader, TD3D12
 		//shader->SetParameter("diffuseMap", m_SRV[0]);
 		//shader->SetParameter("specularMap", m_SRV[1]);
 		//shader->SetParameter("normalMap", m_SRV[2]);
-		//shader->SetDescriptorCache(mesh.GetTD3D12DescriptorCache());
 		//shader->BindParameters();
 		mesh.DrawMesh(gfxContext);
 	}
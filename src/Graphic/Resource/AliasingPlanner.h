@@ -0,0 +1,131 @@
+#pragma once
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+// Device independent placement of transient resources in one shared heap.
+// Every resource declares the range of passes it is used in, resources whose ranges don't overlap may share memory.
+// Resources are placed largest first, each at the lowest aligned offset that doesn't collide with a resource
+// that is live at the same time (greedy interval packing, the heap is at least as large as the largest single pass).
+//
+// A resource that takes over memory from another one needs an aliasing barrier before its first pass,
+// and its content is undefined there, the first use has to clear or discard it.
+
+struct TAliasingResource
+{
+	uint64_t Size = 0;
+
+	uint64_t Alignment = 1;
+
+	// first and last pass the resource is used in, inclusive
+	uint32_t FirstPass = 0;
+	uint32_t LastPass = 0;
+};
+
+struct TAliasingPlan
+{
+	// no resource used this memory before
+	static constexpr int32_t NO_PREDECESSOR = -1;
+
+	// several resources did, the barrier has to name no resource before
+	static constexpr int32_t ANY_PREDECESSOR = -2;
+
+	uint64_t HeapSize = 0;
+
+	// per resource, from the start of the heap
+	std::vector<uint64_t> Offsets;
+
+	// per resource, the index of the resource that used the memory before it, or one of the values above
+	std::vector<int32_t> Predecessors;
+};
+
+class TAliasingPlanner
+{
+public:
+	static TAliasingPlan Plan(const std::vector<TAliasingResource>& Resources)
+	{
+		TAliasingPlan Result;
+		Result.Offsets.resize(Resources.size(), 0);
+		Result.Predecessors.resize(Resources.size(), TAliasingPlan::NO_PREDECESSOR);
+
+		// largest first, the small ones fill the gaps
+		std::vector<uint32_t> Order(Resources.size());
+		for (uint32_t i = 0; i < Order.size(); ++i)
+		{
+			Order[i] = i;
+		}
+
+		std::stable_sort(Order.begin(), Order.end(), [&Resources](uint32_t A, uint32_t B)
+		{
+			return Resources[A].Size > Resources[B].Size;
+		});
+
+		std::vector<uint32_t> Placed;
+		std::vector<std::pair<uint64_t, uint64_t>> Occupied;
+
+		for (uint32_t Index : Order)
+		{
+			const TAliasingResource& Resource = Resources[Index];
+
+			// memory of the placed resources that are live at the same time, by offset
+			Occupied.clear();
+			for (uint32_t Other : Placed)
+			{
+				if (PassesOverlap(Resource, Resources[Other]))
+				{
+					Occupied.push_back({ Result.Offsets[Other], Result.Offsets[Other] + Resources[Other].Size });
+				}
+			}
+			std::sort(Occupied.begin(), Occupied.end());
+
+			// lowest gap that fits
+			uint64_t Offset = 0;
+			for (const auto& [Begin, End] : Occupied)
+			{
+				if (Offset + Resource.Size <= Begin)
+				{
+					break;
+				}
+
+				Offset = (std::max)(Offset, AlignUp(End, Resource.Alignment));
+			}
+
+			Result.Offsets[Index] = Offset;
+			Result.HeapSize = (std::max)(Result.HeapSize, Offset + Resource.Size);
+
+			Placed.push_back(Index);
+		}
+
+		// earlier resources whose memory is taken over
+		for (uint32_t i = 0; i < Resources.size(); ++i)
+		{
+			for (uint32_t j = 0; j < Resources.size(); ++j)
+			{
+				if (Resources[j].LastPass >= Resources[i].FirstPass || !MemoryOverlaps(Result, Resources, i, j))
+				{
+					continue;
+				}
+
+				Result.Predecessors[i] = Result.Predecessors[i] == TAliasingPlan::NO_PREDECESSOR ? (int32_t)j : TAliasingPlan::ANY_PREDECESSOR;
+			}
+		}
+
+		return Result;
+	}
+
+	static bool PassesOverlap(const TAliasingResource& A, const TAliasingResource& B)
+	{
+		return A.FirstPass <= B.LastPass && B.FirstPass <= A.LastPass;
+	}
+
+	static bool MemoryOverlaps(const TAliasingPlan& Plan, const std::vector<TAliasingResource>& Resources, uint32_t A, uint32_t B)
+	{
+		return Plan.Offsets[A] < Plan.Offsets[B] + Resources[B].Size && Plan.Offsets[B] < Plan.Offsets[A] + Resources[A].Size;
+	}
+
+private:
+	static uint64_t AlignUp(uint64_t Value, uint64_t Alignment)
+	{
+		return Alignment > 1 ? (Value + Alignment - 1) / Alignment * Alignment : Value;
+	}
+};
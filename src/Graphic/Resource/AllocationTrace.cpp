@@ -0,0 +1,572 @@
+#include "AllocationTrace.h"
+#include "BuddyAllocator.h"
+#include "TLSFAllocator.h"
+#include "FencedDeletionQueue.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+
+namespace
+{
+	struct TTraceFileHeader
+	{
+		char Magic[4];
+		uint32_t Version;
+		uint32_t EventSize;
+		uint32_t NumEvents;
+	};
+
+	const char TRACE_MAGIC[4] = { 'A', 'T', 'R', 'C' };
+	const uint32_t TRACE_VERSION = 1;
+
+	// one pool of the replay, buddy or TLSF
+	class TReplayPool
+	{
+	public:
+		TReplayPool(bool bTLSF, uint64_t PoolSize, uint64_t InMinBlockSize, uint32_t MaxOrder)
+			: MinBlockSize(InMinBlockSize)
+		{
+			if (bTLSF)
+			{
+				TLSF = std::make_unique<TTLSFAllocator>(PoolSize, MinBlockSize);
+			}
+			else
+			{
+				Buddy = std::make_unique<TBuddyAllocator<THostBackingStore>>(PoolSize, MinBlockSize, MaxOrder);
+			}
+		}
+
+		// Handle is the buddy offset or the TLSF block
+		bool Allocate(uint64_t Size, uint64_t Alignment, uint32_t& OutHandle, uint32_t& OutOrder)
+		{
+			if (TLSF)
+			{
+				TTLSFAllocator::TAllocation Allocation;
+				if (!TLSF->Allocate(Size, Alignment, Allocation))
+				{
+					return false;
+				}
+
+				OutHandle = Allocation.Block;
+				OutOrder = 0;
+				return true;
+			}
+
+			TBuddyAllocation Allocation;
+			if (!Buddy->Allocate(Size, Alignment, Allocation))
+			{
+				return false;
+			}
+
+			OutHandle = Allocation.Offset;
+			OutOrder = Allocation.Order;
+			return true;
+		}
+
+		void Deallocate(uint32_t Handle, uint32_t Order)
+		{
+			if (TLSF)
+			{
+				TLSF->Deallocate(Handle);
+			}
+			else
+			{
+				Buddy->Deallocate(Handle, Order);
+			}
+		}
+
+		uint64_t GetPoolSize() const { return TLSF ? TLSF->GetPoolSize() : Buddy->GetPoolSize(); }
+
+		uint64_t GetTotalAllocSize() const { return TLSF ? TLSF->GetTotalAllocSize() : Buddy->GetTotalAllocSize(); }
+
+		// a lower bound for TLSF
+		uint64_t GetLargestFreeSize() const
+		{
+			if (TLSF)
+			{
+				return TLSF->GetLargestFreeSize();
+			}
+
+			const int32_t Order = Buddy->GetLargestFreeOrder();
+			return Order >= 0 ? MinBlockSize << Order : 0;
+		}
+
+	private:
+		uint64_t MinBlockSize;
+
+		std::unique_ptr<TBuddyAllocator<THostBackingStore>> Buddy;
+
+		std::unique_ptr<TTLSFAllocator> TLSF;
+	};
+
+	const uint32_t DEDICATED_POOL = UINT32_MAX;
+
+	// committed resources take whole 64KB pages
+	uint64_t GetDedicatedSize(uint64_t Size)
+	{
+		const uint64_t PageSize = 64 * 1024;
+		return (Size + PageSize - 1) / PageSize * PageSize;
+	}
+
+	struct TReplayBlock
+	{
+		uint32_t PoolSet = 0;
+
+		// DEDICATED_POOL for a resource of its own
+		uint32_t Pool = 0;
+		uint32_t Handle = 0;
+		uint32_t Order = 0;
+
+		// slab and slot when the block came from a slab
+		int32_t Slab = -1;
+		uint32_t Slot = 0;
+
+		uint64_t Size = 0;
+	};
+
+	struct TReplaySlab
+	{
+		// backing block in the pool set
+		TReplayBlock Block;
+
+		std::vector<uint32_t> FreeSlots;
+	};
+
+	struct TReplayPoolSet
+	{
+		bool bPlaced = false;
+
+		std::vector<std::unique_ptr<TReplayPool>> Pools;
+
+		std::vector<TReplaySlab> Slabs;
+
+		// slabs with a free slot, per size class
+		std::vector<std::vector<int32_t>> PartialSlabs;
+	};
+
+	class TReplay
+	{
+	public:
+		TReplay(const TAllocationReplaySettings& InSettings)
+			: Settings(InSettings)
+		{
+		}
+
+		void Alloc(const TAllocationTraceEvent& Event)
+		{
+			const uint32_t PoolSetIndex = GetPoolSet(Event.HeapType, Event.bPlaced != 0);
+
+			TReplayBlock Block;
+			if (Event.Size > Settings.DedicatedThreshold)
+			{
+				Block.PoolSet = PoolSetIndex;
+				Block.Pool = DEDICATED_POOL;
+
+				ReservedSize += GetDedicatedSize(Event.Size);
+				AllocatedSize += GetDedicatedSize(Event.Size);
+			}
+			else if (!AllocFromSlab(PoolSetIndex, Event.Size, Event.Alignment, Block))
+			{
+				Block = AllocFromPools(PoolSetIndex, Event.Size, Event.Alignment);
+			}
+			Block.Size = Event.Size;
+
+			LiveBlocks[Event.Id] = Block;
+
+			RequestedSize += Event.Size;
+			Result.PeakRequestedSize = (std::max)(Result.PeakRequestedSize, RequestedSize);
+			Result.PeakAllocatedSize = (std::max)(Result.PeakAllocatedSize, AllocatedSize);
+			Result.PeakReservedSize = (std::max)(Result.PeakReservedSize, ReservedSize);
+			++Result.NumAllocations;
+		}
+
+		void Free(const TAllocationTraceEvent& Event)
+		{
+			auto It = LiveBlocks.find(Event.Id);
+			if (It == LiveBlocks.end())
+			{
+				return;
+			}
+
+			PendingFrees.Enqueue(It->second, Event.FenceValue);
+			LiveBlocks.erase(It);
+		}
+
+		void CleanUp(const TAllocationTraceEvent& Event)
+		{
+			PendingFrees.Retire(Event.FenceValue, [this](const TReplayBlock& Block)
+			{
+				RequestedSize -= Block.Size;
+
+				if (Block.Slab >= 0)
+				{
+					FreeSlot(Block);
+				}
+				else
+				{
+					FreeBlock(Block);
+				}
+			});
+
+			SampleFragmentation();
+		}
+
+		TAllocationReplayResult& GetResult() { return Result; }
+
+	private:
+		uint32_t GetPoolSet(uint8_t HeapType, bool bPlaced)
+		{
+			const uint32_t Key = ((uint32_t)HeapType << 1) | (bPlaced ? 1 : 0);
+
+			auto It = PoolSetIndices.find(Key);
+			if (It != PoolSetIndices.end())
+			{
+				return It->second;
+			}
+
+			PoolSets.emplace_back();
+			PoolSets.back().bPlaced = bPlaced;
+
+			const uint32_t Index = (uint32_t)PoolSets.size() - 1;
+			PoolSetIndices[Key] = Index;
+
+			return Index;
+		}
+
+		TReplayBlock AllocFromPools(uint32_t PoolSetIndex, uint64_t Size, uint64_t Alignment)
+		{
+			TReplayPoolSet& PoolSet = PoolSets[PoolSetIndex];
+
+			TReplayBlock Block;
+			Block.PoolSet = PoolSetIndex;
+
+			// first fit in creation order
+			for (uint32_t i = 0; i < (uint32_t)PoolSet.Pools.size(); ++i)
+			{
+				const uint64_t OldAllocSize = PoolSet.Pools[i]->GetTotalAllocSize();
+				if (PoolSet.Pools[i]->Allocate(Size, Alignment, Block.Handle, Block.Order))
+				{
+					AllocatedSize += PoolSet.Pools[i]->GetTotalAllocSize() - OldAllocSize;
+					Block.Pool = i;
+					return Block;
+				}
+			}
+
+			const uint64_t PoolSize = PoolSet.bPlaced ? Settings.PlacedPoolSize : Settings.PoolSize;
+			const uint64_t MinBlockSize = PoolSet.bPlaced ? Settings.PlacedMinBlockSize : Settings.MinBlockSize;
+			const uint64_t MaxBlockSize = Settings.MaxOrder != 0 ? (MinBlockSize << Settings.MaxOrder) : PoolSize;
+
+			// a request larger than the largest block gets a pool of its own, as in TD3D12MultiBuddyAllocator
+			const bool bDedicated = Size + Alignment > MaxBlockSize;
+
+			PoolSet.Pools.push_back(std::make_unique<TReplayPool>(Settings.Algorithm == EReplayAlgorithm::TLSF,
+				bDedicated ? Size + Alignment : PoolSize, MinBlockSize, bDedicated ? 0 : Settings.MaxOrder));
+
+			TReplayPool& Pool = *PoolSet.Pools.back();
+
+			// a TLSF pool can miss an aligned request even when new, the allocators then create a committed resource
+			if (!Pool.Allocate(Size, Alignment, Block.Handle, Block.Order))
+			{
+				PoolSet.Pools.pop_back();
+
+				Block.Pool = DEDICATED_POOL;
+				Block.Size = Size;
+				ReservedSize += GetDedicatedSize(Size);
+				AllocatedSize += GetDedicatedSize(Size);
+				return Block;
+			}
+
+			ReservedSize += Pool.GetPoolSize();
+			AllocatedSize += Pool.GetTotalAllocSize();
+			Block.Pool = (uint32_t)PoolSet.Pools.size() - 1;
+
+			return Block;
+		}
+
+		void FreeBlock(const TReplayBlock& Block)
+		{
+			if (Block.Pool == DEDICATED_POOL)
+			{
+				ReservedSize -= GetDedicatedSize(Block.Size);
+				AllocatedSize -= GetDedicatedSize(Block.Size);
+				return;
+			}
+
+			TReplayPool& Pool = *PoolSets[Block.PoolSet].Pools[Block.Pool];
+
+			const uint64_t OldAllocSize = Pool.GetTotalAllocSize();
+			Pool.Deallocate(Block.Handle, Block.Order);
+			AllocatedSize -= OldAllocSize - Pool.GetTotalAllocSize();
+		}
+
+		// same size classes as TD3D12SlabAllocator, slabs are kept once created
+		bool AllocFromSlab(uint32_t PoolSetIndex, uint64_t Size, uint64_t Alignment, TReplayBlock& OutBlock)
+		{
+			TReplayPoolSet& PoolSet = PoolSets[PoolSetIndex];
+			if (Settings.Algorithm != EReplayAlgorithm::SlabBuddy || PoolSet.bPlaced)
+			{
+				return false;
+			}
+
+			const uint32_t ClassIndex = TBuddyAllocator<THostBackingStore>::GetAllocationOrder((std::max)(Size, Alignment), 0, Settings.MinBlockSize);
+			const uint64_t SlotSize = Settings.MinBlockSize << ClassIndex;
+			if (SlotSize > Settings.SlabMaxSlotSize)
+			{
+				return false;
+			}
+
+			if (PoolSet.PartialSlabs.size() <= ClassIndex)
+			{
+				PoolSet.PartialSlabs.resize(ClassIndex + 1);
+			}
+
+			std::vector<int32_t>& Partial = PoolSet.PartialSlabs[ClassIndex];
+			if (Partial.empty())
+			{
+				TReplaySlab Slab;
+				Slab.Block = AllocFromPools(PoolSetIndex, Settings.SlabSize, 0);
+
+				const uint32_t NumSlots = (uint32_t)(Settings.SlabSize / SlotSize);
+				for (uint32_t Slot = NumSlots; Slot > 0; --Slot)
+				{
+					Slab.FreeSlots.push_back(Slot - 1);
+				}
+
+				PoolSet.Slabs.push_back(std::move(Slab));
+				Partial.push_back((int32_t)PoolSet.Slabs.size() - 1);
+			}
+
+			const int32_t SlabIndex = Partial.back();
+			TReplaySlab& Slab = PoolSet.Slabs[SlabIndex];
+
+			OutBlock.PoolSet = PoolSetIndex;
+			OutBlock.Slab = SlabIndex;
+			OutBlock.Slot = Slab.FreeSlots.back();
+			OutBlock.Order = ClassIndex;
+			Slab.FreeSlots.pop_back();
+
+			if (Slab.FreeSlots.empty())
+			{
+				Partial.pop_back();
+			}
+
+			return true;
+		}
+
+		void FreeSlot(const TReplayBlock& Block)
+		{
+			TReplayPoolSet& PoolSet = PoolSets[Block.PoolSet];
+			TReplaySlab& Slab = PoolSet.Slabs[Block.Slab];
+
+			if (Slab.FreeSlots.empty())
+			{
+				PoolSet.PartialSlabs[Block.Order].push_back(Block.Slab);
+			}
+
+			Slab.FreeSlots.push_back(Block.Slot);
+		}
+
+		void SampleFragmentation()
+		{
+			uint64_t FreeSize = 0;
+			uint64_t LargestFreeSize = 0;
+
+			for (const TReplayPoolSet& PoolSet : PoolSets)
+			{
+				for (const std::unique_ptr<TReplayPool>& Pool : PoolSet.Pools)
+				{
+					FreeSize += Pool->GetPoolSize() - Pool->GetTotalAllocSize();
+					LargestFreeSize = (std::max)(LargestFreeSize, Pool->GetLargestFreeSize());
+				}
+			}
+
+			const float Fragmentation = FreeSize != 0 ? 1.0f - (float)LargestFreeSize / FreeSize : 0.0f;
+
+			FragmentationSum += Fragmentation;
+			++NumFragmentationSamples;
+
+			Result.MaxFragmentation = (std::max)(Result.MaxFragmentation, Fragmentation);
+			Result.AverageFragmentation = (float)(FragmentationSum / NumFragmentationSamples);
+		}
+
+	private:
+		TAllocationReplaySettings Settings;
+
+		TAllocationReplayResult Result;
+
+		std::vector<TReplayPoolSet> PoolSets;
+
+		std::unordered_map<uint32_t, uint32_t> PoolSetIndices;
+
+		std::unordered_map<uint32_t, TReplayBlock> LiveBlocks;
+
+		TFencedDeletionQueue<TReplayBlock> PendingFrees;
+
+		uint64_t ReservedSize = 0;
+		uint64_t AllocatedSize = 0;
+		uint64_t RequestedSize = 0;
+
+		double FragmentationSum = 0.0;
+		uint32_t NumFragmentationSamples = 0;
+	};
+}
+
+TAllocationTraceRecorder& TAllocationTraceRecorder::Get()
+{
+	static TAllocationTraceRecorder Recorder;
+	return Recorder;
+}
+
+void TAllocationTraceRecorder::Begin(uint64_t FenceValue)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	Events.clear();
+	LiveIds.clear();
+	NextId = 0;
+	StartFenceValue = FenceValue;
+
+	bRecording.store(true, std::memory_order_relaxed);
+}
+
+void TAllocationTraceRecorder::End(std::vector<TAllocationTraceEvent>& OutEvents)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	bRecording.store(false, std::memory_order_relaxed);
+
+	OutEvents = std::move(Events);
+	Events.clear();
+	LiveIds.clear();
+}
+
+void TAllocationTraceRecorder::RecordAlloc(const void* Key, uint64_t Size, uint64_t Alignment, uint8_t HeapType, bool bPlaced, uint64_t FenceValue)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	// the capture may have ended while we waited for the lock
+	if (!IsRecording())
+	{
+		return;
+	}
+
+	TAllocationTraceEvent Event;
+	Event.Type = EAllocationTraceEventType::Alloc;
+	Event.HeapType = HeapType;
+	Event.bPlaced = bPlaced ? 1 : 0;
+	Event.Id = NextId++;
+	Event.Alignment = (uint32_t)Alignment;
+	Event.FenceValue = RelativeFence(FenceValue);
+	Event.Size = Size;
+
+	LiveIds[Key] = Event.Id;
+	Events.push_back(Event);
+}
+
+void TAllocationTraceRecorder::RecordFree(const void* Key, uint64_t FenceValue)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	auto It = LiveIds.find(Key);
+	if (!IsRecording() || It == LiveIds.end())
+	{
+		return;
+	}
+
+	TAllocationTraceEvent Event;
+	Event.Type = EAllocationTraceEventType::Free;
+	Event.Id = It->second;
+	Event.FenceValue = RelativeFence(FenceValue);
+
+	LiveIds.erase(It);
+	Events.push_back(Event);
+}
+
+void TAllocationTraceRecorder::RecordCleanUp(uint64_t CompletedFenceValue)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	if (!IsRecording())
+	{
+		return;
+	}
+
+	TAllocationTraceEvent Event;
+	Event.Type = EAllocationTraceEventType::CleanUp;
+	Event.FenceValue = RelativeFence(CompletedFenceValue);
+
+	Events.push_back(Event);
+}
+
+bool SaveAllocationTrace(const char* FileName, const std::vector<TAllocationTraceEvent>& Events)
+{
+	std::ofstream File(FileName, std::ios::binary);
+	if (!File)
+	{
+		return false;
+	}
+
+	TTraceFileHeader Header;
+	std::copy(TRACE_MAGIC, TRACE_MAGIC + 4, Header.Magic);
+	Header.Version = TRACE_VERSION;
+	Header.EventSize = sizeof(TAllocationTraceEvent);
+	Header.NumEvents = (uint32_t)Events.size();
+
+	File.write((const char*)&Header, sizeof(Header));
+	File.write((const char*)Events.data(), Events.size() * sizeof(TAllocationTraceEvent));
+
+	return (bool)File;
+}
+
+bool LoadAllocationTrace(const char* FileName, std::vector<TAllocationTraceEvent>& OutEvents)
+{
+	std::ifstream File(FileName, std::ios::binary);
+	if (!File)
+	{
+		return false;
+	}
+
+	TTraceFileHeader Header;
+	File.read((char*)&Header, sizeof(Header));
+	if (!File || !std::equal(TRACE_MAGIC, TRACE_MAGIC + 4, Header.Magic) || Header.Version != TRACE_VERSION || Header.EventSize != sizeof(TAllocationTraceEvent))
+	{
+		return false;
+	}
+
+	OutEvents.resize(Header.NumEvents);
+	File.read((char*)OutEvents.data(), OutEvents.size() * sizeof(TAllocationTraceEvent));
+
+	return (bool)File;
+}
+
+TAllocationReplayResult ReplayAllocationTrace(const std::vector<TAllocationTraceEvent>& Events, const TAllocationReplaySettings& Settings)
+{
+	TReplay Replay(Settings);
+
+	const auto StartTime = std::chrono::steady_clock::now();
+
+	for (const TAllocationTraceEvent& Event : Events)
+	{
+		switch (Event.Type)
+		{
+		case EAllocationTraceEventType::Alloc:
+			Replay.Alloc(Event);
+			break;
+		case EAllocationTraceEventType::Free:
+			Replay.Free(Event);
+			break;
+		case EAllocationTraceEventType::CleanUp:
+			Replay.CleanUp(Event);
+			break;
+		}
+	}
+
+	const std::chrono::duration<double> Seconds = std::chrono::steady_clock::now() - StartTime;
+
+	TAllocationReplayResult& Result = Replay.GetResult();
+	Result.Seconds = Seconds.count();
+	Result.AllocationsPerSecond = Result.Seconds > 0.0 ? Result.NumAllocations / Result.Seconds : 0.0;
+
+	return Result;
+}
@@ -0,0 +1,134 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+
+// Allocation traces: the buffer and texture allocators log every request while a capture is running,
+// ReplayAllocationTrace runs the same traffic through the device independent allocators on the host.
+// Nothing here talks to the device, heap types and fence values are plain numbers.
+
+enum class EAllocationTraceEventType : uint8_t
+{
+	Alloc,
+	Free,
+	CleanUp,
+};
+
+struct TAllocationTraceEvent
+{
+	EAllocationTraceEventType Type = EAllocationTraceEventType::Alloc;
+
+	// D3D12_HEAP_TYPE of the pool
+	uint8_t HeapType = 0;
+
+	// placed resources (textures) get pools of their own
+	uint8_t bPlaced = 0;
+
+	uint8_t Padding = 0;
+
+	// matches a Free to its Alloc
+	uint32_t Id = 0;
+
+	uint32_t Alignment = 0;
+
+	// next fence value when the event happened, relative to the start of the capture.
+	// for CleanUp it is the completed fence value
+	uint32_t FenceValue = 0;
+
+	// requested size of an Alloc
+	uint64_t Size = 0;
+};
+
+static_assert(sizeof(TAllocationTraceEvent) == 24, "the trace file stores the events as they are");
+
+class TAllocationTraceRecorder
+{
+public:
+	static TAllocationTraceRecorder& Get();
+
+	// cheap enough to test on every allocation
+	bool IsRecording() const { return bRecording.load(std::memory_order_relaxed); }
+
+	void Begin(uint64_t FenceValue);
+
+	// stops the capture and hands the events over
+	void End(std::vector<TAllocationTraceEvent>& OutEvents);
+
+	// Key identifies the allocation until it is freed, the address of its location
+	void RecordAlloc(const void* Key, uint64_t Size, uint64_t Alignment, uint8_t HeapType, bool bPlaced, uint64_t FenceValue);
+
+	// frees of allocations made before Begin are dropped
+	void RecordFree(const void* Key, uint64_t FenceValue);
+
+	void RecordCleanUp(uint64_t CompletedFenceValue);
+
+private:
+	uint32_t RelativeFence(uint64_t FenceValue) const { return FenceValue > StartFenceValue ? (uint32_t)(FenceValue - StartFenceValue) : 0; }
+
+private:
+	std::atomic<bool> bRecording = false;
+
+	std::mutex Mutex;
+
+	std::vector<TAllocationTraceEvent> Events;
+
+	std::unordered_map<const void*, uint32_t> LiveIds;
+
+	uint32_t NextId = 0;
+
+	uint64_t StartFenceValue = 0;
+};
+
+// binary file: a small header followed by the events
+bool SaveAllocationTrace(const char* FileName, const std::vector<TAllocationTraceEvent>& Events);
+
+bool LoadAllocationTrace(const char* FileName, std::vector<TAllocationTraceEvent>& OutEvents);
+
+enum class EReplayAlgorithm
+{
+	Buddy,
+	TLSF,
+	// buddy pools, buffer requests up to SlabMaxSlotSize are served from slabs
+	SlabBuddy,
+};
+
+// the defaults match the D3D12 buffer and texture allocators
+struct TAllocationReplaySettings
+{
+	EReplayAlgorithm Algorithm = EReplayAlgorithm::Buddy;
+
+	uint64_t PoolSize = 1024 * 1024 * 64;
+	uint64_t MinBlockSize = 256;
+	uint32_t MaxOrder = 0;
+
+	uint64_t PlacedPoolSize = 1024 * 1024 * 128;
+	uint64_t PlacedMinBlockSize = 64 * 1024;
+
+	uint64_t SlabSize = 64 * 1024;
+	uint64_t SlabMaxSlotSize = 4 * 1024;
+
+	// larger requests get a committed resource of their own
+	uint64_t DedicatedThreshold = 1024 * 1024 * 16;
+};
+
+struct TAllocationReplayResult
+{
+	uint32_t NumAllocations = 0;
+
+	double Seconds = 0.0;
+
+	double AllocationsPerSecond = 0.0;
+
+	// high water marks of the pool memory, of the blocks handed out and of the requested bytes
+	uint64_t PeakReservedSize = 0;
+	uint64_t PeakAllocatedSize = 0;
+	uint64_t PeakRequestedSize = 0;
+
+	// 1 - largest free block / free memory, sampled at every CleanUp
+	float AverageFragmentation = 0.0f;
+	float MaxFragmentation = 0.0f;
+};
+
+TAllocationReplayResult ReplayAllocationTrace(const std::vector<TAllocationTraceEvent>& Events, const TAllocationReplaySettings& Settings);
@@ -0,0 +1,622 @@
+#pragma once
+#include <stdint.h>
+#include <assert.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Device independent buddy bookkeeping.
+// Only offsets and orders are managed here, the memory itself comes from a backing store policy:
+//
+//   class TBackingStore
+//   {
+//       void Create(uint64_t PoolSize); // reserve PoolSize bytes, offsets handed out are relative to it
+//   };
+//
+// The store is released by its destructor. D3D12 uses a placed heap or a committed buffer (see D3D12MemoryAllocator.h),
+// THostBackingStore below uses system memory so the allocator can run without a device.
+
+// index of the lowest set bit, Mask must not be zero
+inline uint32_t FindLowestSetBit(uint64_t Mask)
+{
+#if defined(_MSC_VER)
+	unsigned long Result;
+#if defined(_M_X64) || defined(_M_ARM64)
+	_BitScanForward64(&Result, Mask);
+#else
+	if (!_BitScanForward(&Result, (unsigned long)Mask))
+	{
+		_BitScanForward(&Result, (unsigned long)(Mask >> 32));
+		Result += 32;
+	}
+#endif
+	return Result;
+#else
+	return (uint32_t)__builtin_ctzll(Mask);
+#endif
+}
+
+// index of the highest set bit, Mask must not be zero
+inline uint32_t FindHighestSetBit(uint64_t Mask)
+{
+#if defined(_MSC_VER)
+	unsigned long Result;
+#if defined(_M_X64) || defined(_M_ARM64)
+	_BitScanReverse64(&Result, Mask);
+#else
+	if (_BitScanReverse(&Result, (unsigned long)(Mask >> 32)))
+	{
+		Result += 32;
+	}
+	else
+	{
+		_BitScanReverse(&Result, (unsigned long)Mask);
+	}
+#endif
+	return Result;
+#else
+	return 63 - (uint32_t)__builtin_clzll(Mask);
+#endif
+}
+
+// Free list of one buddy order, one bit per block.
+// Every upper level keeps one bit per non-empty word of the level below,
+// so the lowest free block is found with one bit scan per level (4 levels for 2^21 blocks).
+class TFreeBlockBitmap
+{
+public:
+	void Initialize(uint32_t NumBits)
+	{
+		Words.clear();
+		LevelOffsets.clear();
+
+		// 至少保留一个字，NumBits为0时也能正常结束
+		uint32_t NumWords = NumBits > 0 ? (NumBits + 63) / 64 : 1;
+		while (true)
+		{
+			LevelOffsets.push_back((uint32_t)Words.size());
+			Words.resize(Words.size() + NumWords, 0);
+
+			if (NumWords == 1)
+			{
+				break;
+			}
+
+			NumWords = (NumWords + 63) / 64;
+		}
+	}
+
+	void Set(uint32_t Index)
+	{
+		for (uint32_t Level = 0; Level < LevelOffsets.size(); ++Level)
+		{
+			uint64_t& Word = Words[LevelOffsets[Level] + (Index >> 6)];
+			const bool bWasEmpty = (Word == 0);
+
+			Word |= (uint64_t)1 << (Index & 63);
+
+			// upper levels already know this word is not empty
+			if (!bWasEmpty)
+			{
+				break;
+			}
+
+			Index >>= 6;
+		}
+	}
+
+	void Clear(uint32_t Index)
+	{
+		for (uint32_t Level = 0; Level < LevelOffsets.size(); ++Level)
+		{
+			uint64_t& Word = Words[LevelOffsets[Level] + (Index >> 6)];
+
+			Word &= ~((uint64_t)1 << (Index & 63));
+
+			// the word still has free blocks, upper levels stay set
+			if (Word != 0)
+			{
+				break;
+			}
+
+			Index >>= 6;
+		}
+	}
+
+	bool Test(uint32_t Index) const
+	{
+		return (Words[Index >> 6] >> (Index & 63)) & 1;
+	}
+
+	bool Empty() const
+	{
+		return Words[LevelOffsets.back()] == 0;
+	}
+
+	// calls Func(Index) for every set bit in increasing order
+	template<typename TFunc>
+	void ForEachSetBit(TFunc&& Func) const
+	{
+		const uint32_t NumLeafWords = LevelOffsets.size() > 1 ? LevelOffsets[1] : (uint32_t)Words.size();
+		for (uint32_t WordIndex = 0; WordIndex < NumLeafWords; ++WordIndex)
+		{
+			uint64_t Word = Words[WordIndex];
+			while (Word != 0)
+			{
+				Func((WordIndex << 6) + FindLowestSetBit(Word));
+				Word &= Word - 1;
+			}
+		}
+	}
+
+	// lowest set bit, the bitmap must not be empty
+	uint32_t FindFirst() const
+	{
+		uint32_t Index = 0;
+
+		for (int32_t Level = (int32_t)LevelOffsets.size() - 1; Level >= 0; --Level)
+		{
+			const uint64_t Word = Words[LevelOffsets[Level] + Index];
+			assert(Word != 0);
+
+			Index = (Index << 6) + FindLowestSetBit(Word);
+		}
+
+		return Index;
+	}
+
+	// shortest run of at least Count set bits, the lowest one on a tie, scans the leaf level word by word.
+	// returns the length of the run, 0 when there is none
+	uint32_t FindBestRun(uint32_t Count, uint32_t& OutIndex) const
+	{
+		const uint32_t NumLeafWords = LevelOffsets.size() > 1 ? LevelOffsets[1] : (uint32_t)Words.size();
+
+		uint32_t BestLength = 0;
+		uint32_t RunStart = 0;
+		uint32_t RunLength = 0;
+
+		auto EndRun = [&]()
+		{
+			if (RunLength >= Count && (BestLength == 0 || RunLength < BestLength))
+			{
+				BestLength = RunLength;
+				OutIndex = RunStart;
+			}
+
+			RunLength = 0;
+		};
+
+		for (uint32_t WordIndex = 0; WordIndex < NumLeafWords; ++WordIndex)
+		{
+			const uint64_t Word = Words[WordIndex];
+
+			if (Word == 0)
+			{
+				if (RunLength > 0)
+				{
+					EndRun();
+				}
+				continue;
+			}
+
+			for (uint32_t Bit = 0; Bit < 64; ++Bit)
+			{
+				if (((Word >> Bit) & 1) == 0)
+				{
+					if (RunLength > 0)
+					{
+						EndRun();
+
+						// nothing beats an exact fit
+						if (BestLength == Count)
+						{
+							return BestLength;
+						}
+					}
+					continue;
+				}
+
+				if (RunLength == 0)
+				{
+					RunStart = (WordIndex << 6) + Bit;
+				}
+				++RunLength;
+			}
+		}
+
+		if (RunLength > 0)
+		{
+			EndRun();
+		}
+
+		return BestLength;
+	}
+
+private:
+	// all levels packed together, leaf level first, the last level is a single word
+	std::vector<uint64_t> Words;
+
+	std::vector<uint32_t> LevelOffsets;
+};
+
+// result of TBuddyAllocator::Allocate
+struct TBuddyAllocation
+{
+	// offset of the block in MinBlockSize units
+	uint32_t Offset = 0;
+
+	uint32_t Order = 0;
+
+	// byte offset from the base of the backing store, aligned to the requested alignment
+	uint64_t AlignedOffset = 0;
+};
+
+template<typename TBackingStore>
+class TBuddyAllocator
+{
+public:
+	// InMaxOrder is the order of the largest block, 0 makes one block that covers the whole pool.
+	// With a smaller MaxOrder the pool is split into several top level blocks that never merge,
+	// PoolSize is rounded up to a multiple of the top level block size.
+	template<typename... TStoreArgs>
+	TBuddyAllocator(uint64_t InPoolSize, uint64_t InMinBlockSize, uint32_t InMaxOrder, TStoreArgs&&... StoreArgs)
+		: MinBlockSize(InMinBlockSize), BackingStore(std::forward<TStoreArgs>(StoreArgs)...)
+	{
+		assert(MinBlockSize > 0);
+
+		MaxOrder = InMaxOrder != 0 ? InMaxOrder : UnitSizeToOrder(SizeToUnitSize(InPoolSize));
+		assert(MaxOrder < 32);
+
+		// offsets in MinBlockSize units have to fit in 32 bits
+		const uint64_t TopBlockUnits = OrderToUnitSize(MaxOrder);
+		NumTopBlocks = (uint32_t)((SizeToUnitSize(InPoolSize) + TopBlockUnits - 1) / TopBlockUnits);
+		assert(NumTopBlocks > 0 && NumTopBlocks * TopBlockUnits <= UINT32_MAX);
+
+		PoolSize = NumTopBlocks * TopBlockUnits * MinBlockSize;
+
+		BackingStore.Create(PoolSize);
+
+		// order i has NumTopBlocks * 2^(MaxOrder - i) blocks
+		FreeBlocks.resize(MaxOrder + 1);
+		NumFreeBlocks.resize(MaxOrder + 1, 0);
+		for (uint32_t i = 0; i <= MaxOrder; ++i)
+		{
+			FreeBlocks[i].Initialize(NumTopBlocks << (MaxOrder - i));
+		}
+
+		// 起始为0，最高阶数
+		for (uint32_t i = 0; i < NumTopBlocks; ++i)
+		{
+			AddFreeBlock(MaxOrder, i);
+		}
+	}
+
+	bool Allocate(uint64_t Size, uint64_t Alignment, TBuddyAllocation& OutAllocation)
+	{
+		const uint64_t SizeToAllocate = GetSizeToAllocate(Size, Alignment);
+
+		if (!CanAllocate(SizeToAllocate))
+		{
+			return false;
+		}
+
+		// Allocate Block
+		const uint32_t Order = UnitSizeToOrder(SizeToUnitSize(SizeToAllocate));
+		const uint32_t Offset = AllocateBlock(Order); // This is  the offset in MinBlockSize units
+		const uint64_t BlockSize = OrderToUnitSize(Order) * MinBlockSize;
+		TotalAllocSize += BlockSize;
+
+		// calculate AlignedOffsetFromResourceBase
+		const uint64_t OffsetFromBaseOfResource = Offset * MinBlockSize;
+		uint64_t AlignedOffsetFromResourceBase = OffsetFromBaseOfResource;
+
+		if (Alignment != 0 && OffsetFromBaseOfResource % Alignment != 0)
+		{
+			AlignedOffsetFromResourceBase = ((OffsetFromBaseOfResource + Alignment - 1) / Alignment) * Alignment;
+
+			assert((AlignedOffsetFromResourceBase - OffsetFromBaseOfResource + Size) <= BlockSize);
+		}
+
+		OutAllocation.Offset = Offset;
+		OutAllocation.Order = Order;
+		OutAllocation.AlignedOffset = AlignedOffsetFromResourceBase;
+
+		return true;
+	}
+
+	void Deallocate(uint32_t Offset, uint32_t Order)
+	{
+		DeallocateBlock(Offset, Order);
+
+		TotalAllocSize -= OrderToUnitSize(Order) * MinBlockSize;
+	}
+
+	// order of the block that serves the request, every pool with the same MinBlockSize agrees on it
+	static uint32_t GetAllocationOrder(uint64_t Size, uint64_t Alignment, uint64_t MinBlockSize)
+	{
+		// if the alignment doesn't match the block size
+		if (Alignment != 0 && MinBlockSize % Alignment != 0)
+		{
+			Size += Alignment;
+		}
+
+		return UnitSizeToOrder((Size + (MinBlockSize - 1)) / MinBlockSize);
+	}
+
+	// order of the largest free block, -1 when the pool is full
+	int32_t GetLargestFreeOrder() const
+	{
+		return FreeOrderMask != 0 ? (int32_t)FindHighestSetBit(FreeOrderMask) : -1;
+	}
+
+	bool CanAllocate(uint64_t SizeToAllocate) const
+	{
+		// 最大块容量 不能满足 请求容量
+		if (SizeToAllocate > GetMaxBlockSize())
+		{
+			return false;
+		}
+
+		// 存在不低于请求阶数的自由块
+		const uint32_t Order = UnitSizeToOrder(SizeToUnitSize(SizeToAllocate));
+
+		return (FreeOrderMask >> Order) != 0;
+	}
+
+	uint64_t GetPoolSize() const { return PoolSize; }
+
+	uint64_t GetMinBlockSize() const { return MinBlockSize; }
+
+	// size of a top level block, the largest size one allocation can have
+	uint64_t GetMaxBlockSize() const { return OrderToUnitSize(MaxOrder) * MinBlockSize; }
+
+	uint64_t GetTotalAllocSize() const { return TotalAllocSize; }
+
+	uint32_t GetMaxOrder() const { return MaxOrder; }
+
+	uint32_t GetNumFreeBlocks(uint32_t Order) const { return NumFreeBlocks[Order]; }
+
+	// calls Func(Offset, Order) for every free block, Offset in MinBlockSize units
+	template<typename TFunc>
+	void ForEachFreeBlock(TFunc&& Func) const
+	{
+		for (uint32_t Order = 0; Order <= MaxOrder; ++Order)
+		{
+			FreeBlocks[Order].ForEachSetBit([&](uint32_t Index)
+			{
+				Func(Index << Order, Order);
+			});
+		}
+	}
+
+	TBackingStore& GetBackingStore() { return BackingStore; }
+
+	const TBackingStore& GetBackingStore() const { return BackingStore; }
+
+private:
+	uint64_t GetSizeToAllocate(uint64_t Size, uint64_t Alignment) const
+	{
+		uint64_t SizeToAllocate = Size;
+
+		// if the alignment doesn't match the block size
+		if (Alignment != 0 && MinBlockSize % Alignment != 0)
+		{
+			SizeToAllocate = Size + Alignment;
+		}
+
+		return SizeToAllocate;
+	}
+
+	uint64_t SizeToUnitSize(uint64_t Size) const
+	{
+		return (Size + (MinBlockSize - 1)) / MinBlockSize;
+	}
+
+	static uint32_t UnitSizeToOrder(uint64_t Size)
+	{
+		// ceil(log2(Size))
+		return Size <= 1 ? 0 : FindHighestSetBit(Size - 1) + 1;
+	}
+
+	uint64_t OrderToUnitSize(uint32_t Order) const
+	{
+		return ((uint64_t)1) << Order;
+	}
+
+	uint32_t AllocateBlock(uint32_t Order)
+	{
+		assert(Order <= MaxOrder);
+
+		// 对应阶数无自由块，往高阶寻找最小的可用阶数
+		const uint64_t Candidates = FreeOrderMask & (~(uint64_t)0 << Order);
+		assert(Candidates != 0);
+
+		uint32_t FoundOrder = FindLowestSetBit(Candidates);
+
+		// 取最左侧的一块进行分配
+		uint32_t Offset = FreeBlocks[FoundOrder].FindFirst() << FoundOrder;
+		RemoveFreeBlock(FoundOrder, Offset >> FoundOrder);
+
+		// 拆分，右半块放回低一阶的自由块
+		while (FoundOrder > Order)
+		{
+			--FoundOrder;
+			AddFreeBlock(FoundOrder, (Offset >> FoundOrder) + 1);
+		}
+
+		return Offset;
+	}
+
+	void DeallocateBlock(uint32_t Offset, uint32_t Order)
+	{
+		// If buddy block is free, merge it and continue with the parent order
+		while (Order < MaxOrder)
+		{
+			// 计算出伙伴块的索引
+			const uint32_t BuddyIndex = (Offset >> Order) ^ 1;
+
+			if (!FreeBlocks[Order].Test(BuddyIndex))
+			{
+				break;
+			}
+
+			// Remove the buddy from the free list
+			RemoveFreeBlock(Order, BuddyIndex);
+
+			// merged block starts at min(Offset, Buddy)
+			Offset &= ~((uint32_t)1 << Order);
+			++Order;
+		}
+
+		// add the block to the free list
+		AddFreeBlock(Order, Offset >> Order);
+	}
+
+	void AddFreeBlock(uint32_t Order, uint32_t Index)
+	{
+		FreeBlocks[Order].Set(Index);
+		FreeOrderMask |= (uint64_t)1 << Order;
+		++NumFreeBlocks[Order];
+	}
+
+	void RemoveFreeBlock(uint32_t Order, uint32_t Index)
+	{
+		FreeBlocks[Order].Clear(Index);
+		--NumFreeBlocks[Order];
+		if (FreeBlocks[Order].Empty())
+		{
+			FreeOrderMask &= ~((uint64_t)1 << Order);
+		}
+	}
+
+private:
+	uint64_t PoolSize = 0;
+
+	const uint64_t MinBlockSize;
+
+	uint32_t MaxOrder = 0;
+
+	uint32_t NumTopBlocks = 0;
+
+	uint64_t TotalAllocSize = 0;
+
+	// FreeBlocks[Order] has one bit per block of that order, indexed by Offset >> Order
+	std::vector<TFreeBlockBitmap> FreeBlocks;
+
+	// bit i is set when FreeBlocks[i] is not empty
+	uint64_t FreeOrderMask = 0;
+
+	// population of FreeBlocks[Order], for statistics
+	std::vector<uint32_t> NumFreeBlocks;
+
+	TBackingStore BackingStore;
+};
+
+// Finds a pool that can serve a given order without asking every pool.
+// Each pool slot is filed under the order of its largest free block, one bitmap per order,
+// so the lookup is a bit scan over the orders plus one TFreeBlockBitmap::FindFirst.
+// The smallest sufficient order wins: that pool is the fullest one that fits,
+// pools with large free ranges are left alone so they can drain.
+class TBuddyPoolIndex
+{
+public:
+	// LargestFreeOrder is -1 when the pool is full or the slot is empty
+	void Update(uint32_t Slot, int32_t LargestFreeOrder)
+	{
+		if (Slot >= SlotOrders.size())
+		{
+			Grow(Slot + 1);
+		}
+
+		const int32_t OldOrder = SlotOrders[Slot];
+		if (OldOrder == LargestFreeOrder)
+		{
+			return;
+		}
+
+		if (OldOrder >= 0)
+		{
+			PoolsByOrder[OldOrder].Clear(Slot);
+			if (PoolsByOrder[OldOrder].Empty())
+			{
+				OrderMask &= ~((uint64_t)1 << OldOrder);
+			}
+		}
+
+		if (LargestFreeOrder >= 0)
+		{
+			PoolsByOrder[LargestFreeOrder].Set(Slot);
+			OrderMask |= (uint64_t)1 << LargestFreeOrder;
+		}
+
+		SlotOrders[Slot] = LargestFreeOrder;
+	}
+
+	bool Find(uint32_t Order, uint32_t& OutSlot) const
+	{
+		const uint64_t Candidates = Order < 64 ? OrderMask & (~(uint64_t)0 << Order) : 0;
+		if (Candidates == 0)
+		{
+			return false;
+		}
+
+		OutSlot = PoolsByOrder[FindLowestSetBit(Candidates)].FindFirst();
+
+		return true;
+	}
+
+private:
+	void Grow(uint32_t NumSlots)
+	{
+		uint32_t Capacity = SlotOrders.empty() ? 64 : (uint32_t)SlotOrders.size();
+		while (Capacity < NumSlots)
+		{
+			Capacity *= 2;
+		}
+
+		SlotOrders.resize(Capacity, -1);
+
+		// bitmaps have a fixed size, rebuild them from SlotOrders
+		PoolsByOrder.resize(64);
+		for (TFreeBlockBitmap& Bitmap : PoolsByOrder)
+		{
+			Bitmap.Initialize(Capacity);
+		}
+
+		for (uint32_t Slot = 0; Slot < Capacity; ++Slot)
+		{
+			if (SlotOrders[Slot] >= 0)
+			{
+				PoolsByOrder[SlotOrders[Slot]].Set(Slot);
+			}
+		}
+	}
+
+private:
+	std::vector<int32_t> SlotOrders;
+
+	// PoolsByOrder[Order] has one bit per pool slot whose largest free block has that order
+	std::vector<TFreeBlockBitmap> PoolsByOrder;
+
+	// bit i is set when PoolsByOrder[i] is not empty
+	uint64_t OrderMask = 0;
+};
+
+// system memory stand-in for the GPU heap, used to run the allocator without a device
+class THostBackingStore
+{
+public:
+	void Create(uint64_t PoolSize)
+	{
+		Memory.reset(new uint8_t[(size_t)PoolSize]);
+	}
+
+	uint8_t* GetBaseAddress() const { return Memory.get(); }
+
+private:
+	std::unique_ptr<uint8_t[]> Memory;
+};
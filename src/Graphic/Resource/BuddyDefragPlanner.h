@@ -0,0 +1,186 @@
+#pragma once
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+#include "BuddyAllocator.h"
+
+// Device independent move planning for a set of buddy pools.
+// One source pool is chosen per call, the least used one, and its blocks are moved into fuller pools
+// until the byte budget runs out. Once the source is empty the pool can be released (see TD3D12MultiBuddyAllocator).
+// A block only moves into a pool that uses at least as many bytes as the source,
+// so the sum of squared pool usage grows with every move and blocks never move back and forth.
+//
+// The destination blocks are allocated by the planner, the caller copies the data,
+// patches its locations and deallocates the source blocks once the GPU is done with them.
+
+// a live block as the planner sees it
+struct TDefragBlock
+{
+	// pool slot
+	uint32_t Pool = 0;
+
+	// offset in MinBlockSize units
+	uint32_t Offset = 0;
+
+	uint32_t Order = 0;
+
+	// bytes that have to be copied, counted against the budget
+	uint64_t Size = 0;
+
+	// false when the owner can't follow a move
+	bool bMovable = true;
+};
+
+struct TDefragMove
+{
+	// index into the block array passed to Plan
+	uint32_t BlockIndex = 0;
+
+	uint32_t DstPool = 0;
+
+	TBuddyAllocation Dst;
+};
+
+template<typename TBackingStore>
+class TBuddyDefragPlanner
+{
+public:
+	typedef TBuddyAllocator<TBackingStore> TPool;
+
+	// Pools may contain null slots, the pools must share MinBlockSize.
+	// At least one move is planned when possible even if that block alone exceeds ByteBudget, so large blocks still move.
+	static std::vector<TDefragMove> Plan(const std::vector<TPool*>& Pools, const std::vector<TDefragBlock>& Blocks, uint64_t ByteBudget)
+	{
+		std::vector<TDefragMove> Moves;
+
+		// non-empty pools, least used first
+		std::vector<uint32_t> Sources;
+		for (uint32_t Slot = 0; Slot < Pools.size(); ++Slot)
+		{
+			if (Pools[Slot] && Pools[Slot]->GetTotalAllocSize() != 0)
+			{
+				Sources.push_back(Slot);
+			}
+		}
+
+		// a single pool can't be evacuated
+		if (Sources.size() < 2)
+		{
+			return Moves;
+		}
+
+		std::sort(Sources.begin(), Sources.end(), [&Pools](uint32_t A, uint32_t B)
+		{
+			return Pools[A]->GetTotalAllocSize() < Pools[B]->GetTotalAllocSize();
+		});
+
+		// the first pool that has something to move is the source of this pass
+		for (uint32_t Source : Sources)
+		{
+			PlanSource(Pools, Blocks, Source, ByteBudget, Moves);
+
+			if (!Moves.empty())
+			{
+				break;
+			}
+		}
+
+		return Moves;
+	}
+
+private:
+	static void PlanSource(const std::vector<TPool*>& Pools, const std::vector<TDefragBlock>& Blocks, uint32_t Source, uint64_t ByteBudget, std::vector<TDefragMove>& Moves)
+	{
+		// largest blocks first, they are the hardest to place
+		std::vector<uint32_t> Candidates;
+		for (uint32_t i = 0; i < Blocks.size(); ++i)
+		{
+			if (Blocks[i].Pool == Source && Blocks[i].bMovable)
+			{
+				Candidates.push_back(i);
+			}
+		}
+
+		std::sort(Candidates.begin(), Candidates.end(), [&Blocks](uint32_t A, uint32_t B)
+		{
+			return Blocks[A].Order > Blocks[B].Order;
+		});
+
+		uint64_t SourceUsed = Pools[Source]->GetTotalAllocSize();
+		uint64_t BytesMoved = 0;
+
+		for (uint32_t BlockIndex : Candidates)
+		{
+			const TDefragBlock& Block = Blocks[BlockIndex];
+
+			if (!Moves.empty() && BytesMoved + Block.Size > ByteBudget)
+			{
+				break;
+			}
+
+			uint32_t DstPool = 0;
+			if (!FindDestination(Pools, Source, SourceUsed, Block.Order, DstPool))
+			{
+				continue;
+			}
+
+			// same order as the source block, buddy blocks are aligned to their own size
+			TPool* Pool = Pools[DstPool];
+			const uint64_t BlockSize = Pool->GetMinBlockSize() << Block.Order;
+
+			TDefragMove Move;
+			Move.BlockIndex = BlockIndex;
+			Move.DstPool = DstPool;
+
+			// FindDestination checked the free order, this can't fail
+			if (!Pool->Allocate(BlockSize, 0, Move.Dst))
+			{
+				assert(false);
+				continue;
+			}
+			assert(Move.Dst.Order == Block.Order);
+
+			Moves.push_back(Move);
+
+			// the source block is only freed by the caller, count it as gone for the next decisions
+			SourceUsed -= BlockSize;
+			BytesMoved += Block.Size;
+		}
+	}
+
+	// the pool with the smallest sufficient free block, ties go to the fuller pool
+	static bool FindDestination(const std::vector<TPool*>& Pools, uint32_t Source, uint64_t SourceUsed, uint32_t Order, uint32_t& OutPool)
+	{
+		bool bFound = false;
+		int32_t BestOrder = 0;
+		uint64_t BestUsed = 0;
+
+		for (uint32_t Slot = 0; Slot < Pools.size(); ++Slot)
+		{
+			const TPool* Pool = Pools[Slot];
+			if (!Pool || Slot == Source)
+			{
+				continue;
+			}
+
+			const int32_t LargestFreeOrder = Pool->GetLargestFreeOrder();
+			const uint64_t Used = Pool->GetTotalAllocSize();
+
+			// moving into an emptier pool gains nothing
+			if (LargestFreeOrder < (int32_t)Order || Used < SourceUsed)
+			{
+				continue;
+			}
+
+			if (!bFound || LargestFreeOrder < BestOrder || (LargestFreeOrder == BestOrder && Used > BestUsed))
+			{
+				bFound = true;
+				BestOrder = LargestFreeOrder;
+				BestUsed = Used;
+				OutPool = Slot;
+			}
+		}
+
+		return bFound;
+	}
+};
@@ -0,0 +1,76 @@
+#include "D3D12AllocationTracker.h"
+#include "stdafx.h"
+
+const char* GetAllocationCategoryName(EAllocationCategory Category)
+{
+	switch (Category)
+	{
+	case EAllocationCategory::VertexBuffer:		return "VertexBuffer";
+	case EAllocationCategory::IndexBuffer:		return "IndexBuffer";
+	case EAllocationCategory::ConstantBuffer:	return "ConstantBuffer";
+	case EAllocationCategory::Texture:			return "Texture";
+	case EAllocationCategory::RenderTarget:		return "RenderTarget";
+	case EAllocationCategory::Staging:			return "Staging";
+	default:									return "Unknown";
+	}
+}
+
+TD3D12AllocationTracker& TD3D12AllocationTracker::Get()
+{
+	static TD3D12AllocationTracker Tracker;
+	return Tracker;
+}
+
+void TD3D12AllocationTracker::Track(const TD3D12ResourceLocation& Location, const TAllocationTag& Tag, uint64_t Size)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	LiveAllocations[&Location] = TEntry{ Tag, Size };
+
+	TCategoryStats& Stats = CategoryStats[(uint32_t)Tag.Category];
+	Stats.NumAllocations += 1;
+	Stats.Size += Size;
+}
+
+void TD3D12AllocationTracker::Untrack(const TD3D12ResourceLocation& Location)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	auto It = LiveAllocations.find(&Location);
+	if (It == LiveAllocations.end())
+	{
+		return;
+	}
+
+	TCategoryStats& Stats = CategoryStats[(uint32_t)It->second.Tag.Category];
+	Stats.NumAllocations -= 1;
+	Stats.Size -= It->second.Size;
+
+	LiveAllocations.erase(It);
+}
+
+TD3D12AllocationTracker::TCategoryStats TD3D12AllocationTracker::GetCategoryStats(EAllocationCategory Category) const
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	return CategoryStats[(uint32_t)Category];
+}
+
+uint32_t TD3D12AllocationTracker::ReportLiveAllocations() const
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	char Buffer[256];
+
+	for (const auto& [Location, Entry] : LiveAllocations)
+	{
+		sprintf_s(Buffer, "Live allocation: %s, %s, %llu bytes\n",
+			GetAllocationCategoryName(Entry.Tag.Category), Entry.Tag.Name ? Entry.Tag.Name : "untagged", Entry.Size);
+		OutputDebugStringA(Buffer);
+	}
+
+	sprintf_s(Buffer, "%u allocations still alive\n", (uint32_t)LiveAllocations.size());
+	OutputDebugStringA(Buffer);
+
+	return (uint32_t)LiveAllocations.size();
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <stdint.h>
+#include <mutex>
+#include <unordered_map>
+
+// debug builds track every sub-allocation, staging builds can define ALLOCATION_TRACKING=1.
+// in release the tag member and the macros below compile to nothing
+#ifndef ALLOCATION_TRACKING
+#ifdef _DEBUG
+#define ALLOCATION_TRACKING 1
+#else
+#define ALLOCATION_TRACKING 0
+#endif
+#endif
+
+enum class EAllocationCategory : uint8_t
+{
+	Unknown,
+	VertexBuffer,
+	IndexBuffer,
+	ConstantBuffer,
+	Texture,
+	RenderTarget,
+	Staging,
+
+	Count,
+};
+
+const char* GetAllocationCategoryName(EAllocationCategory Category);
+
+struct TAllocationTag
+{
+	EAllocationCategory Category = EAllocationCategory::Unknown;
+
+	// call site, must be a string literal
+	const char* Name = nullptr;
+};
+
+#if ALLOCATION_TRACKING
+// set before the allocation, the tag is recorded when the block is assigned
+#define SET_ALLOCATION_TAG(Location, InCategory) (Location).Tag = TAllocationTag{ EAllocationCategory::InCategory, __FUNCTION__ }
+#define SET_ALLOCATION_TAG_NAMED(Location, InCategory, InName) (Location).Tag = TAllocationTag{ EAllocationCategory::InCategory, InName }
+#else
+#define SET_ALLOCATION_TAG(Location, InCategory) ((void)0)
+#define SET_ALLOCATION_TAG_NAMED(Location, InCategory, InName) ((void)0)
+#endif
+
+class TD3D12ResourceLocation;
+
+// live sub-allocations of all the pools, filled by TD3D12SubAllocator
+class TD3D12AllocationTracker
+{
+public:
+	struct TCategoryStats
+	{
+		uint32_t NumAllocations = 0;
+		uint64_t Size = 0;
+	};
+
+	struct TEntry
+	{
+		TAllocationTag Tag;
+		uint64_t Size = 0;
+	};
+
+public:
+	static TD3D12AllocationTracker& Get();
+
+	void Track(const TD3D12ResourceLocation& Location, const TAllocationTag& Tag, uint64_t Size);
+
+	void Untrack(const TD3D12ResourceLocation& Location);
+
+	TCategoryStats GetCategoryStats(EAllocationCategory Category) const;
+
+	// Func(const TD3D12ResourceLocation*, const TEntry&), called under the tracker's lock
+	template<typename FuncType>
+	void ForEachAllocation(EAllocationCategory Category, FuncType&& Func) const
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+
+		for (const auto& [Location, Entry] : LiveAllocations)
+		{
+			if (Entry.Tag.Category == Category)
+			{
+				Func(Location, Entry);
+			}
+		}
+	}
+
+	// writes the allocations still alive to the debug output, returns their count
+	uint32_t ReportLiveAllocations() const;
+
+private:
+	mutable std::mutex Mutex;
+
+	std::unordered_map<const TD3D12ResourceLocation*, TEntry> LiveAllocations;
+
+	TCategoryStats CategoryStats[(uint32_t)EAllocationCategory::Count];
+};
@@ -0,0 +1,93 @@
+#include "D3D12BindlessHeap.h"
+#include "DXSamplerHelper.h"
+#include "D3D12RHI.h"
+
+TD3D12BindlessHeap::TD3D12BindlessHeap(ID3D12Device* InDevice, uint32_t NumDescriptors)
+	: D3DDevice(InDevice), SlotIndex(NumDescriptors, 1)
+{
+	D3D12_DESCRIPTOR_HEAP_DESC Desc = {};
+	Desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	Desc.NumDescriptors = NumDescriptors;
+	Desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	ThrowIfFailed(D3DDevice->CreateDescriptorHeap(&Desc, IID_PPV_ARGS(&Heap)));
+	SetDebugName(Heap.Get(), L"TD3D12BindlessHeap Descriptor Heap");
+
+	DescriptorSize = D3DDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	SlotIndex.AddHeap(0);
+
+	// the lowest free slot comes first, the null view gets BINDLESS_NULL_INDEX
+	TDescriptorSlotIndex::TSlot NullSlot;
+	SlotIndex.Allocate(1, NullSlot);
+	assert(NullSlot.Handle == BINDLESS_NULL_INDEX);
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC NullDesc = {};
+	NullDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	NullDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	NullDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	NullDesc.Texture2D.MipLevels = 1;
+
+	D3DDevice->CreateShaderResourceView(nullptr, &NullDesc, Heap->GetCPUDescriptorHandleForHeapStart());
+}
+
+uint32_t TD3D12BindlessHeap::Register(D3D12_CPU_DESCRIPTOR_HANDLE SRV)
+{
+	uint32_t Index = BINDLESS_NULL_INDEX;
+
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+
+		TDescriptorSlotIndex::TSlot Slot;
+		if (!SlotIndex.Allocate(1, Slot))
+		{
+			OutputDebugStringA("TD3D12BindlessHeap: the heap is full, raise BINDLESS_HEAP_SIZE\n");
+			return BINDLESS_NULL_INDEX;
+		}
+
+		Index = (uint32_t)Slot.Handle;
+		++NumRegistered;
+	}
+
+	Update(Index, SRV);
+
+	return Index;
+}
+
+void TD3D12BindlessHeap::Update(uint32_t Index, D3D12_CPU_DESCRIPTOR_HANDLE SRV)
+{
+	assert(Index != BINDLESS_NULL_INDEX);
+
+	CD3DX12_CPU_DESCRIPTOR_HANDLE Dst(Heap->GetCPUDescriptorHandleForHeapStart(), Index, DescriptorSize);
+	D3DDevice->CopyDescriptorsSimple(1, Dst, SRV, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+void TD3D12BindlessHeap::Release(uint32_t Index)
+{
+	if (Index == BINDLESS_NULL_INDEX)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	// draws recorded so far may still read the slot
+	ReleasedIndices.Enqueue(Index, TD3D12RHI::g_CommandContext.GetNextFenceValue());
+}
+
+void TD3D12BindlessHeap::CleanUpAllocations(uint64_t CompletedFenceValue)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	ReleasedIndices.Retire(CompletedFenceValue, [this](uint32_t Index)
+	{
+		SlotIndex.Free({ 0, Index }, 1);
+		--NumRegistered;
+	});
+}
+
+uint32_t TD3D12BindlessHeap::GetNumRegistered()
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	return NumRegistered;
+}
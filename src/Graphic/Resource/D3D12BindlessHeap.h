@@ -0,0 +1,59 @@
+#pragma once
+#include "stdafx.h"
+#include "DescriptorSlotIndex.h"
+#include "FencedDeletionQueue.h"
+#include <mutex>
+
+// descriptors of the persistent shader visible heap, shaders index it with an unbounded Texture2D[] table
+#define BINDLESS_HEAP_SIZE 65536
+
+// register space of the unbounded table and of the per draw root constants in bindless shaders
+#define BINDLESS_REGISTER_SPACE 1
+
+// index 0 holds a null Texture2D view, unset indices read zeros
+#define BINDLESS_NULL_INDEX 0
+
+// One shader visible CBV/SRV/UAV heap that stays bound for the whole frame.
+// Every texture copies its SRV into it once at creation and keeps the index until it is released,
+// a draw only sets a root constant with the index instead of copying descriptors and switching heaps.
+// Needs resource binding tier 2 for the unbounded table.
+class TD3D12BindlessHeap
+{
+public:
+	TD3D12BindlessHeap(ID3D12Device* InDevice, uint32_t NumDescriptors = BINDLESS_HEAP_SIZE);
+
+	// copy the view into a free slot, returns BINDLESS_NULL_INDEX when the heap is full
+	uint32_t Register(D3D12_CPU_DESCRIPTOR_HANDLE SRV);
+
+	// the view was rewritten, the GPU must not be using the slot. Defragment runs once the previous frame has completed
+	void Update(uint32_t Index, D3D12_CPU_DESCRIPTOR_HANDLE SRV);
+
+	// the slot is reused once the frames recorded so far have completed
+	void Release(uint32_t Index);
+
+	void CleanUpAllocations(uint64_t CompletedFenceValue);
+
+	ID3D12DescriptorHeap* GetHeap() const { return Heap.Get(); }
+
+	// start of the unbounded table
+	D3D12_GPU_DESCRIPTOR_HANDLE GetTableStart() const { return Heap->GetGPUDescriptorHandleForHeapStart(); }
+
+	uint32_t GetNumRegistered();
+
+private:
+	ID3D12Device* D3DDevice = nullptr;
+
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> Heap;
+
+	uint32_t DescriptorSize = 0;
+
+	// one heap, handles are the indices
+	TDescriptorSlotIndex SlotIndex;
+
+	TFencedDeletionQueue<uint32_t> ReleasedIndices;
+
+	uint32_t NumRegistered = 0;
+
+	// textures are created by loader threads
+	std::mutex Mutex;
+};
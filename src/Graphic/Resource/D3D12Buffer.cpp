@@ -6,6 +6,7 @@
 TD3D12VertexBufferRef TD3D12RHI::CreateVertexBuffer(const void* Contents, uint32_t Size, uint32_t Stride)
 {
     TD3D12VertexBufferRef VertexBufferRef = std::make_shared<TD3D12VertexBuffer>();
+    SET_ALLOCATION_TAG(VertexBufferRef->ResourceLocation, VertexBuffer);
 
     CreateAndInitDefaultBuffer(Contents, Size, DEFAULT_RESOURCE_ALIGNMENT, VertexBufferRef->ResourceLocation);
     // create VBV
@@ -16,6 +17,7 @@ TD3D12VertexBufferRef TD3D12RHI::CreateVertexBuffer(const void* Contents, uint32
 TD3D12IndexBufferRef TD3D12RHI::CreateIndexBuffer(const void* Contents, uint32_t Size, DXGI_FORMAT Format)
 {
     TD3D12IndexBufferRef IndexBufferRef = std::make_shared<TD3D12IndexBuffer>();
+    SET_ALLOCATION_TAG(IndexBufferRef->ResourceLocation, IndexBuffer);
 
     CreateAndInitDefaultBuffer(Contents, Size, DEFAULT_RESOURCE_ALIGNMENT, IndexBufferRef->ResourceLocation);
     
@@ -23,11 +25,23 @@ TD3D12IndexBufferRef TD3D12RHI::CreateIndexBuffer(const void* Contents, uint32_t
     return IndexBufferRef;
 }
 
-TD3D12ConstantBufferRef TD3D12RHI::CreateConstantBuffer(const void* Contents, uint32_t Size)
+TD3D12ConstantBufferRef TD3D12RHI::CreateConstantBuffer(const void* Contents, uint32_t Size, bool bTransient)
 {
     TD3D12ConstantBufferRef ConstantBufferRef = std::make_shared<TD3D12ConstantBuffer>();
+    SET_ALLOCATION_TAG(ConstantBufferRef->ResourceLocation, ConstantBuffer);
 
-    void* Mappedata = UploadBufferAllocator->AllocUploadResource(Size, UPLOAD_RESOURCE_ALIGNMENT, ConstantBufferRef->ResourceLocation);
+    void* Mappedata = nullptr;
+
+    // per-frame data goes to the ring, fall back to the buddy allocator when the ring is full
+    if (bTransient)
+    {
+        Mappedata = UploadRingAllocator->AllocUploadResource(Size, UPLOAD_RESOURCE_ALIGNMENT, ConstantBufferRef->ResourceLocation);
+    }
+
+    if (Mappedata == nullptr)
+    {
+        Mappedata = UploadBufferAllocator->AllocUploadResource(Size, UPLOAD_RESOURCE_ALIGNMENT, ConstantBufferRef->ResourceLocation);
+    }
 
     memcpy(Mappedata, Contents, Size);
 
@@ -53,6 +67,7 @@ void TD3D12RHI::CreateAndInitDefaultBuffer(const void* Contents, uint32_t Size,
 
     // create UploadBuffer resource
     TD3D12ResourceLocation uploadResourceLocation;
+    SET_ALLOCATION_TAG(uploadResourceLocation, Staging);
     void* MappedData = UploadBufferAllocator->AllocUploadResource(Size, Alignment, uploadResourceLocation);
 
     // Copy contents to upload resource
@@ -95,10 +110,8 @@ void TD3D12IndexBuffer::CreateDerivedViews(uint32_t Size, DXGI_FORMAT Format)
 
 void TD3D12ConstantBuffer::CreateDerivedViews(uint32_t Size)
 {
+    // constant buffers are bound as root CBVs by GPUVirtualAddress,
+    // only keep the desc here instead of writing a descriptor heap slot for every buffer
     CBV_Desc.BufferLocation = ResourceLocation.GPUVirtualAddress;
-    CBV_Desc.SizeInBytes = (sizeof(Size) + 255) & ~255; // Align to 256 bytes
-
-    auto HeapHandle = TD3D12RHI::SRVHeapSlotAllocator->AllocateHeapSlot().Handle;
-
-    TD3D12RHI::g_Device->CreateConstantBufferView(&CBV_Desc, HeapHandle);
+    CBV_Desc.SizeInBytes = (Size + 255) & ~255; // Align to 256 bytes
 }
@@ -47,6 +47,8 @@ class TD3D12ConstantBuffer : public TD3D12Buffer
 public:
 	void CreateDerivedViews(uint32_t Size);
 
+	const D3D12_CONSTANT_BUFFER_VIEW_DESC& GetCBVDesc() const { return CBV_Desc; }
+
 private:
 	D3D12_CONSTANT_BUFFER_VIEW_DESC CBV_Desc;
 };
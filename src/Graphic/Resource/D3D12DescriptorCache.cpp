@@ -1,8 +1,9 @@
 #include "D3D12DescriptorCache.h"
 #include "DXSamplerHelper.h"
+#include "hash.h"
 
 TD3D12DescriptorCache::TD3D12DescriptorCache(ID3D12Device* InDevice)
-	: D3DDevice(InDevice)
+	: D3DDevice(InDevice), CbvSrvUavRing(MaxCbvSrvUavDescriptorCount)
 {
 	// create cache for Descriptor Heap
 	CreateCacheCbvSrvUavDescriptorHeap();
@@ -19,18 +20,48 @@ CD3DX12_GPU_DESCRIPTOR_HANDLE TD3D12DescriptorCache::AppendCbvSrvUavDescriptors(
 	
 	// caclculate the size of requested Descriptor heaps
 	uint32_t SlotsNeeded = (uint32_t)SrvDescriptors.size();
-	assert(CbvSrvUavDescriptorOffset + SlotsNeeded < MaxCbvSrvUavDescriptorCount);
+
+	size_t Hash = 0;
+	CD3DX12_GPU_DESCRIPTOR_HANDLE CachedGpuHandle;
+	if (FindTable(SrvDescriptors.data(), SlotsNeeded, Hash, CachedGpuHandle))
+	{
+		return CachedGpuHandle;
+	}
 
 	// 计算当前空闲堆的句柄
-	auto CpuDescriptorHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(CacheCbvSrvUavDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), CbvSrvUavDescriptorOffset, CbvSrvUavDescriptorSize);
+	const uint32_t Offset = AllocateCbvSrvUavDescriptors(SlotsNeeded);
+	auto CpuDescriptorHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(CacheCbvSrvUavDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), Offset, CbvSrvUavDescriptorSize);
 	D3DDevice->CopyDescriptors(1, &CpuDescriptorHandle, &SlotsNeeded, SlotsNeeded, SrvDescriptors.data(), nullptr, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
 	// Get GpuDescriptorHandle
-	auto GpuDescriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(CacheCbvSrvUavDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), CbvSrvUavDescriptorOffset, CbvSrvUavDescriptorSize);
+	auto GpuDescriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(CacheCbvSrvUavDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), Offset, CbvSrvUavDescriptorSize);
+	AddTable(Hash, SrvDescriptors.data(), SlotsNeeded, GpuDescriptorHandle);
+
+	return GpuDescriptorHandle;
+}
 
-	// Increase descriptor offset
-	// 计算分配后的空闲堆偏移
-	CbvSrvUavDescriptorOffset += SlotsNeeded;
+CD3DX12_GPU_DESCRIPTOR_HANDLE TD3D12DescriptorCache::AppendCbvSrvUavDescriptorRange(D3D12_CPU_DESCRIPTOR_HANDLE SrcStart, uint32_t NumDescriptors)
+{
+	// same key as the handles passed one by one, a range and a list of the same descriptors share the copy
+	RangeHandles.resize(NumDescriptors);
+	for (uint32_t i = 0; i < NumDescriptors; ++i)
+	{
+		RangeHandles[i].ptr = SrcStart.ptr + (SIZE_T)i * CbvSrvUavDescriptorSize;
+	}
+
+	size_t Hash = 0;
+	CD3DX12_GPU_DESCRIPTOR_HANDLE CachedGpuHandle;
+	if (FindTable(RangeHandles.data(), NumDescriptors, Hash, CachedGpuHandle))
+	{
+		return CachedGpuHandle;
+	}
+
+	const uint32_t Offset = AllocateCbvSrvUavDescriptors(NumDescriptors);
+	auto CpuDescriptorHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(CacheCbvSrvUavDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), Offset, CbvSrvUavDescriptorSize);
+	D3DDevice->CopyDescriptorsSimple(NumDescriptors, CpuDescriptorHandle, SrcStart, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	auto GpuDescriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(CacheCbvSrvUavDescriptorHeap->GetGPUDescriptorHandleForHeapStart(), Offset, CbvSrvUavDescriptorSize);
+	AddTable(Hash, RangeHandles.data(), NumDescriptors, GpuDescriptorHandle);
 
 	return GpuDescriptorHandle;
 }
@@ -52,12 +83,75 @@ void TD3D12DescriptorCache::AppendRtvDescriptors(const std::vector<D3D12_CPU_DES
 	RtvDescriptorOffset += SlotsNeeded;
 }
 
-void TD3D12DescriptorCache::Reset()
+void TD3D12DescriptorCache::FinishFrame(uint64_t FenceValue)
 {
-	ResetCacheCbvSrvUavDescriptorHeap();
+	CbvSrvUavRing.FinishFrame(FenceValue);
+
+	// the copies stay valid until the fence, but the ring only keeps them that long. start over every frame
+	CachedTables.clear();
+
+	LastFrameStats = FrameStats;
+	FrameStats = TD3D12DescriptorCacheStats();
+
+	// RTVs are read when OMSetRenderTargets is recorded, the GPU never sees this heap
 	ResetCacheRtvDescriptorHeap();
 }
 
+void TD3D12DescriptorCache::CleanUpAllocations(uint64_t CompletedFenceValue)
+{
+	CbvSrvUavRing.Retire(CompletedFenceValue);
+}
+
+bool TD3D12DescriptorCache::FindTable(const D3D12_CPU_DESCRIPTOR_HANDLE* Handles, uint32_t NumDescriptors, size_t& OutHash, CD3DX12_GPU_DESCRIPTOR_HANDLE& OutGpuHandle)
+{
+	OutHash = Utility::HashState(Handles, NumDescriptors);
+
+	auto Iter = CachedTables.find(OutHash);
+	if (Iter != CachedTables.end())
+	{
+		const TCachedTable& Table = Iter->second;
+
+		bool bSame = Table.Handles.size() == NumDescriptors;
+		for (uint32_t i = 0; i < NumDescriptors && bSame; ++i)
+		{
+			bSame = Table.Handles[i].ptr == Handles[i].ptr;
+		}
+
+		if (bSame)
+		{
+			++FrameStats.NumTableHits;
+			OutGpuHandle = Table.GpuHandle;
+			return true;
+		}
+	}
+
+	++FrameStats.NumTableMisses;
+	FrameStats.NumCopiedDescriptors += NumDescriptors;
+
+	return false;
+}
+
+void TD3D12DescriptorCache::AddTable(size_t Hash, const D3D12_CPU_DESCRIPTOR_HANDLE* Handles, uint32_t NumDescriptors, CD3DX12_GPU_DESCRIPTOR_HANDLE GpuHandle)
+{
+	// a colliding set replaces the older one
+	TCachedTable& Table = CachedTables[Hash];
+	Table.Handles.assign(Handles, Handles + NumDescriptors);
+	Table.GpuHandle = GpuHandle;
+}
+
+uint32_t TD3D12DescriptorCache::AllocateCbvSrvUavDescriptors(uint32_t NumDescriptors)
+{
+	uint64_t Offset = 0;
+	if (!CbvSrvUavRing.Allocate(NumDescriptors, 0, Offset))
+	{
+		// the frames in flight hold the whole ring
+		OutputDebugStringA("TD3D12DescriptorCache: the ring is full, raise MaxCbvSrvUavDescriptorCount\n");
+		assert(false);
+	}
+
+	return (uint32_t)Offset;
+}
+
 void TD3D12DescriptorCache::CreateCacheCbvSrvUavDescriptorHeap()
 {
 	D3D12_DESCRIPTOR_HEAP_DESC Desc = {};
@@ -84,11 +178,6 @@ void TD3D12DescriptorCache::CreateCacheRtvDescriptorHeap()
 	RtvDescriptorSize = D3DDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
 }
 
-void TD3D12DescriptorCache::ResetCacheCbvSrvUavDescriptorHeap()
-{
-	CbvSrvUavDescriptorOffset = 0;
-}
-
 void TD3D12DescriptorCache::ResetCacheRtvDescriptorHeap()
 {
 	RtvDescriptorOffset = 0;
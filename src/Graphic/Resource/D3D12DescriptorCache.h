@@ -1,5 +1,24 @@
 #pragma once
 #include "stdafx.h"
+#include "RingAllocator.h"
+#include <unordered_map>
+
+// Shader visible CBV/SRV/UAV descriptors of one command context, the whole frame binds this heap once.
+// Tables are copied in with a pointer bump, the frame's range is tagged with its fence in FinishFrame
+// and reused once CleanUpAllocations sees the fence complete, so the ring wraps around under the frames in flight.
+// A table whose source handles were already copied this frame returns the earlier copy, draws that share
+// a material bind the same descriptors without a CopyDescriptors. The source descriptors must not be rewritten
+// in place while a frame is recorded.
+
+struct TD3D12DescriptorCacheStats
+{
+	// tables found among the copies of the frame
+	uint32_t NumTableHits = 0;
+
+	uint32_t NumTableMisses = 0;
+
+	uint32_t NumCopiedDescriptors = 0;
+};
 
 class TD3D12DescriptorCache
 {
@@ -20,6 +39,9 @@ public:
 
 	CD3DX12_GPU_DESCRIPTOR_HANDLE AppendCbvSrvUavDescriptors(const std::vector<D3D12_CPU_DESCRIPTOR_HANDLE>& SrvDescriptors);
 
+	// NumDescriptors side by side starting at SrcStart, copied as one range
+	CD3DX12_GPU_DESCRIPTOR_HANDLE AppendCbvSrvUavDescriptorRange(D3D12_CPU_DESCRIPTOR_HANDLE SrcStart, uint32_t NumDescriptors);
+
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> GetCacheRtvDescriptorHeap()
 	{
 		return CacheRtvDescriptorHeap;
@@ -32,17 +54,29 @@ public:
 
 	void AppendRtvDescriptors(const std::vector<D3D12_CPU_DESCRIPTOR_HANDLE>& RtvDescriptors, CD3DX12_GPU_DESCRIPTOR_HANDLE& OutGpuHandle, CD3DX12_CPU_DESCRIPTOR_HANDLE& OutCpuHandle);
 
-	void Reset();
+	// the descriptors appended since the last call are in use until FenceValue completes
+	void FinishFrame(uint64_t FenceValue);
+
+	void CleanUpAllocations(uint64_t CompletedFenceValue);
+
+	// counters of the last finished frame
+	const TD3D12DescriptorCacheStats& GetLastFrameStats() const { return LastFrameStats; }
 
 private:
 	void CreateCacheCbvSrvUavDescriptorHeap();
 
 	void CreateCacheRtvDescriptorHeap();
 
-	void ResetCacheCbvSrvUavDescriptorHeap();
+	// index of the first of NumDescriptors free descriptors in the ring
+	uint32_t AllocateCbvSrvUavDescriptors(uint32_t NumDescriptors);
 
 	void ResetCacheRtvDescriptorHeap();
 
+	// copy of Handles made earlier in the frame, Hash is kept for AddTable on a miss
+	bool FindTable(const D3D12_CPU_DESCRIPTOR_HANDLE* Handles, uint32_t NumDescriptors, size_t& OutHash, CD3DX12_GPU_DESCRIPTOR_HANDLE& OutGpuHandle);
+
+	void AddTable(size_t Hash, const D3D12_CPU_DESCRIPTOR_HANDLE* Handles, uint32_t NumDescriptors, CD3DX12_GPU_DESCRIPTOR_HANDLE GpuHandle);
+
 	// for CBV SRV UAV Descriptor Heap
 private:
 	ID3D12Device* D3DDevice = nullptr;
@@ -50,9 +84,29 @@ private:
 
 	UINT CbvSrvUavDescriptorSize;
 
-	static const int MaxCbvSrvUavDescriptorCount = 2048;
+	// every draw of the frames in flight, not one mesh
+	static const int MaxCbvSrvUavDescriptorCount = 16384;
+
+	// in descriptors, not bytes
+	TRingAllocator CbvSrvUavRing;
+
+	struct TCachedTable
+	{
+		// compared on a hash hit, two sets may share a hash
+		std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> Handles;
+
+		CD3DX12_GPU_DESCRIPTOR_HANDLE GpuHandle;
+	};
+
+	// tables copied this frame by the hash of their source handles, cleared in FinishFrame
+	std::unordered_map<size_t, TCachedTable> CachedTables;
+
+	// the handles of a range for FindTable, kept to avoid an allocation per draw
+	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> RangeHandles;
+
+	TD3D12DescriptorCacheStats FrameStats;
 
-	uint32_t CbvSrvUavDescriptorOffset = 0;
+	TD3D12DescriptorCacheStats LastFrameStats;
 
 	// for RTV Descriptor Heap
 private:
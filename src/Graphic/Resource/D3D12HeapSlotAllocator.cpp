@@ -4,7 +4,8 @@
 TD3D12HeapSlotAllocator::TD3D12HeapSlotAllocator(ID3D12Device* InDevice, D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t NumDescriptorPerHeap)
 	: D3DDevice(InDevice), 
 	HeapDesc(CreateHeapDesc(Type, NumDescriptorPerHeap)),
-	DescriptorSize(D3DDevice->GetDescriptorHandleIncrementSize(HeapDesc.Type))
+	DescriptorSize(D3DDevice->GetDescriptorHandleIncrementSize(HeapDesc.Type)),
+	SlotIndex(NumDescriptorPerHeap, DescriptorSize)
 {
 }
 
@@ -14,40 +15,28 @@ TD3D12HeapSlotAllocator::~TD3D12HeapSlotAllocator()
 
 TD3D12HeapSlotAllocator::HeapSlot TD3D12HeapSlotAllocator::AllocateHeapSlot()
 {
-	// find the entry with free list
-	int EntryIndex = -1;
-	for (int i = 0; i < HeapMap.size(); ++i)
-	{
-		if (HeapMap[i].FreeList.size() > 0)
-		{
-			EntryIndex = i;
-			break;
-		}
-	}
-
-	// if all entry are full, create a new one
-	if (EntryIndex == -1)
-	{
-		AllocateHeap();
-
-		EntryIndex = int(HeapMap.size() - 1);
-	}
+	return AllocateRange(1);
+}
 
-	// allcate a slot based on EntryIndex
-	HeapEntry& Entry = HeapMap[EntryIndex];
-	assert(Entry.FreeList.size() > 0);
+TD3D12HeapSlotAllocator::HeapSlot TD3D12HeapSlotAllocator::AllocateRange(uint32_t Count)
+{
+	assert(Count > 0 && Count <= HeapDesc.NumDescriptors);
 
-	FreeRange& Range = Entry.FreeList.front();
-	HeapSlot Slot = { (uint32_t)EntryIndex, Range.Start };
+	TDescriptorSlotIndex::TSlot Slot;
 
-	// Remove this range if all slot has been allocated
-	Range.Start += DescriptorSize;
-	if (Range.Start == Range.End)
+	// if no heap has room, create a new one
+	if (!SlotIndex.Allocate(Count, Slot))
 	{
-		Entry.FreeList.pop_front();
+		AllocateHeap();
+
+		// a new heap holds any range up to NumDescriptors
+		if (!SlotIndex.Allocate(Count, Slot))
+		{
+			ThrowIfFailed(E_OUTOFMEMORY);
+		}
 	}
 
-	return Slot;
+	return { Slot.HeapIndex, { (DescriptorHandleRaw)Slot.Handle } };
 }
 
 Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> TD3D12HeapSlotAllocator::AllocateHeapOnly()
@@ -81,75 +70,25 @@ void TD3D12HeapSlotAllocator::AllocateHeap()
 	ThrowIfFailed(D3DDevice->CreateDescriptorHeap(&HeapDesc, IID_PPV_ARGS(&Heap)));
 	SetDebugName(Heap.Get(), L"TD3D12HeapSlotAllocator Descriptor Heap");
 
-	// Add an entry covering the entire heap
+	// all descriptors of the heap are free
 	DescriptorHandle HeapBase = Heap->GetCPUDescriptorHandleForHeapStart();
 	assert(HeapBase.ptr != 0);
 
-	HeapEntry Entry;
-	Entry.Heap = Heap;
-	Entry.FreeList.push_back({ HeapBase.ptr, HeapBase.ptr + (SIZE_T)HeapDesc.NumDescriptors * DescriptorSize });
+	const uint32_t HeapIndex = SlotIndex.AddHeap(HeapBase.ptr);
+	assert(HeapIndex == HeapMap.size());
 
-	// add the entry to heapMap
-	HeapMap.push_back(Entry);
+	// add the heap to heapMap
+	HeapMap.push_back(Heap);
 }
 
 void TD3D12HeapSlotAllocator::FreeHeapSlot(const HeapSlot& Slot)
 {
-	assert(Slot.HeapIndex < HeapMap.size());
-
-	HeapEntry& Entry = HeapMap[Slot.HeapIndex];
-
-	FreeRange NewRange =
-	{
-		Slot.Handle.ptr,
-		Slot.Handle.ptr + DescriptorSize
-	};
-
-	bool bFound = false;
-
-	for (auto Node = Entry.FreeList.begin(); Node != Entry.FreeList.end() && !bFound; Node++)
-	{
-		FreeRange& Range = *Node;
-		assert(Range.Start < Range.End);
-
+	FreeRange(Slot, 1);
+}
 
-		// ----------------------------------------
-		//  NewRange.Start>>>>>>NewRange.End,Range.Start>>>>>>Range.End
-		// ----------------------------------------
-		if (Range.Start == NewRange.End) // Merge NewRange and Range
-		{
-			Range.Start = NewRange.End;
-			bFound = true;
-		}
-		// ----------------------------------------
-		//  Range.Start>>>>>>Range.End,NewRange.Start>>>>>>NewRange.End
-		// ----------------------------------------
-		else if (Range.End == NewRange.Start)
-		{
-			Range.End = NewRange.End;
-			bFound = true;
-		}
-		// ----------------------------------------
-		//  Range.Start>>>>>>Range.End >>>> NewRange.Start>>>>>>NewRange.End
-		// ----------------------------------------
-		//  Range.Start>>>>>>Range.End >>>> NewRange.Start>>>>>>NewRange.End
-		// ----------------------------------------
-		else
-		{
-			// Range在New前面
-			assert(Range.End < NewRange.Start || Range.Start > NewRange.Start);
-
-			if (Range.Start > NewRange.Start)// insert NewRange before Range
-			{
-				Entry.FreeList.insert(Node, NewRange);
-				bFound = true;
-			}
-		}
-	}
+void TD3D12HeapSlotAllocator::FreeRange(const HeapSlot& Range, uint32_t Count)
+{
+	assert(Range.HeapIndex < HeapMap.size());
 
-	if (!bFound)
-	{
-		// add NewRange to tail
-		Entry.FreeList.push_back(NewRange);
-	}
+	SlotIndex.Free({ Range.HeapIndex, Range.Handle.ptr }, Count);
 }
@@ -1,6 +1,6 @@
 #pragma once
 #include "stdafx.h"
-#include <list>
+#include "DescriptorSlotIndex.h"
 
 class TD3D12HeapSlotAllocator
 {
@@ -16,22 +16,6 @@ public:
 		D3D12_CPU_DESCRIPTOR_HANDLE Handle;
 	};
 
-private:
-
-	struct FreeRange
-	{
-		DescriptorHandleRaw Start;
-		DescriptorHandleRaw End;
-	};
-
-	struct HeapEntry
-	{
-		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> Heap = nullptr;
-		std::list<TD3D12HeapSlotAllocator::FreeRange> FreeList;
-
-		HeapEntry() { }
-	};
-
 public:
 	TD3D12HeapSlotAllocator(ID3D12Device* InDevice, D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t NumDescriptorPerHeap);
 
@@ -39,10 +23,19 @@ public:
 
 	HeapSlot AllocateHeapSlot();
 
+	// Count contiguous descriptors in one heap for a descriptor table, Slot.Handle is the first one.
+	// placed best fit, a freed range merges with its free neighbours
+	HeapSlot AllocateRange(uint32_t Count);
+
 	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> AllocateHeapOnly();
 
 	void FreeHeapSlot(const HeapSlot& Slot);
 
+	// Count must match the AllocateRange
+	void FreeRange(const HeapSlot& Range, uint32_t Count);
+
+	uint32_t GetDescriptorSize() const { return DescriptorSize; }
+
 private:
 	D3D12_DESCRIPTOR_HEAP_DESC CreateHeapDesc(D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t NumDescriptorPerHeap);
 
@@ -55,6 +48,9 @@ private:
 
 	const uint32_t DescriptorSize;
 
-	std::vector<HeapEntry> HeapMap;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> HeapMap;
+
+	// free descriptors of every heap in HeapMap
+	TDescriptorSlotIndex SlotIndex;
 
 };
\ No newline at end of file
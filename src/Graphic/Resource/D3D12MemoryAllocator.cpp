@@ -1,106 +1,65 @@
 #include "D3D12MemoryAllocator.h"
 #include "DXSamplerHelper.h"
-
-TD3D12BuddyAllocator::TD3D12BuddyAllocator(ID3D12Device* InDevice, const TAllocatorInitData& InInitData)
-	: D3DDevice(InDevice), InitData(InInitData)
-{
-	Initialize();
-}
-
-TD3D12BuddyAllocator::~TD3D12BuddyAllocator()
+#include "D3D12RHI.h"
+#include "AllocationTrace.h"
+#include "D3D12ResidencyManager.h"
+#include <algorithm>
+#include <atomic>
+
+// objects of a JSON array are appended one by one
+static void AppendJsonSeparator(std::string& Json)
 {
-	if (BackingResource)
+	if (!Json.empty() && Json.back() != '[')
 	{
-		delete BackingResource;
+		Json += ",";
 	}
+}
 
-	if (BackingHeap)
+// logs the request while an allocation trace is captured
+static void TraceAllocation(const TD3D12ResourceLocation& ResourceLocation, uint64_t Size, uint64_t Alignment, D3D12_HEAP_TYPE HeapType, bool bPlaced)
+{
+	TAllocationTraceRecorder& Recorder = TAllocationTraceRecorder::Get();
+	if (Recorder.IsRecording())
 	{
-		BackingHeap->Release();
+		Recorder.RecordAlloc(&ResourceLocation, Size, Alignment, (uint8_t)HeapType, bPlaced, TD3D12RHI::g_CommandContext.GetNextFenceValue());
 	}
 }
 
-bool TD3D12BuddyAllocator::AllocResource(uint32_t Size, uint32_t Alignment, TD3D12ResourceLocation& ResourceLocation)
+void TD3D12AllocatorStats::WriteJson(std::string& Json) const
 {
-	uint32_t SizeToAllocate = GetSizeToAllocate(Size, Alignment);
-
-	if (CanAllocate(SizeToAllocate))
-	{
-		// Allocate Block
-		const uint32_t UnitSize = SizeToUnitSize(SizeToAllocate);
-		const uint32_t Order = UnitSizeToOrder(UnitSize);
-		const uint32_t Offset = AllocateBlock(Order); // This is  the offset in MinBlockSize units
-		const uint32_t AllocSize = UnitSize * MinBlockSize;
-		TotalAllocSize += AllocSize;
-
-		// calculate AlignedOffsetFromResourceBase
-		const uint32_t OffsetFromBaseOfResource = GetAllocOffsetInBytes(Offset);
-		uint32_t AlignedOffsetFromResourceBase = OffsetFromBaseOfResource;
-
-		if (Alignment != 0 && OffsetFromBaseOfResource % Alignment != 0)
-		{
-			AlignedOffsetFromResourceBase = AlignArbitrary(OffsetFromBaseOfResource, Alignment);
-
-			uint32_t Padding = AlignedOffsetFromResourceBase - OffsetFromBaseOfResource;
-			assert((Padding + Size) <= AllocSize);
-		}
-
-		assert((AlignedOffsetFromResourceBase % Alignment) == 0);
-
-		// save allocation info to ResourceLocation
-		ResourceLocation.SetType(TD3D12ResourceLocation::EResourceLocationType::SubAllocation);
-		ResourceLocation.BlockData.Order = Order;
-		ResourceLocation.BlockData.Offset = Offset;
-		ResourceLocation.BlockData.ActualUsedSize = Size;
-		ResourceLocation.Allocator = this;
-
-		if (InitData.AllocatioStrategy == EAllocationStrategy::ManualSubAllocation)
-		{
-			// 手动划分，计算GPUVirtualAddress for default buffer
-			ResourceLocation.UnderlyingResource = BackingResource;
-			ResourceLocation.OffsetFromBaseOfResource = AlignedOffsetFromResourceBase;
-			ResourceLocation.GPUVirtualAddress = BackingResource->GPUVirtualAddress + AlignedOffsetFromResourceBase;
-
-			// 计算MappedAddress for upload buffer
-			if (InitData.HeapType == D3D12_HEAP_TYPE_UPLOAD)
-			{
-				ResourceLocation.MappedAddress = ((uint8_t*)BackingResource->MappedBaseAddress + AlignedOffsetFromResourceBase);
-			}
-		}
-		else
-		{
-			ResourceLocation.OffsetFromBaseOfHeap = AlignedOffsetFromResourceBase;
-
-			// Place Resource are initialized by caller
-		}
+	char Buffer[512];
+	sprintf_s(Buffer, "{\"pools\":%u,\"allocations\":%u,\"pendingFrees\":%u,\"reserved\":%llu,\"allocated\":%llu,\"requested\":%llu,\"largestFree\":%llu,\"freeBlocksByOrder\":[",
+		NumPools, NumAllocations, NumPendingFrees, ReservedSize, AllocatedSize, RequestedSize, LargestFreeBlock);
+	Json += Buffer;
 
-		return true;
-	}
-	else
+	for (uint32_t Order = 0; Order < 32; ++Order)
 	{
-		return false;
+		sprintf_s(Buffer, Order == 0 ? "%u" : ",%u", NumFreeBlocks[Order]);
+		Json += Buffer;
 	}
+
+	Json += "]}";
 }
 
-void TD3D12BuddyAllocator::Deallocate(TD3D12ResourceLocation& ResourceLocation)
+TD3D12SubAllocator::TBackingStore::TBackingStore(ID3D12Device* InDevice, const TAllocatorInitData& InInitData)
+	: D3DDevice(InDevice), InitData(InInitData)
 {
-	DeferredDeletionQueue.push_back(ResourceLocation.BlockData);
 }
 
-void TD3D12BuddyAllocator::CleanUpAllocations()
+TD3D12SubAllocator::TBackingStore::~TBackingStore()
 {
-	for (int32_t i = 0; i < DeferredDeletionQueue.size(); ++i)
+	if (BackingResource)
 	{
-		const TD3D12BuddyBlockData& Block = DeferredDeletionQueue[i];
-
-		DeallocateInternal(Block);
+		delete BackingResource;
 	}
 
-	// clear out all of the released blocks, don't allow the array to shrink
-	DeferredDeletionQueue.clear();
+	if (BackingHeap)
+	{
+		BackingHeap->Release();
+	}
 }
 
-void TD3D12BuddyAllocator::Initialize()
+void TD3D12SubAllocator::TBackingStore::Create(uint64_t PoolSize)
 {
 	// create backingHeap or backingResource
 
@@ -110,7 +69,7 @@ void TD3D12BuddyAllocator::Initialize()
 		// 定义堆类型，Default heap or Upload heap
 		CD3DX12_HEAP_PROPERTIES HeapProperties(InitData.HeapType);
 		D3D12_HEAP_DESC Desc = {};
-		Desc.SizeInBytes = DEFAULT_POOL_SIZE;
+		Desc.SizeInBytes = PoolSize;
 		Desc.Properties = HeapProperties;
 		Desc.Alignment = 0;
 		Desc.Flags = InitData.HeapFlags;
@@ -118,7 +77,7 @@ void TD3D12BuddyAllocator::Initialize()
 		// create BackingHeap, we will create place resources on it
 		ID3D12Heap* Heap = nullptr;
 		ThrowIfFailed(D3DDevice->CreateHeap(&Desc, IID_PPV_ARGS(&Heap)));
-		Heap->SetName(L"TD3D12BuddyAllocator BackingHeap");
+		Heap->SetName(L"TD3D12SubAllocator BackingHeap");
 
 		// DX12基于Com接口，引用计数机制，所以脱离了作用域Heap也不会析构
 		BackingHeap = Heap;
@@ -137,7 +96,7 @@ void TD3D12BuddyAllocator::Initialize()
 			HeapResourceState = D3D12_RESOURCE_STATE_COMMON;
 		}
 
-		CD3DX12_RESOURCE_DESC BufferDesc = CD3DX12_RESOURCE_DESC::Buffer(DEFAULT_POOL_SIZE, InitData.ResourceFlags);
+		CD3DX12_RESOURCE_DESC BufferDesc = CD3DX12_RESOURCE_DESC::Buffer(PoolSize, InitData.ResourceFlags);
 
 		// create committed resource, we will allocate sub regions on it
 		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
@@ -149,7 +108,7 @@ void TD3D12BuddyAllocator::Initialize()
 			nullptr,
 			IID_PPV_ARGS(&Resource)));
 
-		Resource->SetName(L"TD3D12BuddyAllocator BackingResource");
+		Resource->SetName(L"TD3D12SubAllocator BackingResource");
 
 		// 将创建的Resource对象封装管理
 		BackingResource = new TD3D12Resource(Resource);
@@ -160,101 +119,90 @@ void TD3D12BuddyAllocator::Initialize()
 			BackingResource->Map();
 		}
 	}
+}
 
-	// Initialize free blocks, add the free block for MarOrder
-	MaxOrder = UnitSizeToOrder(SizeToUnitSize(DEFAULT_POOL_SIZE));
-
-	for (uint32_t i = 0; i <= MaxOrder; ++i)
-	{
-		FreeBlocks.emplace_back(std::set<uint32_t>());
-	}
-
-	// 起始为0，最高阶数
-	FreeBlocks[MaxOrder].insert((uint32_t)0);
+TD3D12SubAllocator::TD3D12SubAllocator(const TAllocatorInitData& InInitData)
+	: InitData(InInitData)
+{
 }
 
-uint32_t TD3D12BuddyAllocator::AllocateBlock(uint32_t Order)
+TD3D12SubAllocator::~TD3D12SubAllocator()
 {
-	uint32_t Offset;
+	// the derived allocator has already flushed the queue, FreeBlock can't be called from here
+	assert(DeferredDeletionQueue.Empty());
+}
 
-	if (Order > MaxOrder)
+void TD3D12SubAllocator::AssignLocation(uint32_t Offset, uint32_t Order, uint64_t AlignedOffset, uint64_t Size, TD3D12ResourceLocation& ResourceLocation)
+{
+	// placed blocks only need the heap offset, the heap type doesn't matter
+	if (InitData.AllocatioStrategy == EAllocationStrategy::PlacedResource)
 	{
-		assert(false);
+		AssignPoolLocation<TTexturePolicy>(Offset, Order, AlignedOffset, Size, ResourceLocation);
 	}
-
-	if (FreeBlocks[Order].size() == 0) 
+	else if (InitData.HeapType == D3D12_HEAP_TYPE_UPLOAD)
 	{
-		// 对应阶数无自由块，往高一阶寻找，并拆分
-		uint32_t Left = AllocateBlock(Order + 1);
-
-		uint32_t UnitSize = OrderToUnitSize(Order);
-
-		uint32_t Right = Left + UnitSize;
-
-		FreeBlocks[Order].insert(Right); // add the right block to the free pool]
-
-		Offset = Left;
+		AssignPoolLocation<TUploadBufferPolicy>(Offset, Order, AlignedOffset, Size, ResourceLocation);
 	}
-	else // 有对应阶数自由块，则找最左侧的一块进行分配（set已经自动完成排序，底层为排序二叉树，红黑树)
+	else
 	{
-		auto It = FreeBlocks[Order].cbegin();
-		Offset = *It;
-
-		// Remove the block from the free list
-		FreeBlocks[Order].erase(*It);
+		AssignPoolLocation<TDefaultBufferPolicy>(Offset, Order, AlignedOffset, Size, ResourceLocation);
 	}
-
-	return Offset;
 }
 
-uint32_t TD3D12BuddyAllocator::GetSizeToAllocate(uint32_t Size, uint32_t Alignment)
+void TD3D12SubAllocator::TrackLocation(uint64_t Size, TD3D12ResourceLocation& ResourceLocation)
 {
-	uint32_t SizeToAllocate = Size;
-	
-	// if the alignment doesn't match the block size
-	if (Alignment != 0 && MinBlockSize % Alignment != 0)
-	{
-		SizeToAllocate = Size + Alignment;
-	}
+	std::lock_guard<std::mutex> Lock(DeletionMutex);
+	LiveLocations.insert(&ResourceLocation);
+
+	++NumBlocks;
+	RequestedSize += Size;
 
-	return SizeToAllocate;
+#if ALLOCATION_TRACKING
+	TD3D12AllocationTracker::Get().Track(ResourceLocation, ResourceLocation.Tag, Size);
+#endif
 }
 
-bool TD3D12BuddyAllocator::CanAllocate(uint32_t SizeToAllocate)
+void TD3D12SubAllocator::Deallocate(TD3D12ResourceLocation& ResourceLocation)
 {
-	// 已分配容量 等于 默认容量
-	if (TotalAllocSize == DEFAULT_POOL_SIZE)
-	{
-		return false;
-	}
+	std::lock_guard<std::mutex> Lock(DeletionMutex);
 
-	uint32_t BlockSize = DEFAULT_POOL_SIZE;
+	// commands recorded so far may still use the block, they are covered by the next fence signal.
+	// read under the lock: a value read before it could be older than one another thread already enqueued
+	const uint64_t FenceValue = TD3D12RHI::g_CommandContext.GetNextFenceValue();
 
-	// 从最高阶遍历 自由块进行分配
-	for (int i = (int)FreeBlocks.size() - 1; i >= 0; i--)
-	{
-		if (FreeBlocks[i].size() && BlockSize >= SizeToAllocate)
-			return true;
+	DeferredDeletionQueue.Enqueue(ResourceLocation.BlockData, FenceValue);
 
-		// halve the block size
-		BlockSize = BlockSize >> 1;
+	LiveLocations.erase(&ResourceLocation);
 
-		//最小块容量 不能满足 请求容量
-		if (BlockSize < SizeToAllocate) return false;
-	}
+#if ALLOCATION_TRACKING
+	TD3D12AllocationTracker::Get().Untrack(ResourceLocation);
+#endif
+}
 
-	return false;
+bool TD3D12SubAllocator::IsEmpty() const
+{
+	std::lock_guard<std::mutex> Lock(DeletionMutex);
+
+	return GetTotalAllocSize() == 0 && DeferredDeletionQueue.Empty();
 }
 
-void TD3D12BuddyAllocator::DeallocateInternal(const TD3D12BuddyBlockData& Block)
+void TD3D12SubAllocator::CleanUpAllocations(uint64_t CompletedFenceValue)
 {
-	// 删除合并
-	DeallocateBlock(Block.Offset, Block.Order);
+	std::lock_guard<std::mutex> Lock(DeletionMutex);
+
+	DeferredDeletionQueue.Retire(CompletedFenceValue, [this](const TD3D12BuddyBlockData& Block)
+	{
+		DeallocateInternal(Block);
+	});
+}
 
-	// 重新计算总分配容量
-	uint32_t Size = OrderToUnitSize(Block.Order) * MinBlockSize;
+void TD3D12SubAllocator::DeallocateInternal(const TD3D12BuddyBlockData& Block)
+{
+	// 删除合并, 重新计算总分配容量
+	FreeBlock(Block);
 
-	TotalAllocSize -= Size;
+	--NumBlocks;
+	RequestedSize -= Block.ActualUsedSize;
 
 	// 删除指针
 	if (InitData.AllocatioStrategy == EAllocationStrategy::PlacedResource)
@@ -266,202 +214,1985 @@ void TD3D12BuddyAllocator::DeallocateInternal(const TD3D12BuddyBlockData& Block)
 	}
 }
 
-void TD3D12BuddyAllocator::DeallocateBlock(uint32_t Offset, uint32_t Order)
+void TD3D12SubAllocator::GetStats(TD3D12AllocatorStats& Stats) const
+{
+	std::lock_guard<std::mutex> Lock(DeletionMutex);
+
+	Stats.NumPools += 1;
+	Stats.NumAllocations += NumBlocks;
+	Stats.NumPendingFrees += (uint32_t)DeferredDeletionQueue.Num();
+	Stats.ReservedSize += GetPoolSize();
+	Stats.AllocatedSize += GetTotalAllocSize();
+	Stats.RequestedSize += RequestedSize;
+
+	GetFreeBlockStats(Stats);
+}
+
+void TD3D12SubAllocator::WriteBlockMap(std::string& Json) const
 {
-	// Get buddy block
-	uint32_t Size = OrderToUnitSize(Order);
-	// 计算出伙伴块的偏移
-	uint32_t Buddy = GetBuddyOffset(Offset, Size);
+	std::lock_guard<std::mutex> Lock(DeletionMutex);
 
-	auto It = FreeBlocks[Order].find(Buddy);
-	if (It != FreeBlocks[Order].end())// If buddy block is free, merge it
+	char Buffer[128];
+	sprintf_s(Buffer, "{\"size\":%llu,\"allocated\":%llu,\"blocks\":[", GetPoolSize(), GetTotalAllocSize());
+	Json += Buffer;
+
+	for (const TD3D12ResourceLocation* Location : LiveLocations)
 	{
-		// Deallocate merged blocks
-		DeallocateBlock(min(Offset, Buddy), Order + 1);
+		// aligned start of the data
+		const uint64_t Offset = InitData.AllocatioStrategy == EAllocationStrategy::ManualSubAllocation ?
+			Location->OffsetFromBaseOfResource - BackingOffset : Location->OffsetFromBaseOfHeap;
 
-		// Remove the buddy from the free list
-		FreeBlocks[Order].erase(*It);
+		AppendJsonSeparator(Json);
+		sprintf_s(Buffer, "[%llu,%llu,%llu]", Offset, GetBlockSize(Location->BlockData), Location->BlockData.ActualUsedSize);
+		Json += Buffer;
 	}
-	else
+
+	Json += "],\"free\":[";
+
+	ForEachFreeBlock([&](uint64_t Offset, uint64_t Size)
 	{
-		// add the block to the free list
-		FreeBlocks[Order].insert(Offset);
-	}
+		AppendJsonSeparator(Json);
+		sprintf_s(Buffer, "[%llu,%llu]", Offset, Size);
+		Json += Buffer;
+	});
+
+	Json += "]}";
 }
 
-TD3D12MultiBuddyAllocator::TD3D12MultiBuddyAllocator(ID3D12Device* InDevice, const TD3D12BuddyAllocator::TAllocatorInitData& InInitData)
-	: Device(InDevice), InitData(InInitData)
+TD3D12BuddyAllocator::TD3D12BuddyAllocator(ID3D12Device* InDevice, const TAllocatorInitData& InInitData)
+	: TD3D12SubAllocator(InInitData), Buddy(InInitData.PoolSize, InInitData.MinBlockSize, InInitData.MaxOrder, InDevice, InInitData)
 {
+	BackingResource = Buddy.GetBackingStore().BackingResource;
+	BackingHeap = Buddy.GetBackingStore().BackingHeap;
 }
 
-TD3D12MultiBuddyAllocator::~TD3D12MultiBuddyAllocator()
+TD3D12BuddyAllocator::~TD3D12BuddyAllocator()
 {
+	// the GPU is idle on shutdown, release the placed resources still waiting for their fence
+	CleanUpAllocations(UINT64_MAX);
 }
 
-bool TD3D12MultiBuddyAllocator::AllocResource(uint32_t Size, uint32_t Alignment, TD3D12ResourceLocation& ResourceLocation)
+bool TD3D12BuddyAllocator::AllocResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation)
 {
-	for (auto& Allocator : Allocators) // try to use existing allocators
+	TBuddyAllocation Allocation;
+
+	if (!Buddy.Allocate(Size, Alignment, Allocation))
 	{
-		if (Allocator->AllocResource(Size, Alignment, ResourceLocation))
-		{
-			return true;
-		}
+		return false;
 	}
 
-	// create new allocator
-	auto Allocator = std::make_shared<TD3D12BuddyAllocator>(Device, InitData);
-	Allocators.push_back(Allocator);
-
-	bool Result = Allocator->AllocResource(Size, Alignment, ResourceLocation);
-	assert(Result);
+	AssignAllocation(Allocation, Size, ResourceLocation);
 
 	return true;
 }
 
-void TD3D12MultiBuddyAllocator::CleanUpAllocations()
+void TD3D12BuddyAllocator::AssignAllocation(const TBuddyAllocation& Allocation, uint64_t Size, TD3D12ResourceLocation& ResourceLocation)
 {
-	for (auto& Allocator : Allocators)
-		Allocator->CleanUpAllocations();
+	AssignLocation(Allocation.Offset, Allocation.Order, Allocation.AlignedOffset, Size, ResourceLocation);
 }
 
-TD3D12UploadBufferAllocator::TD3D12UploadBufferAllocator(ID3D12Device* InDevice)
+void TD3D12BuddyAllocator::FreeBlock(const TD3D12BuddyBlockData& Block)
 {
-	TD3D12BuddyAllocator::TAllocatorInitData InitData;
-	InitData.AllocatioStrategy = TD3D12BuddyAllocator::EAllocationStrategy::ManualSubAllocation; // UploadBuffer状态一致，可以共用一个Resource，逻辑上进行不同区域的划分
-	InitData.HeapType = D3D12_HEAP_TYPE_UPLOAD;
-	InitData.ResourceFlags = D3D12_RESOURCE_FLAG_NONE;
+	Buddy.Deallocate(Block.Offset, Block.Order);
+}
 
-	Allocator = std::make_unique<TD3D12MultiBuddyAllocator>(InDevice, InitData);
+uint64_t TD3D12BuddyAllocator::GetBlockSize(const TD3D12BuddyBlockData& Block) const
+{
+	return InitData.MinBlockSize << Block.Order;
+}
 
-	D3DDevice = InDevice;
+void TD3D12BuddyAllocator::GetFreeBlockStats(TD3D12AllocatorStats& Stats) const
+{
+	for (uint32_t Order = 0; Order <= Buddy.GetMaxOrder(); ++Order)
+	{
+		Stats.NumFreeBlocks[Order] += Buddy.GetNumFreeBlocks(Order);
+	}
+
+	const int32_t LargestFreeOrder = Buddy.GetLargestFreeOrder();
+	if (LargestFreeOrder >= 0)
+	{
+		Stats.LargestFreeBlock = (std::max)(Stats.LargestFreeBlock, InitData.MinBlockSize << LargestFreeOrder);
+	}
+}
+
+void TD3D12BuddyAllocator::ForEachFreeBlock(const std::function<void(uint64_t, uint64_t)>& Func) const
+{
+	Buddy.ForEachFreeBlock([&](uint32_t Offset, uint32_t Order)
+	{
+		Func(Offset * InitData.MinBlockSize, InitData.MinBlockSize << Order);
+	});
 }
 
-void* TD3D12UploadBufferAllocator::AllocUploadResource(uint32_t Size, uint32_t Alignment, TD3D12ResourceLocation& ResourceLocation)
+TD3D12TLSFAllocator::TD3D12TLSFAllocator(ID3D12Device* InDevice, const TAllocatorInitData& InInitData)
+	: TD3D12SubAllocator(InInitData), BackingStore(InDevice, InInitData), TLSF(InInitData.PoolSize, InInitData.MinBlockSize)
 {
-	Allocator->AllocResource(Size, Alignment, ResourceLocation);
+	BackingStore.Create(TLSF.GetPoolSize());
 
-	return ResourceLocation.MappedAddress;
+	BackingResource = BackingStore.BackingResource;
+	BackingHeap = BackingStore.BackingHeap;
 }
 
-void TD3D12UploadBufferAllocator::CleanUpAllocations()
+TD3D12TLSFAllocator::~TD3D12TLSFAllocator()
 {
-	Allocator->CleanUpAllocations();
+	// the GPU is idle on shutdown, release the placed resources still waiting for their fence
+	CleanUpAllocations(UINT64_MAX);
 }
 
-TD3D12DefaultBufferAllocator::TD3D12DefaultBufferAllocator(ID3D12Device* InDevice)
+bool TD3D12TLSFAllocator::AllocResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation)
 {
-	{
-		TD3D12BuddyAllocator::TAllocatorInitData InitData;
-		InitData.AllocatioStrategy = TD3D12BuddyAllocator::EAllocationStrategy::ManualSubAllocation;
-		InitData.HeapType = D3D12_HEAP_TYPE_DEFAULT;
-		InitData.ResourceFlags = D3D12_RESOURCE_FLAG_NONE;
+	TTLSFAllocator::TAllocation Allocation;
 
-		Allocator = std::make_unique<TD3D12MultiBuddyAllocator>(InDevice, InitData);
+	if (!TLSF.Allocate(Size, Alignment, Allocation))
+	{
+		return false;
 	}
 
-	{
-		TD3D12BuddyAllocator::TAllocatorInitData InitData;
-		InitData.AllocatioStrategy = TD3D12BuddyAllocator::EAllocationStrategy::ManualSubAllocation;
-		InitData.HeapType = D3D12_HEAP_TYPE_DEFAULT;
-		InitData.ResourceFlags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS; // for UAV
+	// no order, the block handle is enough to free it
+	AssignLocation(Allocation.Block, 0, Allocation.AlignedOffset, Size, ResourceLocation);
 
-		UavAllocator = std::make_unique<TD3D12MultiBuddyAllocator>(InDevice, InitData);
-	}
+	return true;
+}
 
-	D3DDevice = InDevice;
+int32_t TD3D12TLSFAllocator::GetLargestFreeOrder() const
+{
+	// the largest power of two MinBlockSize multiple that surely fits, keeps the pool index shared with buddy
+	const uint64_t FreeUnits = TLSF.GetLargestFreeSize() / InitData.MinBlockSize;
+
+	return FreeUnits != 0 ? (int32_t)FindHighestSetBit(FreeUnits) : -1;
 }
 
-void TD3D12DefaultBufferAllocator::AllocDefaultResource(const D3D12_RESOURCE_DESC& REsourceDesc, uint32_t Alignment, TD3D12ResourceLocation& ResourceLocation)
+void TD3D12TLSFAllocator::FreeBlock(const TD3D12BuddyBlockData& Block)
 {
-	if (REsourceDesc.Flags == D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS)
+	TLSF.Deallocate(Block.Offset);
+}
+
+uint64_t TD3D12TLSFAllocator::GetBlockSize(const TD3D12BuddyBlockData& Block) const
+{
+	return TLSF.GetBlockSize(Block.Offset);
+}
+
+void TD3D12TLSFAllocator::GetFreeBlockStats(TD3D12AllocatorStats& Stats) const
+{
+	for (uint32_t Order = 0; Order < 32; ++Order)
 	{
-		UavAllocator->AllocResource((uint32_t)REsourceDesc.Width, Alignment, ResourceLocation);
+		Stats.NumFreeBlocks[Order] += TLSF.GetNumFreeBlocks(Order);
 	}
-	else
+
+	Stats.LargestFreeBlock = (std::max)(Stats.LargestFreeBlock, TLSF.GetLargestFreeSize());
+}
+
+void TD3D12TLSFAllocator::ForEachFreeBlock(const std::function<void(uint64_t, uint64_t)>& Func) const
+{
+	TLSF.ForEachBlock([&](uint64_t Offset, uint64_t Size, bool bFree)
 	{
-		Allocator->AllocResource((uint32_t)REsourceDesc.Width, Alignment, ResourceLocation);
-	}
+		if (bFree)
+		{
+			Func(Offset, Size);
+		}
+	});
 }
 
-void TD3D12DefaultBufferAllocator::CleanUpAllocations()
+static TD3D12SubAllocator::TAllocatorInitData MakeDedicatedInitData(const TD3D12SubAllocator::TAllocatorInitData& InInitData)
 {
-	Allocator->CleanUpAllocations();
+	// the location keeps its resource in BlockData.PlacedResource, released with the block like a placed one
+	TD3D12SubAllocator::TAllocatorInitData InitData = InInitData;
+	InitData.AllocatioStrategy = TD3D12SubAllocator::EAllocationStrategy::PlacedResource;
+
+	return InitData;
 }
 
-TD3D12TextureResourceAllocator::TD3D12TextureResourceAllocator(ID3D12Device* InDevice)
+TD3D12DedicatedAllocator::TD3D12DedicatedAllocator(ID3D12Device* InDevice, const TAllocatorInitData& InInitData)
+	: TD3D12SubAllocator(MakeDedicatedInitData(InInitData)), D3DDevice(InDevice)
 {
-	TD3D12BuddyAllocator::TAllocatorInitData InitData;
-	
-	// placed resource : differents states for different resources
-	InitData.AllocatioStrategy = TD3D12BuddyAllocator::EAllocationStrategy::PlacedResource;
-	InitData.HeapType = D3D12_HEAP_TYPE_DEFAULT;
-	InitData.HeapFlags = D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
-	
-	Allocator = std::make_unique<TD3D12MultiBuddyAllocator>(InDevice, InitData);
+}
 
-	D3DDevice = InDevice;
+TD3D12DedicatedAllocator::~TD3D12DedicatedAllocator()
+{
+	CleanUpAllocations(UINT64_MAX);
 }
 
-void TD3D12TextureResourceAllocator::AllocTextureResource(const D3D12_RESOURCE_STATES& ResourceState, const D3D12_RESOURCE_DESC& ResourceDesc, uint32_t Alignment, TD3D12ResourceLocation& ResourceLocation)
+bool TD3D12DedicatedAllocator::AllocResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation)
 {
-	const D3D12_RESOURCE_ALLOCATION_INFO Info = D3DDevice->GetResourceAllocationInfo(0, 1, &ResourceDesc);
+	assert(Alignment <= D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
 
-	Allocator->AllocResource((uint32_t)Info.SizeInBytes, Alignment, ResourceLocation);
+	CD3DX12_HEAP_PROPERTIES HeapProperties(InitData.HeapType);
+	CD3DX12_RESOURCE_DESC BufferDesc = CD3DX12_RESOURCE_DESC::Buffer(Size, InitData.ResourceFlags);
 
-	// create placed resource
-	{
-		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+	// same initial states as the pools
+	const D3D12_RESOURCE_STATES State = InitData.HeapType == D3D12_HEAP_TYPE_UPLOAD ? D3D12_RESOURCE_STATE_GENERIC_READ : D3D12_RESOURCE_STATE_COMMON;
 
-		ID3D12Heap* BackingHeap = ResourceLocation.Allocator->GetBackingHeap();
-		uint64_t HeapOffset = ResourceLocation.OffsetFromBaseOfHeap;
-		D3DDevice->CreatePlacedResource(BackingHeap, HeapOffset, &ResourceDesc, ResourceState, nullptr, IID_PPV_ARGS(&Resource));
+	Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+	ThrowIfFailed(D3DDevice->CreateCommittedResource(&HeapProperties, D3D12_HEAP_FLAG_NONE, &BufferDesc, State, nullptr, IID_PPV_ARGS(&Resource)));
+	Resource->SetName(L"TD3D12DedicatedAllocator Buffer");
 
-		TD3D12Resource* NewResource = new TD3D12Resource(Resource);
-		ResourceLocation.UnderlyingResource = NewResource;
-		ResourceLocation.BlockData.PlacedResource = NewResource; // will delete Resource when ResourceLocation was destoryed
+	TD3D12Resource* NewResource = new TD3D12Resource(Resource, State);
+	if (InitData.HeapType == D3D12_HEAP_TYPE_UPLOAD)
+	{
+		NewResource->Map();
 	}
+
+	AssignResource(NewResource, Size, ResourceLocation);
+
+	ResourceLocation.GPUVirtualAddress = NewResource->GPUVirtualAddress;
+	ResourceLocation.MappedAddress = NewResource->MappedBaseAddress;
+
+	return true;
 }
 
-void TD3D12TextureResourceAllocator::CleanUpAllocations()
+void TD3D12DedicatedAllocator::AllocTextureResource(const D3D12_RESOURCE_STATES& ResourceState, const D3D12_RESOURCE_DESC& ResourceDesc, const D3D12_CLEAR_VALUE* ClearValue, TD3D12ResourceLocation& ResourceLocation)
 {
-	Allocator->CleanUpAllocations();
+	const D3D12_RESOURCE_ALLOCATION_INFO Info = D3DDevice->GetResourceAllocationInfo(0, 1, &ResourceDesc);
+
+	CD3DX12_HEAP_PROPERTIES HeapProperties(InitData.HeapType);
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+	ThrowIfFailed(D3DDevice->CreateCommittedResource(&HeapProperties, D3D12_HEAP_FLAG_NONE, &ResourceDesc, ResourceState, ClearValue, IID_PPV_ARGS(&Resource)));
+	Resource->SetName(L"TD3D12DedicatedAllocator Texture");
+
+	AssignResource(new TD3D12Resource(Resource, ResourceState), Info.SizeInBytes, ResourceLocation);
 }
 
-TD3D12PixelResourceAllocator::TD3D12PixelResourceAllocator(ID3D12Device* InDevice)
+void TD3D12DedicatedAllocator::AssignResource(TD3D12Resource* Resource, uint64_t Size, TD3D12ResourceLocation& ResourceLocation)
 {
-	TD3D12BuddyAllocator::TAllocatorInitData InitData;
+	CommittedSize += GetBlockSize({ 0, 0, Size });
 
-	// placed resource : differents states for different resources
-	InitData.AllocatioStrategy = TD3D12BuddyAllocator::EAllocationStrategy::PlacedResource;
-	InitData.HeapType = D3D12_HEAP_TYPE_DEFAULT;
-	InitData.HeapFlags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+	AssignLocation(0, 0, 0, Size, ResourceLocation);
 
-	Allocator = std::make_unique<TD3D12MultiBuddyAllocator>(InDevice, InitData);
+	// the resource is the allocation
+	ResourceLocation.SetType(TD3D12ResourceLocation::EResourceLocationType::StandAlone);
+	ResourceLocation.UnderlyingResource = Resource;
+	ResourceLocation.BlockData.PlacedResource = Resource;
+	ResourceLocation.OffsetFromBaseOfResource = 0;
+}
 
-	D3DDevice = InDevice;
+void TD3D12DedicatedAllocator::FreeBlock(const TD3D12BuddyBlockData& Block)
+{
+	CommittedSize -= GetBlockSize(Block);
 }
 
-void TD3D12PixelResourceAllocator::AllocTextureResource(const D3D12_RESOURCE_STATES& ResourceState, const D3D12_RESOURCE_DESC& ResourceDesc, uint32_t Alignment, D3D12_CLEAR_VALUE ClearValue, TD3D12ResourceLocation& ResourceLocation)
+uint64_t TD3D12DedicatedAllocator::GetBlockSize(const TD3D12BuddyBlockData& Block) const
+{
+	// committed resources take whole 64KB pages
+	const uint64_t PageSize = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+
+	return (Block.ActualUsedSize + PageSize - 1) / PageSize * PageSize;
+}
+
+TD3D12AliasingAllocator::TD3D12AliasingAllocator(ID3D12Device* InDevice, const TAllocatorInitData& InInitData)
+	: TD3D12SubAllocator(InInitData), D3DDevice(InDevice)
+{
+	assert(InitData.AllocatioStrategy == EAllocationStrategy::PlacedResource);
+}
+
+TD3D12AliasingAllocator::~TD3D12AliasingAllocator()
+{
+	CleanUpAllocations(UINT64_MAX);
+}
+
+void TD3D12AliasingAllocator::DeclareTransient(const D3D12_RESOURCE_DESC& ResourceDesc, const D3D12_CLEAR_VALUE& ClearValue, uint32_t FirstPass, uint32_t LastPass, TD3D12ResourceLocation& ResourceLocation)
 {
+	assert(FirstPass <= LastPass);
+
 	const D3D12_RESOURCE_ALLOCATION_INFO Info = D3DDevice->GetResourceAllocationInfo(0, 1, &ResourceDesc);
 
-	Allocator->AllocResource((uint32_t)Info.SizeInBytes, Alignment, ResourceLocation);
+	TTransient Transient = { ResourceDesc, ClearValue, &ResourceLocation, nullptr };
+	Transient.Range.Size = Info.SizeInBytes;
+	Transient.Range.Alignment = Info.Alignment;
+	Transient.Range.FirstPass = FirstPass;
+	Transient.Range.LastPass = LastPass;
 
-	// create placed resource
+	Declared.push_back(Transient);
+}
+
+uint64_t TD3D12AliasingAllocator::CommitTransients()
+{
+	// the GPU may still use the heap through the previous transients
+	assert(IsEmpty());
+
+	std::vector<TAliasingResource> Ranges;
+	uint64_t MaxAlignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	for (const TTransient& Transient : Declared)
+	{
+		Ranges.push_back(Transient.Range);
+		MaxAlignment = (std::max)(MaxAlignment, Transient.Range.Alignment);
+	}
+
+	const TAliasingPlan Plan = TAliasingPlanner::Plan(Ranges);
+
+	Committed = std::move(Declared);
+	Declared.clear();
+	Predecessors = Plan.Predecessors;
+
+	// keep the heap when the new set fits, MSAA targets need a 4MB aligned heap
+	if (Plan.HeapSize != 0 && (!Heap || Plan.HeapSize > HeapSize || MaxAlignment > Heap->GetDesc().Alignment))
+	{
+		D3D12_HEAP_DESC Desc = {};
+		Desc.SizeInBytes = Plan.HeapSize;
+		Desc.Properties = CD3DX12_HEAP_PROPERTIES(InitData.HeapType);
+		Desc.Alignment = MaxAlignment;
+		Desc.Flags = InitData.HeapFlags;
+
+		Heap.Reset();
+		ThrowIfFailed(D3DDevice->CreateHeap(&Desc, IID_PPV_ARGS(&Heap)));
+		Heap->SetName(L"TD3D12AliasingAllocator Heap");
+
+		HeapSize = Plan.HeapSize;
+		BackingHeap = Heap.Get();
+	}
+
+	for (uint32_t i = 0; i < Committed.size(); ++i)
 	{
+		TTransient& Transient = Committed[i];
+
+		// the runtime rejects a clear value on a texture that is neither a render target nor a depth stencil
+		const bool bClearable = (Transient.ResourceDesc.Flags & (D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL)) != 0;
+
 		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+		ThrowIfFailed(D3DDevice->CreatePlacedResource(Heap.Get(), Plan.Offsets[i], &Transient.ResourceDesc, D3D12_RESOURCE_STATE_COMMON,
+			bClearable ? &Transient.ClearValue : nullptr, IID_PPV_ARGS(&Resource)));
 
-		ID3D12Heap* BackingHeap = ResourceLocation.Allocator->GetBackingHeap();
-		uint64_t HeapOffset = ResourceLocation.OffsetFromBaseOfHeap;
-		D3DDevice->CreatePlacedResource(BackingHeap, HeapOffset, &ResourceDesc, ResourceState, &ClearValue, IID_PPV_ARGS(&Resource));
+		Transient.Resource = new TD3D12Resource(Resource, D3D12_RESOURCE_STATE_COMMON);
 
-		TD3D12Resource* NewResource = new TD3D12Resource(Resource);
-		ResourceLocation.UnderlyingResource = NewResource;
-		ResourceLocation.BlockData.PlacedResource = NewResource; // will delete Resource when ResourceLocation was destoryed
+		// the index is the block handle
+		AssignLocation(i, 0, Plan.Offsets[i], Transient.Range.Size, *Transient.Location);
+		Transient.Location->UnderlyingResource = Transient.Resource;
+		Transient.Location->BlockData.PlacedResource = Transient.Resource;
+		Transient.Location = nullptr;
+
+		++NumLiveTransients;
+	}
+
+	return HeapSize;
+}
+
+void TD3D12AliasingAllocator::AliasingBarriers(uint32_t Pass, TD3D12CommandContext& CommandContext)
+{
+	std::vector<D3D12_RESOURCE_BARRIER> Barriers;
+
+	for (uint32_t i = 0; i < Committed.size(); ++i)
+	{
+		if (Committed[i].Range.FirstPass != Pass || Predecessors[i] == TAliasingPlan::NO_PREDECESSOR || !Committed[i].Resource)
+		{
+			continue;
+		}
+
+		// no resource before covers several previous users
+		ID3D12Resource* Before = nullptr;
+		if (Predecessors[i] >= 0 && Committed[Predecessors[i]].Resource)
+		{
+			Before = Committed[Predecessors[i]].Resource->D3DResource.Get();
+		}
+
+		Barriers.push_back(CD3DX12_RESOURCE_BARRIER::Aliasing(Before, Committed[i].Resource->D3DResource.Get()));
+	}
+
+	if (!Barriers.empty())
+	{
+		CommandContext.GetCommandList()->ResourceBarrier((UINT)Barriers.size(), Barriers.data());
+	}
+}
+
+void TD3D12AliasingAllocator::FreeBlock(const TD3D12BuddyBlockData& Block)
+{
+	// the resource itself is deleted with the block
+	Committed[Block.Offset].Resource = nullptr;
+
+	--NumLiveTransients;
+}
+
+template<typename TPolicy>
+TD3D12MultiBuddyAllocator<TPolicy>::TD3D12MultiBuddyAllocator(ID3D12Device* InDevice, const TD3D12SubAllocator::TAllocatorInitData& InInitData)
+	: Device(InDevice), InitData(InInitData)
+{
+	// the pools are created from InitData, it has to describe the same kind
+	assert(InitData.AllocatioStrategy == TPolicy::Strategy && InitData.HeapType == TPolicy::HeapType && InitData.HeapFlags == TPolicy::HeapFlags);
+
+	// 1/64 of a pool, larger requests would leave a pool fragmented quickly
+	SmallAllocationThreshold = InitData.PoolSize / 64;
+
+	DedicatedAllocator = std::make_unique<TD3D12DedicatedAllocator>(InDevice, InitData);
+}
+
+template<typename TPolicy>
+TD3D12MultiBuddyAllocator<TPolicy>::~TD3D12MultiBuddyAllocator()
+{
+	if (ResidencyManager)
+	{
+		for (TPoolSet* PoolSet : { &SmallPools, &LargePools })
+		{
+			for (auto& Allocator : PoolSet->Allocators)
+			{
+				if (Allocator)
+				{
+					ResidencyManager->Unregister(Allocator->GetBackingHeap());
+				}
+			}
+		}
 	}
 }
 
-void TD3D12PixelResourceAllocator::CleanUpAllocations()
+template<typename TPolicy>
+bool TD3D12MultiBuddyAllocator<TPolicy>::AllocResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation)
 {
-	Allocator->CleanUpAllocations();
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	if constexpr (!TPolicy::bPlaced)
+	{
+		if (IsDedicated(Size))
+		{
+			return DedicatedAllocator->AllocResource(Size, Alignment, ResourceLocation);
+		}
+	}
+
+	TPoolSet& PoolSet = GetPoolSet(Size);
+
+	// pick the fullest pool with a large enough free block
+	const uint32_t Order = TD3D12SubAllocator::GetAllocationOrder(Size, Alignment, InitData.MinBlockSize);
+
+	uint32_t Slot = 0;
+	bool bAllocated = PoolSet.Index.Find(Order, Slot) && AllocFromSlot(PoolSet, Slot, Size, Alignment, ResourceLocation);
+
+	// no pool has a large enough block, or a TLSF pool missed an aligned request (the index only knows the largest free order)
+	if (!bAllocated)
+	{
+		Slot = CreatePool(PoolSet, MakePoolInitData(Size, Alignment));
+		bAllocated = AllocFromSlot(PoolSet, Slot, Size, Alignment, ResourceLocation);
+	}
+
+	if (!bAllocated)
+	{
+		// buffers still get a committed resource, placed resources are left to the caller
+		if constexpr (!TPolicy::bPlaced)
+		{
+			return DedicatedAllocator->AllocResource(Size, Alignment, ResourceLocation);
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	TD3D12SubAllocator* Allocator = PoolSet.Allocators[Slot].get();
+
+	PoolSet.IdleFrames[Slot] = 0;
+
+	// the new resource is about to be initialized on the GPU
+	if constexpr (TPolicy::bPlaced)
+	{
+		if (ResidencyManager)
+		{
+			ResidencyManager->MarkUsed(Allocator->GetBackingHeap(), TD3D12RHI::g_CommandContext.GetNextFenceValue());
+		}
+	}
+
+	return true;
+}
+
+template<typename TPolicy>
+TD3D12SubAllocator::TAllocatorInitData TD3D12MultiBuddyAllocator<TPolicy>::MakePoolInitData(uint64_t Size, uint64_t Alignment) const
+{
+	// a request larger than the largest block gets a pool of its own
+	TD3D12SubAllocator::TAllocatorInitData NewInitData = InitData;
+	const uint64_t MaxBlockSize = InitData.MaxOrder != 0 ? (InitData.MinBlockSize << InitData.MaxOrder) : InitData.PoolSize;
+	if (Size + Alignment > MaxBlockSize)
+	{
+		NewInitData.PoolSize = Size + Alignment;
+		NewInitData.MaxOrder = 0;
+	}
+
+	return NewInitData;
+}
+
+template<typename TPolicy>
+bool TD3D12MultiBuddyAllocator<TPolicy>::AllocFromSlot(TPoolSet& PoolSet, uint32_t Slot, uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation)
+{
+	TD3D12SubAllocator* Allocator = PoolSet.Allocators[Slot].get();
+
+	// every pool of this allocator has the same algorithm, the branch always goes the same way
+	if (InitData.Algorithm == TD3D12SubAllocator::EAllocationAlgorithm::TLSF)
+	{
+		return AllocFromPool(static_cast<TD3D12TLSFPool<TPolicy>*>(Allocator), PoolSet, Slot, Size, Alignment, ResourceLocation);
+	}
+	else
+	{
+		return AllocFromPool(static_cast<TD3D12BuddyPool<TPolicy>*>(Allocator), PoolSet, Slot, Size, Alignment, ResourceLocation);
+	}
+}
+
+template<typename TPolicy>
+template<typename TPool>
+bool TD3D12MultiBuddyAllocator<TPolicy>::AllocFromPool(TPool* Pool, TPoolSet& PoolSet, uint32_t Slot, uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation)
+{
+	// the pool classes are final, neither call goes through the vtable
+	if (!Pool->AllocPoolResource(Size, Alignment, ResourceLocation))
+	{
+		return false;
+	}
+
+	PoolSet.Index.Update(Slot, Pool->GetLargestFreeOrder());
+
+	return true;
+}
+
+template<typename TPolicy>
+void TD3D12MultiBuddyAllocator<TPolicy>::AllocDedicatedTexture(const D3D12_RESOURCE_STATES& ResourceState, const D3D12_RESOURCE_DESC& ResourceDesc, const D3D12_CLEAR_VALUE* ClearValue, TD3D12ResourceLocation& ResourceLocation)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	DedicatedAllocator->AllocTextureResource(ResourceState, ResourceDesc, ClearValue, ResourceLocation);
+}
+
+template<typename TPolicy>
+uint32_t TD3D12MultiBuddyAllocator<TPolicy>::CreatePool(TPoolSet& PoolSet, const TD3D12SubAllocator::TAllocatorInitData& PoolInitData)
+{
+	uint32_t Slot = 0;
+
+	if (!PoolSet.FreeSlots.empty())
+	{
+		Slot = PoolSet.FreeSlots.back();
+		PoolSet.FreeSlots.pop_back();
+	}
+	else
+	{
+		Slot = (uint32_t)PoolSet.Allocators.size();
+		PoolSet.Allocators.emplace_back();
+		PoolSet.IdleFrames.push_back(0);
+	}
+
+	if (PoolInitData.Algorithm == TD3D12SubAllocator::EAllocationAlgorithm::TLSF)
+	{
+		PoolSet.Allocators[Slot] = std::make_unique<TD3D12TLSFPool<TPolicy>>(Device, PoolInitData);
+	}
+	else
+	{
+		PoolSet.Allocators[Slot] = std::make_unique<TD3D12BuddyPool<TPolicy>>(Device, PoolInitData);
+	}
+	PoolSet.IdleFrames[Slot] = 0;
+
+	// committed buffers of ManualSubAllocation have no heap
+	ID3D12Heap* Heap = PoolSet.Allocators[Slot]->GetBackingHeap();
+	if (ResidencyManager && Heap)
+	{
+		ResidencyManager->Register(Heap, PoolSet.Allocators[Slot]->GetPoolSize(), TD3D12RHI::g_CommandContext.GetNextFenceValue());
+	}
+
+	return Slot;
+}
+
+template<typename TPolicy>
+uint64_t TD3D12MultiBuddyAllocator<TPolicy>::ReleasePool(TPoolSet& PoolSet, uint32_t Slot)
+{
+	const uint64_t PoolSize = PoolSet.Allocators[Slot]->GetPoolSize();
+
+	if (ResidencyManager)
+	{
+		ResidencyManager->Unregister(PoolSet.Allocators[Slot]->GetBackingHeap());
+	}
+
+	// destroying the allocator releases its BackingHeap or BackingResource
+	PoolSet.Allocators[Slot].reset();
+	PoolSet.Index.Update(Slot, -1);
+	PoolSet.FreeSlots.push_back(Slot);
+
+	return PoolSize;
+}
+
+template<typename TPolicy>
+void TD3D12MultiBuddyAllocator<TPolicy>::CleanUpAllocations(uint64_t CompletedFenceValue)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	CleanUpAllocations(SmallPools, CompletedFenceValue);
+	CleanUpAllocations(LargePools, CompletedFenceValue);
+
+	DedicatedAllocator->CleanUpAllocations(CompletedFenceValue);
+}
+
+template<typename TPolicy>
+void TD3D12MultiBuddyAllocator<TPolicy>::CleanUpAllocations(TPoolSet& PoolSet, uint64_t CompletedFenceValue)
+{
+	for (uint32_t Slot = 0; Slot < PoolSet.Allocators.size(); ++Slot)
+	{
+		TD3D12SubAllocator* Allocator = PoolSet.Allocators[Slot].get();
+		if (!Allocator)
+		{
+			continue;
+		}
+
+		Allocator->CleanUpAllocations(CompletedFenceValue);
+
+		// freed blocks may have merged into a larger one
+		PoolSet.Index.Update(Slot, Allocator->GetLargestFreeOrder());
+
+		// an empty pool is kept for a while in case the memory is needed again soon
+		if (!Allocator->IsEmpty())
+		{
+			PoolSet.IdleFrames[Slot] = 0;
+		}
+		else if (++PoolSet.IdleFrames[Slot] > InitData.EmptyPoolReleaseDelay)
+		{
+			ReleasePool(PoolSet, Slot);
+		}
+	}
+}
+
+template<typename TPolicy>
+uint64_t TD3D12MultiBuddyAllocator<TPolicy>::Trim()
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	return Trim(SmallPools) + Trim(LargePools);
+}
+
+template<typename TPolicy>
+uint64_t TD3D12MultiBuddyAllocator<TPolicy>::Trim(TPoolSet& PoolSet)
+{
+	uint64_t BytesFreed = 0;
+
+	for (uint32_t Slot = 0; Slot < PoolSet.Allocators.size(); ++Slot)
+	{
+		if (PoolSet.Allocators[Slot] && PoolSet.Allocators[Slot]->IsEmpty())
+		{
+			BytesFreed += ReleasePool(PoolSet, Slot);
+		}
+	}
+
+	return BytesFreed;
+}
+
+template<typename TPolicy>
+void TD3D12MultiBuddyAllocator<TPolicy>::GetStats(TD3D12AllocatorStats& Stats)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	Stats.Name = InitData.Name;
+
+	for (TPoolSet* PoolSet : { &SmallPools, &LargePools })
+	{
+		for (auto& Allocator : PoolSet->Allocators)
+		{
+			if (Allocator)
+			{
+				Allocator->GetStats(Stats);
+			}
+		}
+	}
+
+	// counted as one more pool while it holds resources
+	if (!DedicatedAllocator->IsEmpty())
+	{
+		DedicatedAllocator->GetStats(Stats);
+	}
+}
+
+template<typename TPolicy>
+void TD3D12MultiBuddyAllocator<TPolicy>::WriteJson(std::string& Json)
+{
+	TD3D12AllocatorStats Stats;
+	GetStats(Stats);
+
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	Json += "{\"name\":\"";
+	Json += InitData.Name;
+	Json += "\",\"stats\":";
+	Stats.WriteJson(Json);
+	Json += ",\"pools\":[";
+
+	for (TPoolSet* PoolSet : { &SmallPools, &LargePools })
+	{
+		for (auto& Allocator : PoolSet->Allocators)
+		{
+			if (Allocator)
+			{
+				AppendJsonSeparator(Json);
+				Allocator->WriteBlockMap(Json);
+			}
+		}
+	}
+
+	if (!DedicatedAllocator->IsEmpty())
+	{
+		AppendJsonSeparator(Json);
+		DedicatedAllocator->WriteBlockMap(Json);
+	}
+
+	Json += "]}";
+}
+
+template<typename TPolicy>
+uint64_t TD3D12MultiBuddyAllocator<TPolicy>::Defragment(uint64_t ByteBudget, TD3D12CommandContext& CommandContext)
+{
+	// only placed resources can move, buffer views point into the shared backing resource.
+	// the planner works on buddy orders
+	if (!TPolicy::bPlaced || InitData.Algorithm != TD3D12SubAllocator::EAllocationAlgorithm::Buddy)
+	{
+		return 0;
+	}
+
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	uint64_t BytesMoved = Defragment(LargePools, ByteBudget, CommandContext);
+
+	if (BytesMoved < ByteBudget)
+	{
+		BytesMoved += Defragment(SmallPools, ByteBudget - BytesMoved, CommandContext);
+	}
+
+	return BytesMoved;
+}
+
+template<typename TPolicy>
+void TD3D12MultiBuddyAllocator<TPolicy>::MarkUsed(TD3D12ResourceLocation& ResourceLocation)
+{
+	// dedicated resources are not tracked
+	if (ResidencyManager && ResourceLocation.Allocator && ResourceLocation.Allocator->GetBackingHeap())
+	{
+		ResidencyManager->MarkUsed(ResourceLocation.Allocator->GetBackingHeap(), TD3D12RHI::g_CommandContext.GetNextFenceValue());
+	}
+}
+
+template<typename TPolicy>
+uint64_t TD3D12MultiBuddyAllocator<TPolicy>::Defragment(TPoolSet& PoolSet, uint64_t ByteBudget, TD3D12CommandContext& CommandContext)
+{
+	typedef TBuddyDefragPlanner<TD3D12BuddyAllocator::TBackingStore> TPlanner;
+
+	// nothing to evacuate into with less than two pools in use
+	uint32_t NumUsedPools = 0;
+	for (auto& Allocator : PoolSet.Allocators)
+	{
+		if (Allocator && !Allocator->GetLiveLocations().empty())
+		{
+			++NumUsedPools;
+		}
+	}
+
+	if (NumUsedPools < 2)
+	{
+		return 0;
+	}
+
+	std::vector<TPlanner::TPool*> Pools(PoolSet.Allocators.size(), nullptr);
+	std::vector<TDefragBlock> Blocks;
+	std::vector<TD3D12ResourceLocation*> Locations;
+
+	for (uint32_t Slot = 0; Slot < PoolSet.Allocators.size(); ++Slot)
+	{
+		TD3D12BuddyAllocator* Allocator = static_cast<TD3D12BuddyAllocator*>(PoolSet.Allocators[Slot].get());
+		if (!Allocator)
+		{
+			continue;
+		}
+
+		Pools[Slot] = &Allocator->GetBuddy();
+
+		for (TD3D12ResourceLocation* Location : Allocator->GetLiveLocations())
+		{
+			TDefragBlock Block;
+			Block.Pool = Slot;
+			Block.Offset = Location->BlockData.Offset;
+			Block.Order = Location->BlockData.Order;
+			Block.Size = Location->BlockData.ActualUsedSize;
+			Block.bMovable = (bool)Location->OnRelocated;
+
+			Blocks.push_back(Block);
+			Locations.push_back(Location);
+		}
+	}
+
+	const std::vector<TDefragMove> Moves = TPlanner::Plan(Pools, Blocks, ByteBudget);
+
+	uint64_t BytesMoved = 0;
+	for (const TDefragMove& Move : Moves)
+	{
+		if (Relocate(*Locations[Move.BlockIndex], static_cast<TD3D12BuddyAllocator*>(PoolSet.Allocators[Move.DstPool].get()), Move.Dst, CommandContext))
+		{
+			BytesMoved += Blocks[Move.BlockIndex].Size;
+		}
+	}
+
+	for (uint32_t Slot = 0; Slot < PoolSet.Allocators.size(); ++Slot)
+	{
+		if (PoolSet.Allocators[Slot])
+		{
+			PoolSet.Index.Update(Slot, PoolSet.Allocators[Slot]->GetLargestFreeOrder());
+		}
+	}
+
+	return BytesMoved;
+}
+
+template<typename TPolicy>
+bool TD3D12MultiBuddyAllocator<TPolicy>::Relocate(TD3D12ResourceLocation& ResourceLocation, TD3D12BuddyAllocator* DstAllocator, const TBuddyAllocation& Dst, TD3D12CommandContext& CommandContext)
+{
+	TD3D12Resource* Resource = ResourceLocation.UnderlyingResource;
+	const D3D12_RESOURCE_DESC Desc = Resource->D3DResource->GetDesc();
+
+	// the resource may have been replaced by a larger one since it was allocated
+	const D3D12_RESOURCE_ALLOCATION_INFO Info = Device->GetResourceAllocationInfo(0, 1, &Desc);
+	if (Info.SizeInBytes > (InitData.MinBlockSize << Dst.Order) || Info.Alignment > InitData.MinBlockSize)
+	{
+		// the GPU never saw the destination block, it can be freed right away
+		DstAllocator->GetBuddy().Deallocate(Dst.Offset, Dst.Order);
+		return false;
+	}
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> NewResource;
+	ThrowIfFailed(Device->CreatePlacedResource(DstAllocator->GetBackingHeap(), Dst.AlignedOffset, &Desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&NewResource)));
+
+	// the copy reads the source pool and writes the destination pool
+	if (ResidencyManager)
+	{
+		ResidencyManager->MarkUsed(ResourceLocation.Allocator->GetBackingHeap(), CommandContext.GetNextFenceValue());
+		ResidencyManager->MarkUsed(DstAllocator->GetBackingHeap(), CommandContext.GetNextFenceValue());
+	}
+
+	const D3D12_RESOURCE_STATES State = Resource->CurrentState;
+	if (State != D3D12_RESOURCE_STATE_COPY_SOURCE)
+	{
+		CommandContext.Transition(Resource, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	}
+
+	CommandContext.GetCommandList()->CopyResource(NewResource.Get(), Resource->D3DResource.Get());
+
+	// the old resource stays in the source block until the GPU has finished the copy
+	ResourceLocation.BlockData.PlacedResource = new TD3D12Resource(Resource->D3DResource, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	ResourceLocation.Allocator->Deallocate(ResourceLocation);
+
+	// keep the TD3D12Resource object, everyone holding it sees the new resource
+	Resource->D3DResource = NewResource;
+	Resource->GPUVirtualAddress = Desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER ? NewResource->GetGPUVirtualAddress() : 0;
+	Resource->CurrentState = D3D12_RESOURCE_STATE_COPY_DEST;
+
+	if (State != D3D12_RESOURCE_STATE_COPY_DEST)
+	{
+		CommandContext.Transition(Resource, State);
+	}
+
+	DstAllocator->AssignAllocation(Dst, ResourceLocation.BlockData.ActualUsedSize, ResourceLocation);
+	ResourceLocation.BlockData.PlacedResource = Resource;
+
+	// let the owner rewrite its views
+	ResourceLocation.OnRelocated(ResourceLocation);
+
+	return true;
+}
+
+// the kinds of pool the wrappers below create
+template class TD3D12MultiBuddyAllocator<TUploadBufferPolicy>;
+template class TD3D12MultiBuddyAllocator<TDefaultBufferPolicy>;
+template class TD3D12MultiBuddyAllocator<TTexturePolicy>;
+template class TD3D12MultiBuddyAllocator<TRenderTargetPolicy>;
+
+TD3D12Slab::TD3D12Slab(TD3D12MultiBuddyAllocator<TUploadBufferPolicy>& Parent, const TAllocatorInitData& InInitData, uint64_t InSlotSize)
+	: TD3D12SubAllocator(InInitData), SlotSize(InSlotSize)
+{
+	// buddy blocks are aligned to their size, so every slot is aligned to SlotSize
+	Parent.AllocResource(SLAB_SIZE, 0, SlabLocation);
+
+#if ALLOCATION_TRACKING
+	// the slots are tracked one by one
+	TD3D12AllocationTracker::Get().Untrack(SlabLocation);
+#endif
+
+	BackingResource = SlabLocation.UnderlyingResource;
+	BackingOffset = SlabLocation.OffsetFromBaseOfResource;
+
+	const uint32_t NumSlots = (uint32_t)(SLAB_SIZE / SlotSize);
+	FreeSlots.Initialize(NumSlots);
+	for (uint32_t Slot = 0; Slot < NumSlots; ++Slot)
+	{
+		FreeSlots.Set(Slot);
+	}
+}
+
+TD3D12Slab::~TD3D12Slab()
+{
+	CleanUpAllocations(UINT64_MAX);
+
+	// SlabLocation gives the block back to the buddy pool
+}
+
+bool TD3D12Slab::AllocResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation)
+{
+	if (FreeSlots.Empty() || Size > SlotSize || Alignment > SlotSize)
+	{
+		return false;
+	}
+
+	const uint32_t Slot = FreeSlots.FindFirst();
+	FreeSlots.Clear(Slot);
+	++NumUsedSlots;
+
+	AssignPoolLocation<TUploadBufferPolicy>(Slot, 0, Slot * SlotSize, Size, ResourceLocation);
+
+	return true;
+}
+
+void TD3D12Slab::FreeBlock(const TD3D12BuddyBlockData& Block)
+{
+	assert(!FreeSlots.Test(Block.Offset));
+
+	FreeSlots.Set(Block.Offset);
+	--NumUsedSlots;
+}
+
+uint64_t TD3D12Slab::GetBlockSize(const TD3D12BuddyBlockData& Block) const
+{
+	return SlotSize;
+}
+
+void TD3D12Slab::GetFreeBlockStats(TD3D12AllocatorStats& Stats) const
+{
+	if (!FreeSlots.Empty())
+	{
+		Stats.NumFreeBlocks[GetAllocationOrder(SlotSize, 0, InitData.MinBlockSize)] += (uint32_t)(SLAB_SIZE / SlotSize) - NumUsedSlots;
+		Stats.LargestFreeBlock = (std::max)(Stats.LargestFreeBlock, SlotSize);
+	}
+}
+
+void TD3D12Slab::ForEachFreeBlock(const std::function<void(uint64_t, uint64_t)>& Func) const
+{
+	FreeSlots.ForEachSetBit([&](uint32_t Slot)
+	{
+		Func(Slot * SlotSize, SlotSize);
+	});
+}
+
+TD3D12SlabAllocator::TD3D12SlabAllocator(TD3D12MultiBuddyAllocator<TUploadBufferPolicy>& InParent, const TD3D12SubAllocator::TAllocatorInitData& InInitData)
+	: Parent(InParent), InitData(InInitData)
+{
+	assert(InitData.AllocatioStrategy == TUploadBufferPolicy::Strategy && InitData.HeapType == TUploadBufferPolicy::HeapType);
+
+	InitData.PoolSize = SLAB_SIZE;
+
+	// MinBlockSize, 2 * MinBlockSize ... SLAB_MAX_SLOT_SIZE
+	const uint32_t NumSizeClasses = TD3D12SubAllocator::GetAllocationOrder(SLAB_MAX_SLOT_SIZE, 0, InitData.MinBlockSize) + 1;
+	for (TShard& Shard : Shards)
+	{
+		Shard.SizeClasses.resize(NumSizeClasses);
+	}
+}
+
+TD3D12SlabAllocator::TShard& TD3D12SlabAllocator::GetShard()
+{
+	// threads take shards round robin in the order they first allocate
+	static std::atomic<uint32_t> NextThreadIndex = 0;
+	thread_local const uint32_t ThreadIndex = NextThreadIndex++;
+
+	return Shards[ThreadIndex % SLAB_NUM_SHARDS];
+}
+
+TD3D12SlabAllocator::~TD3D12SlabAllocator()
+{
+}
+
+bool TD3D12SlabAllocator::AllocResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation)
+{
+	// slots are aligned to their size, a larger alignment picks a larger class
+	const uint32_t ClassIndex = TD3D12SubAllocator::GetAllocationOrder((std::max)(Size, Alignment), 0, InitData.MinBlockSize);
+	if (ClassIndex >= Shards[0].SizeClasses.size())
+	{
+		return false;
+	}
+
+	TShard& Shard = GetShard();
+	std::lock_guard<std::mutex> Lock(Shard.Mutex);
+
+	TSizeClass& SizeClass = Shard.SizeClasses[ClassIndex];
+
+	if (SizeClass.PartialSlabs.empty())
+	{
+		SizeClass.Slabs.push_back(std::make_unique<TD3D12Slab>(Parent, InitData, InitData.MinBlockSize << ClassIndex));
+		AddPartial(SizeClass, SizeClass.Slabs.back().get());
+	}
+
+	// the last partial slab is the one touched most recently
+	TD3D12Slab* Slab = SizeClass.PartialSlabs.back();
+
+	// a partial slab always has a slot and the class fits the request, the caller falls back to the pools anyway
+	if (!Slab->AllocResource(Size, Alignment, ResourceLocation))
+	{
+		return false;
+	}
+
+	if (Slab->IsFull())
+	{
+		RemovePartial(SizeClass, Slab);
+	}
+
+	return true;
+}
+
+void TD3D12SlabAllocator::CleanUpAllocations(uint64_t CompletedFenceValue)
+{
+	for (TShard& Shard : Shards)
+	{
+		std::lock_guard<std::mutex> Lock(Shard.Mutex);
+
+		for (TSizeClass& SizeClass : Shard.SizeClasses)
+		{
+			CleanUpAllocations(SizeClass, CompletedFenceValue);
+		}
+	}
+}
+
+void TD3D12SlabAllocator::CleanUpAllocations(TSizeClass& SizeClass, uint64_t CompletedFenceValue)
+{
+	bool bKeptEmptySlab = false;
+
+	for (uint32_t Index = 0; Index < SizeClass.Slabs.size();)
+	{
+		TD3D12Slab* Slab = SizeClass.Slabs[Index].get();
+
+		const bool bWasFull = Slab->IsFull();
+		Slab->CleanUpAllocations(CompletedFenceValue);
+
+		if (bWasFull && !Slab->IsFull())
+		{
+			AddPartial(SizeClass, Slab);
+		}
+
+		if (Slab->IsEmpty())
+		{
+			if (bKeptEmptySlab)
+			{
+				// the last slab is moved into Index
+				ReleaseSlab(SizeClass, Index);
+				continue;
+			}
+
+			bKeptEmptySlab = true;
+		}
+
+		++Index;
+	}
+}
+
+void TD3D12SlabAllocator::Trim()
+{
+	for (TShard& Shard : Shards)
+	{
+		std::lock_guard<std::mutex> Lock(Shard.Mutex);
+
+		for (TSizeClass& SizeClass : Shard.SizeClasses)
+		{
+			for (uint32_t Index = 0; Index < SizeClass.Slabs.size();)
+			{
+				if (SizeClass.Slabs[Index]->IsEmpty())
+				{
+					ReleaseSlab(SizeClass, Index);
+					continue;
+				}
+
+				++Index;
+			}
+		}
+	}
+}
+
+void TD3D12SlabAllocator::GetStats(TD3D12AllocatorStats& Stats)
+{
+	Stats.Name = InitData.Name;
+
+	for (TShard& Shard : Shards)
+	{
+		std::lock_guard<std::mutex> Lock(Shard.Mutex);
+
+		for (TSizeClass& SizeClass : Shard.SizeClasses)
+		{
+			for (auto& Slab : SizeClass.Slabs)
+			{
+				Slab->GetStats(Stats);
+			}
+		}
+	}
+}
+
+void TD3D12SlabAllocator::WriteJson(std::string& Json)
+{
+	TD3D12AllocatorStats Stats;
+	GetStats(Stats);
+
+	Json += "{\"name\":\"";
+	Json += InitData.Name;
+	Json += "\",\"stats\":";
+	Stats.WriteJson(Json);
+	Json += ",\"pools\":[";
+
+	for (TShard& Shard : Shards)
+	{
+		std::lock_guard<std::mutex> Lock(Shard.Mutex);
+
+		for (TSizeClass& SizeClass : Shard.SizeClasses)
+		{
+			for (auto& Slab : SizeClass.Slabs)
+			{
+				AppendJsonSeparator(Json);
+				Slab->WriteBlockMap(Json);
+			}
+		}
+	}
+
+	Json += "]}";
+}
+
+void TD3D12SlabAllocator::AddPartial(TSizeClass& SizeClass, TD3D12Slab* Slab)
+{
+	assert(Slab->PartialIndex == TD3D12Slab::INDEX_NONE);
+
+	Slab->PartialIndex = (uint32_t)SizeClass.PartialSlabs.size();
+	SizeClass.PartialSlabs.push_back(Slab);
+}
+
+void TD3D12SlabAllocator::RemovePartial(TSizeClass& SizeClass, TD3D12Slab* Slab)
+{
+	assert(Slab->PartialIndex != TD3D12Slab::INDEX_NONE);
+
+	TD3D12Slab* Last = SizeClass.PartialSlabs.back();
+	SizeClass.PartialSlabs[Slab->PartialIndex] = Last;
+	Last->PartialIndex = Slab->PartialIndex;
+
+	SizeClass.PartialSlabs.pop_back();
+	Slab->PartialIndex = TD3D12Slab::INDEX_NONE;
+}
+
+void TD3D12SlabAllocator::ReleaseSlab(TSizeClass& SizeClass, uint32_t Index)
+{
+	TD3D12Slab* Slab = SizeClass.Slabs[Index].get();
+
+	if (Slab->PartialIndex != TD3D12Slab::INDEX_NONE)
+	{
+		RemovePartial(SizeClass, Slab);
+	}
+
+	SizeClass.Slabs[Index] = std::move(SizeClass.Slabs.back());
+	SizeClass.Slabs.pop_back();
+}
+
+TD3D12UploadBufferAllocator::TD3D12UploadBufferAllocator(ID3D12Device* InDevice)
+{
+	TD3D12SubAllocator::TAllocatorInitData InitData = TUploadBufferPolicy::MakeInitData();
+	InitData.ResourceFlags = D3D12_RESOURCE_FLAG_NONE;
+	InitData.PoolSize = 1024 * 1024 * 64; // staging for buffer and texture uploads, per-frame constants use the ring
+	InitData.Name = "Upload";
+
+	Allocator = std::make_unique<TD3D12MultiBuddyAllocator<TUploadBufferPolicy>>(InDevice, InitData);
+
+	InitData.Name = "UploadSlab";
+	SlabAllocator = std::make_unique<TD3D12SlabAllocator>(*Allocator, InitData);
+
+	D3DDevice = InDevice;
+}
+
+void* TD3D12UploadBufferAllocator::AllocUploadResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation)
+{
+	if (!SlabAllocator->AllocResource(Size, Alignment, ResourceLocation) && !Allocator->AllocResource(Size, Alignment, ResourceLocation))
+	{
+		// the pools already fall back to a committed buffer, nothing is left to try
+		ThrowIfFailed(E_OUTOFMEMORY);
+	}
+
+	TraceAllocation(ResourceLocation, Size, Alignment, D3D12_HEAP_TYPE_UPLOAD, false);
+
+	return ResourceLocation.MappedAddress;
+}
+
+void TD3D12UploadBufferAllocator::CleanUpAllocations(uint64_t CompletedFenceValue)
+{
+	// released slabs queue their blocks on Allocator like any other deallocation
+	SlabAllocator->CleanUpAllocations(CompletedFenceValue);
+	Allocator->CleanUpAllocations(CompletedFenceValue);
+}
+
+uint64_t TD3D12UploadBufferAllocator::Trim()
+{
+	// the blocks of the released slabs are only queued on the pools, they come back on a later Trim.
+	// counting them here would report memory that is still held
+	SlabAllocator->Trim();
+
+	return Allocator->Trim();
+}
+
+void TD3D12UploadBufferAllocator::GetStats(std::vector<TD3D12AllocatorStats>& OutStats)
+{
+	OutStats.emplace_back();
+	Allocator->GetStats(OutStats.back());
+
+	OutStats.emplace_back();
+	SlabAllocator->GetStats(OutStats.back());
+}
+
+void TD3D12UploadBufferAllocator::WriteJson(std::string& Json)
+{
+	AppendJsonSeparator(Json);
+	Allocator->WriteJson(Json);
+
+	AppendJsonSeparator(Json);
+	SlabAllocator->WriteJson(Json);
+}
+
+TD3D12UploadRingAllocator::TD3D12UploadRingAllocator(ID3D12Device* InDevice, uint32_t Size)
+	: Ring(Size), D3DDevice(InDevice)
+{
+	CD3DX12_HEAP_PROPERTIES HeapProperties(D3D12_HEAP_TYPE_UPLOAD);
+	CD3DX12_RESOURCE_DESC BufferDesc = CD3DX12_RESOURCE_DESC::Buffer(Size);
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+	ThrowIfFailed(D3DDevice->CreateCommittedResource(
+		&HeapProperties,
+		D3D12_HEAP_FLAG_NONE,
+		&BufferDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&Resource)));
+
+	Resource->SetName(L"TD3D12UploadRingAllocator BackingResource");
+
+	// upload heap 常驻映射
+	BackingResource = new TD3D12Resource(Resource);
+	BackingResource->Map();
+}
+
+TD3D12UploadRingAllocator::~TD3D12UploadRingAllocator()
+{
+	delete BackingResource;
+}
+
+void* TD3D12UploadRingAllocator::AllocUploadResource(uint32_t Size, uint32_t Alignment, TD3D12ResourceLocation& ResourceLocation)
+{
+	uint64_t Offset = 0;
+	if (!Ring.Allocate(Size, Alignment, Offset))
+	{
+		return nullptr;
+	}
+
+	// no allocator, the ring reclaims the memory by fence
+	ResourceLocation.SetType(TD3D12ResourceLocation::EResourceLocationType::SubAllocation);
+	ResourceLocation.Allocator = nullptr;
+	ResourceLocation.UnderlyingResource = BackingResource;
+	ResourceLocation.OffsetFromBaseOfResource = Offset;
+	ResourceLocation.GPUVirtualAddress = BackingResource->GPUVirtualAddress + Offset;
+	ResourceLocation.MappedAddress = (uint8_t*)BackingResource->MappedBaseAddress + Offset;
+
+	return ResourceLocation.MappedAddress;
+}
+
+void TD3D12UploadRingAllocator::FinishFrame(uint64_t FenceValue)
+{
+	Ring.FinishFrame(FenceValue);
+}
+
+void TD3D12UploadRingAllocator::CleanUpAllocations(uint64_t CompletedFenceValue)
+{
+	Ring.Retire(CompletedFenceValue);
+}
+
+void TD3D12UploadRingAllocator::GetStats(std::vector<TD3D12AllocatorStats>& OutStats)
+{
+	// no blocks, the used range is one allocation
+	TD3D12AllocatorStats Stats;
+	Stats.Name = "UploadRing";
+	Stats.NumPools = 1;
+	Stats.ReservedSize = Ring.GetCapacity();
+	Stats.AllocatedSize = Ring.GetUsedSize();
+	Stats.RequestedSize = Stats.AllocatedSize;
+	Stats.LargestFreeBlock = Stats.ReservedSize - Stats.AllocatedSize;
+
+	OutStats.push_back(Stats);
+}
+
+void TD3D12UploadRingAllocator::WriteJson(std::string& Json)
+{
+	std::vector<TD3D12AllocatorStats> Stats;
+	GetStats(Stats);
+
+	AppendJsonSeparator(Json);
+	Json += "{\"name\":\"UploadRing\",\"stats\":";
+	Stats[0].WriteJson(Json);
+	Json += ",\"pools\":[]}";
+}
+
+TD3D12ReadbackAllocator::TD3D12ReadbackAllocator(ID3D12Device* InDevice, uint32_t Size)
+	: Ring(Size), D3DDevice(InDevice)
+{
+	CD3DX12_HEAP_PROPERTIES HeapProperties(D3D12_HEAP_TYPE_READBACK);
+	CD3DX12_RESOURCE_DESC BufferDesc = CD3DX12_RESOURCE_DESC::Buffer(Size);
+
+	// resources in a readback heap stay in COPY_DEST
+	Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+	ThrowIfFailed(D3DDevice->CreateCommittedResource(
+		&HeapProperties,
+		D3D12_HEAP_FLAG_NONE,
+		&BufferDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&Resource)));
+
+	Resource->SetName(L"TD3D12ReadbackAllocator BackingResource");
+
+	// 回读堆是write back内存，常驻映射，fence完成后CPU就能读到GPU写入的数据
+	BackingResource = new TD3D12Resource(Resource, D3D12_RESOURCE_STATE_COPY_DEST);
+	BackingResource->Map();
+}
+
+TD3D12ReadbackAllocator::~TD3D12ReadbackAllocator()
+{
+	// the callbacks still waiting are dropped, nobody is left to receive them on shutdown
+	delete BackingResource;
+}
+
+bool TD3D12ReadbackAllocator::Readback(TD3D12Resource* Resource, uint32_t Subresource, TD3D12ReadbackCallback Callback, TD3D12CommandContext& CommandContext)
+{
+	const D3D12_RESOURCE_DESC Desc = Resource->D3DResource->GetDesc();
+
+	TD3D12ReadbackData Data;
+	Data.Format = Desc.Format;
+
+	uint64_t Offset = 0;
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT Footprint = {};
+
+	if (Desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+	{
+		Data.Size = Desc.Width;
+		Data.Width = (uint32_t)Desc.Width;
+		Data.Height = 1;
+
+		if (!Ring.Allocate(Data.Size, 0, Offset))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		uint32_t NumRows = 0;
+		uint64_t RowSize = 0;
+		D3DDevice->GetCopyableFootprints(&Desc, Subresource, 1, 0, &Footprint, &NumRows, &RowSize, &Data.Size);
+
+		Data.RowPitch = Footprint.Footprint.RowPitch;
+		Data.Width = Footprint.Footprint.Width;
+		Data.Height = Footprint.Footprint.Height;
+
+		if (!Ring.Allocate(Data.Size, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, Offset))
+		{
+			return false;
+		}
+	}
+
+	const D3D12_RESOURCE_STATES State = Resource->CurrentState;
+	if (State != D3D12_RESOURCE_STATE_COPY_SOURCE)
+	{
+		CommandContext.Transition(Resource, D3D12_RESOURCE_STATE_COPY_SOURCE);
+	}
+
+	if (Desc.Dimension == D3D12_RESOURCE_DIMENSION_BUFFER)
+	{
+		CommandContext.GetCommandList()->CopyBufferRegion(BackingResource->D3DResource.Get(), Offset, Resource->D3DResource.Get(), 0, Data.Size);
+	}
+	else
+	{
+		Footprint.Offset = Offset;
+
+		CD3DX12_TEXTURE_COPY_LOCATION Dst(BackingResource->D3DResource.Get(), Footprint);
+		CD3DX12_TEXTURE_COPY_LOCATION Src(Resource->D3DResource.Get(), Subresource);
+		CommandContext.GetCommandList()->CopyTextureRegion(&Dst, 0, 0, 0, &Src, nullptr);
+	}
+
+	if (State != D3D12_RESOURCE_STATE_COPY_SOURCE)
+	{
+		CommandContext.Transition(Resource, State);
+	}
+
+	Enqueue(Offset, Data, std::move(Callback), CommandContext);
+
+	return true;
+}
+
+bool TD3D12ReadbackAllocator::ReadbackBuffer(const TD3D12ResourceLocation& ResourceLocation, uint64_t Size, TD3D12ReadbackCallback Callback, TD3D12CommandContext& CommandContext)
+{
+	uint64_t Offset = 0;
+	if (!Ring.Allocate(Size, 0, Offset))
+	{
+		return false;
+	}
+
+	TD3D12ReadbackData Data;
+	Data.Size = Size;
+	Data.Width = (uint32_t)Size;
+	Data.Height = 1;
+
+	CommandContext.GetCommandList()->CopyBufferRegion(BackingResource->D3DResource.Get(), Offset,
+		ResourceLocation.UnderlyingResource->D3DResource.Get(), ResourceLocation.OffsetFromBaseOfResource, Size);
+
+	Enqueue(Offset, Data, std::move(Callback), CommandContext);
+
+	return true;
+}
+
+bool TD3D12ReadbackAllocator::ReadbackQueries(ID3D12QueryHeap* QueryHeap, D3D12_QUERY_TYPE Type, uint32_t StartIndex, uint32_t NumQueries, TD3D12ReadbackCallback Callback, TD3D12CommandContext& CommandContext)
+{
+	// ResolveQueryData writes to 8 byte aligned offsets
+	uint64_t Offset = 0;
+	if (!Ring.Allocate(NumQueries * sizeof(uint64_t), sizeof(uint64_t), Offset))
+	{
+		return false;
+	}
+
+	TD3D12ReadbackData Data;
+	Data.Size = NumQueries * sizeof(uint64_t);
+	Data.Width = NumQueries;
+	Data.Height = 1;
+
+	CommandContext.GetCommandList()->ResolveQueryData(QueryHeap, Type, StartIndex, NumQueries, BackingResource->D3DResource.Get(), Offset);
+
+	Enqueue(Offset, Data, std::move(Callback), CommandContext);
+
+	return true;
+}
+
+void TD3D12ReadbackAllocator::Enqueue(uint64_t Offset, const TD3D12ReadbackData& Data, TD3D12ReadbackCallback&& Callback, TD3D12CommandContext& CommandContext)
+{
+	// the copy is covered by the next fence signal
+	Ring.Enqueue(Offset, Data, std::move(Callback), CommandContext.GetNextFenceValue());
+}
+
+void TD3D12ReadbackAllocator::FinishFrame(uint64_t FenceValue)
+{
+	Ring.FinishFrame(FenceValue);
+}
+
+void TD3D12ReadbackAllocator::CleanUpAllocations(uint64_t CompletedFenceValue)
+{
+	// the callbacks read the ring, its space is only reclaimed afterwards
+	Ring.Retire(CompletedFenceValue, BackingResource->MappedBaseAddress);
+}
+
+void TD3D12ReadbackAllocator::GetStats(std::vector<TD3D12AllocatorStats>& OutStats)
+{
+	TD3D12AllocatorStats Stats;
+	Stats.Name = "Readback";
+	Stats.NumPools = 1;
+	Stats.NumPendingFrees = (uint32_t)Ring.GetNumPending();
+	Stats.ReservedSize = Ring.GetCapacity();
+	Stats.AllocatedSize = Ring.GetUsedSize();
+	Stats.RequestedSize = Stats.AllocatedSize;
+	Stats.LargestFreeBlock = Stats.ReservedSize - Stats.AllocatedSize;
+
+	OutStats.push_back(Stats);
+}
+
+void TD3D12ReadbackAllocator::WriteJson(std::string& Json)
+{
+	std::vector<TD3D12AllocatorStats> Stats;
+	GetStats(Stats);
+
+	AppendJsonSeparator(Json);
+	Json += "{\"name\":\"Readback\",\"stats\":";
+	Stats[0].WriteJson(Json);
+	Json += ",\"pools\":[]}";
+}
+
+TD3D12DefaultBufferAllocator::TD3D12DefaultBufferAllocator(ID3D12Device* InDevice, TD3D12SubAllocator::EAllocationAlgorithm Algorithm)
+{
+	{
+		TD3D12SubAllocator::TAllocatorInitData InitData = TDefaultBufferPolicy::MakeInitData();
+		InitData.Algorithm = Algorithm;
+		InitData.ResourceFlags = D3D12_RESOURCE_FLAG_NONE;
+		InitData.PoolSize = 1024 * 1024 * 64; // vertex and index buffers
+		InitData.Name = "DefaultBuffer";
+
+		Allocator = std::make_unique<TD3D12MultiBuddyAllocator<TDefaultBufferPolicy>>(InDevice, InitData);
+	}
+
+	{
+		TD3D12SubAllocator::TAllocatorInitData InitData = TDefaultBufferPolicy::MakeInitData();
+		InitData.ResourceFlags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS; // for UAV
+		InitData.PoolSize = 1024 * 1024 * 16;
+		InitData.Name = "DefaultUav";
+
+		UavAllocator = std::make_unique<TD3D12MultiBuddyAllocator<TDefaultBufferPolicy>>(InDevice, InitData);
+	}
+
+	D3DDevice = InDevice;
+}
+
+void TD3D12DefaultBufferAllocator::AllocDefaultResource(const D3D12_RESOURCE_DESC& REsourceDesc, uint32_t Alignment, TD3D12ResourceLocation& ResourceLocation)
+{
+	if (REsourceDesc.Flags == D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS)
+	{
+		UavAllocator->AllocResource(REsourceDesc.Width, Alignment, ResourceLocation);
+	}
+	else
+	{
+		Allocator->AllocResource(REsourceDesc.Width, Alignment, ResourceLocation);
+	}
+
+	TraceAllocation(ResourceLocation, REsourceDesc.Width, Alignment, D3D12_HEAP_TYPE_DEFAULT, false);
+}
+
+void TD3D12DefaultBufferAllocator::CleanUpAllocations(uint64_t CompletedFenceValue)
+{
+	Allocator->CleanUpAllocations(CompletedFenceValue);
+	UavAllocator->CleanUpAllocations(CompletedFenceValue);
+}
+
+uint64_t TD3D12DefaultBufferAllocator::Trim()
+{
+	return Allocator->Trim() + UavAllocator->Trim();
+}
+
+void TD3D12DefaultBufferAllocator::GetStats(std::vector<TD3D12AllocatorStats>& OutStats)
+{
+	OutStats.emplace_back();
+	Allocator->GetStats(OutStats.back());
+
+	OutStats.emplace_back();
+	UavAllocator->GetStats(OutStats.back());
+}
+
+void TD3D12DefaultBufferAllocator::WriteJson(std::string& Json)
+{
+	AppendJsonSeparator(Json);
+	Allocator->WriteJson(Json);
+
+	AppendJsonSeparator(Json);
+	UavAllocator->WriteJson(Json);
+}
+
+TD3D12TextureResourceAllocator::TD3D12TextureResourceAllocator(ID3D12Device* InDevice, TD3D12ResidencyManager* ResidencyManager)
+{
+	TD3D12SubAllocator::TAllocatorInitData InitData = TTexturePolicy::MakeInitData();
+	InitData.PoolSize = 1024 * 1024 * 128;
+	InitData.MinBlockSize = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT; // placed resources start on 64KB boundaries
+	InitData.Name = "Texture";
+	
+	Allocator = std::make_unique<TD3D12MultiBuddyAllocator<TTexturePolicy>>(InDevice, InitData);
+	Allocator->SetResidencyManager(ResidencyManager);
+
+	D3DDevice = InDevice;
+}
+
+void TD3D12TextureResourceAllocator::AllocTextureResource(const D3D12_RESOURCE_STATES& ResourceState, const D3D12_RESOURCE_DESC& ResourceDesc, uint32_t Alignment, TD3D12ResourceLocation& ResourceLocation)
+{
+	const D3D12_RESOURCE_ALLOCATION_INFO Info = D3DDevice->GetResourceAllocationInfo(0, 1, &ResourceDesc);
+
+	// placed resources need the device alignment (64KB, 4MB for MSAA), not the one of the texture data
+	const uint64_t PlacementAlignment = (std::max)((uint64_t)Alignment, Info.Alignment);
+	TraceAllocation(ResourceLocation, Info.SizeInBytes, PlacementAlignment, D3D12_HEAP_TYPE_DEFAULT, true);
+
+	// too large for a pool block
+	if (Allocator->IsDedicated(Info.SizeInBytes))
+	{
+		Allocator->AllocDedicatedTexture(ResourceState, ResourceDesc, nullptr, ResourceLocation);
+		return;
+	}
+
+	// no pool could take it, fall back to a committed resource
+	if (!Allocator->AllocResource(Info.SizeInBytes, PlacementAlignment, ResourceLocation))
+	{
+		Allocator->AllocDedicatedTexture(ResourceState, ResourceDesc, nullptr, ResourceLocation);
+		return;
+	}
+
+	// create placed resource
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+
+		ID3D12Heap* BackingHeap = ResourceLocation.Allocator->GetBackingHeap();
+		uint64_t HeapOffset = ResourceLocation.OffsetFromBaseOfHeap;
+		D3DDevice->CreatePlacedResource(BackingHeap, HeapOffset, &ResourceDesc, ResourceState, nullptr, IID_PPV_ARGS(&Resource));
+
+		TD3D12Resource* NewResource = new TD3D12Resource(Resource);
+		ResourceLocation.UnderlyingResource = NewResource;
+		ResourceLocation.BlockData.PlacedResource = NewResource; // will delete Resource when ResourceLocation was destoryed
+	}
+}
+
+void TD3D12TextureResourceAllocator::CleanUpAllocations(uint64_t CompletedFenceValue)
+{
+	Allocator->CleanUpAllocations(CompletedFenceValue);
+}
+
+uint64_t TD3D12TextureResourceAllocator::Trim()
+{
+	return Allocator->Trim();
+}
+
+void TD3D12TextureResourceAllocator::GetStats(std::vector<TD3D12AllocatorStats>& OutStats)
+{
+	OutStats.emplace_back();
+	Allocator->GetStats(OutStats.back());
+}
+
+void TD3D12TextureResourceAllocator::WriteJson(std::string& Json)
+{
+	AppendJsonSeparator(Json);
+	Allocator->WriteJson(Json);
+}
+
+uint64_t TD3D12TextureResourceAllocator::Defragment(uint64_t ByteBudget, TD3D12CommandContext& CommandContext)
+{
+	return Allocator->Defragment(ByteBudget, CommandContext);
+}
+
+void TD3D12TextureResourceAllocator::MarkUsed(TD3D12ResourceLocation& ResourceLocation)
+{
+	Allocator->MarkUsed(ResourceLocation);
+}
+
+TD3D12PixelResourceAllocator::TD3D12PixelResourceAllocator(ID3D12Device* InDevice)
+{
+	TD3D12SubAllocator::TAllocatorInitData InitData = TRenderTargetPolicy::MakeInitData();
+	InitData.PoolSize = 1024 * 1024 * 128;
+	InitData.MinBlockSize = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	InitData.Name = "Pixel";
+
+	Allocator = std::make_unique<TD3D12MultiBuddyAllocator<TRenderTargetPolicy>>(InDevice, InitData);
+
+	InitData.Name = "PixelTransient";
+	AliasingAllocator = std::make_unique<TD3D12AliasingAllocator>(InDevice, InitData);
+
+	D3DDevice = InDevice;
+}
+
+void TD3D12PixelResourceAllocator::AllocTextureResource(const D3D12_RESOURCE_STATES& ResourceState, const D3D12_RESOURCE_DESC& ResourceDesc, uint32_t Alignment, D3D12_CLEAR_VALUE ClearValue, TD3D12ResourceLocation& ResourceLocation)
+{
+	const D3D12_RESOURCE_ALLOCATION_INFO Info = D3DDevice->GetResourceAllocationInfo(0, 1, &ResourceDesc);
+
+	// placed resources need the device alignment (64KB, 4MB for MSAA), not the one of the texture data
+	const uint64_t PlacementAlignment = (std::max)((uint64_t)Alignment, Info.Alignment);
+	TraceAllocation(ResourceLocation, Info.SizeInBytes, PlacementAlignment, D3D12_HEAP_TYPE_DEFAULT, true);
+
+	if (Allocator->IsDedicated(Info.SizeInBytes))
+	{
+		Allocator->AllocDedicatedTexture(ResourceState, ResourceDesc, &ClearValue, ResourceLocation);
+		return;
+	}
+
+	// no pool could take it, fall back to a committed resource
+	if (!Allocator->AllocResource(Info.SizeInBytes, PlacementAlignment, ResourceLocation))
+	{
+		Allocator->AllocDedicatedTexture(ResourceState, ResourceDesc, &ClearValue, ResourceLocation);
+		return;
+	}
+
+	// create placed resource
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+
+		ID3D12Heap* BackingHeap = ResourceLocation.Allocator->GetBackingHeap();
+		uint64_t HeapOffset = ResourceLocation.OffsetFromBaseOfHeap;
+		D3DDevice->CreatePlacedResource(BackingHeap, HeapOffset, &ResourceDesc, ResourceState, &ClearValue, IID_PPV_ARGS(&Resource));
+
+		TD3D12Resource* NewResource = new TD3D12Resource(Resource);
+		ResourceLocation.UnderlyingResource = NewResource;
+		ResourceLocation.BlockData.PlacedResource = NewResource; // will delete Resource when ResourceLocation was destoryed
+	}
+}
+
+void TD3D12PixelResourceAllocator::CleanUpAllocations(uint64_t CompletedFenceValue)
+{
+	Allocator->CleanUpAllocations(CompletedFenceValue);
+	AliasingAllocator->CleanUpAllocations(CompletedFenceValue);
+}
+
+uint64_t TD3D12PixelResourceAllocator::Trim()
+{
+	return Allocator->Trim();
+}
+
+void TD3D12PixelResourceAllocator::GetStats(std::vector<TD3D12AllocatorStats>& OutStats)
+{
+	OutStats.emplace_back();
+	Allocator->GetStats(OutStats.back());
+
+	OutStats.emplace_back();
+	OutStats.back().Name = "PixelTransient";
+	AliasingAllocator->GetStats(OutStats.back());
+}
+
+void TD3D12PixelResourceAllocator::WriteJson(std::string& Json)
+{
+	AppendJsonSeparator(Json);
+	Allocator->WriteJson(Json);
+
+	// the transients overlap in the block map
+	TD3D12AllocatorStats Stats;
+	AliasingAllocator->GetStats(Stats);
+
+	Json += ",{\"name\":\"PixelTransient\",\"stats\":";
+	Stats.WriteJson(Json);
+	Json += ",\"pools\":[";
+	AliasingAllocator->WriteBlockMap(Json);
+	Json += "]}";
+}
+
+uint64_t TD3D12PixelResourceAllocator::Defragment(uint64_t ByteBudget, TD3D12CommandContext& CommandContext)
+{
+	return Allocator->Defragment(ByteBudget, CommandContext);
+}
+
+void TD3D12PixelResourceAllocator::DeclareTransient(const D3D12_RESOURCE_DESC& ResourceDesc, D3D12_CLEAR_VALUE ClearValue, uint32_t FirstPass, uint32_t LastPass, TD3D12ResourceLocation& ResourceLocation)
+{
+	AliasingAllocator->DeclareTransient(ResourceDesc, ClearValue, FirstPass, LastPass, ResourceLocation);
+}
+
+uint64_t TD3D12PixelResourceAllocator::CommitTransients()
+{
+	return AliasingAllocator->CommitTransients();
+}
+
+void TD3D12PixelResourceAllocator::AliasingBarriers(uint32_t Pass, TD3D12CommandContext& CommandContext)
+{
+	AliasingAllocator->AliasingBarriers(Pass, CommandContext);
+}
+
+void TD3D12TilePoolAllocator::TTileHeapStore::CreateHeap(uint32_t HeapIndex, uint64_t HeapSize)
+{
+	D3D12_HEAP_DESC Desc = {};
+	Desc.SizeInBytes = HeapSize;
+	Desc.Properties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	Desc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	Desc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES;
+
+	if (HeapIndex >= Heaps.size())
+	{
+		Heaps.resize(HeapIndex + 1);
+	}
+
+	ThrowIfFailed(D3DDevice->CreateHeap(&Desc, IID_PPV_ARGS(&Heaps[HeapIndex])));
+	Heaps[HeapIndex]->SetName(L"TD3D12TilePoolAllocator TileHeap");
+}
+
+void TD3D12TilePoolAllocator::TTileHeapStore::ReleaseHeap(uint32_t HeapIndex)
+{
+	Heaps[HeapIndex].Reset();
+}
+
+TD3D12TilePoolAllocator::TD3D12TilePoolAllocator(ID3D12Device* InDevice)
+	: D3DDevice(InDevice), Pool(TILE_POOL_HEAP_SIZE / D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES, InDevice)
+{
+}
+
+TD3D12TilePoolAllocator::~TD3D12TilePoolAllocator()
+{
+	CleanUpAllocations(UINT64_MAX);
+}
+
+void TD3D12TilePoolAllocator::CreateReservedTexture(const D3D12_RESOURCE_STATES& ResourceState, const D3D12_RESOURCE_DESC& ResourceDesc, TD3D12ReservedResource& ReservedResource)
+{
+	// the tiling is read per mip
+	assert(ResourceDesc.MipLevels != 0);
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+	ThrowIfFailed(D3DDevice->CreateReservedResource(&ResourceDesc, ResourceState, nullptr, IID_PPV_ARGS(&Resource)));
+
+	// tiling of the first array slice, the other slices are the same
+	UINT NumTiles = 0;
+	D3D12_PACKED_MIP_INFO PackedMipInfo = {};
+	D3D12_TILE_SHAPE TileShape = {};
+	UINT NumSubresourceTilings = ResourceDesc.MipLevels;
+	std::vector<D3D12_SUBRESOURCE_TILING> SubresourceTilings(NumSubresourceTilings);
+	D3DDevice->GetResourceTiling(Resource.Get(), &NumTiles, &PackedMipInfo, &TileShape, &NumSubresourceTilings, 0, SubresourceTilings.data());
+
+	TTiledTextureLayout Layout;
+	for (UINT Mip = 0; Mip < PackedMipInfo.NumStandardMips; ++Mip)
+	{
+		TTiledTextureLayout::TMip MipLayout;
+		MipLayout.WidthInTiles = SubresourceTilings[Mip].WidthInTiles;
+		MipLayout.HeightInTiles = SubresourceTilings[Mip].HeightInTiles;
+		MipLayout.DepthInTiles = SubresourceTilings[Mip].DepthInTiles;
+		Layout.StandardMips.push_back(MipLayout);
+	}
+	Layout.NumPackedMips = PackedMipInfo.NumPackedMips;
+	Layout.NumTilesForPackedMips = PackedMipInfo.NumTilesForPackedMips;
+	Layout.TileWidth = TileShape.WidthInTexels;
+	Layout.TileHeight = TileShape.HeightInTexels;
+	Layout.ArraySize = ResourceDesc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? 1 : ResourceDesc.DepthOrArraySize;
+
+	ReservedResource.Resource = new TD3D12Resource(Resource, ResourceState);
+	ReservedResource.TileMap = std::make_unique<TTiledTextureMap>(Layout);
+}
+
+void TD3D12TilePoolAllocator::ReleaseReservedTexture(TD3D12ReservedResource& ReservedResource)
+{
+	if (!ReservedResource.Resource)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	// the mappings go away with the resource, only the tiles have to be given back
+	std::vector<TTileUpdate> Updates;
+	std::vector<TTileLocation> FreedTiles;
+	ReservedResource.TileMap->DecommitAll(Updates, FreedTiles);
+	FreeTiles(FreedTiles);
+
+	DeferredResources.Enqueue(ReservedResource.Resource, TD3D12RHI::g_CommandContext.GetNextFenceValue());
+
+	ReservedResource.Resource = nullptr;
+	ReservedResource.TileMap.reset();
+}
+
+void TD3D12TilePoolAllocator::CommitRegion(TD3D12ReservedResource& ReservedResource, uint32_t Slice, uint32_t Mip, uint32_t X, uint32_t Y, uint32_t Width, uint32_t Height)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	std::vector<TTileUpdate> Updates;
+	ReservedResource.TileMap->CommitRegion(Pool, Slice, Mip, X, Y, Width, Height, Updates);
+
+	UpdateTileMappings(ReservedResource.Resource->D3DResource.Get(), Updates);
+}
+
+void TD3D12TilePoolAllocator::CommitMip(TD3D12ReservedResource& ReservedResource, uint32_t Mip)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	std::vector<TTileUpdate> Updates;
+	for (uint32_t Slice = 0; Slice < ReservedResource.TileMap->GetLayout().ArraySize; ++Slice)
+	{
+		ReservedResource.TileMap->CommitMip(Pool, Slice, Mip, Updates);
+	}
+
+	UpdateTileMappings(ReservedResource.Resource->D3DResource.Get(), Updates);
+}
+
+void TD3D12TilePoolAllocator::DecommitMip(TD3D12ReservedResource& ReservedResource, uint32_t Mip)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	std::vector<TTileUpdate> Updates;
+	std::vector<TTileLocation> FreedTiles;
+	for (uint32_t Slice = 0; Slice < ReservedResource.TileMap->GetLayout().ArraySize; ++Slice)
+	{
+		ReservedResource.TileMap->DecommitMip(Slice, Mip, Updates, FreedTiles);
+	}
+
+	UpdateTileMappings(ReservedResource.Resource->D3DResource.Get(), Updates);
+	FreeTiles(FreedTiles);
+}
+
+void TD3D12TilePoolAllocator::FreeTiles(const std::vector<TTileLocation>& Tiles)
+{
+	const uint64_t FenceValue = TD3D12RHI::g_CommandContext.GetNextFenceValue();
+
+	for (const TTileLocation& Tile : Tiles)
+	{
+		DeferredTiles.Enqueue(Tile, FenceValue);
+	}
+}
+
+void TD3D12TilePoolAllocator::UpdateTileMappings(ID3D12Resource* Resource, std::vector<TTileUpdate>& Updates)
+{
+	if (Updates.empty())
+	{
+		return;
+	}
+
+	// one call per heap, the unmaps (no heap) come last
+	std::sort(Updates.begin(), Updates.end(), [](const TTileUpdate& A, const TTileUpdate& B)
+	{
+		return A.Location.Heap < B.Location.Heap;
+	});
+
+	const D3D12_TILE_REGION_SIZE RegionSize = { 1, FALSE, 0, 0, 0 };
+
+	std::vector<D3D12_TILED_RESOURCE_COORDINATE> Coordinates;
+	std::vector<D3D12_TILE_REGION_SIZE> RegionSizes;
+	std::vector<D3D12_TILE_RANGE_FLAGS> RangeFlags;
+	std::vector<UINT> HeapRangeStartOffsets;
+	std::vector<UINT> RangeTileCounts;
+
+	for (size_t Begin = 0, End = 0; Begin < Updates.size(); Begin = End)
+	{
+		const uint32_t HeapIndex = Updates[Begin].Location.Heap;
+
+		Coordinates.clear();
+		RegionSizes.clear();
+		RangeFlags.clear();
+		HeapRangeStartOffsets.clear();
+		RangeTileCounts.clear();
+
+		for (End = Begin; End < Updates.size() && Updates[End].Location.Heap == HeapIndex; ++End)
+		{
+			const TTileUpdate& Update = Updates[End];
+			Coordinates.push_back({ Update.X, Update.Y, Update.Z, Update.Subresource });
+			RegionSizes.push_back(RegionSize);
+
+			RangeFlags.push_back(Update.Location.IsValid() ? D3D12_TILE_RANGE_FLAG_NONE : D3D12_TILE_RANGE_FLAG_NULL);
+			HeapRangeStartOffsets.push_back(Update.Location.Tile);
+			RangeTileCounts.push_back(1);
+		}
+
+		ID3D12Heap* Heap = HeapIndex != TTileLocation::INDEX_NONE ? Pool.GetBackingStore().GetHeap(HeapIndex) : nullptr;
+
+		TD3D12RHI::g_CommandContext.GetCommandQueue()->UpdateTileMappings(Resource, (UINT)Coordinates.size(), Coordinates.data(), RegionSizes.data(),
+			Heap, (UINT)RangeFlags.size(), RangeFlags.data(), HeapRangeStartOffsets.data(), RangeTileCounts.data(), D3D12_TILE_MAPPING_FLAG_NONE);
+	}
+}
+
+void TD3D12TilePoolAllocator::CleanUpAllocations(uint64_t CompletedFenceValue)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	DeferredTiles.Retire(CompletedFenceValue, [this](const TTileLocation& Tile)
+	{
+		Pool.Free(Tile);
+	});
+
+	DeferredResources.Retire(CompletedFenceValue, [](TD3D12Resource* Resource)
+	{
+		delete Resource;
+	});
+}
+
+uint64_t TD3D12TilePoolAllocator::Trim()
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	return Pool.Trim();
+}
+
+void TD3D12TilePoolAllocator::GetStats(std::vector<TD3D12AllocatorStats>& OutStats)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	OutStats.emplace_back();
+	TD3D12AllocatorStats& Stats = OutStats.back();
+
+	// a tile is a block of order 0
+	Stats.Name = "Tiles";
+	Stats.NumPools = Pool.GetNumHeaps();
+	Stats.NumAllocations = Pool.GetNumUsedTiles();
+	Stats.NumPendingFrees = (uint32_t)DeferredTiles.Num();
+	Stats.ReservedSize = Pool.GetPoolSize();
+	Stats.AllocatedSize = (uint64_t)Pool.GetNumUsedTiles() * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES;
+	Stats.RequestedSize = Stats.AllocatedSize;
+	Stats.NumFreeBlocks[0] = (uint32_t)((Stats.ReservedSize - Stats.AllocatedSize) / D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES);
+	Stats.LargestFreeBlock = Stats.NumFreeBlocks[0] != 0 ? D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES : 0;
+}
+
+void TD3D12TilePoolAllocator::WriteJson(std::string& Json)
+{
+	std::vector<TD3D12AllocatorStats> Stats;
+	GetStats(Stats);
+
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	AppendJsonSeparator(Json);
+	Json += "{\"name\":\"Tiles\",\"stats\":";
+	Stats[0].WriteJson(Json);
+	Json += ",\"pools\":[";
+
+	// tiles are not tracked by offset, only the fill of each heap
+	Pool.ForEachHeap([&](uint32_t HeapIndex, uint32_t NumUsedTiles)
+	{
+		char Buffer[128];
+		AppendJsonSeparator(Json);
+		sprintf_s(Buffer, "{\"size\":%llu,\"allocated\":%llu,\"blocks\":[],\"free\":[]}", Pool.GetHeapSize(), (uint64_t)NumUsedTiles * D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES);
+		Json += Buffer;
+	});
+
+	Json += "]}";
 }
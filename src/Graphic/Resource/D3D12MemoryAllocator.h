@@ -1,14 +1,83 @@
 #pragma once
 #include "D3D12Resource.h"
+#include "BuddyAllocator.h"
+#include "FencedDeletionQueue.h"
+#include "RingAllocator.h"
+#include "ReadbackRing.h"
+#include "BuddyDefragPlanner.h"
+#include "TLSFAllocator.h"
+#include "AliasingPlanner.h"
+#include "TilePool.h"
 #include <vector>
-#include <set>
+#include <unordered_set>
+#include <mutex>
+#include <string>
+
+class TD3D12CommandContext;
+class TD3D12ResidencyManager;
 
 #define DEFAULT_POOL_SIZE (1024 * 1024 * 512)
 
+#define DEFAULT_MIN_BLOCK_SIZE 256
+
 #define DEFAULT_RESOURCE_ALIGNMENT 4
 #define UPLOAD_RESOURCE_ALIGNMENT 256
 
-class TD3D12BuddyAllocator
+#define UPLOAD_RING_SIZE (1024 * 1024 * 4)
+
+// a few full screen captures in flight
+#define READBACK_RING_SIZE (1024 * 1024 * 32)
+
+#define DEFRAG_BYTES_PER_FRAME (1024 * 1024 * 8)
+
+// larger resources get a committed resource of their own, in a pool they would waste up to half of a large block
+#define DEDICATED_ALLOCATION_THRESHOLD (1024 * 1024 * 16)
+
+// small allocations are served from fixed size slots of slabs, one slab is a block of the buddy allocator
+#define SLAB_SIZE (1024 * 64)
+#define SLAB_MAX_SLOT_SIZE (1024 * 4)
+
+// threads are spread over this many independent sets of slabs
+#define SLAB_NUM_SHARDS 8
+
+// tile heaps of reserved textures, 1024 tiles of 64KB
+#define TILE_POOL_HEAP_SIZE (1024 * 1024 * 64)
+
+// live numbers of one allocator, summed over its pools
+struct TD3D12AllocatorStats
+{
+	const char* Name = "";
+
+	uint32_t NumPools = 0;
+
+	// blocks that are not recycled yet, the ones waiting for their fence included
+	uint32_t NumAllocations = 0;
+
+	uint32_t NumPendingFrees = 0;
+
+	// bytes of all pools
+	uint64_t ReservedSize = 0;
+
+	// bytes of all blocks, AllocatedSize - RequestedSize is lost to rounding and alignment padding
+	uint64_t AllocatedSize = 0;
+
+	uint64_t RequestedSize = 0;
+
+	// a lower bound for TLSF pools
+	uint64_t LargestFreeBlock = 0;
+
+	// free blocks by order in MinBlockSize units, a TLSF block is counted under the largest order it holds
+	uint32_t NumFreeBlocks[32] = {};
+
+	void WriteJson(std::string& Json) const;
+};
+
+// Threading: the block algorithm of a pool is only touched under the lock of its owner
+// (TD3D12MultiBuddyAllocator or a shard of TD3D12SlabAllocator), Deallocate may be called from any thread.
+// TD3D12UploadRingAllocator is lock free.
+
+// one pool of GPU memory: a heap for placed resources or a committed buffer, sub-allocated by buddy or TLSF
+class TD3D12SubAllocator
 {
 public:
 	enum class EAllocationStrategy
@@ -17,110 +86,664 @@ public:
 		ManualSubAllocation
 	};
 
+	// how blocks are carved out of the pool
+	enum class EAllocationAlgorithm
+	{
+		Buddy, // power of two blocks, pools can be defragmented
+		TLSF // arbitrary sizes, for buffers where the rounding of buddy wastes too much
+	};
+
 	struct TAllocatorInitData
 	{
 		EAllocationStrategy AllocatioStrategy;
 
+		const char* Name = ""; // shown in statistics
+
+		EAllocationAlgorithm Algorithm = EAllocationAlgorithm::Buddy;
+
 		D3D12_HEAP_TYPE HeapType; // default or upload heap
 
 		D3D12_HEAP_FLAGS HeapFlags = D3D12_HEAP_FLAG_NONE; // only for placed resource
 
 		D3D12_RESOURCE_FLAGS ResourceFlags = D3D12_RESOURCE_FLAG_NONE; // only for committed resource(ManualSubAllocation)
+
+		uint64_t PoolSize = DEFAULT_POOL_SIZE; // bytes reserved by one allocator
+
+		uint64_t MinBlockSize = DEFAULT_MIN_BLOCK_SIZE; // size of an order 0 block, the granularity of TLSF
+
+		uint32_t MaxOrder = 0; // order of the largest block, 0 means one block covering the pool. buddy only
+
+		uint32_t EmptyPoolReleaseDelay = 120; // frames an empty pool is kept before it is released, avoids recreating it on every spike
+
+		uint64_t DedicatedThreshold = DEDICATED_ALLOCATION_THRESHOLD; // see TD3D12DedicatedAllocator
+	};
+
+	// backing store policy of TBuddyAllocator: a heap for placed resources or a committed buffer for manual sub-allocation
+	class TBackingStore
+	{
+	public:
+		TBackingStore(ID3D12Device* InDevice, const TAllocatorInitData& InInitData);
+
+		~TBackingStore();
+
+		void Create(uint64_t PoolSize);
+
+	public:
+		ID3D12Device* D3DDevice;
+
+		TAllocatorInitData InitData;
+
+		TD3D12Resource* BackingResource = nullptr;
+
+		ID3D12Heap* BackingHeap = nullptr;
 	};
 
 public:
-	TD3D12BuddyAllocator(ID3D12Device* InDevice, const TAllocatorInitData& InInitData);
+	TD3D12SubAllocator(const TAllocatorInitData& InInitData);
 
-	~TD3D12BuddyAllocator();
+	virtual ~TD3D12SubAllocator();
 
-	bool AllocResource(uint32_t Size, uint32_t Alignment, TD3D12ResourceLocation& ResourceLocation);
+	virtual bool AllocResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation) = 0;
 
+	// the block is recycled once the GPU has passed the next fence signaled by the command context
 	void Deallocate(TD3D12ResourceLocation& ResourceLocation);
 
-	void CleanUpAllocations();
+	// recycle the deallocated blocks whose fence value has completed
+	void CleanUpAllocations(uint64_t CompletedFenceValue);
 
 	ID3D12Heap* GetBackingHeap() { return BackingHeap; }
 
+	// every request whose GetAllocationOrder is not above it fits, -1 when the pool is full
+	virtual int32_t GetLargestFreeOrder() const = 0;
+
+	static uint32_t GetAllocationOrder(uint64_t Size, uint64_t Alignment, uint64_t MinBlockSize)
+	{
+		return TBuddyAllocator<TBackingStore>::GetAllocationOrder(Size, Alignment, MinBlockSize);
+	}
+
 	EAllocationStrategy GetAllocationStrategy() { return InitData.AllocatioStrategy; }
 
+	virtual uint64_t GetPoolSize() const = 0;
+
+	virtual uint64_t GetTotalAllocSize() const = 0;
+
+	// no live block and nothing waiting for a fence
+	bool IsEmpty() const;
+
+	// adds this pool to Stats
+	void GetStats(TD3D12AllocatorStats& Stats) const;
+
+	// {"size", "allocated", "blocks": [[offset, size, requested size]...], "free": [[offset, size]...]}.
+	// blocks waiting for their fence are not listed
+	void WriteBlockMap(std::string& Json) const;
+
+	// not locked, only for defragmentation while no other thread releases resources of this pool
+	const std::unordered_set<TD3D12ResourceLocation*>& GetLiveLocations() const { return LiveLocations; }
+
+protected:
+	// give the block back to the algorithm
+	virtual void FreeBlock(const TD3D12BuddyBlockData& Block) = 0;
+
+	virtual uint64_t GetBlockSize(const TD3D12BuddyBlockData& Block) const = 0;
+
+	// NumFreeBlocks and LargestFreeBlock
+	virtual void GetFreeBlockStats(TD3D12AllocatorStats& Stats) const = 0;
+
+	// Func(Offset, Size) for every free block, offsets from the start of the pool
+	virtual void ForEachFreeBlock(const std::function<void(uint64_t, uint64_t)>& Func) const = 0;
+
+	// fill ResourceLocation with a block at AlignedOffset from the start of the pool, picks the pool kind from InitData
+	void AssignLocation(uint32_t Offset, uint32_t Order, uint64_t AlignedOffset, uint64_t Size, TD3D12ResourceLocation& ResourceLocation);
+
+	// same for a pool kind known at compile time, see TD3D12PoolPolicy
+	template<typename TPolicy>
+	void AssignPoolLocation(uint32_t Offset, uint32_t Order, uint64_t AlignedOffset, uint64_t Size, TD3D12ResourceLocation& ResourceLocation);
+
+private:
+	// the block of ResourceLocation is live from now on
+	void TrackLocation(uint64_t Size, TD3D12ResourceLocation& ResourceLocation);
+
+	void DeallocateInternal(const TD3D12BuddyBlockData& Block);
+
+protected:
+	TAllocatorInitData InitData;
+
+	// set by the derived allocator, the backing store is owned by it
+	TD3D12Resource* BackingResource = nullptr;
+
+	ID3D12Heap* BackingHeap = nullptr;
+
+	// start of the pool in BackingResource, a slab lives inside a block of another pool
+	uint64_t BackingOffset = 0;
+
 private:
-	void Initialize();
+	// guards DeferredDeletionQueue and LiveLocations, Deallocate comes from any thread
+	mutable std::mutex DeletionMutex;
+
+	TFencedDeletionQueue<TD3D12BuddyBlockData> DeferredDeletionQueue;
+
+	// locations that currently own a block, defragmentation patches them when it moves a block
+	std::unordered_set<TD3D12ResourceLocation*> LiveLocations;
+
+	// blocks until they are recycled and the bytes asked for them, for statistics
+	uint32_t NumBlocks = 0;
+
+	uint64_t RequestedSize = 0;
+};
+
+// Compile time pool kinds. The wrappers below always create the same kind of pool, the policy fixes what
+// TAllocatorInitData would decide at runtime, so the allocation path has no branch on it.
+// InitData keeps the same values for creating the backing store and for statistics
+template<D3D12_HEAP_TYPE InHeapType, TD3D12SubAllocator::EAllocationStrategy InStrategy, D3D12_HEAP_FLAGS InHeapFlags>
+struct TD3D12PoolPolicy
+{
+	static constexpr D3D12_HEAP_TYPE HeapType = InHeapType;
+
+	static constexpr TD3D12SubAllocator::EAllocationStrategy Strategy = InStrategy;
+
+	static constexpr D3D12_HEAP_FLAGS HeapFlags = InHeapFlags;
+
+	static constexpr bool bPlaced = InStrategy == TD3D12SubAllocator::EAllocationStrategy::PlacedResource;
+
+	// pool settings and name are up to the caller
+	static TD3D12SubAllocator::TAllocatorInitData MakeInitData()
+	{
+		TD3D12SubAllocator::TAllocatorInitData InitData;
+		InitData.AllocatioStrategy = Strategy;
+		InitData.HeapType = HeapType;
+		InitData.HeapFlags = HeapFlags;
+
+		return InitData;
+	}
+};
+
+// UploadBuffer状态一致，可以共用一个Resource，逻辑上进行不同区域的划分
+typedef TD3D12PoolPolicy<D3D12_HEAP_TYPE_UPLOAD, TD3D12SubAllocator::EAllocationStrategy::ManualSubAllocation, D3D12_HEAP_FLAG_NONE> TUploadBufferPolicy;
+
+typedef TD3D12PoolPolicy<D3D12_HEAP_TYPE_DEFAULT, TD3D12SubAllocator::EAllocationStrategy::ManualSubAllocation, D3D12_HEAP_FLAG_NONE> TDefaultBufferPolicy;
+
+// placed resource : differents states for different resources
+typedef TD3D12PoolPolicy<D3D12_HEAP_TYPE_DEFAULT, TD3D12SubAllocator::EAllocationStrategy::PlacedResource, D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES> TTexturePolicy;
+
+typedef TD3D12PoolPolicy<D3D12_HEAP_TYPE_DEFAULT, TD3D12SubAllocator::EAllocationStrategy::PlacedResource, D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES> TRenderTargetPolicy;
+
+template<typename TPolicy>
+inline void TD3D12SubAllocator::AssignPoolLocation(uint32_t Offset, uint32_t Order, uint64_t AlignedOffset, uint64_t Size, TD3D12ResourceLocation& ResourceLocation)
+{
+	assert(InitData.AllocatioStrategy == TPolicy::Strategy);
+
+	const uint64_t AlignedOffsetFromResourceBase = BackingOffset + AlignedOffset;
+
+	// save allocation info to ResourceLocation
+	ResourceLocation.SetType(TD3D12ResourceLocation::EResourceLocationType::SubAllocation);
+	ResourceLocation.BlockData.Order = Order;
+	ResourceLocation.BlockData.Offset = Offset;
+	ResourceLocation.BlockData.ActualUsedSize = Size;
+	ResourceLocation.Allocator = this;
 
-	uint32_t AllocateBlock(uint32_t Order);
+	if constexpr (TPolicy::bPlaced)
+	{
+		// Place Resource are initialized by caller
+		ResourceLocation.OffsetFromBaseOfHeap = AlignedOffsetFromResourceBase;
+	}
+	else
+	{
+		// 手动划分，计算GPUVirtualAddress for default buffer
+		ResourceLocation.UnderlyingResource = BackingResource;
+		ResourceLocation.OffsetFromBaseOfResource = AlignedOffsetFromResourceBase;
+		ResourceLocation.GPUVirtualAddress = BackingResource->GPUVirtualAddress + AlignedOffsetFromResourceBase;
+
+		// 计算MappedAddress for upload buffer
+		if constexpr (TPolicy::HeapType == D3D12_HEAP_TYPE_UPLOAD)
+		{
+			ResourceLocation.MappedAddress = ((uint8_t*)BackingResource->MappedBaseAddress + AlignedOffsetFromResourceBase);
+		}
+	}
+
+	TrackLocation(Size, ResourceLocation);
+}
+
+class TD3D12BuddyAllocator : public TD3D12SubAllocator
+{
+public:
+	TD3D12BuddyAllocator(ID3D12Device* InDevice, const TAllocatorInitData& InInitData);
+
+	~TD3D12BuddyAllocator();
 
-	uint32_t GetSizeToAllocate(uint32_t Size, uint32_t Alignment);
+	bool AllocResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation) override;
 
-	bool CanAllocate(uint32_t SizeToAllocate);
+	// fill ResourceLocation from a block allocated directly on the buddy, used by defragmentation
+	void AssignAllocation(const TBuddyAllocation& Allocation, uint64_t Size, TD3D12ResourceLocation& ResourceLocation);
 
-	uint32_t SizeToUnitSize(uint32_t Size) const
+	int32_t GetLargestFreeOrder() const override { return Buddy.GetLargestFreeOrder(); }
+
+	uint64_t GetPoolSize() const override { return Buddy.GetPoolSize(); }
+
+	uint64_t GetTotalAllocSize() const override { return Buddy.GetTotalAllocSize(); }
+
+	TBuddyAllocator<TBackingStore>& GetBuddy() { return Buddy; }
+
+protected:
+	void FreeBlock(const TD3D12BuddyBlockData& Block) override;
+
+	uint64_t GetBlockSize(const TD3D12BuddyBlockData& Block) const override;
+
+	void GetFreeBlockStats(TD3D12AllocatorStats& Stats) const override;
+
+	void ForEachFreeBlock(const std::function<void(uint64_t, uint64_t)>& Func) const override;
+
+private:
+	TBuddyAllocator<TBackingStore> Buddy;
+};
+
+// a buddy pool of one kind. AllocPoolResource is inlined into the caller, a pointer to the pool binds the calls at compile time
+template<typename TPolicy>
+class TD3D12BuddyPool final : public TD3D12BuddyAllocator
+{
+public:
+	TD3D12BuddyPool(ID3D12Device* InDevice, const TAllocatorInitData& InInitData)
+		: TD3D12BuddyAllocator(InDevice, InInitData)
 	{
-		return (Size + (MinBlockSize - 1)) / MinBlockSize;
 	}
 
-	uint32_t UnitSizeToOrder(uint32_t Size)  const
+	bool AllocPoolResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation)
 	{
-		unsigned long Result;
-		_BitScanReverse(&Result, Size + Size - 1);// ceil(log2(Size))
-		return Result;
+		TBuddyAllocation Allocation;
+
+		if (!GetBuddy().Allocate(Size, Alignment, Allocation))
+		{
+			return false;
+		}
+
+		AssignPoolLocation<TPolicy>(Allocation.Offset, Allocation.Order, Allocation.AlignedOffset, Size, ResourceLocation);
+
+		return true;
 	}
 
-	uint32_t OrderToUnitSize(uint32_t Order) const
+	bool AllocResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation) override
 	{
-		return ((uint32_t)1) << Order;
+		return AllocPoolResource(Size, Alignment, ResourceLocation);
 	}
+};
 
-	void DeallocateInternal(const TD3D12BuddyBlockData& Block);
+// two-level segregated fit, blocks are only rounded up to MinBlockSize
+class TD3D12TLSFAllocator : public TD3D12SubAllocator
+{
+public:
+	TD3D12TLSFAllocator(ID3D12Device* InDevice, const TAllocatorInitData& InInitData);
+
+	~TD3D12TLSFAllocator();
+
+	bool AllocResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation) override;
+
+	int32_t GetLargestFreeOrder() const override;
+
+	uint64_t GetPoolSize() const override { return TLSF.GetPoolSize(); }
 
-	void DeallocateBlock(uint32_t Offset, uint32_t Order);
+	uint64_t GetTotalAllocSize() const override { return TLSF.GetTotalAllocSize(); }
 
-	uint32_t GetBuddyOffset(const uint32_t& Offset, const uint32_t& Size)
+protected:
+	void FreeBlock(const TD3D12BuddyBlockData& Block) override;
+
+	uint64_t GetBlockSize(const TD3D12BuddyBlockData& Block) const override;
+
+	void GetFreeBlockStats(TD3D12AllocatorStats& Stats) const override;
+
+	void ForEachFreeBlock(const std::function<void(uint64_t, uint64_t)>& Func) const override;
+
+private:
+	TBackingStore BackingStore;
+
+protected:
+	TTLSFAllocator TLSF;
+};
+
+// TLSF counterpart of TD3D12BuddyPool
+template<typename TPolicy>
+class TD3D12TLSFPool final : public TD3D12TLSFAllocator
+{
+public:
+	TD3D12TLSFPool(ID3D12Device* InDevice, const TAllocatorInitData& InInitData)
+		: TD3D12TLSFAllocator(InDevice, InInitData)
 	{
-		return Offset ^ Size;
 	}
 
-	uint32_t GetAllocOffsetInBytes(uint32_t Offset) const 
-	{ 
-		return Offset * MinBlockSize; 
+	bool AllocPoolResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation)
+	{
+		TTLSFAllocator::TAllocation Allocation;
+
+		if (!TLSF.Allocate(Size, Alignment, Allocation))
+		{
+			return false;
+		}
+
+		AssignPoolLocation<TPolicy>(Allocation.Block, 0, Allocation.AlignedOffset, Size, ResourceLocation);
+
+		return true;
+	}
+
+	bool AllocResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation) override
+	{
+		return AllocPoolResource(Size, Alignment, ResourceLocation);
 	}
+};
+
+// no pool: every allocation is a committed resource of its own, the location is StandAlone.
+// the resource is released by fence like a placed resource, InitData.AllocatioStrategy is ignored
+class TD3D12DedicatedAllocator : public TD3D12SubAllocator
+{
+public:
+	TD3D12DedicatedAllocator(ID3D12Device* InDevice, const TAllocatorInitData& InInitData);
+
+	~TD3D12DedicatedAllocator();
+
+	// a buffer in InitData.HeapType, mapped for upload heaps. committed resources are 64KB aligned
+	bool AllocResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation) override;
+
+	// ClearValue may be null
+	void AllocTextureResource(const D3D12_RESOURCE_STATES& ResourceState, const D3D12_RESOURCE_DESC& ResourceDesc, const D3D12_CLEAR_VALUE* ClearValue, TD3D12ResourceLocation& ResourceLocation);
+
+	int32_t GetLargestFreeOrder() const override { return -1; }
+
+	// the live committed resources
+	uint64_t GetPoolSize() const override { return CommittedSize; }
+
+	uint64_t GetTotalAllocSize() const override { return CommittedSize; }
+
+protected:
+	void FreeBlock(const TD3D12BuddyBlockData& Block) override;
+
+	uint64_t GetBlockSize(const TD3D12BuddyBlockData& Block) const override;
+
+	void GetFreeBlockStats(TD3D12AllocatorStats& Stats) const override {}
+
+	void ForEachFreeBlock(const std::function<void(uint64_t, uint64_t)>& Func) const override {}
 
 private:
-	TAllocatorInitData InitData;
+	void AssignResource(TD3D12Resource* Resource, uint64_t Size, TD3D12ResourceLocation& ResourceLocation);
+
+private:
+	ID3D12Device* D3DDevice;
+
+	uint64_t CommittedSize = 0;
+};
+
+// one heap shared by transient render targets and depth buffers that are never live in the same pass,
+// placed by TAliasingPlanner. Transients are declared first, CommitTransients creates the heap and the resources.
+// the locations are SubAllocations of this allocator, releasing them is fenced as usual
+class TD3D12AliasingAllocator : public TD3D12SubAllocator
+{
+public:
+	TD3D12AliasingAllocator(ID3D12Device* InDevice, const TAllocatorInitData& InInitData);
+
+	~TD3D12AliasingAllocator();
+
+	// transients only come through DeclareTransient
+	bool AllocResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation) override { return false; }
+
+	// the location gets its resource in CommitTransients, it has to stay where it is until then
+	void DeclareTransient(const D3D12_RESOURCE_DESC& ResourceDesc, const D3D12_CLEAR_VALUE& ClearValue, uint32_t FirstPass, uint32_t LastPass, TD3D12ResourceLocation& ResourceLocation);
+
+	// place the declared transients and create them, returns the heap size.
+	// the transients of the previous commit must have been released and retired
+	uint64_t CommitTransients();
+
+	// aliasing barriers for the transients whose first pass is Pass, record them before the pass
+	void AliasingBarriers(uint32_t Pass, TD3D12CommandContext& CommandContext);
+
+	int32_t GetLargestFreeOrder() const override { return -1; }
 
-	const uint32_t MinBlockSize = 256;
+	uint64_t GetPoolSize() const override { return HeapSize; }
 
-	uint32_t MaxOrder;
+	// the whole heap while any transient is alive, the transients overlap
+	uint64_t GetTotalAllocSize() const override { return NumLiveTransients != 0 ? HeapSize : 0; }
 
-	uint32_t TotalAllocSize = 0;
+protected:
+	void FreeBlock(const TD3D12BuddyBlockData& Block) override;
 
-	std::vector<std::set<uint32_t>> FreeBlocks;
+	uint64_t GetBlockSize(const TD3D12BuddyBlockData& Block) const override { return Block.ActualUsedSize; }
 
-	std::vector<TD3D12BuddyBlockData> DeferredDeletionQueue;
+	void GetFreeBlockStats(TD3D12AllocatorStats& Stats) const override {}
+
+	void ForEachFreeBlock(const std::function<void(uint64_t, uint64_t)>& Func) const override {}
+
+private:
+	struct TTransient
+	{
+		D3D12_RESOURCE_DESC ResourceDesc;
+
+		D3D12_CLEAR_VALUE ClearValue;
+
+		// only valid until the commit
+		TD3D12ResourceLocation* Location;
+
+		// set by the commit, cleared once the transient is retired
+		TD3D12Resource* Resource;
+
+		TAliasingResource Range;
+	};
 
 	ID3D12Device* D3DDevice;
 
-	TD3D12Resource* BackingResource = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Heap> Heap;
 
-	ID3D12Heap* BackingHeap = nullptr;
+	uint64_t HeapSize = 0;
+
+	// declared since the last commit
+	std::vector<TTransient> Declared;
+
+	// BlockData.Offset of a committed transient is its index here
+	std::vector<TTransient> Committed;
+
+	// the transient that used the memory before, see TAliasingPlan
+	std::vector<int32_t> Predecessors;
+
+	uint32_t NumLiveTransients = 0;
 };
 
+// pools of one kind, small and large requests are kept in separate pools so small blocks don't pin large pools.
+// TPolicy is the kind, instantiated in D3D12MemoryAllocator.cpp for the four policies above
+template<typename TPolicy>
 class TD3D12MultiBuddyAllocator
 {
 public:
-	TD3D12MultiBuddyAllocator(ID3D12Device* InDevice, const TD3D12BuddyAllocator::TAllocatorInitData& InInitData);
+	TD3D12MultiBuddyAllocator(ID3D12Device* InDevice, const TD3D12SubAllocator::TAllocatorInitData& InInitData);
 
 	~TD3D12MultiBuddyAllocator();
 
-	bool AllocResource(uint32_t Size, uint32_t Alignment, TD3D12ResourceLocation& ResourceLocation);
+	// buffers above InitData.DedicatedThreshold get a dedicated committed resource, so do buffers no pool can take.
+	// false only for placed resources that fit no pool, the caller then creates a committed resource
+	bool AllocResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation);
+
+	// placed resources are created by the caller, it asks here whether a texture should skip the pools
+	bool IsDedicated(uint64_t Size) const { return Size > InitData.DedicatedThreshold; }
+
+	void AllocDedicatedTexture(const D3D12_RESOURCE_STATES& ResourceState, const D3D12_RESOURCE_DESC& ResourceDesc, const D3D12_CLEAR_VALUE* ClearValue, TD3D12ResourceLocation& ResourceLocation);
+
+	// also releases the pools that stayed empty for EmptyPoolReleaseDelay calls
+	void CleanUpAllocations(uint64_t CompletedFenceValue);
+
+	// release every empty pool now, returns the number of bytes given back
+	uint64_t Trim();
+
+	void GetStats(TD3D12AllocatorStats& Stats);
+
+	// {"name", "stats", "pools": [block map of every pool]}
+	void WriteJson(std::string& Json);
+
+	// move placed resources out of the least used pool, copies are recorded on CommandContext. buddy pools only.
+	// returns the number of bytes moved
+	uint64_t Defragment(uint64_t ByteBudget, TD3D12CommandContext& CommandContext);
+
+	// the heaps of the pools are registered with it from now on, placed resources only.
+	// call before the first allocation
+	void SetResidencyManager(TD3D12ResidencyManager* InResidencyManager) { ResidencyManager = InResidencyManager; }
 
-	void CleanUpAllocations();
+	// the GPU uses the resource in the current frame
+	void MarkUsed(TD3D12ResourceLocation& ResourceLocation);
 
 private:
+	struct TPoolSet
+	{
+		// a released pool leaves a null slot, it is reused by the next new pool
+		std::vector<std::unique_ptr<TD3D12SubAllocator>> Allocators;
+
+		// number of CleanUpAllocations calls the pool has been empty for
+		std::vector<uint32_t> IdleFrames;
+
+		std::vector<uint32_t> FreeSlots;
+
+		// slot i is Allocators[i]
+		TBuddyPoolIndex Index;
+	};
+
+	TPoolSet& GetPoolSet(uint64_t Size) { return Size <= SmallAllocationThreshold ? SmallPools : LargePools; }
+
+	uint32_t CreatePool(TPoolSet& PoolSet, const TD3D12SubAllocator::TAllocatorInitData& PoolInitData);
+
+	// init data of a new pool that can hold the request
+	TD3D12SubAllocator::TAllocatorInitData MakePoolInitData(uint64_t Size, uint64_t Alignment) const;
+
+	// false when the pool in Slot can't serve the request
+	bool AllocFromSlot(TPoolSet& PoolSet, uint32_t Slot, uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation);
+
+	// TPool is the pool class of InitData.Algorithm
+	template<typename TPool>
+	bool AllocFromPool(TPool* Pool, TPoolSet& PoolSet, uint32_t Slot, uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation);
+
+	uint64_t ReleasePool(TPoolSet& PoolSet, uint32_t Slot);
+
+	void CleanUpAllocations(TPoolSet& PoolSet, uint64_t CompletedFenceValue);
 
-	std::vector<std::shared_ptr<TD3D12BuddyAllocator>> Allocators;
+	uint64_t Trim(TPoolSet& PoolSet);
+
+	uint64_t Defragment(TPoolSet& PoolSet, uint64_t ByteBudget, TD3D12CommandContext& CommandContext);
+
+	bool Relocate(TD3D12ResourceLocation& ResourceLocation, TD3D12BuddyAllocator* DstAllocator, const TBuddyAllocation& Dst, TD3D12CommandContext& CommandContext);
+
+private:
+
+	TPoolSet SmallPools;
+
+	TPoolSet LargePools;
+
+	std::unique_ptr<TD3D12DedicatedAllocator> DedicatedAllocator;
+
+	// requests up to this size go to the small pools
+	uint64_t SmallAllocationThreshold = 0;
 
 	ID3D12Device* Device;
 
-	TD3D12BuddyAllocator::TAllocatorInitData InitData;
+	TD3D12SubAllocator::TAllocatorInitData InitData;
+
+	TD3D12ResidencyManager* ResidencyManager = nullptr;
+
+	// one global lock, the slab shards in front of it take most of the small requests
+	std::mutex Mutex;
+};
+
+// a block of a buddy pool cut into fixed size slots, slot i starts at i * SlotSize. slabs only serve upload buffers
+class TD3D12Slab final : public TD3D12SubAllocator
+{
+public:
+	TD3D12Slab(TD3D12MultiBuddyAllocator<TUploadBufferPolicy>& Parent, const TAllocatorInitData& InInitData, uint64_t InSlotSize);
+
+	~TD3D12Slab();
+
+	bool AllocResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation) override;
+
+	int32_t GetLargestFreeOrder() const override { return FreeSlots.Empty() ? -1 : (int32_t)GetAllocationOrder(SlotSize, 0, InitData.MinBlockSize); }
+
+	uint64_t GetPoolSize() const override { return SLAB_SIZE; }
+
+	uint64_t GetTotalAllocSize() const override { return NumUsedSlots * SlotSize; }
+
+	bool IsFull() const { return FreeSlots.Empty(); }
+
+public:
+	static const uint32_t INDEX_NONE = UINT32_MAX;
+
+	// position in the partial list of the size class, INDEX_NONE when the slab is full
+	uint32_t PartialIndex = INDEX_NONE;
+
+protected:
+	void FreeBlock(const TD3D12BuddyBlockData& Block) override;
+
+	uint64_t GetBlockSize(const TD3D12BuddyBlockData& Block) const override;
+
+	void GetFreeBlockStats(TD3D12AllocatorStats& Stats) const override;
+
+	void ForEachFreeBlock(const std::function<void(uint64_t, uint64_t)>& Func) const override;
+
+private:
+	// the slab memory, given back to the buddy pool when the slab is destroyed
+	TD3D12ResourceLocation SlabLocation;
+
+	TFreeBlockBitmap FreeSlots;
+
+	const uint64_t SlotSize;
+
+	uint32_t NumUsedSlots = 0;
+};
+
+// slabs for requests up to SLAB_MAX_SLOT_SIZE, one size class per power of two from MinBlockSize.
+// a slot is found in constant time and doesn't walk the buddy orders, empty slabs go back to the buddy pools.
+// each thread allocates from its own shard, so loader threads only meet on the buddy lock when a new slab is needed
+class TD3D12SlabAllocator
+{
+public:
+	TD3D12SlabAllocator(TD3D12MultiBuddyAllocator<TUploadBufferPolicy>& InParent, const TD3D12SubAllocator::TAllocatorInitData& InInitData);
+
+	~TD3D12SlabAllocator();
+
+	// false when the request is too large for a slot, the caller uses the buddy allocator
+	bool AllocResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation);
+
+	// keeps one empty slab per size class so a class doesn't create and release a slab every frame
+	void CleanUpAllocations(uint64_t CompletedFenceValue);
+
+	// release every empty slab now. no memory is given back yet: the slab blocks reach their buddy pools
+	// after the next fence, the pools are released by a later Trim or once they have been idle
+	void Trim();
+
+	// slabs count as pools, their memory is also part of the buddy pools they come from
+	void GetStats(TD3D12AllocatorStats& Stats);
+
+	void WriteJson(std::string& Json);
+
+private:
+	struct TSizeClass
+	{
+		std::vector<std::unique_ptr<TD3D12Slab>> Slabs;
+
+		// slabs with a free slot
+		std::vector<TD3D12Slab*> PartialSlabs;
+	};
+
+	struct TShard
+	{
+		std::mutex Mutex;
+
+		std::vector<TSizeClass> SizeClasses;
+	};
+
+	// shard of the calling thread
+	TShard& GetShard();
+
+	void CleanUpAllocations(TSizeClass& SizeClass, uint64_t CompletedFenceValue);
+
+	void AddPartial(TSizeClass& SizeClass, TD3D12Slab* Slab);
+
+	void RemovePartial(TSizeClass& SizeClass, TD3D12Slab* Slab);
+
+	void ReleaseSlab(TSizeClass& SizeClass, uint32_t Index);
+
+private:
+	TShard Shards[SLAB_NUM_SHARDS];
+
+	TD3D12MultiBuddyAllocator<TUploadBufferPolicy>& Parent;
+
+	TD3D12SubAllocator::TAllocatorInitData InitData;
 };
 
 class TD3D12UploadBufferAllocator
@@ -128,12 +751,114 @@ class TD3D12UploadBufferAllocator
 public:
 	TD3D12UploadBufferAllocator(ID3D12Device* InDevice);
 
+	// a slab slot, a pool block or a committed buffer, in that order. the location is always filled, throws when all fail
+	void* AllocUploadResource(uint64_t Size, uint64_t Alignment, TD3D12ResourceLocation& ResourceLocation);
+
+	void CleanUpAllocations(uint64_t CompletedFenceValue);
+
+	uint64_t Trim();
+
+	// appends one entry per underlying allocator
+	void GetStats(std::vector<TD3D12AllocatorStats>& OutStats);
+
+	// appends comma separated {"name", "stats", "pools"} objects
+	void WriteJson(std::string& Json);
+
+private:
+	std::unique_ptr<TD3D12MultiBuddyAllocator<TUploadBufferPolicy>> Allocator = nullptr;
+
+	// in front of Allocator for small buffers, constant buffers mostly. destroyed first, its slabs live in Allocator
+	std::unique_ptr<TD3D12SlabAllocator> SlabAllocator = nullptr;
+
+	ID3D12Device* D3DDevice = nullptr;
+};
+
+// transient upload memory that only lives for one frame, e.g. per-frame constant buffers
+// the memory is reclaimed by fence, ReleaseResource of the location doesn't need to do anything
+class TD3D12UploadRingAllocator
+{
+public:
+	TD3D12UploadRingAllocator(ID3D12Device* InDevice, uint32_t Size = UPLOAD_RING_SIZE);
+
+	~TD3D12UploadRingAllocator();
+
+	// returns nullptr when the ring is full
 	void* AllocUploadResource(uint32_t Size, uint32_t Alignment, TD3D12ResourceLocation& ResourceLocation);
 
-	void CleanUpAllocations();
+	// allocations made since the last call are reclaimed once FenceValue completes
+	void FinishFrame(uint64_t FenceValue);
+
+	void CleanUpAllocations(uint64_t CompletedFenceValue);
+
+	void GetStats(std::vector<TD3D12AllocatorStats>& OutStats);
+
+	void WriteJson(std::string& Json);
+
+private:
+	TRingAllocator Ring;
+
+	TD3D12Resource* BackingResource = nullptr;
+
+	ID3D12Device* D3DDevice = nullptr;
+};
+
+// what a readback hands to its callback, Data is only valid during the call
+struct TD3D12ReadbackData
+{
+	const void* Data = nullptr;
+
+	uint64_t Size = 0;
+
+	// texture rows are D3D12_TEXTURE_DATA_PITCH_ALIGNMENT aligned, 0 for buffers and queries
+	uint32_t RowPitch = 0;
+
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+
+	DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+};
+
+typedef TReadbackRing<TD3D12ReadbackData>::TCallback TD3D12ReadbackCallback;
+
+// GPU to CPU copies without waiting for the GPU. The copy is recorded into a ring in a readback heap,
+// the callback runs in CleanUpAllocations once the fence of the frame has completed, usually a frame or two later.
+// the space is reclaimed by fence like TD3D12UploadRingAllocator, after the callbacks have read it (see TReadbackRing).
+// render thread only, the copies are recorded on its command list
+class TD3D12ReadbackAllocator
+{
+public:
+	TD3D12ReadbackAllocator(ID3D12Device* InDevice, uint32_t Size = READBACK_RING_SIZE);
+
+	~TD3D12ReadbackAllocator();
+
+	// one subresource of a texture or a whole buffer, transitioned to COPY_SOURCE for the copy and back.
+	// returns false when the ring is full, try again next frame
+	bool Readback(TD3D12Resource* Resource, uint32_t Subresource, TD3D12ReadbackCallback Callback, TD3D12CommandContext& CommandContext);
+
+	// Size bytes of a sub-allocated buffer, pools stay in COMMON and the copy promotes them
+	bool ReadbackBuffer(const TD3D12ResourceLocation& ResourceLocation, uint64_t Size, TD3D12ReadbackCallback Callback, TD3D12CommandContext& CommandContext);
+
+	// resolve NumQueries results from StartIndex, one uint64_t per timestamp or occlusion query
+	bool ReadbackQueries(ID3D12QueryHeap* QueryHeap, D3D12_QUERY_TYPE Type, uint32_t StartIndex, uint32_t NumQueries, TD3D12ReadbackCallback Callback, TD3D12CommandContext& CommandContext);
+
+	// copies recorded since the last call complete with FenceValue
+	void FinishFrame(uint64_t FenceValue);
+
+	// run the callbacks of the completed copies, then reclaim their space.
+	// the command list is closed here, a callback can't record another readback
+	void CleanUpAllocations(uint64_t CompletedFenceValue);
+
+	void GetStats(std::vector<TD3D12AllocatorStats>& OutStats);
+
+	void WriteJson(std::string& Json);
 
 private:
-	std::unique_ptr<TD3D12MultiBuddyAllocator> Allocator = nullptr;
+	void Enqueue(uint64_t Offset, const TD3D12ReadbackData& Data, TD3D12ReadbackCallback&& Callback, TD3D12CommandContext& CommandContext);
+
+private:
+	TReadbackRing<TD3D12ReadbackData> Ring;
+
+	TD3D12Resource* BackingResource = nullptr;
 
 	ID3D12Device* D3DDevice = nullptr;
 };
@@ -141,16 +866,23 @@ private:
 class TD3D12DefaultBufferAllocator
 {
 public:
-	TD3D12DefaultBufferAllocator(ID3D12Device* InDevice);
+	// vertex and index buffers have arbitrary sizes, TLSF keeps them from being rounded up to a power of two
+	TD3D12DefaultBufferAllocator(ID3D12Device* InDevice, TD3D12SubAllocator::EAllocationAlgorithm Algorithm = TD3D12SubAllocator::EAllocationAlgorithm::TLSF);
 
 	void AllocDefaultResource(const D3D12_RESOURCE_DESC& REsourceDesc, uint32_t Alignment, TD3D12ResourceLocation& ResourceLocation);
 
-	void CleanUpAllocations();
+	void CleanUpAllocations(uint64_t CompletedFenceValue);
+
+	uint64_t Trim();
+
+	void GetStats(std::vector<TD3D12AllocatorStats>& OutStats);
+
+	void WriteJson(std::string& Json);
 
 private:
 
-	std::unique_ptr<TD3D12MultiBuddyAllocator> Allocator = nullptr;
-	std::unique_ptr<TD3D12MultiBuddyAllocator> UavAllocator = nullptr;
+	std::unique_ptr<TD3D12MultiBuddyAllocator<TDefaultBufferPolicy>> Allocator = nullptr;
+	std::unique_ptr<TD3D12MultiBuddyAllocator<TDefaultBufferPolicy>> UavAllocator = nullptr;
 
 	ID3D12Device* D3DDevice = nullptr;
 };
@@ -162,10 +894,27 @@ public:
 
 	void AllocTextureResource(const D3D12_RESOURCE_STATES& ResourceState, const D3D12_RESOURCE_DESC& ResourceDesc, uint32_t Alignment, D3D12_CLEAR_VALUE ClearValue, TD3D12ResourceLocation& ResourceLocation);
 
-	void CleanUpAllocations();
+	void CleanUpAllocations(uint64_t CompletedFenceValue);
+
+	uint64_t Trim();
+
+	void GetStats(std::vector<TD3D12AllocatorStats>& OutStats);
+
+	void WriteJson(std::string& Json);
+
+	uint64_t Defragment(uint64_t ByteBudget, TD3D12CommandContext& CommandContext);
+
+	// aliasing mode for transient render targets, see TD3D12AliasingAllocator
+	void DeclareTransient(const D3D12_RESOURCE_DESC& ResourceDesc, D3D12_CLEAR_VALUE ClearValue, uint32_t FirstPass, uint32_t LastPass, TD3D12ResourceLocation& ResourceLocation);
+
+	uint64_t CommitTransients();
+
+	void AliasingBarriers(uint32_t Pass, TD3D12CommandContext& CommandContext);
 
 private:
-	std::unique_ptr<TD3D12MultiBuddyAllocator> Allocator = nullptr;
+	std::unique_ptr<TD3D12MultiBuddyAllocator<TRenderTargetPolicy>> Allocator = nullptr;
+
+	std::unique_ptr<TD3D12AliasingAllocator> AliasingAllocator = nullptr;
 
 	ID3D12Device* D3DDevice = nullptr;
 };
@@ -173,14 +922,103 @@ private:
 class TD3D12TextureResourceAllocator
 {
 public:
-	TD3D12TextureResourceAllocator(ID3D12Device* InDevice);
+	// the pool heaps are evicted by ResidencyManager when the video memory budget is exceeded
+	TD3D12TextureResourceAllocator(ID3D12Device* InDevice, TD3D12ResidencyManager* ResidencyManager = nullptr);
 
 	void AllocTextureResource(const D3D12_RESOURCE_STATES& ResourceState, const D3D12_RESOURCE_DESC& ResourceDesc, uint32_t Alignment, TD3D12ResourceLocation& ResourceLocation);
 
-	void CleanUpAllocations();
+	void CleanUpAllocations(uint64_t CompletedFenceValue);
+
+	uint64_t Trim();
+
+	void GetStats(std::vector<TD3D12AllocatorStats>& OutStats);
+
+	void WriteJson(std::string& Json);
+
+	uint64_t Defragment(uint64_t ByteBudget, TD3D12CommandContext& CommandContext);
+
+	// call for the textures a frame reads, a pool that was evicted is made resident again
+	void MarkUsed(TD3D12ResourceLocation& ResourceLocation);
 
 private:
-	std::unique_ptr<TD3D12MultiBuddyAllocator> Allocator = nullptr;
+	std::unique_ptr<TD3D12MultiBuddyAllocator<TTexturePolicy>> Allocator = nullptr;
 
 	ID3D12Device* D3DDevice = nullptr;
-};
\ No newline at end of file
+};
+// a reserved texture and the tiles mapped to it, filled by TD3D12TilePoolAllocator
+struct TD3D12ReservedResource
+{
+	TD3D12Resource* Resource = nullptr;
+
+	std::unique_ptr<TTiledTextureMap> TileMap;
+};
+
+// memory of reserved textures, handed out in 64KB tiles so a texture only pays for the mips and regions it maps.
+// the mapping changes are queued on the command queue right away, call between frames.
+// unmapped tiles and released textures wait for the GPU like pool blocks
+class TD3D12TilePoolAllocator
+{
+public:
+	// backing store policy of TTilePool
+	class TTileHeapStore
+	{
+	public:
+		TTileHeapStore(ID3D12Device* InDevice) : D3DDevice(InDevice) {}
+
+		void CreateHeap(uint32_t HeapIndex, uint64_t HeapSize);
+
+		void ReleaseHeap(uint32_t HeapIndex);
+
+		ID3D12Heap* GetHeap(uint32_t HeapIndex) { return Heaps[HeapIndex].Get(); }
+
+	private:
+		ID3D12Device* D3DDevice;
+
+		std::vector<Microsoft::WRL::ComPtr<ID3D12Heap>> Heaps;
+	};
+
+public:
+	TD3D12TilePoolAllocator(ID3D12Device* InDevice);
+
+	~TD3D12TilePoolAllocator();
+
+	// nothing is mapped yet, commit the mips before the texture is used
+	void CreateReservedTexture(const D3D12_RESOURCE_STATES& ResourceState, const D3D12_RESOURCE_DESC& ResourceDesc, TD3D12ReservedResource& ReservedResource);
+
+	void ReleaseReservedTexture(TD3D12ReservedResource& ReservedResource);
+
+	// map the tiles of a texel rectangle of one array slice that are not mapped yet, the whole tail for a packed mip
+	void CommitRegion(TD3D12ReservedResource& ReservedResource, uint32_t Slice, uint32_t Mip, uint32_t X, uint32_t Y, uint32_t Width, uint32_t Height);
+
+	// every array slice
+	void CommitMip(TD3D12ReservedResource& ReservedResource, uint32_t Mip);
+
+	void DecommitMip(TD3D12ReservedResource& ReservedResource, uint32_t Mip);
+
+	void CleanUpAllocations(uint64_t CompletedFenceValue);
+
+	// release the tile heaps without a mapped tile, returns the number of bytes given back
+	uint64_t Trim();
+
+	void GetStats(std::vector<TD3D12AllocatorStats>& OutStats);
+
+	void WriteJson(std::string& Json);
+
+private:
+	// the tiles are given back once the GPU has passed the next fence
+	void FreeTiles(const std::vector<TTileLocation>& Tiles);
+
+	void UpdateTileMappings(ID3D12Resource* Resource, std::vector<TTileUpdate>& Updates);
+
+private:
+	ID3D12Device* D3DDevice;
+
+	TTilePool<TTileHeapStore> Pool;
+
+	TFencedDeletionQueue<TTileLocation> DeferredTiles;
+
+	TFencedDeletionQueue<TD3D12Resource*> DeferredResources;
+
+	// textures are streamed in from loader threads
+	std::mutex Mutex;
+};
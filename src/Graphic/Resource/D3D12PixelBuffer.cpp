@@ -90,6 +90,11 @@ void D3D12PixelBuffer::CreateTextureResource(D3D12_RESOURCE_STATES State, const
     ResourceLocation.SetType(TD3D12ResourceLocation::EResourceLocationType::StandAlone);
 }
 
+void D3D12PixelBuffer::DeclareTransientResource(const D3D12_RESOURCE_DESC& ResourceDesc, D3D12_CLEAR_VALUE ClearValue, uint32_t FirstPass, uint32_t LastPass)
+{
+    TD3D12RHI::DeclareTransient(ResourceDesc, ClearValue, FirstPass, LastPass, ResourceLocation);
+}
+
 
 void D3D12ColorBuffer::CreateFromSwapChain(const std::wstring& name, ID3D12Resource* BaseResource)
 {
@@ -209,13 +214,33 @@ void D3D12DepthBuffer::Create(const std::wstring& Name, uint32_t Width, uint32_t
     D3D12_RESOURCE_DESC ResourceDesc = DescribeTex2D(Width, Height, 1, 1, Format, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
     ResourceDesc.SampleDesc.Count = NumSamples;
 
+    CreateTextureResource(D3D12_RESOURCE_STATE_COMMON, ResourceDesc, MakeClearValue(Format), VidMemPtr);
+    CreateDerivedViews(g_Device, Format);
+}
+
+void D3D12DepthBuffer::DeclareTransient(uint32_t Width, uint32_t Height, DXGI_FORMAT Format, uint32_t FirstPass, uint32_t LastPass)
+{
+    D3D12_RESOURCE_DESC ResourceDesc = DescribeTex2D(Width, Height, 1, 1, Format, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
+
+    DeclareTransientResource(ResourceDesc, MakeClearValue(Format), FirstPass, LastPass);
+}
+
+void D3D12DepthBuffer::CreateTransientViews(const std::wstring& Name)
+{
+    assert(ResourceLocation.UnderlyingResource != nullptr);
+
+    CreateDerivedViews(g_Device, m_Format);
+
+    ResourceLocation.UnderlyingResource->D3DResource->SetName(Name.c_str());
+}
+
+D3D12_CLEAR_VALUE D3D12DepthBuffer::MakeClearValue(DXGI_FORMAT Format) const
+{
     D3D12_CLEAR_VALUE ClearValue = {};
     ClearValue.Format = Format;
     ClearValue.DepthStencil.Depth = m_ClearDepth;
     ClearValue.DepthStencil.Stencil = m_ClearStencil;
-
-    CreateTextureResource(D3D12_RESOURCE_STATE_COMMON, ResourceDesc, ClearValue, VidMemPtr);
-    CreateDerivedViews(g_Device, Format);
+    return ClearValue;
 }
 
 DXGI_FORMAT D3D12DepthBuffer::GetDSVFormat(DXGI_FORMAT Format)
@@ -26,6 +26,10 @@ protected:
 	void CreateTextureResource(D3D12_RESOURCE_STATES State, const D3D12_RESOURCE_DESC& ResourceDesc,
 		D3D12_CLEAR_VALUE ClearValue, D3D12_GPU_VIRTUAL_ADDRESS VidMemPtr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN);
 
+	// the texture only lives through passes [FirstPass, LastPass] and shares the transient heap with the other passes,
+	// it has no resource until TD3D12RHI::CommitTransients
+	void DeclareTransientResource(const D3D12_RESOURCE_DESC& ResourceDesc, D3D12_CLEAR_VALUE ClearValue, uint32_t FirstPass, uint32_t LastPass);
+
 	DXGI_FORMAT GetDepthFormat(DXGI_FORMAT defaultFormat);
 
 	uint32_t m_Width;
@@ -110,6 +114,12 @@ public:
 	void Create(const std::wstring& Name, uint32_t Width, uint32_t Height, uint32_t NumSamples, DXGI_FORMAT Format,
 		D3D12_GPU_VIRTUAL_ADDRESS VidMemPtr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN);
 
+	// aliasing mode, see TD3D12RHI::DeclareTransient. the contents don't survive the passes: clear or discard it first
+	void DeclareTransient(uint32_t Width, uint32_t Height, DXGI_FORMAT Format, uint32_t FirstPass, uint32_t LastPass);
+
+	// after TD3D12RHI::CommitTransients
+	void CreateTransientViews(const std::wstring& Name);
+
 	const D3D12_CPU_DESCRIPTOR_HANDLE& GetDSV() const { return m_DSVHandle; }
 	const D3D12_CPU_DESCRIPTOR_HANDLE& GetSRV() const { return m_SRVHandle; }
 
@@ -120,6 +130,8 @@ private:
 
 	DXGI_FORMAT GetDSVFormat(DXGI_FORMAT Format);
 
+	D3D12_CLEAR_VALUE MakeClearValue(DXGI_FORMAT Format) const;
+
 	void CreateDerivedViews(ID3D12Device* Device, DXGI_FORMAT Format);
 
 	float m_ClearDepth;
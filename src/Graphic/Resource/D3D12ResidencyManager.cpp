@@ -0,0 +1,115 @@
+#include "D3D12ResidencyManager.h"
+#include "DXSamplerHelper.h"
+
+TDXGIBudgetProvider::TDXGIBudgetProvider(ID3D12Device* InDevice)
+{
+	Microsoft::WRL::ComPtr<IDXGIFactory4> Factory;
+	ThrowIfFailed(CreateDXGIFactory1(IID_PPV_ARGS(&Factory)));
+	ThrowIfFailed(Factory->EnumAdapterByLuid(InDevice->GetAdapterLuid(), IID_PPV_ARGS(&Adapter)));
+}
+
+TMemoryBudget TDXGIBudgetProvider::QueryBudget()
+{
+	DXGI_QUERY_VIDEO_MEMORY_INFO Info = {};
+	Adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &Info);
+
+	TMemoryBudget Budget;
+	Budget.Budget = Info.Budget;
+	Budget.CurrentUsage = Info.CurrentUsage;
+
+	return Budget;
+}
+
+TD3D12ResidencyManager::TD3D12ResidencyManager(ID3D12Device* InDevice, IMemoryBudgetProvider& InBudgetProvider, float TargetFraction)
+	: D3DDevice(InDevice), Policy(InBudgetProvider, TargetFraction)
+{
+}
+
+void TD3D12ResidencyManager::Register(ID3D12Pageable* Pageable, uint64_t Size, uint64_t FenceValue)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	const uint32_t Handle = Policy.Register(Size, FenceValue);
+	if (Handle >= Pageables.size())
+	{
+		Pageables.resize(Handle + 1, nullptr);
+	}
+
+	Pageables[Handle] = Pageable;
+	Handles[Pageable] = Handle;
+}
+
+void TD3D12ResidencyManager::Unregister(ID3D12Pageable* Pageable)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	auto It = Handles.find(Pageable);
+	if (It == Handles.end())
+	{
+		return;
+	}
+
+	// an evicted heap can be released as it is
+	Policy.Unregister(It->second);
+	Pageables[It->second] = nullptr;
+	Handles.erase(It);
+}
+
+void TD3D12ResidencyManager::MarkUsed(ID3D12Pageable* Pageable, uint64_t FenceValue)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	auto It = Handles.find(Pageable);
+	if (It == Handles.end())
+	{
+		return;
+	}
+
+	if (Policy.MarkUsed(It->second, FenceValue))
+	{
+		// blocks until the heap is paged in, the work using it hasn't been submitted yet
+		ThrowIfFailed(D3DDevice->MakeResident(1, &Pageable));
+	}
+}
+
+void TD3D12ResidencyManager::Update(uint64_t CompletedFenceValue)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	EvictHandles.clear();
+	Policy.Update(CompletedFenceValue, EvictHandles);
+
+	if (EvictHandles.empty())
+	{
+		return;
+	}
+
+	std::vector<ID3D12Pageable*> Evicted;
+	for (uint32_t Handle : EvictHandles)
+	{
+		Evicted.push_back(Pageables[Handle]);
+	}
+
+	ThrowIfFailed(D3DDevice->Evict((UINT)Evicted.size(), Evicted.data()));
+}
+
+uint64_t TD3D12ResidencyManager::GetResidentSize()
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	return Policy.GetResidentSize();
+}
+
+uint64_t TD3D12ResidencyManager::GetEvictedSize()
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	return Policy.GetEvictedSize();
+}
+
+TMemoryBudget TD3D12ResidencyManager::GetLastBudget()
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+
+	return Policy.GetLastBudget();
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "stdafx.h"
+#include "ResidencyPolicy.h"
+#include <mutex>
+#include <unordered_map>
+
+// Heaps of the texture pools are above the video memory budget of the OS sooner or later on small GPUs,
+// the driver then pages on its own and the frame stalls for several frames.
+// The manager evicts the least recently used heaps itself while the usage is above the budget and
+// makes a heap resident again when it is used, see TResidencyPolicy
+
+// local segment of the adapter the device was created on
+class TDXGIBudgetProvider : public IMemoryBudgetProvider
+{
+public:
+	TDXGIBudgetProvider(ID3D12Device* InDevice);
+
+	TMemoryBudget QueryBudget() override;
+
+private:
+	Microsoft::WRL::ComPtr<IDXGIAdapter3> Adapter;
+};
+
+class TD3D12ResidencyManager
+{
+public:
+	TD3D12ResidencyManager(ID3D12Device* InDevice, IMemoryBudgetProvider& InBudgetProvider, float TargetFraction = 0.9f);
+
+	// the heap is resident on creation
+	void Register(ID3D12Pageable* Pageable, uint64_t Size, uint64_t FenceValue);
+
+	// before the heap is released
+	void Unregister(ID3D12Pageable* Pageable);
+
+	// the heap is used by the work signaled with FenceValue, an evicted heap is made resident right away
+	void MarkUsed(ID3D12Pageable* Pageable, uint64_t FenceValue);
+
+	// evict least recently used heaps while the usage is above the target, call once per frame
+	void Update(uint64_t CompletedFenceValue);
+
+	uint64_t GetResidentSize();
+
+	uint64_t GetEvictedSize();
+
+	TMemoryBudget GetLastBudget();
+
+private:
+	ID3D12Device* D3DDevice;
+
+	TResidencyPolicy Policy;
+
+	std::unordered_map<ID3D12Pageable*, uint32_t> Handles;
+
+	// the policy handle of each heap
+	std::vector<ID3D12Pageable*> Pageables;
+
+	std::vector<uint32_t> EvictHandles;
+
+	// heaps are registered by loader threads
+	std::mutex Mutex;
+};
@@ -1,5 +1,8 @@
 #include "D3D12Resource.h"
 #include "DXSamplerHelper.h"
+#include "D3D12MemoryAllocator.h"
+#include "D3D12RHI.h"
+#include "AllocationTrace.h"
 
 TD3D12Resource::TD3D12Resource(Microsoft::WRL::ComPtr<ID3D12Resource> InD3DResource, D3D12_RESOURCE_STATES InitState)
 	: D3DResource(InD3DResource), CurrentState(InitState)
@@ -45,22 +48,42 @@ TD3D12ResourceLocation::~TD3D12ResourceLocation()
 
 void TD3D12ResourceLocation::ReleaseResource()
 {
+	TAllocationTraceRecorder& Recorder = TAllocationTraceRecorder::Get();
+	if (Allocator && Recorder.IsRecording())
+	{
+		Recorder.RecordFree(this, TD3D12RHI::g_CommandContext.GetNextFenceValue());
+	}
+
 	switch (ResourceLocationType)
 	{
 	case TD3D12ResourceLocation::EResourceLocationType::StandAlone:
 	{
-		delete UnderlyingResource;
+		// a dedicated allocation waits for the GPU like a pool block
+		if (Allocator)
+		{
+			Allocator->Deallocate(*this);
+		}
+		else
+		{
+			delete UnderlyingResource;
+		}
 		break;
 	}
 	case TD3D12ResourceLocation::EResourceLocationType::SubAllocation:
 	{
 		if (Allocator)
 		{
-			//Allocator->Dellocate(*this);
+			// the block stays alive until the GPU has finished with it
+			Allocator->Deallocate(*this);
 		}
 		break;
 	}
 	default:
 		break;
 	}
+
+	ResourceLocationType = EResourceLocationType::Undefined;
+	Allocator = nullptr;
+	UnderlyingResource = nullptr;
+	MappedAddress = nullptr;
 }
@@ -1,7 +1,9 @@
 #pragma once
 #include "stdafx.h"
+#include "D3D12AllocationTracker.h"
+#include <functional>
 
-class TD3D12BuddyAllocator;
+class TD3D12SubAllocator;
 
 class TD3D12Resource
 {
@@ -29,9 +31,9 @@ public:
 // buddy info
 struct TD3D12BuddyBlockData
 {
-	uint32_t Offset = 0;
+	uint32_t Offset = 0; // in MinBlockSize units, the block handle for TLSF
 	uint32_t Order = 0;
-	uint32_t ActualUsedSize = 0;
+	uint64_t ActualUsedSize = 0;
 
 	// Resource in Block
 	TD3D12Resource* PlacedResource = nullptr;
@@ -54,16 +56,20 @@ public:
 
 	~TD3D12ResourceLocation();
 
+	// a location owns its allocation, copying it would release the block twice
+	TD3D12ResourceLocation(const TD3D12ResourceLocation&) = delete;
+	TD3D12ResourceLocation& operator=(const TD3D12ResourceLocation&) = delete;
+
 	void ReleaseResource();
 
-	void SetType(EResourceLocationType Type) {}
+	void SetType(EResourceLocationType Type) { ResourceLocationType = Type; }
 
 public:
 
 	EResourceLocationType ResourceLocationType = EResourceLocationType::Undefined;
 
-	// SubAllocation
-	TD3D12BuddyAllocator* Allocator = nullptr;
+	// SubAllocation, or a StandAlone resource of TD3D12DedicatedAllocator
+	TD3D12SubAllocator* Allocator = nullptr;
 
 	TD3D12BuddyBlockData BlockData;
 
@@ -80,6 +86,15 @@ public:
 
 	// mapping for upload buffer
 	void* MappedAddress = nullptr;
+
+	// called after defragmentation moved the allocation, the owner recreates its views here.
+	// locations without it are never moved
+	std::function<void(TD3D12ResourceLocation&)> OnRelocated;
+
+#if ALLOCATION_TRACKING
+	// who owns the block, see SET_ALLOCATION_TAG
+	TAllocationTag Tag;
+#endif
 };
 
 template<typename T>
@@ -17,7 +17,15 @@ bool TD3D12Texture::CreateDDSFromMemory(const void* memBuffer, size_t fileSize,
         m_hCpuDescriptorHandle = TD3D12RHI::SRVHeapSlotAllocator->AllocateHeapSlot().Handle;
 
     HRESULT hr = CreateDDSTextureFromMemory(TD3D12RHI::g_Device,
-        (const uint8_t*)memBuffer, fileSize, 0, sRGB, &ResourceLocation.UnderlyingResource->D3DResource, m_hCpuDescriptorHandle);
+        (const uint8_t*)memBuffer, fileSize, 0, sRGB, &ResourceLocation->UnderlyingResource->D3DResource, m_hCpuDescriptorHandle);
+
+    // the loader creates its own committed resource, it doesn't live in the pool block and can't be moved
+    ResourceLocation->OnRelocated = nullptr;
+
+    if (SUCCEEDED(hr))
+    {
+        RegisterBindless();
+    }
     
     return SUCCEEDED(hr);
 }
@@ -27,7 +35,15 @@ bool TD3D12Texture::CreateDDSFromFile(const wchar_t* fileName, size_t fileSize,
     if (m_hCpuDescriptorHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
         m_hCpuDescriptorHandle = TD3D12RHI::SRVHeapSlotAllocator->AllocateHeapSlot().Handle;
 
-    HRESULT hr = CreateDDSTextureFromFile(TD3D12RHI::g_Device, fileName, ResourceLocation.UnderlyingResource->D3DResource.GetAddressOf(), m_hCpuDescriptorHandle, fileSize, sRGB);
+    HRESULT hr = CreateDDSTextureFromFile(TD3D12RHI::g_Device, fileName, ResourceLocation->UnderlyingResource->D3DResource.GetAddressOf(), m_hCpuDescriptorHandle, fileSize, sRGB);
+
+    // committed resource of the loader, see CreateDDSFromMemory
+    ResourceLocation->OnRelocated = nullptr;
+
+    if (SUCCEEDED(hr))
+    {
+        RegisterBindless();
+    }
 
     return SUCCEEDED(hr);
 }
@@ -57,6 +73,9 @@ bool TD3D12Texture::CreateWICFromFile(const wchar_t* fileName, size_t fileSize,
 
     TD3D12RHI::UploadTextureData(DestTexture, m_InitData);
 
+    // the upload works on a copy of the resource, keep the tracked state in sync for later barriers
+    GetResource()->CurrentState = D3D12_RESOURCE_STATE_GENERIC_READ;
+
     return SUCCEEDED(hr);
 }
 
@@ -81,13 +100,17 @@ void TD3D12Texture::Create2D(size_t Width, size_t Height, DXGI_FORMAT Format)
     texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
 
     // allocate Texture Resource
-    TD3D12RHI::TextureResourceAllocator->AllocTextureResource(m_state, texDesc, DEFAULT_RESOURCE_ALIGNMENT, ResourceLocation);
+    SET_ALLOCATION_TAG(*ResourceLocation, Texture);
+    TD3D12RHI::TextureResourceAllocator->AllocTextureResource(m_state, texDesc, DEFAULT_RESOURCE_ALIGNMENT, *ResourceLocation);
 
     // allocate descriptor heap
     if (m_hCpuDescriptorHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
         m_hCpuDescriptorHandle = TD3D12RHI::SRVHeapSlotAllocator->AllocateHeapSlot().Handle;
 
-    TD3D12RHI::g_Device->CreateShaderResourceView(ResourceLocation.UnderlyingResource->D3DResource.Get(), nullptr, m_hCpuDescriptorHandle);
+    TD3D12RHI::g_Device->CreateShaderResourceView(ResourceLocation->UnderlyingResource->D3DResource.Get(), nullptr, m_hCpuDescriptorHandle);
+
+    RegisterBindless();
+    SetRelocationCallback(nullptr);
 }
 
 void TD3D12Texture::Create2D(TextureInfo info)
@@ -106,7 +129,8 @@ void TD3D12Texture::Create2D(TextureInfo info)
     m_Desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
     m_Desc.Flags = D3D12_RESOURCE_FLAG_NONE;
 
-    TD3D12RHI::TextureResourceAllocator->AllocTextureResource(m_state, m_Desc, 256, ResourceLocation);
+    SET_ALLOCATION_TAG(*ResourceLocation, Texture);
+    TD3D12RHI::TextureResourceAllocator->AllocTextureResource(m_state, m_Desc, 256, *ResourceLocation);
 
     if (m_hCpuDescriptorHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
         m_hCpuDescriptorHandle = TD3D12RHI::SRVHeapSlotAllocator->AllocateHeapSlot().Handle;
@@ -120,7 +144,10 @@ void TD3D12Texture::Create2D(TextureInfo info)
     SRVDesc.Texture2D.ResourceMinLODClamp = 0.0;
     SRVDesc.Format = info.Format;
 
-    TD3D12RHI::g_Device->CreateShaderResourceView(ResourceLocation.UnderlyingResource->D3DResource.Get(), &SRVDesc, m_hCpuDescriptorHandle);
+    TD3D12RHI::g_Device->CreateShaderResourceView(ResourceLocation->UnderlyingResource->D3DResource.Get(), &SRVDesc, m_hCpuDescriptorHandle);
+
+    RegisterBindless();
+    SetRelocationCallback(&SRVDesc);
 }
 
 void TD3D12Texture::CreateCube(size_t Width, size_t Height, DXGI_FORMAT Format)
@@ -145,7 +172,8 @@ void TD3D12Texture::CreateCube(size_t Width, size_t Height, DXGI_FORMAT Format)
     texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
 
     // allocate Texture Resource
-    TD3D12RHI::TextureResourceAllocator->AllocTextureResource(m_state, texDesc, DEFAULT_RESOURCE_ALIGNMENT, ResourceLocation);
+    SET_ALLOCATION_TAG(*ResourceLocation, Texture);
+    TD3D12RHI::TextureResourceAllocator->AllocTextureResource(m_state, texDesc, DEFAULT_RESOURCE_ALIGNMENT, *ResourceLocation);
 
     // allocate descriptor heap
     if (m_hCpuDescriptorHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
@@ -160,7 +188,10 @@ void TD3D12Texture::CreateCube(size_t Width, size_t Height, DXGI_FORMAT Format)
     srvDesc.TextureCube.MostDetailedMip = 0;
     srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
 
-    TD3D12RHI::g_Device->CreateShaderResourceView(ResourceLocation.UnderlyingResource->D3DResource.Get(), &srvDesc, m_hCpuDescriptorHandle);
+    TD3D12RHI::g_Device->CreateShaderResourceView(ResourceLocation->UnderlyingResource->D3DResource.Get(), &srvDesc, m_hCpuDescriptorHandle);
+
+    RegisterBindless();
+    SetRelocationCallback(&srvDesc);
 }
 
 void TD3D12Texture::CreateCube(TextureInfo info)
@@ -178,7 +209,8 @@ void TD3D12Texture::CreateCube(TextureInfo info)
     m_Desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
     m_Desc.Flags = D3D12_RESOURCE_FLAG_NONE;
 
-    TD3D12RHI::TextureResourceAllocator->AllocTextureResource(m_state, m_Desc, 256, ResourceLocation);
+    SET_ALLOCATION_TAG(*ResourceLocation, Texture);
+    TD3D12RHI::TextureResourceAllocator->AllocTextureResource(m_state, m_Desc, 256, *ResourceLocation);
 
     if (m_hCpuDescriptorHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
         m_hCpuDescriptorHandle = TD3D12RHI::SRVHeapSlotAllocator->AllocateHeapSlot().Handle;
@@ -191,7 +223,159 @@ void TD3D12Texture::CreateCube(TextureInfo info)
     srvDesc.TextureCube.MostDetailedMip = 0;
     srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
 
-    TD3D12RHI::g_Device->CreateShaderResourceView(ResourceLocation.UnderlyingResource->D3DResource.Get(), &srvDesc, m_hCpuDescriptorHandle);
+    TD3D12RHI::g_Device->CreateShaderResourceView(ResourceLocation->UnderlyingResource->D3DResource.Get(), &srvDesc, m_hCpuDescriptorHandle);
+
+    RegisterBindless();
+    SetRelocationCallback(&srvDesc);
+}
+
+void TD3D12Texture::RegisterBindless()
+{
+    if (!TD3D12RHI::BindlessHeap)
+    {
+        return;
+    }
+
+    if (BindlessIndex)
+    {
+        TD3D12RHI::BindlessHeap->Update(*BindlessIndex, m_hCpuDescriptorHandle);
+        return;
+    }
+
+    BindlessIndex = std::shared_ptr<uint32_t>(new uint32_t(TD3D12RHI::BindlessHeap->Register(m_hCpuDescriptorHandle)), [](uint32_t* Index)
+    {
+        TD3D12RHI::BindlessHeap->Release(*Index);
+        delete Index;
+    });
+}
+
+void TD3D12Texture::SetRelocationCallback(const D3D12_SHADER_RESOURCE_VIEW_DESC* SRVDesc)
+{
+    // textures are copied by value, capture the view instead of this
+    const D3D12_CPU_DESCRIPTOR_HANDLE Handle = m_hCpuDescriptorHandle;
+    const bool bHasDesc = SRVDesc != nullptr;
+    const D3D12_SHADER_RESOURCE_VIEW_DESC Desc = bHasDesc ? *SRVDesc : D3D12_SHADER_RESOURCE_VIEW_DESC{};
+    const uint32_t Index = GetBindlessIndex();
+
+    ResourceLocation->OnRelocated = [Handle, bHasDesc, Desc, Index](TD3D12ResourceLocation& Location)
+    {
+        TD3D12RHI::g_Device->CreateShaderResourceView(Location.UnderlyingResource->D3DResource.Get(), bHasDesc ? &Desc : nullptr, Handle);
+
+        // the location lives as long as the texture copies, so does the index
+        if (Index != BINDLESS_NULL_INDEX)
+        {
+            TD3D12RHI::BindlessHeap->Update(Index, Handle);
+        }
+    };
+}
+
+void TD3D12Texture::MarkUsed()
+{
+    TD3D12RHI::TextureResourceAllocator->MarkUsed(*ResourceLocation);
+}
+
+TD3D12ReservedTexture::~TD3D12ReservedTexture()
+{
+    if (ReservedResource.Resource)
+    {
+        TD3D12RHI::TilePoolAllocator->ReleaseReservedTexture(ReservedResource);
+    }
+
+    if (bHasSRVSlot)
+    {
+        TD3D12RHI::SRVHeapSlotAllocator->FreeHeapSlot(SRVSlot);
+    }
+}
+
+void TD3D12ReservedTexture::Create2D(uint32_t Width, uint32_t Height, uint32_t MipLevels, DXGI_FORMAT Format)
+{
+    Desc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+    Desc.Width = Width;
+    Desc.Height = Height;
+    Desc.DepthOrArraySize = 1;
+    Desc.MipLevels = (UINT16)MipLevels;
+    Desc.Format = Format;
+    Desc.SampleDesc.Count = 1;
+    Desc.SampleDesc.Quality = 0;
+    Desc.Layout = D3D12_TEXTURE_LAYOUT_64KB_UNDEFINED_SWIZZLE; // reserved textures are always tiled
+    Desc.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+    TD3D12RHI::TilePoolAllocator->CreateReservedTexture(D3D12_RESOURCE_STATE_COPY_DEST, Desc, ReservedResource);
+
+    if (!bHasSRVSlot)
+    {
+        SRVSlot = TD3D12RHI::SRVHeapSlotAllocator->AllocateHeapSlot();
+        bHasSRVSlot = true;
+    }
+
+    UpdateSRV();
+}
+
+void TD3D12ReservedTexture::CommitMip(uint32_t Mip)
+{
+    TD3D12RHI::TilePoolAllocator->CommitMip(ReservedResource, Mip);
+
+    UpdateSRV();
+}
+
+void TD3D12ReservedTexture::CommitRegion(uint32_t Mip, uint32_t X, uint32_t Y, uint32_t Width, uint32_t Height)
+{
+    TD3D12RHI::TilePoolAllocator->CommitRegion(ReservedResource, 0, Mip, X, Y, Width, Height);
+
+    UpdateSRV();
+}
+
+void TD3D12ReservedTexture::DecommitMip(uint32_t Mip)
+{
+    TD3D12RHI::TilePoolAllocator->DecommitMip(ReservedResource, Mip);
+
+    UpdateSRV();
+}
+
+void TD3D12ReservedTexture::UploadMip(uint32_t Mip, const D3D12_SUBRESOURCE_DATA& Data)
+{
+    TD3D12Resource* Dest = ReservedResource.Resource;
+    UINT64 uploadBufferSize = GetRequiredIntermediateSize(Dest->D3DResource.Get(), Mip, 1);
+
+    TD3D12RHI::g_CommandContext.ResetCommandList();
+
+    TD3D12ResourceLocation uploadResourceLocation;
+    SET_ALLOCATION_TAG(uploadResourceLocation, Staging);
+    TD3D12RHI::UploadBufferAllocator->AllocUploadResource(uploadBufferSize, 256, uploadResourceLocation);
+
+    if (Dest->CurrentState != D3D12_RESOURCE_STATE_COPY_DEST)
+    {
+        TD3D12RHI::g_CommandContext.Transition(Dest, D3D12_RESOURCE_STATE_COPY_DEST);
+    }
+
+    D3D12_SUBRESOURCE_DATA SubData = Data;
+    UpdateSubresources(TD3D12RHI::g_CommandContext.GetCommandList(), Dest->D3DResource.Get(), uploadResourceLocation.UnderlyingResource->D3DResource.Get(), 0, Mip, 1, &SubData);
+
+    TD3D12RHI::g_CommandContext.Transition(Dest, D3D12_RESOURCE_STATE_GENERIC_READ);
+
+    TD3D12RHI::g_CommandContext.ExecuteCommandLists();
+}
+
+void TD3D12ReservedTexture::UpdateSRV()
+{
+    const uint32_t MostDetailedMip = GetMostDetailedMip();
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC SRVDesc = {};
+    SRVDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    SRVDesc.Format = Desc.Format;
+    SRVDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+
+    // nothing committed, a null view reads zeros
+    if (MostDetailedMip >= Desc.MipLevels)
+    {
+        SRVDesc.Texture2D.MipLevels = 1;
+        TD3D12RHI::g_Device->CreateShaderResourceView(nullptr, &SRVDesc, SRVSlot.Handle);
+        return;
+    }
+
+    SRVDesc.Texture2D.MostDetailedMip = MostDetailedMip;
+    SRVDesc.Texture2D.MipLevels = Desc.MipLevels - MostDetailedMip;
+    TD3D12RHI::g_Device->CreateShaderResourceView(ReservedResource.Resource->D3DResource.Get(), &SRVDesc, SRVSlot.Handle);
 }
 
 void TD3D12RHI::InitializeTexture(TD3D12Resource& Dest, UINT NumSubresources, D3D12_SUBRESOURCE_DATA SubData[])
@@ -202,6 +386,7 @@ void TD3D12RHI::InitializeTexture(TD3D12Resource& Dest, UINT NumSubresources, D3
 
     // create UploadBuffer resource
     TD3D12ResourceLocation uploadResourceLocation;
+    SET_ALLOCATION_TAG(uploadResourceLocation, Staging);
     UploadBufferAllocator->AllocUploadResource(uploadBufferSize, 256, uploadResourceLocation);
     TD3D12Resource* UploadBuffer = uploadResourceLocation.UnderlyingResource;
 
@@ -229,7 +414,8 @@ void TD3D12RHI::UploadTextureData(TD3D12Resource TextureResource, const std::vec
 
     //Create upload resource
     TD3D12ResourceLocation UploadResourceLocation;
-    void* MappedData = TD3D12RHI::UploadBufferAllocator->AllocUploadResource((uint32_t)RequiredSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, UploadResourceLocation);
+    SET_ALLOCATION_TAG(UploadResourceLocation, Staging);
+    void* MappedData = TD3D12RHI::UploadBufferAllocator->AllocUploadResource(RequiredSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, UploadResourceLocation);
     ID3D12Resource* UploadBuffer = UploadResourceLocation.UnderlyingResource->D3DResource.Get();
 
     //Copy contents to upload resource
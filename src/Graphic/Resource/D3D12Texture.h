@@ -1,5 +1,8 @@
 #pragma once
 #include "D3D12Resource.h"
+#include "D3D12MemoryAllocator.h"
+#include "D3D12HeapSlotAllocator.h"
+#include "D3D12BindlessHeap.h"
 #include <memory>
 
 #define D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN   ((D3D12_GPU_VIRTUAL_ADDRESS)-1)
@@ -25,7 +28,7 @@ class TD3D12Texture
 {
 public:
 
-	TD3D12Texture() {m_hCpuDescriptorHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;}
+	TD3D12Texture() : ResourceLocation(std::make_shared<TD3D12ResourceLocation>()) {m_hCpuDescriptorHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;}
 
 	void Create2D(size_t Width, size_t Height, DXGI_FORMAT Format=DXGI_FORMAT_R32G32B32A32_FLOAT);
 
@@ -40,19 +43,34 @@ public:
 
 	D3D12_CPU_DESCRIPTOR_HANDLE GetSRV() const { return m_hCpuDescriptorHandle; }
 
+	// index of the SRV in TD3D12RHI::BindlessHeap, stable for the lifetime of the texture
+	uint32_t GetBindlessIndex() const { return BindlessIndex ? *BindlessIndex : BINDLESS_NULL_INDEX; }
+
 	uint32_t GetWidth() const { return m_Width; }
 	uint32_t GetHeight() const { return m_Height; }
 	uint32_t GetDepth() const { return m_Depth; }
 
-	TD3D12Resource* GetResource() { return ResourceLocation.UnderlyingResource; }
+	TD3D12Resource* GetResource() { return ResourceLocation->UnderlyingResource; }
+
+	ID3D12Resource* GetD3DResource() { return ResourceLocation->UnderlyingResource->D3DResource.Get(); }
 
-	ID3D12Resource* GetD3DResource() { return ResourceLocation.UnderlyingResource->D3DResource.Get(); }
+	// before drawing with the texture, its pool may have been evicted
+	void MarkUsed();
 
 public:
-	TD3D12ResourceLocation ResourceLocation;
+	// textures are copied by value between models and meshes, the copies share one allocation
+	// which is released when the last copy goes away
+	std::shared_ptr<TD3D12ResourceLocation> ResourceLocation;
 
 	std::string name;
 
+private:
+	// copy the SRV to the bindless heap once it has been created, a second call refreshes the copy
+	void RegisterBindless();
+
+	// rewrite the SRV when defragmentation moves the texture, nullptr SRVDesc uses the default view
+	void SetRelocationCallback(const D3D12_SHADER_RESOURCE_VIEW_DESC* SRVDesc);
+
 private:
 	
 	uint32_t m_Width;
@@ -68,4 +86,55 @@ private:
 	std::vector<uint8_t> decodedData;
 
 	D3D12_CPU_DESCRIPTOR_HANDLE m_hCpuDescriptorHandle;
+
+	// shared by the copies like ResourceLocation, the last one releases the index
+	std::shared_ptr<uint32_t> BindlessIndex;
+};
+
+// a texture that only has memory for the mips and regions committed to it, the tiles come from TD3D12TilePoolAllocator.
+// the SRV starts at the most detailed mip that is committed together with all coarser ones,
+// a partly committed mip may be sampled but reads zeros outside the committed regions
+class TD3D12ReservedTexture
+{
+public:
+	TD3D12ReservedTexture() = default;
+
+	~TD3D12ReservedTexture();
+
+	// owns its tiles, a copy would release them twice
+	TD3D12ReservedTexture(const TD3D12ReservedTexture&) = delete;
+	TD3D12ReservedTexture& operator=(const TD3D12ReservedTexture&) = delete;
+
+	void Create2D(uint32_t Width, uint32_t Height, uint32_t MipLevels, DXGI_FORMAT Format = DXGI_FORMAT_R8G8B8A8_UNORM);
+
+	void CommitMip(uint32_t Mip);
+
+	// texels of Mip, the tiles touched by the rectangle are mapped
+	void CommitRegion(uint32_t Mip, uint32_t X, uint32_t Y, uint32_t Width, uint32_t Height);
+
+	void DecommitMip(uint32_t Mip);
+
+	// copy a whole mip, it has to be committed. like the other uploads it resets g_CommandContext's list and submits the
+	// copy right away, so call it outside the frame recording (at load time or before PopulateCommandList).
+	// the staging block is released on the next fence signal
+	void UploadMip(uint32_t Mip, const D3D12_SUBRESOURCE_DATA& Data);
+
+	D3D12_CPU_DESCRIPTOR_HANDLE GetSRV() const { return SRVSlot.Handle; }
+
+	// the mip count when nothing can be sampled yet
+	uint32_t GetMostDetailedMip() const { return ReservedResource.TileMap->GetMostDetailedCommittedMip(); }
+
+	ID3D12Resource* GetD3DResource() { return ReservedResource.Resource->D3DResource.Get(); }
+
+private:
+	void UpdateSRV();
+
+private:
+	TD3D12ReservedResource ReservedResource;
+
+	D3D12_RESOURCE_DESC Desc = {};
+
+	TD3D12HeapSlotAllocator::HeapSlot SRVSlot = {};
+
+	bool bHasSRVSlot = false;
 };
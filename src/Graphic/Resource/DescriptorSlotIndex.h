@@ -0,0 +1,183 @@
+#pragma once
+#include <stdint.h>
+#include <assert.h>
+#include <vector>
+#include "BuddyAllocator.h"
+
+// Device independent slot bookkeeping of the descriptor heap allocator.
+// Every heap has a bitmap of its free descriptors and a second bitmap holds the heaps that still have one,
+// a single descriptor is found with two bit scans however many heaps there are, freeing it sets one bit.
+// Ranges for descriptor tables are placed best fit, freed ranges coalesce with free neighbours in the bitmap.
+// Handles are plain integers: the CPU handle of the heap start plus the descriptor index times the descriptor size.
+
+class TDescriptorSlotIndex
+{
+public:
+	struct TSlot
+	{
+		uint32_t HeapIndex = 0;
+
+		// handle of the first descriptor
+		uint64_t Handle = 0;
+	};
+
+	TDescriptorSlotIndex(uint32_t InNumDescriptorsPerHeap, uint32_t InDescriptorSize)
+		: NumDescriptorsPerHeap(InNumDescriptorsPerHeap), DescriptorSize(InDescriptorSize)
+	{
+		GrowHeapsWithSpace(64);
+	}
+
+	// a heap whose descriptors are all free, returns its index
+	uint32_t AddHeap(uint64_t BaseHandle)
+	{
+		const uint32_t HeapIndex = (uint32_t)Heaps.size();
+
+		THeap& Heap = Heaps.emplace_back();
+		Heap.BaseHandle = BaseHandle;
+		Heap.NumFree = NumDescriptorsPerHeap;
+		Heap.FreeSlots.Initialize(NumDescriptorsPerHeap);
+		for (uint32_t Index = 0; Index < NumDescriptorsPerHeap; ++Index)
+		{
+			Heap.FreeSlots.Set(Index);
+		}
+
+		if (HeapIndex >= HeapsWithSpaceCapacity)
+		{
+			GrowHeapsWithSpace(HeapsWithSpaceCapacity * 2);
+		}
+		HeapsWithSpace.Set(HeapIndex);
+
+		return HeapIndex;
+	}
+
+	// Count contiguous descriptors, a single one from the lowest heap that has room, a range from the shortest free run.
+	// returns false when no heap has room, the caller adds a heap and tries again
+	bool Allocate(uint32_t Count, TSlot& OutSlot)
+	{
+		assert(Count > 0 && Count <= NumDescriptorsPerHeap);
+
+		if (HeapsWithSpace.Empty())
+		{
+			return false;
+		}
+
+		uint32_t HeapIndex = 0;
+		uint32_t Index = 0;
+
+		if (Count == 1)
+		{
+			HeapIndex = HeapsWithSpace.FindFirst();
+			Index = Heaps[HeapIndex].FreeSlots.FindFirst();
+		}
+		else
+		{
+			// best fit over the heaps with enough free descriptors, the long runs stay for long tables
+			uint32_t BestLength = 0;
+			for (uint32_t Candidate = 0; Candidate < Heaps.size() && BestLength != Count; ++Candidate)
+			{
+				if (Heaps[Candidate].NumFree < Count)
+				{
+					continue;
+				}
+
+				uint32_t CandidateIndex = 0;
+				const uint32_t Length = Heaps[Candidate].FreeSlots.FindBestRun(Count, CandidateIndex);
+				if (Length > 0 && (BestLength == 0 || Length < BestLength))
+				{
+					BestLength = Length;
+					HeapIndex = Candidate;
+					Index = CandidateIndex;
+				}
+			}
+
+			if (BestLength == 0)
+			{
+				return false;
+			}
+		}
+
+		THeap& Heap = Heaps[HeapIndex];
+		for (uint32_t i = 0; i < Count; ++i)
+		{
+			Heap.FreeSlots.Clear(Index + i);
+		}
+
+		Heap.NumFree -= Count;
+		if (Heap.NumFree == 0)
+		{
+			HeapsWithSpace.Clear(HeapIndex);
+		}
+
+		OutSlot.HeapIndex = HeapIndex;
+		OutSlot.Handle = Heap.BaseHandle + (uint64_t)Index * DescriptorSize;
+
+		return true;
+	}
+
+	// Count must match the Allocate
+	void Free(const TSlot& Slot, uint32_t Count)
+	{
+		assert(Slot.HeapIndex < Heaps.size());
+
+		THeap& Heap = Heaps[Slot.HeapIndex];
+
+		assert(Slot.Handle >= Heap.BaseHandle);
+		const uint32_t Index = (uint32_t)((Slot.Handle - Heap.BaseHandle) / DescriptorSize);
+		assert(Index + Count <= NumDescriptorsPerHeap);
+
+		for (uint32_t i = 0; i < Count; ++i)
+		{
+			// double free
+			assert(!Heap.FreeSlots.Test(Index + i));
+			Heap.FreeSlots.Set(Index + i);
+		}
+
+		if (Heap.NumFree == 0)
+		{
+			HeapsWithSpace.Set(Slot.HeapIndex);
+		}
+		Heap.NumFree += Count;
+	}
+
+	uint32_t GetNumHeaps() const { return (uint32_t)Heaps.size(); }
+
+	uint32_t GetNumFree(uint32_t HeapIndex) const { return Heaps[HeapIndex].NumFree; }
+
+private:
+	struct THeap
+	{
+		uint64_t BaseHandle = 0;
+
+		uint32_t NumFree = 0;
+
+		// one bit per free descriptor
+		TFreeBlockBitmap FreeSlots;
+	};
+
+	void GrowHeapsWithSpace(uint32_t Capacity)
+	{
+		// the bitmap has a fixed size, rebuild it from the heaps
+		HeapsWithSpaceCapacity = Capacity;
+		HeapsWithSpace.Initialize(Capacity);
+
+		for (uint32_t HeapIndex = 0; HeapIndex < Heaps.size(); ++HeapIndex)
+		{
+			if (Heaps[HeapIndex].NumFree > 0)
+			{
+				HeapsWithSpace.Set(HeapIndex);
+			}
+		}
+	}
+
+private:
+	const uint32_t NumDescriptorsPerHeap;
+
+	const uint32_t DescriptorSize;
+
+	std::vector<THeap> Heaps;
+
+	// one bit per heap with at least one free descriptor
+	TFreeBlockBitmap HeapsWithSpace;
+
+	uint32_t HeapsWithSpaceCapacity = 0;
+};
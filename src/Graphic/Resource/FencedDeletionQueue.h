@@ -0,0 +1,68 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include <vector>
+
+// Items released on the CPU that the GPU may still be reading.
+// Each item is tagged with the fence value that is signaled after the last command list using it,
+// and is handed back once the completed fence value reaches that tag.
+// Fence values only grow, so the queue is kept in FIFO order and retiring stops at the first pending item.
+// Nothing here talks to the device, the fence values are plain numbers.
+template<typename T>
+class TFencedDeletionQueue
+{
+public:
+	void Enqueue(const T& Item, uint64_t FenceValue)
+	{
+		assert(Entries.size() == Head || Entries.back().FenceValue <= FenceValue);
+
+		Entries.push_back({ Item, FenceValue });
+	}
+
+	// calls Release(Item) for every item whose fence has completed, returns the number of retired items
+	template<typename TReleaseFunc>
+	uint32_t Retire(uint64_t CompletedFenceValue, TReleaseFunc&& Release)
+	{
+		uint32_t NumRetired = 0;
+
+		while (Head < Entries.size() && Entries[Head].FenceValue <= CompletedFenceValue)
+		{
+			Release(Entries[Head].Item);
+
+			++Head;
+			++NumRetired;
+		}
+
+		// clear out all of the released entries, don't allow the array to shrink
+		if (Head == Entries.size())
+		{
+			Entries.clear();
+			Head = 0;
+		}
+		else if (Head > Entries.size() / 2)
+		{
+			Entries.erase(Entries.begin(), Entries.begin() + Head);
+			Head = 0;
+		}
+
+		return NumRetired;
+	}
+
+	size_t Num() const { return Entries.size() - Head; }
+
+	bool Empty() const { return Num() == 0; }
+
+private:
+	struct TEntry
+	{
+		T Item;
+
+		uint64_t FenceValue;
+	};
+
+	std::vector<TEntry> Entries;
+
+	// first entry that has not been retired yet
+	size_t Head = 0;
+};
@@ -34,6 +34,16 @@ namespace PSOManager
 
 			TShader boxShader(boxInfo);
 			m_shaderMap["skyboxShader"] = boxShader;
+
+			// same lighting, the diffuse map comes from the bindless heap
+			if (BindlessHeap)
+			{
+				TShaderInfo bindlessInfo = info;
+				bindlessInfo.FileName = "shaders/modelShaderBindless";
+
+				TShader bindlessShader(bindlessInfo);
+				m_shaderMap["modelShaderBindless"] = bindlessShader;
+			}
 		}
 
 		D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
@@ -65,6 +75,15 @@ namespace PSOManager
 
 		m_gfxPSOMap["pso"] = pso;
 
+		if (BindlessHeap)
+		{
+			GraphicsPSO bindlessPso = pso;
+			bindlessPso.SetShader(&m_shaderMap["modelShaderBindless"]);
+			bindlessPso.Finalize();
+
+			m_gfxPSOMap["bindlessPSO"] = bindlessPso;
+		}
+
 		GraphicsPSO boxPso(L"skybox PSO");
 		boxPso.SetShader(&m_shaderMap["skyboxShader"]);
 		boxPso.SetInputLayout(_countof(inputElementDescs), inputElementDescs);
@@ -0,0 +1,85 @@
+#pragma once
+#include <stdint.h>
+#include <functional>
+#include "FencedDeletionQueue.h"
+#include "RingAllocator.h"
+
+// Device independent part of the GPU to CPU readbacks: a ring of copy destinations,
+// and the callbacks waiting for the fence of their copy.
+// TData describes one copy and has a const void* Data member, Retire points it at the copied bytes for the callback.
+// The callbacks of a completed fence run before the ring reclaims their space, so they can still read it.
+// Nothing here talks to the device, the memory behind the ring is passed to Retire.
+template<typename TData>
+class TReadbackRing
+{
+public:
+	typedef std::function<void(const TData&)> TCallback;
+
+	explicit TReadbackRing(uint64_t Capacity)
+		: Ring(Capacity)
+	{
+	}
+
+	// returns false when the GPU still writes to the space, try again next frame
+	bool Allocate(uint64_t Size, uint64_t Alignment, uint64_t& OutOffset)
+	{
+		return Ring.Allocate(Size, Alignment, OutOffset);
+	}
+
+	// the copy to Offset is covered by the signal of FenceValue
+	void Enqueue(uint64_t Offset, const TData& Data, TCallback&& Callback, uint64_t FenceValue)
+	{
+		TPendingReadback Pending;
+		Pending.Offset = Offset;
+		Pending.Data = Data;
+		Pending.Callback = std::move(Callback);
+
+		PendingReadbacks.Enqueue(Pending, FenceValue);
+	}
+
+	// allocations made since the last call complete with FenceValue
+	void FinishFrame(uint64_t FenceValue)
+	{
+		Ring.FinishFrame(FenceValue);
+	}
+
+	// run the callbacks of the completed copies, then reclaim their space. BaseAddress is where the ring is mapped
+	void Retire(uint64_t CompletedFenceValue, const void* BaseAddress)
+	{
+		PendingReadbacks.Retire(CompletedFenceValue, [BaseAddress](TPendingReadback& Pending)
+		{
+			// moved out, captures of the callback may hold large buffers
+			const TCallback Callback = std::move(Pending.Callback);
+
+			TData Data = Pending.Data;
+			Data.Data = (const uint8_t*)BaseAddress + Pending.Offset;
+
+			if (Callback)
+			{
+				Callback(Data);
+			}
+		});
+
+		Ring.Retire(CompletedFenceValue);
+	}
+
+	size_t GetNumPending() const { return PendingReadbacks.Num(); }
+
+	uint64_t GetCapacity() const { return Ring.GetCapacity(); }
+
+	uint64_t GetUsedSize() const { return Ring.GetUsedSize(); }
+
+private:
+	struct TPendingReadback
+	{
+		uint64_t Offset = 0;
+
+		TData Data;
+
+		TCallback Callback;
+	};
+
+	TRingAllocator Ring;
+
+	TFencedDeletionQueue<TPendingReadback> PendingReadbacks;
+};
@@ -0,0 +1,213 @@
+#pragma once
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+// Device independent bookkeeping of the residency manager.
+// Heaps are registered with their size, every use moves a heap to the back of an LRU list.
+// Update asks the budget provider for the current usage and picks the least recently used heaps to evict
+// until the usage is back under the target. A heap is only picked once the GPU has finished its last use,
+// the fence values are the frame clock.
+
+struct TMemoryBudget
+{
+	// what the OS lets the process use without paging
+	uint64_t Budget = 0;
+
+	uint64_t CurrentUsage = 0;
+};
+
+// the D3D12 implementation asks DXGI, tests feed in their own numbers
+class IMemoryBudgetProvider
+{
+public:
+	virtual ~IMemoryBudgetProvider() {}
+
+	virtual TMemoryBudget QueryBudget() = 0;
+};
+
+class TResidencyPolicy
+{
+public:
+	static constexpr uint32_t INDEX_NONE = UINT32_MAX;
+
+	// TargetFraction of the budget is kept free for the driver and the other allocations of the frame
+	TResidencyPolicy(IMemoryBudgetProvider& InBudgetProvider, float InTargetFraction = 0.9f)
+		: BudgetProvider(InBudgetProvider), TargetFraction(InTargetFraction)
+	{
+	}
+
+	// a new heap is resident and counts as used at FenceValue, returns its handle
+	uint32_t Register(uint64_t Size, uint64_t FenceValue)
+	{
+		uint32_t Handle = 0;
+		if (FreeHandles.empty())
+		{
+			Handle = (uint32_t)Entries.size();
+			Entries.emplace_back();
+		}
+		else
+		{
+			Handle = FreeHandles.back();
+			FreeHandles.pop_back();
+		}
+
+		TEntry& Entry = Entries[Handle];
+		Entry = TEntry();
+		Entry.Size = Size;
+		Entry.LastUsedFenceValue = FenceValue;
+		Entry.bResident = true;
+
+		PushBack(Handle);
+		ResidentSize += Size;
+
+		return Handle;
+	}
+
+	void Unregister(uint32_t Handle)
+	{
+		TEntry& Entry = Entries[Handle];
+
+		if (Entry.bResident)
+		{
+			Unlink(Handle);
+			ResidentSize -= Entry.Size;
+		}
+		else
+		{
+			EvictedSize -= Entry.Size;
+		}
+
+		FreeHandles.push_back(Handle);
+	}
+
+	// the GPU uses the heap in the work signaled with FenceValue.
+	// returns true when the heap was evicted, the caller has to make it resident before submitting
+	bool MarkUsed(uint32_t Handle, uint64_t FenceValue)
+	{
+		TEntry& Entry = Entries[Handle];
+		Entry.LastUsedFenceValue = FenceValue;
+
+		if (Entry.bResident)
+		{
+			// most recently used is the back
+			Unlink(Handle);
+			PushBack(Handle);
+			return false;
+		}
+
+		Entry.bResident = true;
+		EvictedSize -= Entry.Size;
+		ResidentSize += Entry.Size;
+		PushBack(Handle);
+
+		return true;
+	}
+
+	// appends the heaps to evict to OutEvict, least recently used first, and counts them as evicted.
+	// heaps the GPU may still use (last use after CompletedFenceValue) are never picked
+	void Update(uint64_t CompletedFenceValue, std::vector<uint32_t>& OutEvict)
+	{
+		LastBudget = BudgetProvider.QueryBudget();
+
+		const uint64_t Target = (uint64_t)((double)LastBudget.Budget * TargetFraction);
+		if (LastBudget.CurrentUsage <= Target)
+		{
+			return;
+		}
+
+		uint64_t BytesToFree = LastBudget.CurrentUsage - Target;
+
+		while (Head != INDEX_NONE && BytesToFree > 0)
+		{
+			const uint32_t Handle = Head;
+			TEntry& Entry = Entries[Handle];
+
+			// the list is ordered by last use, the rest is newer
+			if (Entry.LastUsedFenceValue > CompletedFenceValue)
+			{
+				break;
+			}
+
+			Unlink(Handle);
+			Entry.bResident = false;
+			ResidentSize -= Entry.Size;
+			EvictedSize += Entry.Size;
+
+			BytesToFree -= (std::min)(BytesToFree, Entry.Size);
+
+			OutEvict.push_back(Handle);
+		}
+	}
+
+	bool IsResident(uint32_t Handle) const { return Entries[Handle].bResident; }
+
+	uint64_t GetResidentSize() const { return ResidentSize; }
+
+	uint64_t GetEvictedSize() const { return EvictedSize; }
+
+	// the numbers seen by the last Update
+	const TMemoryBudget& GetLastBudget() const { return LastBudget; }
+
+private:
+	struct TEntry
+	{
+		uint64_t Size = 0;
+
+		uint64_t LastUsedFenceValue = 0;
+
+		// LRU list of the resident heaps
+		uint32_t Prev = INDEX_NONE;
+		uint32_t Next = INDEX_NONE;
+
+		bool bResident = false;
+	};
+
+	void PushBack(uint32_t Handle)
+	{
+		TEntry& Entry = Entries[Handle];
+		Entry.Prev = Tail;
+		Entry.Next = INDEX_NONE;
+
+		if (Tail != INDEX_NONE)
+		{
+			Entries[Tail].Next = Handle;
+		}
+		else
+		{
+			Head = Handle;
+		}
+
+		Tail = Handle;
+	}
+
+	void Unlink(uint32_t Handle)
+	{
+		TEntry& Entry = Entries[Handle];
+
+		(Entry.Prev != INDEX_NONE ? Entries[Entry.Prev].Next : Head) = Entry.Next;
+		(Entry.Next != INDEX_NONE ? Entries[Entry.Next].Prev : Tail) = Entry.Prev;
+
+		Entry.Prev = INDEX_NONE;
+		Entry.Next = INDEX_NONE;
+	}
+
+private:
+	IMemoryBudgetProvider& BudgetProvider;
+
+	float TargetFraction;
+
+	std::vector<TEntry> Entries;
+
+	std::vector<uint32_t> FreeHandles;
+
+	// least and most recently used resident heap
+	uint32_t Head = INDEX_NONE;
+	uint32_t Tail = INDEX_NONE;
+
+	uint64_t ResidentSize = 0;
+
+	uint64_t EvictedSize = 0;
+
+	TMemoryBudget LastBudget;
+};
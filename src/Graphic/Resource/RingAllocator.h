@@ -0,0 +1,119 @@
+#pragma once
+#include <stdint.h>
+#include <assert.h>
+#include <atomic>
+#include "FencedDeletionQueue.h"
+
+// Device independent ring for transient per-frame data.
+// Allocation is a pointer bump, everything allocated between two FinishFrame calls forms one segment
+// that is tagged with the frame's fence value and given back as a whole once that fence completes.
+// Offsets keep growing, the physical offset is Offset % Capacity, so Head - Tail is always the used size.
+// Allocate is lock free and may be called from any thread, FinishFrame and Retire belong to the render thread.
+class TRingAllocator
+{
+public:
+	// Capacity must be a multiple of every alignment that is requested
+	TRingAllocator(uint64_t InCapacity)
+		: Capacity(InCapacity)
+	{
+	}
+
+	// returns false when the GPU still uses the space, the caller falls back to another allocator
+	bool Allocate(uint64_t Size, uint64_t Alignment, uint64_t& OutOffset)
+	{
+		assert(Alignment == 0 || Capacity % Alignment == 0);
+
+		if (Size > Capacity)
+		{
+			return false;
+		}
+
+		while (true)
+		{
+			// Tail first, Retire moves Head before Tail so Head is never behind the Tail seen here
+			const uint64_t CurrentTail = Tail.load(std::memory_order_acquire);
+			uint64_t OldHead = Head.load(std::memory_order_relaxed);
+
+			uint64_t Offset = OldHead;
+			if (Alignment != 0)
+			{
+				Offset = (Offset + Alignment - 1) / Alignment * Alignment;
+			}
+
+			// an allocation can't wrap around, skip the rest of the buffer
+			const uint64_t PhysicalOffset = Offset % Capacity;
+			if (PhysicalOffset + Size > Capacity)
+			{
+				Offset += Capacity - PhysicalOffset;
+			}
+
+			if (Offset + Size - CurrentTail > Capacity)
+			{
+				return false;
+			}
+
+			// another thread moved Head, try again
+			if (Head.compare_exchange_weak(OldHead, Offset + Size, std::memory_order_relaxed))
+			{
+				OutOffset = Offset % Capacity;
+				return true;
+			}
+		}
+	}
+
+	// close the current segment, it is reclaimed once FenceValue completes
+	void FinishFrame(uint64_t FenceValue)
+	{
+		const uint64_t FrameEnd = Head.load(std::memory_order_relaxed);
+		if (FrameEnd != FrameStart)
+		{
+			Segments.Enqueue(FrameEnd, FenceValue);
+			FrameStart = FrameEnd;
+		}
+	}
+
+	// reclaim the segments whose fence has completed
+	void Retire(uint64_t CompletedFenceValue)
+	{
+		Segments.Retire(CompletedFenceValue, [this](uint64_t SegmentEnd)
+		{
+			Tail.store(SegmentEnd, std::memory_order_release);
+		});
+
+		// nothing in flight, restart from the beginning of the buffer so the whole capacity is usable.
+		// fails harmlessly when another thread allocates at the same time
+		uint64_t Drained = Tail.load(std::memory_order_relaxed);
+		if (Drained % Capacity != 0 && FrameStart == Drained)
+		{
+			const uint64_t Restart = Drained + Capacity - Drained % Capacity;
+			if (Head.compare_exchange_strong(Drained, Restart, std::memory_order_relaxed))
+			{
+				FrameStart = Restart;
+				Tail.store(Restart, std::memory_order_release);
+			}
+		}
+	}
+
+	uint64_t GetCapacity() const { return Capacity; }
+
+	uint64_t GetUsedSize() const
+	{
+		const uint64_t CurrentTail = Tail.load(std::memory_order_acquire);
+		return Head.load(std::memory_order_relaxed) - CurrentTail;
+	}
+
+private:
+	const uint64_t Capacity;
+
+	// next free byte
+	std::atomic<uint64_t> Head = 0;
+
+	// oldest byte the GPU may still read, only written by Retire
+	std::atomic<uint64_t> Tail = 0;
+
+	// start of the segment that is being filled, render thread only
+	uint64_t FrameStart = 0;
+
+	// end offset of every finished segment
+	TFencedDeletionQueue<uint64_t> Segments;
+};
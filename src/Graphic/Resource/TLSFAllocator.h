@@ -0,0 +1,401 @@
+#pragma once
+#include <stdint.h>
+#include <assert.h>
+#include <vector>
+#include "BuddyAllocator.h"
+
+// Device independent two-level segregated fit allocator.
+// Free blocks are binned by size: the first level is the power of two, the second level splits it linearly into
+// SL_COUNT ranges, a bitmap per level finds a large enough bin in O(1). Blocks are split to the requested size and
+// merged with their free neighbours on free, so the waste is the rounding to Granularity instead of a power of two.
+//
+// GPU memory can't hold block headers, the block list lives on the CPU side and a block is named by its index.
+class TTLSFAllocator
+{
+public:
+	static const uint32_t INVALID_BLOCK = UINT32_MAX;
+
+	struct TAllocation
+	{
+		// handle for Deallocate
+		uint32_t Block = INVALID_BLOCK;
+
+		// byte offset from the base of the backing store, aligned to the requested alignment
+		uint64_t AlignedOffset = 0;
+	};
+
+public:
+	// sizes and offsets are kept in Granularity units, every allocation is aligned to Granularity.
+	// the pool size is rounded up to Granularity
+	TTLSFAllocator(uint64_t InPoolSize, uint64_t InGranularity)
+		: Granularity(InGranularity)
+	{
+		assert(Granularity > 0);
+
+		PoolUnits = (InPoolSize + Granularity - 1) / Granularity;
+		assert(PoolUnits > 0 && PoolUnits <= UINT32_MAX);
+
+		for (uint32_t& Head : FreeHeads)
+		{
+			Head = INVALID_BLOCK;
+		}
+
+		FirstBlock = NewBlock(0, (uint32_t)PoolUnits);
+		InsertFreeBlock(FirstBlock);
+	}
+
+	bool Allocate(uint64_t Size, uint64_t Alignment, TAllocation& OutAllocation)
+	{
+		const uint64_t Units = (Size + Granularity - 1) / Granularity;
+		const uint64_t AlignmentUnits = Alignment > Granularity ? (Alignment + Granularity - 1) / Granularity : 1;
+
+		// room to move the start up to the alignment
+		const uint64_t SearchUnits = (Units == 0 ? 1 : Units) + AlignmentUnits - 1;
+		if (SearchUnits > PoolUnits)
+		{
+			return false;
+		}
+
+		uint32_t FL = 0;
+		uint32_t SL = 0;
+		MappingSearch((uint32_t)SearchUnits, FL, SL);
+
+		if (!FindSuitableBin(FL, SL))
+		{
+			return false;
+		}
+
+		uint32_t Block = FreeHeads[FL * SL_COUNT + SL];
+		RemoveFreeBlock(Block);
+
+		// split the front off when the block start isn't aligned
+		const uint32_t Offset = Blocks[Block].Offset;
+		const uint32_t AlignedOffset = (uint32_t)((Offset + AlignmentUnits - 1) / AlignmentUnits * AlignmentUnits);
+		if (AlignedOffset != Offset)
+		{
+			const uint32_t Front = Block;
+			Block = Split(Front, AlignedOffset - Offset);
+			InsertFreeBlock(Front);
+		}
+
+		// give the tail back
+		const uint32_t UsedUnits = Units == 0 ? 1 : (uint32_t)Units;
+		if (Blocks[Block].Size > UsedUnits)
+		{
+			const uint32_t Tail = Split(Block, UsedUnits);
+			InsertFreeBlock(Tail);
+		}
+
+		Blocks[Block].bFree = false;
+		TotalAllocSize += Blocks[Block].Size * Granularity;
+
+		OutAllocation.Block = Block;
+		OutAllocation.AlignedOffset = Blocks[Block].Offset * Granularity;
+
+		return true;
+	}
+
+	void Deallocate(uint32_t Block)
+	{
+		assert(Block < Blocks.size() && !Blocks[Block].bFree);
+
+		TotalAllocSize -= Blocks[Block].Size * Granularity;
+		Blocks[Block].bFree = true;
+
+		// merge with the free neighbours in memory
+		const uint32_t Prev = Blocks[Block].PrevPhys;
+		if (Prev != INVALID_BLOCK && Blocks[Prev].bFree)
+		{
+			RemoveFreeBlock(Prev);
+			Block = Merge(Prev, Block);
+		}
+
+		const uint32_t Next = Blocks[Block].NextPhys;
+		if (Next != INVALID_BLOCK && Blocks[Next].bFree)
+		{
+			RemoveFreeBlock(Next);
+			Block = Merge(Block, Next);
+		}
+
+		InsertFreeBlock(Block);
+	}
+
+	uint64_t GetPoolSize() const { return PoolUnits * Granularity; }
+
+	uint64_t GetTotalAllocSize() const { return TotalAllocSize; }
+
+	// size of a live block in bytes
+	uint64_t GetBlockSize(uint32_t Block) const { return Blocks[Block].Size * Granularity; }
+
+	// free blocks whose size in Granularity units has its highest bit at Log2Size
+	uint32_t GetNumFreeBlocks(uint32_t Log2Size) const { return NumFreeBlocks[Log2Size]; }
+
+	// calls Func(Offset, Size, bFree) in bytes for every block in address order
+	template<typename TFunc>
+	void ForEachBlock(TFunc&& Func) const
+	{
+		// the block at offset 0 is never merged away
+		for (uint32_t Block = FirstBlock; Block != INVALID_BLOCK; Block = Blocks[Block].NextPhys)
+		{
+			Func(Blocks[Block].Offset * Granularity, Blocks[Block].Size * Granularity, Blocks[Block].bFree);
+		}
+	}
+
+	// a lower bound of the largest free block in bytes, any request up to it succeeds
+	uint64_t GetLargestFreeSize() const
+	{
+		if (FLBitmap == 0)
+		{
+			return 0;
+		}
+
+		const uint32_t FL = FindHighestSetBit(FLBitmap);
+		const uint32_t SL = FindHighestSetBit(SLBitmaps[FL]);
+
+		return (uint64_t)BinLowerBound(FL, SL) * Granularity;
+	}
+
+private:
+	static const uint32_t SL_LOG2 = 4;
+	static const uint32_t SL_COUNT = 1 << SL_LOG2;
+
+	// enough for 2^32 units
+	static const uint32_t FL_COUNT = 32 - SL_LOG2 + 1;
+
+	struct TBlock
+	{
+		uint32_t Offset = 0;
+		uint32_t Size = 0;
+
+		bool bFree = false;
+
+		// neighbours in memory
+		uint32_t PrevPhys = INVALID_BLOCK;
+		uint32_t NextPhys = INVALID_BLOCK;
+
+		// neighbours in the free list of the bin, NextFree also links unused block records
+		uint32_t PrevFree = INVALID_BLOCK;
+		uint32_t NextFree = INVALID_BLOCK;
+	};
+
+	// bin of a block of Units size
+	static void MappingInsert(uint32_t Units, uint32_t& OutFL, uint32_t& OutSL)
+	{
+		if (Units < SL_COUNT)
+		{
+			OutFL = 0;
+			OutSL = Units;
+		}
+		else
+		{
+			const uint32_t HighBit = FindHighestSetBit(Units);
+			OutFL = HighBit - SL_LOG2 + 1;
+			OutSL = (Units >> (HighBit - SL_LOG2)) ^ SL_COUNT;
+		}
+	}
+
+	// first bin whose blocks are all at least Units large
+	static void MappingSearch(uint32_t Units, uint32_t& OutFL, uint32_t& OutSL)
+	{
+		uint64_t Rounded = Units;
+		if (Units >= SL_COUNT)
+		{
+			Rounded += ((uint64_t)1 << (FindHighestSetBit(Units) - SL_LOG2)) - 1;
+		}
+
+		if (Rounded > UINT32_MAX)
+		{
+			OutFL = FL_COUNT;
+			OutSL = 0;
+			return;
+		}
+
+		MappingInsert((uint32_t)Rounded, OutFL, OutSL);
+	}
+
+	static uint32_t BinLowerBound(uint32_t FL, uint32_t SL)
+	{
+		if (FL == 0)
+		{
+			return SL;
+		}
+
+		const uint32_t Shift = FL + SL_LOG2 - 1;
+		return ((uint32_t)1 << Shift) + (SL << (Shift - SL_LOG2));
+	}
+
+	bool FindSuitableBin(uint32_t& InOutFL, uint32_t& InOutSL) const
+	{
+		if (InOutFL >= FL_COUNT)
+		{
+			return false;
+		}
+
+		uint32_t SLMap = SLBitmaps[InOutFL] & (~(uint32_t)0 << InOutSL);
+		if (SLMap == 0)
+		{
+			// nothing in this first level, take the next non-empty one
+			const uint64_t FLMap = InOutFL + 1 < 64 ? FLBitmap & (~(uint64_t)0 << (InOutFL + 1)) : 0;
+			if (FLMap == 0)
+			{
+				return false;
+			}
+
+			InOutFL = FindLowestSetBit(FLMap);
+			SLMap = SLBitmaps[InOutFL];
+		}
+
+		InOutSL = FindLowestSetBit(SLMap);
+		return true;
+	}
+
+	uint32_t NewBlock(uint32_t Offset, uint32_t Size)
+	{
+		uint32_t Block;
+		if (UnusedBlocks != INVALID_BLOCK)
+		{
+			Block = UnusedBlocks;
+			UnusedBlocks = Blocks[Block].NextFree;
+			Blocks[Block] = TBlock();
+		}
+		else
+		{
+			Block = (uint32_t)Blocks.size();
+			Blocks.emplace_back();
+		}
+
+		Blocks[Block].Offset = Offset;
+		Blocks[Block].Size = Size;
+
+		return Block;
+	}
+
+	void DeleteBlock(uint32_t Block)
+	{
+		Blocks[Block].NextFree = UnusedBlocks;
+		UnusedBlocks = Block;
+	}
+
+	// cut Block after Units, returns the second part
+	uint32_t Split(uint32_t Block, uint32_t Units)
+	{
+		assert(Blocks[Block].Size > Units);
+
+		const uint32_t Rest = NewBlock(Blocks[Block].Offset + Units, Blocks[Block].Size - Units);
+		Blocks[Block].Size = Units;
+
+		const uint32_t Next = Blocks[Block].NextPhys;
+		Blocks[Rest].PrevPhys = Block;
+		Blocks[Rest].NextPhys = Next;
+		Blocks[Block].NextPhys = Rest;
+		if (Next != INVALID_BLOCK)
+		{
+			Blocks[Next].PrevPhys = Rest;
+		}
+
+		return Rest;
+	}
+
+	// Second directly follows First, returns the merged block
+	uint32_t Merge(uint32_t First, uint32_t Second)
+	{
+		Blocks[First].Size += Blocks[Second].Size;
+
+		const uint32_t Next = Blocks[Second].NextPhys;
+		Blocks[First].NextPhys = Next;
+		if (Next != INVALID_BLOCK)
+		{
+			Blocks[Next].PrevPhys = First;
+		}
+
+		DeleteBlock(Second);
+
+		return First;
+	}
+
+	void InsertFreeBlock(uint32_t Block)
+	{
+		uint32_t FL = 0;
+		uint32_t SL = 0;
+		MappingInsert(Blocks[Block].Size, FL, SL);
+
+		uint32_t& Head = FreeHeads[FL * SL_COUNT + SL];
+
+		Blocks[Block].bFree = true;
+		Blocks[Block].PrevFree = INVALID_BLOCK;
+		Blocks[Block].NextFree = Head;
+		if (Head != INVALID_BLOCK)
+		{
+			Blocks[Head].PrevFree = Block;
+		}
+		Head = Block;
+
+		FLBitmap |= (uint64_t)1 << FL;
+		SLBitmaps[FL] |= (uint32_t)1 << SL;
+
+		++NumFreeBlocks[FindHighestSetBit(Blocks[Block].Size)];
+	}
+
+	void RemoveFreeBlock(uint32_t Block)
+	{
+		uint32_t FL = 0;
+		uint32_t SL = 0;
+		MappingInsert(Blocks[Block].Size, FL, SL);
+
+		const uint32_t Prev = Blocks[Block].PrevFree;
+		const uint32_t Next = Blocks[Block].NextFree;
+
+		if (Prev != INVALID_BLOCK)
+		{
+			Blocks[Prev].NextFree = Next;
+		}
+		else
+		{
+			FreeHeads[FL * SL_COUNT + SL] = Next;
+		}
+
+		if (Next != INVALID_BLOCK)
+		{
+			Blocks[Next].PrevFree = Prev;
+		}
+
+		if (FreeHeads[FL * SL_COUNT + SL] == INVALID_BLOCK)
+		{
+			SLBitmaps[FL] &= ~((uint32_t)1 << SL);
+			if (SLBitmaps[FL] == 0)
+			{
+				FLBitmap &= ~((uint64_t)1 << FL);
+			}
+		}
+
+		Blocks[Block].bFree = false;
+
+		--NumFreeBlocks[FindHighestSetBit(Blocks[Block].Size)];
+	}
+
+private:
+	const uint64_t Granularity;
+
+	uint64_t PoolUnits = 0;
+
+	uint64_t TotalAllocSize = 0;
+
+	std::vector<TBlock> Blocks;
+
+	// the block at offset 0, head of the address order
+	uint32_t FirstBlock = INVALID_BLOCK;
+
+	// free list of reusable block records
+	uint32_t UnusedBlocks = INVALID_BLOCK;
+
+	// bit FL is set when SLBitmaps[FL] is not empty
+	uint64_t FLBitmap = 0;
+
+	uint32_t SLBitmaps[FL_COUNT] = {};
+
+	// first free block of every bin
+	uint32_t FreeHeads[FL_COUNT * SL_COUNT];
+
+	// for statistics
+	uint32_t NumFreeBlocks[32] = {};
+};
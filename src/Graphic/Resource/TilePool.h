@@ -0,0 +1,460 @@
+#pragma once
+#include <stdint.h>
+#include <assert.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "BuddyAllocator.h"
+
+// Device independent bookkeeping of reserved (tiled) resources.
+// TTilePool hands out 64KB tiles from a growing set of tile heaps, one tile at a time, so the tiles of a
+// resource don't have to be contiguous. TTiledTextureMap knows which tile is mapped to which region of a texture
+// and produces the mapping updates for the device. The heaps come from a backing store policy:
+//
+//   class TBackingStore
+//   {
+//       void CreateHeap(uint32_t HeapIndex, uint64_t HeapSize);
+//       void ReleaseHeap(uint32_t HeapIndex);
+//   };
+//
+// D3D12 uses ID3D12Heaps (see TD3D12TilePoolAllocator), THostTileStore below only counts the heaps.
+
+struct TTileLocation
+{
+	static constexpr uint32_t INDEX_NONE = UINT32_MAX;
+
+	uint32_t Heap = INDEX_NONE;
+
+	// in tiles from the start of the heap
+	uint32_t Tile = 0;
+
+	bool IsValid() const { return Heap != INDEX_NONE; }
+};
+
+template<typename TBackingStore>
+class TTilePool
+{
+public:
+	// D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES
+	static constexpr uint64_t TILE_SIZE = 64 * 1024;
+
+	template<typename... TStoreArgs>
+	TTilePool(uint32_t InTilesPerHeap, TStoreArgs&&... StoreArgs)
+		: TilesPerHeap(InTilesPerHeap), BackingStore(std::forward<TStoreArgs>(StoreArgs)...)
+	{
+		assert(TilesPerHeap > 0);
+	}
+
+	// appends NumTiles tiles to OutTiles, new heaps are created when the existing ones are full.
+	// the lowest heaps are filled first so the upper ones empty out and can be trimmed
+	void Allocate(uint32_t NumTiles, std::vector<TTileLocation>& OutTiles)
+	{
+		uint32_t HeapIndex = 0;
+
+		while (NumTiles > 0)
+		{
+			while (HeapIndex < Heaps.size() && (!Heaps[HeapIndex].bAlive || Heaps[HeapIndex].FreeTiles.Empty()))
+			{
+				++HeapIndex;
+			}
+
+			if (HeapIndex == Heaps.size())
+			{
+				HeapIndex = CreateHeap();
+			}
+
+			THeap& Heap = Heaps[HeapIndex];
+			while (NumTiles > 0 && !Heap.FreeTiles.Empty())
+			{
+				TTileLocation Location;
+				Location.Heap = HeapIndex;
+				Location.Tile = Heap.FreeTiles.FindFirst();
+
+				Heap.FreeTiles.Clear(Location.Tile);
+				++Heap.NumUsedTiles;
+				++NumUsedTiles;
+				--NumTiles;
+
+				OutTiles.push_back(Location);
+			}
+		}
+	}
+
+	// the GPU must be done with the tile, see TD3D12TilePoolAllocator for the fenced version
+	void Free(const TTileLocation& Location)
+	{
+		THeap& Heap = Heaps[Location.Heap];
+		assert(Heap.bAlive && !Heap.FreeTiles.Test(Location.Tile));
+
+		Heap.FreeTiles.Set(Location.Tile);
+		--Heap.NumUsedTiles;
+		--NumUsedTiles;
+	}
+
+	// release every heap without a used tile, returns the number of bytes given back
+	uint64_t Trim()
+	{
+		uint64_t BytesFreed = 0;
+
+		for (uint32_t HeapIndex = 0; HeapIndex < Heaps.size(); ++HeapIndex)
+		{
+			THeap& Heap = Heaps[HeapIndex];
+			if (Heap.bAlive && Heap.NumUsedTiles == 0)
+			{
+				BackingStore.ReleaseHeap(HeapIndex);
+				Heap.bAlive = false;
+				--NumHeaps;
+
+				BytesFreed += GetHeapSize();
+			}
+		}
+
+		return BytesFreed;
+	}
+
+	uint64_t GetHeapSize() const { return TilesPerHeap * TILE_SIZE; }
+
+	uint32_t GetNumHeaps() const { return NumHeaps; }
+
+	uint32_t GetNumUsedTiles() const { return NumUsedTiles; }
+
+	uint64_t GetPoolSize() const { return NumHeaps * GetHeapSize(); }
+
+	// Func(HeapIndex, NumUsedTiles) for every live heap
+	template<typename TFunc>
+	void ForEachHeap(TFunc&& Func) const
+	{
+		for (uint32_t HeapIndex = 0; HeapIndex < Heaps.size(); ++HeapIndex)
+		{
+			if (Heaps[HeapIndex].bAlive)
+			{
+				Func(HeapIndex, Heaps[HeapIndex].NumUsedTiles);
+			}
+		}
+	}
+
+	TBackingStore& GetBackingStore() { return BackingStore; }
+
+private:
+	struct THeap
+	{
+		TFreeBlockBitmap FreeTiles;
+
+		uint32_t NumUsedTiles = 0;
+
+		// a trimmed heap leaves its slot, the next new heap takes it
+		bool bAlive = false;
+	};
+
+	uint32_t CreateHeap()
+	{
+		uint32_t HeapIndex = 0;
+		while (HeapIndex < Heaps.size() && Heaps[HeapIndex].bAlive)
+		{
+			++HeapIndex;
+		}
+
+		if (HeapIndex == Heaps.size())
+		{
+			Heaps.emplace_back();
+		}
+
+		THeap& Heap = Heaps[HeapIndex];
+		Heap.FreeTiles.Initialize(TilesPerHeap);
+		for (uint32_t Tile = 0; Tile < TilesPerHeap; ++Tile)
+		{
+			Heap.FreeTiles.Set(Tile);
+		}
+		Heap.NumUsedTiles = 0;
+		Heap.bAlive = true;
+		++NumHeaps;
+
+		BackingStore.CreateHeap(HeapIndex, GetHeapSize());
+
+		return HeapIndex;
+	}
+
+private:
+	const uint32_t TilesPerHeap;
+
+	std::vector<THeap> Heaps;
+
+	uint32_t NumHeaps = 0;
+
+	uint32_t NumUsedTiles = 0;
+
+	TBackingStore BackingStore;
+};
+
+// tiling of a texture as the device reports it (ID3D12Device::GetResourceTiling)
+struct TTiledTextureLayout
+{
+	struct TMip
+	{
+		uint32_t WidthInTiles = 1;
+		uint32_t HeightInTiles = 1;
+		uint32_t DepthInTiles = 1;
+	};
+
+	// the mips that are tiled one by one, most detailed first
+	std::vector<TMip> StandardMips;
+
+	// the smallest mips of an array slice share NumTilesForPackedMips tiles and are mapped together
+	uint32_t NumPackedMips = 0;
+	uint32_t NumTilesForPackedMips = 0;
+
+	// texels covered by one tile
+	uint32_t TileWidth = 1;
+	uint32_t TileHeight = 1;
+
+	uint32_t ArraySize = 1;
+
+	uint32_t GetNumMips() const { return (uint32_t)StandardMips.size() + NumPackedMips; }
+};
+
+// one tile mapping change, in D3D12_TILED_RESOURCE_COORDINATE terms.
+// for packed mips Subresource is the first packed mip and X the tile in the packed tail
+struct TTileUpdate
+{
+	uint32_t Subresource = 0;
+
+	uint32_t X = 0;
+	uint32_t Y = 0;
+	uint32_t Z = 0;
+
+	// invalid to unmap
+	TTileLocation Location;
+};
+
+class TTiledTextureMap
+{
+public:
+	TTiledTextureMap(const TTiledTextureLayout& InLayout)
+		: Layout(InLayout)
+	{
+		// the standard mips of a slice and its packed tail
+		const uint32_t NumLevels = (uint32_t)Layout.StandardMips.size() + 1;
+		Levels.resize(NumLevels * Layout.ArraySize);
+
+		for (uint32_t Slice = 0; Slice < Layout.ArraySize; ++Slice)
+		{
+			for (uint32_t Mip = 0; Mip < NumLevels; ++Mip)
+			{
+				Levels[Slice * NumLevels + Mip].Tiles.resize(GetNumTiles(Mip));
+			}
+		}
+	}
+
+	const TTiledTextureLayout& GetLayout() const { return Layout; }
+
+	bool IsPackedMip(uint32_t Mip) const { return Mip >= Layout.StandardMips.size(); }
+
+	// map the tiles covering a texel rectangle of a standard mip that are not mapped yet.
+	// a packed mip maps the whole packed tail of the slice
+	template<typename TPool>
+	void CommitRegion(TPool& Pool, uint32_t Slice, uint32_t Mip, uint32_t X, uint32_t Y, uint32_t Width, uint32_t Height, std::vector<TTileUpdate>& OutUpdates)
+	{
+		assert(Width > 0 && Height > 0);
+
+		if (IsPackedMip(Mip))
+		{
+			CommitMip(Pool, Slice, Mip, OutUpdates);
+			return;
+		}
+
+		const TTiledTextureLayout::TMip& MipLayout = Layout.StandardMips[Mip];
+		const uint32_t BeginX = X / Layout.TileWidth;
+		const uint32_t BeginY = Y / Layout.TileHeight;
+		const uint32_t EndX = (std::min)((X + Width + Layout.TileWidth - 1) / Layout.TileWidth, MipLayout.WidthInTiles);
+		const uint32_t EndY = (std::min)((Y + Height + Layout.TileHeight - 1) / Layout.TileHeight, MipLayout.HeightInTiles);
+
+		CommitTiles(Pool, Slice, Mip, BeginX, EndX, BeginY, EndY, 0, MipLayout.DepthInTiles, OutUpdates);
+	}
+
+	template<typename TPool>
+	void CommitMip(TPool& Pool, uint32_t Slice, uint32_t Mip, std::vector<TTileUpdate>& OutUpdates)
+	{
+		assert(Slice < Layout.ArraySize && Mip < Layout.GetNumMips());
+
+		if (IsPackedMip(Mip))
+		{
+			CommitTiles(Pool, Slice, (uint32_t)Layout.StandardMips.size(), 0, Layout.NumTilesForPackedMips, 0, 1, 0, 1, OutUpdates);
+			return;
+		}
+
+		const TTiledTextureLayout::TMip& MipLayout = Layout.StandardMips[Mip];
+		CommitTiles(Pool, Slice, Mip, 0, MipLayout.WidthInTiles, 0, MipLayout.HeightInTiles, 0, MipLayout.DepthInTiles, OutUpdates);
+	}
+
+	// unmap every tile of the mip, the tiles are appended to OutFreed.
+	// the owner gives them back to the pool once the GPU is done with them
+	void DecommitMip(uint32_t Slice, uint32_t Mip, std::vector<TTileUpdate>& OutUpdates, std::vector<TTileLocation>& OutFreed)
+	{
+		const uint32_t Level = (std::min)(Mip, (uint32_t)Layout.StandardMips.size());
+		TLevel& Mapping = GetLevel(Slice, Level);
+
+		for (uint32_t i = 0; i < Mapping.Tiles.size(); ++i)
+		{
+			if (!Mapping.Tiles[i].IsValid())
+			{
+				continue;
+			}
+
+			OutFreed.push_back(Mapping.Tiles[i]);
+			Mapping.Tiles[i] = TTileLocation();
+			--Mapping.NumMapped;
+			--NumMappedTiles;
+
+			OutUpdates.push_back(MakeUpdate(Slice, Level, i));
+		}
+	}
+
+	void DecommitAll(std::vector<TTileUpdate>& OutUpdates, std::vector<TTileLocation>& OutFreed)
+	{
+		for (uint32_t Slice = 0; Slice < Layout.ArraySize; ++Slice)
+		{
+			for (uint32_t Level = 0; Level <= Layout.StandardMips.size(); ++Level)
+			{
+				DecommitMip(Slice, Level, OutUpdates, OutFreed);
+			}
+		}
+	}
+
+	// every tile of the mip is mapped in every slice
+	bool IsMipCommitted(uint32_t Mip) const
+	{
+		const uint32_t Level = (std::min)(Mip, (uint32_t)Layout.StandardMips.size());
+
+		for (uint32_t Slice = 0; Slice < Layout.ArraySize; ++Slice)
+		{
+			const TLevel& Mapping = GetLevel(Slice, Level);
+			if (Mapping.NumMapped != Mapping.Tiles.size())
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// the most detailed mip that can be sampled, it and all coarser mips are committed.
+	// GetNumMips() when the packed tail is not, a shader must not sample the texture then
+	uint32_t GetMostDetailedCommittedMip() const
+	{
+		uint32_t Mip = Layout.GetNumMips();
+
+		while (Mip > 0 && IsMipCommitted(Mip - 1))
+		{
+			--Mip;
+		}
+
+		return Mip;
+	}
+
+	uint32_t GetNumMappedTiles() const { return NumMappedTiles; }
+
+private:
+	struct TLevel
+	{
+		// row major, then depth
+		std::vector<TTileLocation> Tiles;
+
+		uint32_t NumMapped = 0;
+	};
+
+	// Level is a standard mip or StandardMips.size() for the packed tail
+	uint32_t GetNumTiles(uint32_t Level) const
+	{
+		if (Level == Layout.StandardMips.size())
+		{
+			return Layout.NumTilesForPackedMips;
+		}
+
+		const TTiledTextureLayout::TMip& MipLayout = Layout.StandardMips[Level];
+		return MipLayout.WidthInTiles * MipLayout.HeightInTiles * MipLayout.DepthInTiles;
+	}
+
+	TLevel& GetLevel(uint32_t Slice, uint32_t Level) { return Levels[Slice * (Layout.StandardMips.size() + 1) + Level]; }
+
+	const TLevel& GetLevel(uint32_t Slice, uint32_t Level) const { return Levels[Slice * (Layout.StandardMips.size() + 1) + Level]; }
+
+	TTileUpdate MakeUpdate(uint32_t Slice, uint32_t Level, uint32_t TileIndex) const
+	{
+		TTileUpdate Update;
+		Update.Subresource = Level + Slice * Layout.GetNumMips();
+
+		if (Level == Layout.StandardMips.size())
+		{
+			Update.X = TileIndex;
+			return Update;
+		}
+
+		const TTiledTextureLayout::TMip& MipLayout = Layout.StandardMips[Level];
+		Update.X = TileIndex % MipLayout.WidthInTiles;
+		Update.Y = TileIndex / MipLayout.WidthInTiles % MipLayout.HeightInTiles;
+		Update.Z = TileIndex / (MipLayout.WidthInTiles * MipLayout.HeightInTiles);
+
+		return Update;
+	}
+
+	template<typename TPool>
+	void CommitTiles(TPool& Pool, uint32_t Slice, uint32_t Level, uint32_t BeginX, uint32_t EndX, uint32_t BeginY, uint32_t EndY, uint32_t BeginZ, uint32_t EndZ, std::vector<TTileUpdate>& OutUpdates)
+	{
+		TLevel& Mapping = GetLevel(Slice, Level);
+		const uint32_t RowPitch = Level == Layout.StandardMips.size() ? Layout.NumTilesForPackedMips : Layout.StandardMips[Level].WidthInTiles;
+		const uint32_t SlicePitch = Level == Layout.StandardMips.size() ? Layout.NumTilesForPackedMips : RowPitch * Layout.StandardMips[Level].HeightInTiles;
+
+		// unmapped tiles of the region
+		std::vector<uint32_t> TileIndices;
+		for (uint32_t Z = BeginZ; Z < EndZ; ++Z)
+		{
+			for (uint32_t Y = BeginY; Y < EndY; ++Y)
+			{
+				for (uint32_t X = BeginX; X < EndX; ++X)
+				{
+					const uint32_t TileIndex = Z * SlicePitch + Y * RowPitch + X;
+					if (!Mapping.Tiles[TileIndex].IsValid())
+					{
+						TileIndices.push_back(TileIndex);
+					}
+				}
+			}
+		}
+
+		std::vector<TTileLocation> Locations;
+		Pool.Allocate((uint32_t)TileIndices.size(), Locations);
+
+		for (uint32_t i = 0; i < TileIndices.size(); ++i)
+		{
+			Mapping.Tiles[TileIndices[i]] = Locations[i];
+			++Mapping.NumMapped;
+			++NumMappedTiles;
+
+			TTileUpdate Update = MakeUpdate(Slice, Level, TileIndices[i]);
+			Update.Location = Locations[i];
+			OutUpdates.push_back(Update);
+		}
+	}
+
+private:
+	TTiledTextureLayout Layout;
+
+	// per slice the standard mips and the packed tail
+	std::vector<TLevel> Levels;
+
+	uint32_t NumMappedTiles = 0;
+};
+
+// stand-in for the tile heaps, used to run the bookkeeping without a device
+class THostTileStore
+{
+public:
+	void CreateHeap(uint32_t, uint64_t) { ++NumCreatedHeaps; }
+
+	void ReleaseHeap(uint32_t) { ++NumReleasedHeaps; }
+
+public:
+	uint32_t NumCreatedHeaps = 0;
+
+	uint32_t NumReleasedHeaps = 0;
+};
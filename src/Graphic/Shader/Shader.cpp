@@ -1,5 +1,6 @@
 #include "Shader.h"
 #include "DXSamplerHelper.h"
+#include <algorithm>
 
 using namespace Microsoft::WRL;
 
@@ -44,13 +45,6 @@ void TShader::Initialize()
 	CreateRootSignature();
 }
 
-bool TShader::SetDescriptorCache(std::shared_ptr<TD3D12DescriptorCache> InDescriptorCache)
-{
-	descriptorCache = InDescriptorCache;
-
-	return descriptorCache != nullptr;
-}
-
 bool TShader::SetParameter(std::string ParamName, TD3D12ConstantBufferRef ConstantBufferRef)
 {
 	bool FindParam = false;
@@ -94,6 +88,22 @@ bool TShader::SetParameter(std::string ParamName, std::vector<D3D12_CPU_DESCRIPT
 	return FindParam;
 }
 
+bool TShader::SetParameter(std::string ParamName, uint32_t Value)
+{
+	bool FindParam = false;
+
+	for (const TShaderRootConstantParameter& Param : RootConstantParams)
+	{
+		if (Param.Name == ParamName)
+		{
+			RootConstants[Param.Offset] = Value;
+			FindParam = true;
+		}
+	}
+
+	return FindParam;
+}
+
 void TShader::BindParameters()
 {
 	auto CommandList = TD3D12RHI::g_CommandContext.GetCommandList();
@@ -120,8 +130,34 @@ void TShader::BindParameters()
 		}
 	}
 
+	// root constants
+	if (RootConstantBindSlot >= 0)
+	{
+		if (bComputeShader)
+		{
+			CommandList->SetComputeRoot32BitConstants(RootConstantBindSlot, (UINT)RootConstants.size(), RootConstants.data(), 0);
+		}
+		else
+		{
+			CommandList->SetGraphicsRoot32BitConstants(RootConstantBindSlot, (UINT)RootConstants.size(), RootConstants.data(), 0);
+		}
+	}
+
+	// bindless table, the whole heap. no copies and no SetDescriptorHeaps here
+	if (BindlessTableBindSlot >= 0)
+	{
+		if (bComputeShader)
+		{
+			CommandList->SetComputeRootDescriptorTable(BindlessTableBindSlot, TD3D12RHI::BindlessHeap->GetTableStart());
+		}
+		else
+		{
+			CommandList->SetGraphicsRootDescriptorTable(BindlessTableBindSlot, TD3D12RHI::BindlessHeap->GetTableStart());
+		}
+	}
+
 	// SRV binding
-	if (SRVCount>0)
+	if (SRVSignatureBindSlot >= 0)
 	{
 		std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> SrcDescriptors;
 		SrcDescriptors.resize(SRVParams.size());
@@ -135,11 +171,24 @@ void TShader::BindParameters()
 			}
 		}
 
+		// the ring of the command context, shared by every draw of the frame
+		TD3D12DescriptorCache* DescriptorCache = TD3D12RHI::g_CommandContext.GetDescriptorCache();
+
+		// a material table allocated with AllocateRange is already contiguous, copy it as one range
+		const UINT DescriptorSize = DescriptorCache->GetCbvSrvUavDescriptorSize();
+		bool bContiguous = !SrcDescriptors.empty();
+		for (UINT i = 1; i < SrcDescriptors.size() && bContiguous; ++i)
+		{
+			bContiguous = SrcDescriptors[i].ptr == SrcDescriptors[0].ptr + (SIZE_T)i * DescriptorSize;
+		}
+
 		UINT RootParamIdx = SRVSignatureBindSlot;
-		auto GpuDescriptorHanle = descriptorCache->AppendCbvSrvUavDescriptors(SrcDescriptors);
+		auto GpuDescriptorHanle = bContiguous
+			? DescriptorCache->AppendCbvSrvUavDescriptorRange(SrcDescriptors[0], (uint32_t)SrcDescriptors.size())
+			: DescriptorCache->AppendCbvSrvUavDescriptors(SrcDescriptors);
 
-		ID3D12DescriptorHeap* Heaps[] = {descriptorCache->GetCacheCbvSrvUavDescriptorHeap().Get()};
-		CommandList->SetDescriptorHeaps(1, Heaps);
+		// only the first draw after another heap was bound sets it
+		TD3D12RHI::g_CommandContext.SetDescriptorHeap(DescriptorCache->GetCacheCbvSrvUavDescriptorHeap().Get());
 
 		if (bComputeShader)
 		{
@@ -206,7 +255,42 @@ void TShader::GetShaderParameter(Microsoft::WRL::ComPtr<ID3DBlob> PassBlob, ESha
 		auto BindPoint = ResourceDesc.BindPoint;
 		auto BindCount = ResourceDesc.BindCount;
 
-		if (ResourceType == D3D_SHADER_INPUT_TYPE::D3D_SIT_CBUFFER)
+		if (ResourceType == D3D_SHADER_INPUT_TYPE::D3D_SIT_CBUFFER && RegisterSpace == BINDLESS_REGISTER_SPACE)
+		{
+			// VS and PS may both read it, one set of root constants
+			if (!RootConstantParams.empty())
+			{
+				continue;
+			}
+
+			ID3D12ShaderReflectionConstantBuffer* ConstantBuffer = Reflection->GetConstantBufferByName(ShaderVarName);
+			D3D12_SHADER_BUFFER_DESC BufferDesc;
+			ConstantBuffer->GetDesc(&BufferDesc);
+
+			for (UINT j = 0; j < BufferDesc.Variables; ++j)
+			{
+				D3D12_SHADER_VARIABLE_DESC VariableDesc;
+				ConstantBuffer->GetVariableByIndex(j)->GetDesc(&VariableDesc);
+
+				TShaderRootConstantParameter Param;
+				Param.Name = VariableDesc.Name;
+				Param.ShaderType = ShaderType;
+				Param.BindPoint = BindPoint;
+				Param.RegisterSpace = RegisterSpace;
+				Param.Offset = VariableDesc.StartOffset / 4;
+
+				RootConstantParams.push_back(Param);
+			}
+
+			RootConstantBindPoint = BindPoint;
+			RootConstants.resize(BufferDesc.Size / 4, 0);
+		}
+		else if (ResourceType == D3D_SHADER_INPUT_TYPE::D3D10_SIT_TEXTURE && RegisterSpace == BINDLESS_REGISTER_SPACE)
+		{
+			// the unbounded table covers the whole bindless heap
+			bBindlessTable = true;
+		}
+		else if (ResourceType == D3D_SHADER_INPUT_TYPE::D3D_SIT_CBUFFER)
 		{
 			TShaderCBVParameter Param;
 			Param.Name = ShaderVarName;
@@ -348,6 +432,31 @@ void TShader::CreateRootSignature()
 		SlotRootParameter.push_back(RootParam);
 	}
 
+	// root constants, visible to every stage
+	if (!RootConstants.empty())
+	{
+		RootConstantBindSlot = (UINT)SlotRootParameter.size();
+
+		CD3DX12_ROOT_PARAMETER RootParam;
+		RootParam.InitAsConstants((UINT)RootConstants.size(), RootConstantBindPoint, BINDLESS_REGISTER_SPACE);
+		SlotRootParameter.push_back(RootParam);
+	}
+
+	// bindless
+	CD3DX12_DESCRIPTOR_RANGE BindlessTable;
+	if (bBindlessTable)
+	{
+		assert(TD3D12RHI::BindlessHeap && "bindless shaders need resource binding tier 2");
+
+		BindlessTableBindSlot = (UINT)SlotRootParameter.size();
+		BindlessTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX, 0, BINDLESS_REGISTER_SPACE);
+
+		CD3DX12_ROOT_PARAMETER RootParam;
+		D3D12_SHADER_VISIBILITY ShaderVisibility = ShaderInfo.bCreateCS ? D3D12_SHADER_VISIBILITY_ALL : D3D12_SHADER_VISIBILITY_PIXEL;
+		RootParam.InitAsDescriptorTable(1, &BindlessTable, ShaderVisibility);
+		SlotRootParameter.push_back(RootParam);
+	}
+
 	// SRV
 	{
 		for (const TShaderSRVParameter& Param : SRVParams)
@@ -355,7 +464,8 @@ void TShader::CreateRootSignature()
 			SRVCount += Param.BindCount;
 		}
 
-		if (SRVCount > 0)
+		// a bindless shader may have no table of its own
+		if (SRVCount > 0 && !(bBindlessTable && SRVParams.empty()))
 		{
 			SRVSignatureBindSlot = (UINT)SlotRootParameter.size();
 			CD3DX12_DESCRIPTOR_RANGE SRVTable;
@@ -403,11 +513,6 @@ void TShader::CheckBindings()
 	{
 		assert(Param.SRVList.size() > 0);
 	}
-
-	if (descriptorCache == nullptr)
-	{
-		assert(false && "descriptorCache is null!");
-	}
 }
 
 void TShader::ClearBindings()
@@ -422,7 +527,8 @@ void TShader::ClearBindings()
 		Param.SRVList.clear();
 	}
 
-	descriptorCache->Reset();
+	// unset indices read the null view
+	std::fill(RootConstants.begin(), RootConstants.end(), 0);
 }
 
 void TShaderDefines::GetD3DShaderMacro(std::vector<D3D_SHADER_MACRO>& outMacros) const
@@ -72,6 +72,13 @@ struct TShaderSRVParameter : TShaderParameter
 	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> SRVList;
 };
 
+// a variable of the cbuffer in BINDLESS_REGISTER_SPACE, the cbuffer is set as root constants on every bind
+struct TShaderRootConstantParameter : TShaderParameter
+{
+	// in 32-bit values from the start of the cbuffer
+	UINT Offset;
+};
+
 struct TShaderUAVParameter : TShaderParameter
 {
 
@@ -111,15 +118,18 @@ public:
 
 	void Initialize();
 
-	bool SetDescriptorCache(std::shared_ptr<TD3D12DescriptorCache> InDescriptorCache);
-
 	bool SetParameter(std::string ParamName, TD3D12ConstantBufferRef ConstantBufferRef);
 
 	bool SetParameter(std::string ParamName, D3D12_CPU_DESCRIPTOR_HANDLE& SRVHandle);
 	bool SetParameter(std::string ParamName, std::vector<D3D12_CPU_DESCRIPTOR_HANDLE>& SRVHandleList);
+	// root constant, e.g. the bindless index of a texture
+	bool SetParameter(std::string ParamName, uint32_t Value);
 	// UAV
 	// ...
 
+	// a shader with an unbounded table in BINDLESS_REGISTER_SPACE reads TD3D12RHI::BindlessHeap,
+	// the caller sets the heap once before the draws instead of the descriptor cache.
+	// SRV tables are copied to the descriptor cache of TD3D12RHI::g_CommandContext
 	void BindParameters();
 
 private:
@@ -145,6 +155,7 @@ public:
 	std::vector<TShaderCBVParameter> CBVParams;
 	std::vector<TShaderSRVParameter> SRVParams;
 	std::vector<TShaderSamplerParameter> SamplerParams;
+	std::vector<TShaderRootConstantParameter> RootConstantParams;
 
 	//std::vector<TShaderUAVParameter> UAVParams;
 
@@ -161,9 +172,18 @@ public:
 
 	int SamplerSignatureBindSlot = -1;
 
+	int RootConstantBindSlot = -1;
+
+	UINT RootConstantBindPoint = 0;
+
+	// values of the RootConstantParams, 32 bits each
+	std::vector<uint32_t> RootConstants;
+
+	bool bBindlessTable = false;
+
+	int BindlessTableBindSlot = -1;
+
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3DBlob>> ShaderPass;
 
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> RootSignature;
-
-	std::shared_ptr<TD3D12DescriptorCache> descriptorCache = nullptr;
 };
\ No newline at end of file
@@ -1,8 +1,36 @@
 #include "TextureManager.h"
+#include "D3D12RHI.h"
 
 namespace TextureManager
 {
 	std::unordered_map<std::string, D3D12_CPU_DESCRIPTOR_HANDLE> m_SrvMaps;
+	std::unordered_map<std::string, TD3D12Texture> m_TextureMaps;
+	std::unique_ptr<TD3D12ReservedTexture> m_StreamedTexture;
+
+	// first mip with content, STREAMED_TEXTURE_NUM_MIPS when nothing is uploaded
+	static uint32_t StreamedMip = STREAMED_TEXTURE_NUM_MIPS;
+
+	// 8x8 squares per mip, a different color per mip so the streamed mips can be told apart
+	static void UploadCheckerMip(uint32_t Mip)
+	{
+		const uint32_t Size = (std::max)(STREAMED_TEXTURE_SIZE >> Mip, 1);
+		const uint32_t MipColor = 0xFF000000 | (0x3F << (Mip % 3 * 8)) * (1 + Mip / 3);
+
+		std::vector<uint32_t> Texels(Size * Size);
+		for (uint32_t Y = 0; Y < Size; ++Y)
+		{
+			for (uint32_t X = 0; X < Size; ++X)
+			{
+				Texels[Y * Size + X] = ((X * 8 / Size + Y * 8 / Size) & 1) ? MipColor : 0xFFFFFFFF;
+			}
+		}
+
+		D3D12_SUBRESOURCE_DATA Data;
+		Data.pData = Texels.data();
+		Data.RowPitch = Size * sizeof(uint32_t);
+		Data.SlicePitch = Data.RowPitch * Size;
+		m_StreamedTexture->UploadMip(Mip, Data);
+	}
 
 	void LoadTexture()
 	{
@@ -10,19 +38,53 @@ namespace TextureManager
 		tex.Create2D(64, 64);
 		tex.CreateDDSFromFile(L"./textures/Wood.dds", 0, false);
 		m_SrvMaps["wood"] = tex.GetSRV();
+		m_TextureMaps["wood"] = tex;
 
 		TD3D12Texture skytex;
 		skytex.CreateCube(64, 64);
 		skytex.CreateDDSFromFile(L"./textures/cubeMap.dds", 0, false);
 		m_SrvMaps["skybox"] = skytex.GetSRV();
+		m_TextureMaps["skybox"] = skytex;
 
 		TD3D12Texture lofttex;
 		lofttex.CreateCube(64, 64);
 		lofttex.CreateDDSFromFile(L"./textures/newport_loft.dds", 0, false);
 		m_SrvMaps["loft"] = lofttex.GetSRV();
+		m_TextureMaps["loft"] = lofttex;
+
+		if (TD3D12RHI::TilePoolAllocator)
+		{
+			m_StreamedTexture = std::make_unique<TD3D12ReservedTexture>();
+			m_StreamedTexture->Create2D(STREAMED_TEXTURE_SIZE, STREAMED_TEXTURE_SIZE, STREAMED_TEXTURE_NUM_MIPS);
+			StreamTexture(STREAMED_TEXTURE_MAX_MIP);
+			m_SrvMaps["streamed"] = m_StreamedTexture->GetSRV();
+		}
 	}
+
+	void StreamTexture(uint32_t MostDetailedMip)
+	{
+		assert(m_StreamedTexture && MostDetailedMip <= STREAMED_TEXTURE_MAX_MIP);
+
+		// coarse to fine, a mip is never sampled before the coarser ones
+		for (uint32_t Mip = StreamedMip; Mip-- > MostDetailedMip;)
+		{
+			m_StreamedTexture->CommitMip(Mip);
+			UploadCheckerMip(Mip);
+		}
+
+		for (uint32_t Mip = StreamedMip; Mip < MostDetailedMip; ++Mip)
+		{
+			m_StreamedTexture->DecommitMip(Mip);
+		}
+
+		StreamedMip = MostDetailedMip;
+	}
+
 	void DestroyTexture()
 	{
 		m_SrvMaps.clear();
+		m_TextureMaps.clear();
+		m_StreamedTexture.reset();
+		StreamedMip = STREAMED_TEXTURE_NUM_MIPS;
 	}
 };
@@ -1,13 +1,29 @@
 #pragma once
 #include "D3D12Texture.h"
 #include <unordered_map>
+#include <memory>
+
+// generated checker board in a reserved texture, 128x128 texel tiles: mip 4 is the last one tiled on its own
+#define STREAMED_TEXTURE_SIZE 2048
+#define STREAMED_TEXTURE_NUM_MIPS 12
+#define STREAMED_TEXTURE_MAX_MIP 4
 
 namespace TextureManager
 {
 	extern std::unordered_map<std::string, D3D12_CPU_DESCRIPTOR_HANDLE> m_SrvMaps;
 
+	// keeps the texture memory alive as long as the SRVs are in use
+	extern std::unordered_map<std::string, TD3D12Texture> m_TextureMaps;
+
+	// only the mips from the one passed to StreamTexture down have tiles, null without tiled resources tier 2
+	extern std::unique_ptr<TD3D12ReservedTexture> m_StreamedTexture;
+
 	void LoadTexture();
 
+	// commit and upload the mips from MostDetailedMip down and decommit the finer ones, MostDetailedMip is at most
+	// STREAMED_TEXTURE_MAX_MIP so the shared tiles of the packed mips stay mapped. uploads, see TD3D12ReservedTexture::UploadMip
+	void StreamTexture(uint32_t MostDetailedMip);
+
 	void DestroyTexture();
 
 };
@@ -1,17 +1,24 @@
 #include "ImGuiManager.h"
 #include "D3D12RHI.h"
 #include "Win32Application.h"
+#include "AllocationTrace.h"
 
 #include "imgui.h"
 #include "imgui_impl_win32.h"
 #include "imgui_impl_dx12.h"
 
+#include <map>
+#include <string>
+#include <fstream>
+
 using namespace TD3D12RHI;
 
 namespace ImGuiManager
 {
 	bool show_demo_window = false;
 
+	bool show_allocator_stats = false;
+
 	void InitImGui()
 	{
 		IMGUI_CHECKVERSION();
@@ -48,5 +55,115 @@ namespace ImGuiManager
 		ImGui::DestroyContext();
 	}
 
+	void AllocatorStatsWindow(bool* p_open)
+	{
+		// MB per allocator over the last frames
+		const int HistorySize = 240;
+		struct THistory
+		{
+			float Allocated[HistorySize] = {};
+			float Waste[HistorySize] = {};
+		};
+
+		static std::map<std::string, THistory> Histories;
+		static int HistoryOffset = 0;
+
+		const float MB = 1024.0f * 1024.0f;
+
+		std::vector<TD3D12AllocatorStats> Stats;
+		GetAllocatorStats(Stats);
+
+		HistoryOffset = (HistoryOffset + 1) % HistorySize;
+		for (const TD3D12AllocatorStats& AllocatorStats : Stats)
+		{
+			THistory& History = Histories[AllocatorStats.Name];
+			History.Allocated[HistoryOffset] = AllocatorStats.AllocatedSize / MB;
+			History.Waste[HistoryOffset] = (AllocatorStats.AllocatedSize - AllocatorStats.RequestedSize) / MB;
+		}
+
+		if (!*p_open)
+		{
+			return;
+		}
+
+		ImGui::Begin("Allocator Stats", p_open);
+
+		for (const TD3D12AllocatorStats& AllocatorStats : Stats)
+		{
+			if (!ImGui::CollapsingHeader(AllocatorStats.Name, ImGuiTreeNodeFlags_DefaultOpen))
+			{
+				continue;
+			}
+
+			ImGui::PushID(AllocatorStats.Name);
+
+			const float WastePercent = AllocatorStats.AllocatedSize != 0 ? 100.0f * (AllocatorStats.AllocatedSize - AllocatorStats.RequestedSize) / AllocatorStats.AllocatedSize : 0.0f;
+
+			ImGui::Text("pools %u, allocations %u, pending frees %u", AllocatorStats.NumPools, AllocatorStats.NumAllocations, AllocatorStats.NumPendingFrees);
+			ImGui::Text("reserved %.2f MB, allocated %.2f MB, requested %.2f MB", AllocatorStats.ReservedSize / MB, AllocatorStats.AllocatedSize / MB, AllocatorStats.RequestedSize / MB);
+			ImGui::Text("waste %.1f%%, largest free block %.2f MB", WastePercent, AllocatorStats.LargestFreeBlock / MB);
+
+			// oldest value first
+			const THistory& History = Histories[AllocatorStats.Name];
+			ImGui::PlotLines("allocated MB", History.Allocated, HistorySize, (HistoryOffset + 1) % HistorySize, nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+			ImGui::PlotLines("waste MB", History.Waste, HistorySize, (HistoryOffset + 1) % HistorySize, nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+
+			float FreeBlocks[32];
+			for (int Order = 0; Order < 32; ++Order)
+			{
+				FreeBlocks[Order] = (float)AllocatorStats.NumFreeBlocks[Order];
+			}
+			ImGui::PlotHistogram("free blocks by order", FreeBlocks, 32, 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+
+			ImGui::PopID();
+		}
+
+		if (ImGui::CollapsingHeader("Residency"))
+		{
+			const TMemoryBudget Budget = ResidencyManager->GetLastBudget();
+			ImGui::Text("budget %.2f MB, usage %.2f MB", Budget.Budget / MB, Budget.CurrentUsage / MB);
+			ImGui::Text("texture pools resident %.2f MB, evicted %.2f MB", ResidencyManager->GetResidentSize() / MB, ResidencyManager->GetEvictedSize() / MB);
+		}
+
+#if ALLOCATION_TRACKING
+		if (ImGui::CollapsingHeader("Live allocations by category"))
+		{
+			for (uint32_t Category = 0; Category < (uint32_t)EAllocationCategory::Count; ++Category)
+			{
+				const TD3D12AllocationTracker::TCategoryStats CategoryStats = TD3D12AllocationTracker::Get().GetCategoryStats((EAllocationCategory)Category);
+				ImGui::Text("%s: %u, %.2f MB", GetAllocationCategoryName((EAllocationCategory)Category), CategoryStats.NumAllocations, CategoryStats.Size / MB);
+			}
+		}
+#endif
+
+		if (ImGui::Button("Dump JSON"))
+		{
+			std::ofstream File("AllocatorDump.json");
+			File << DumpAllocatorsJson();
+		}
+
+		// capture the allocations of the next frames, replay them against every allocator variant
+		ImGui::SameLine();
+		if (!TAllocationTraceRecorder::Get().IsRecording())
+		{
+			if (ImGui::Button("Record Trace"))
+			{
+				BeginAllocationTrace();
+			}
+		}
+		else if (ImGui::Button("Stop Trace"))
+		{
+			EndAllocationTrace("AllocatorTrace.bin");
+		}
+
+		ImGui::SameLine();
+		if (ImGui::Button("Replay Trace"))
+		{
+			BenchmarkAllocationTrace("AllocatorTrace.bin");
+		}
+
+		ImGui::End();
+	}
+
 }
 
@@ -4,8 +4,13 @@ namespace ImGuiManager
 {
 	extern bool show_demo_window;
 
+	extern bool show_allocator_stats;
+
 	void InitImGui();
 
 	void DestroyImGui();
+
+	// records the allocator statistics every frame, draws them while p_open is set
+	void AllocatorStatsWindow(bool* p_open);
 };
 
@@ -0,0 +1,116 @@
+#include "HostTest.h"
+#include "AliasingPlanner.h"
+
+namespace
+{
+	TAliasingResource MakeResource(uint64_t Size, uint32_t FirstPass, uint32_t LastPass, uint64_t Alignment = 65536)
+	{
+		TAliasingResource Resource;
+		Resource.Size = Size;
+		Resource.Alignment = Alignment;
+		Resource.FirstPass = FirstPass;
+		Resource.LastPass = LastPass;
+		return Resource;
+	}
+
+	// the resources that used the memory of resource Index in an earlier pass, by the definition of TAliasingPlan
+	int32_t BruteForcePredecessor(const TAliasingPlan& Plan, const std::vector<TAliasingResource>& Resources, uint32_t Index)
+	{
+		int32_t Predecessor = TAliasingPlan::NO_PREDECESSOR;
+		for (uint32_t Other = 0; Other < Resources.size(); ++Other)
+		{
+			if (Resources[Other].LastPass < Resources[Index].FirstPass && TAliasingPlanner::MemoryOverlaps(Plan, Resources, Index, Other))
+			{
+				Predecessor = Predecessor == TAliasingPlan::NO_PREDECESSOR ? (int32_t)Other : TAliasingPlan::ANY_PREDECESSOR;
+			}
+		}
+		return Predecessor;
+	}
+}
+
+// a resource of a later pass reuses the memory of an earlier one and needs a barrier naming it
+HOST_TEST(AliasingDisjointPassesShareMemory)
+{
+	const std::vector<TAliasingResource> Resources = { MakeResource(1 << 20, 0, 1), MakeResource(1 << 20, 2, 3) };
+	const TAliasingPlan Plan = TAliasingPlanner::Plan(Resources);
+
+	CHECK_EQ(Plan.HeapSize, (uint64_t)1 << 20);
+	CHECK_EQ(Plan.Offsets[0], 0u);
+	CHECK_EQ(Plan.Offsets[1], 0u);
+	CHECK_EQ(Plan.Predecessors[0], TAliasingPlan::NO_PREDECESSOR);
+	CHECK_EQ(Plan.Predecessors[1], 0);
+}
+
+HOST_TEST(AliasingOverlappingPassesDontShareMemory)
+{
+	const std::vector<TAliasingResource> Resources = { MakeResource(1 << 20, 0, 2), MakeResource(1 << 20, 2, 3) };
+	const TAliasingPlan Plan = TAliasingPlanner::Plan(Resources);
+
+	CHECK_EQ(Plan.HeapSize, (uint64_t)2 << 20);
+	CHECK(Plan.Offsets[0] != Plan.Offsets[1]);
+	CHECK_EQ(Plan.Predecessors[0], TAliasingPlan::NO_PREDECESSOR);
+	CHECK_EQ(Plan.Predecessors[1], TAliasingPlan::NO_PREDECESSOR);
+}
+
+// a large target over two small ones of an earlier pass can't name a single resource before
+HOST_TEST(AliasingSeveralPredecessors)
+{
+	const std::vector<TAliasingResource> Resources = { MakeResource(1 << 16, 0, 0), MakeResource(1 << 16, 0, 0), MakeResource(1 << 17, 1, 1) };
+	const TAliasingPlan Plan = TAliasingPlanner::Plan(Resources);
+
+	CHECK_EQ(Plan.HeapSize, (uint64_t)1 << 17);
+	CHECK_EQ(Plan.Predecessors[0], TAliasingPlan::NO_PREDECESSOR);
+	CHECK_EQ(Plan.Predecessors[1], TAliasingPlan::NO_PREDECESSOR);
+	CHECK_EQ(Plan.Predecessors[2], TAliasingPlan::ANY_PREDECESSOR);
+}
+
+// random frames: live resources never share memory, offsets are aligned and inside the heap
+HOST_TEST(AliasingRandomFramesNeverOverlap)
+{
+	THostRandom Random(16);
+
+	for (uint32_t Frame = 0; Frame < 500; ++Frame)
+	{
+		std::vector<TAliasingResource> Resources(Random.Range(1, 24));
+		for (TAliasingResource& Resource : Resources)
+		{
+			// 64KB placement, 4MB for MSAA targets
+			const uint64_t Alignment = Random.Chance(20) ? 4 << 20 : 65536;
+			const uint32_t FirstPass = Random.Uniform(16);
+			Resource = MakeResource((uint64_t)Random.Range(1, 256) * 16384, FirstPass, FirstPass + Random.Uniform(4), Alignment);
+		}
+
+		const TAliasingPlan Plan = TAliasingPlanner::Plan(Resources);
+		CHECK_EQ(Plan.Offsets.size(), Resources.size());
+		CHECK_EQ(Plan.Predecessors.size(), Resources.size());
+
+		uint64_t UpperBound = 0;
+		for (uint32_t i = 0; i < Resources.size(); ++i)
+		{
+			CHECK_EQ(Plan.Offsets[i] % Resources[i].Alignment, 0u);
+			CHECK(Plan.Offsets[i] + Resources[i].Size <= Plan.HeapSize);
+			CHECK_EQ(Plan.Predecessors[i], BruteForcePredecessor(Plan, Resources, i));
+
+			for (uint32_t j = i + 1; j < Resources.size(); ++j)
+			{
+				const bool bLiveTogether = Resources[i].FirstPass <= Resources[j].LastPass && Resources[j].FirstPass <= Resources[i].LastPass;
+				const bool bShareMemory = Plan.Offsets[i] < Plan.Offsets[j] + Resources[j].Size && Plan.Offsets[j] < Plan.Offsets[i] + Resources[i].Size;
+				CHECK(!bLiveTogether || !bShareMemory);
+			}
+
+			UpperBound += Resources[i].Size + Resources[i].Alignment;
+		}
+
+		// never worse than no aliasing at all, never smaller than the busiest pass
+		CHECK(Plan.HeapSize <= UpperBound);
+		for (uint32_t Pass = 0; Pass < 20; ++Pass)
+		{
+			uint64_t PassSize = 0;
+			for (const TAliasingResource& Resource : Resources)
+			{
+				PassSize += Resource.FirstPass <= Pass && Pass <= Resource.LastPass ? Resource.Size : 0;
+			}
+			CHECK(Plan.HeapSize >= PassSize);
+		}
+	}
+}
@@ -0,0 +1,111 @@
+#include "HostTest.h"
+#include "D3D12AllocationTracker.h"
+#include <string.h>
+#include <thread>
+
+// the tracker only keys on the address, the real location lives in D3D12Resource.h
+class TD3D12ResourceLocation
+{
+public:
+	TAllocationTag Tag;
+};
+
+// the macros fill the tag the sub-allocator records later
+HOST_TEST(TrackerTagMacros)
+{
+	TD3D12ResourceLocation Location;
+	CHECK(Location.Tag.Name == nullptr);
+
+	SET_ALLOCATION_TAG_NAMED(Location, VertexBuffer, "Mesh");
+	CHECK(Location.Tag.Category == EAllocationCategory::VertexBuffer);
+	CHECK(strcmp(Location.Tag.Name, "Mesh") == 0);
+
+	SET_ALLOCATION_TAG(Location, Texture);
+	CHECK(Location.Tag.Category == EAllocationCategory::Texture);
+	CHECK(Location.Tag.Name != nullptr);
+
+	CHECK(strcmp(GetAllocationCategoryName(EAllocationCategory::Staging), "Staging") == 0);
+	CHECK(strcmp(GetAllocationCategoryName(EAllocationCategory::Count), "Unknown") == 0);
+}
+
+// the category totals follow track and untrack, an untracked location is ignored
+HOST_TEST(TrackerCategoryStats)
+{
+	TD3D12AllocationTracker Tracker;
+	TD3D12ResourceLocation Vertices[3];
+	TD3D12ResourceLocation Texture;
+
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		Tracker.Track(Vertices[i], TAllocationTag{ EAllocationCategory::VertexBuffer, "Mesh" }, 256 * (i + 1));
+	}
+	Tracker.Track(Texture, TAllocationTag{ EAllocationCategory::Texture, "Albedo" }, 65536);
+
+	CHECK_EQ(Tracker.GetCategoryStats(EAllocationCategory::VertexBuffer).NumAllocations, 3u);
+	CHECK_EQ(Tracker.GetCategoryStats(EAllocationCategory::VertexBuffer).Size, 1536u);
+	CHECK_EQ(Tracker.GetCategoryStats(EAllocationCategory::Texture).Size, 65536u);
+	CHECK_EQ(Tracker.GetCategoryStats(EAllocationCategory::IndexBuffer).NumAllocations, 0u);
+
+	uint64_t Size = 0;
+	uint32_t NumAllocations = 0;
+	Tracker.ForEachAllocation(EAllocationCategory::VertexBuffer, [&](const TD3D12ResourceLocation* Location, const TD3D12AllocationTracker::TEntry& Entry)
+	{
+		CHECK(Location >= Vertices && Location < Vertices + 3);
+		CHECK(strcmp(Entry.Tag.Name, "Mesh") == 0);
+		Size += Entry.Size;
+		++NumAllocations;
+	});
+	CHECK_EQ(NumAllocations, 3u);
+	CHECK_EQ(Size, 1536u);
+
+	Tracker.Untrack(Vertices[1]);
+	Tracker.Untrack(Vertices[1]);
+	CHECK_EQ(Tracker.GetCategoryStats(EAllocationCategory::VertexBuffer).NumAllocations, 2u);
+	CHECK_EQ(Tracker.GetCategoryStats(EAllocationCategory::VertexBuffer).Size, 1024u);
+	CHECK_EQ(Tracker.ReportLiveAllocations(), 3u);
+
+	Tracker.Untrack(Vertices[0]);
+	Tracker.Untrack(Vertices[2]);
+	Tracker.Untrack(Texture);
+	CHECK_EQ(Tracker.ReportLiveAllocations(), 0u);
+	CHECK_EQ(Tracker.GetCategoryStats(EAllocationCategory::Texture).Size, 0u);
+}
+
+// loader threads allocate and free at the same time, the totals end at zero
+HOST_TEST(TrackerConcurrentTracking)
+{
+	const uint32_t NumThreads = 4;
+	const uint32_t NumPerThread = 20000;
+
+	TD3D12AllocationTracker Tracker;
+	std::vector<std::vector<TD3D12ResourceLocation>> Locations(NumThreads, std::vector<TD3D12ResourceLocation>(NumPerThread));
+
+	std::vector<std::thread> Threads;
+	for (uint32_t ThreadIndex = 0; ThreadIndex < NumThreads; ++ThreadIndex)
+	{
+		Threads.emplace_back([&Tracker, &Locations, ThreadIndex]()
+		{
+			const TAllocationTag Tag{ (EAllocationCategory)(1 + ThreadIndex % 2), "Loader" };
+			for (uint32_t i = 0; i < NumPerThread; ++i)
+			{
+				Tracker.Track(Locations[ThreadIndex][i], Tag, 256);
+
+				// every tenth one stays alive
+				if (i % 10 != 0)
+				{
+					Tracker.Untrack(Locations[ThreadIndex][i]);
+				}
+			}
+		});
+	}
+
+	for (std::thread& Thread : Threads)
+	{
+		Thread.join();
+	}
+
+	const uint32_t NumAlive = NumThreads * NumPerThread / 10;
+	CHECK_EQ(Tracker.GetCategoryStats(EAllocationCategory::VertexBuffer).NumAllocations, NumAlive / 2);
+	CHECK_EQ(Tracker.GetCategoryStats(EAllocationCategory::IndexBuffer).Size, (uint64_t)NumAlive / 2 * 256);
+	CHECK_EQ(Tracker.ReportLiveAllocations(), NumAlive);
+}
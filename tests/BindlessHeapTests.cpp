@@ -0,0 +1,116 @@
+#include "HostTest.h"
+#include "D3D12BindlessHeap.h"
+#include "D3D12RHI.h"
+#include <set>
+#include <thread>
+
+namespace
+{
+	// address of descriptor Index in the bindless heap
+	SIZE_T BindlessHandle(const TD3D12BindlessHeap& Bindless, uint32_t Index)
+	{
+		return Bindless.GetHeap()->GetCPUDescriptorHandleForHeapStart().ptr + (SIZE_T)Index * ID3D12Device::DescriptorSize;
+	}
+}
+
+// the null view takes BINDLESS_NULL_INDEX, textures start after it and their SRV lands at their index
+HOST_TEST(BindlessNullIndexIsReserved)
+{
+	ID3D12Device Device;
+	TD3D12BindlessHeap Bindless(&Device, 16);
+
+	CHECK_EQ(Bindless.GetHeap()->GetDesc().Flags, D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE);
+	CHECK_EQ(Device.Writes.size(), (size_t)1);
+	CHECK_EQ(Device.Writes[0].Dst, BindlessHandle(Bindless, BINDLESS_NULL_INDEX));
+	CHECK_EQ(Device.Writes[0].Src, (SIZE_T)0);
+
+	const uint32_t Index = Bindless.Register({ 0x5000 });
+	CHECK_EQ(Index, 1u);
+	CHECK_EQ(Bindless.GetNumRegistered(), 1u);
+	CHECK_EQ(Device.Writes.back().Dst, BindlessHandle(Bindless, Index));
+	CHECK_EQ(Device.Writes.back().Src, (SIZE_T)0x5000);
+
+	Bindless.Update(Index, { 0x6000 });
+	CHECK_EQ(Device.Writes.back().Dst, BindlessHandle(Bindless, Index));
+	CHECK_EQ(Device.Writes.back().Src, (SIZE_T)0x6000);
+
+	// releasing the null index is a no-op
+	Bindless.Release(BINDLESS_NULL_INDEX);
+	Bindless.CleanUpAllocations(UINT64_MAX);
+	CHECK_EQ(Bindless.Register({ 0x7000 }), 2u);
+}
+
+// a released index stays taken until the frames recorded before the release have completed
+HOST_TEST(BindlessReleaseWaitsForTheFence)
+{
+	ID3D12Device Device;
+	TD3D12BindlessHeap Bindless(&Device, 16);
+
+	const uint32_t First = Bindless.Register({ 0x1000 });
+	Bindless.Register({ 0x2000 });
+
+	TD3D12RHI::g_CommandContext.NextFenceValue = 5;
+	Bindless.Release(First);
+
+	Bindless.CleanUpAllocations(4);
+	CHECK(Bindless.Register({ 0x3000 }) != First);
+	CHECK_EQ(Bindless.GetNumRegistered(), 3u);
+
+	Bindless.CleanUpAllocations(5);
+	CHECK_EQ(Bindless.GetNumRegistered(), 2u);
+	CHECK_EQ(Bindless.Register({ 0x4000 }), First);
+
+	TD3D12RHI::g_CommandContext.NextFenceValue = 1;
+}
+
+HOST_TEST(BindlessFullHeapReturnsTheNullIndex)
+{
+	ID3D12Device Device;
+	TD3D12BindlessHeap Bindless(&Device, 4);
+
+	for (uint32_t i = 1; i < 4; ++i)
+	{
+		CHECK_EQ(Bindless.Register({ 0x1000 * i }), i);
+	}
+
+	const size_t NumWrites = Device.Writes.size();
+	CHECK_EQ(Bindless.Register({ 0x9000 }), (uint32_t)BINDLESS_NULL_INDEX);
+	CHECK_EQ(Device.Writes.size(), NumWrites);
+	CHECK_EQ(Bindless.GetNumRegistered(), 3u);
+}
+
+// loader threads register textures at the same time, every one gets its own index
+HOST_TEST(BindlessConcurrentRegisters)
+{
+	const uint32_t NumThreads = 4;
+	const uint32_t NumPerThread = 2000;
+
+	ID3D12Device Device;
+	TD3D12BindlessHeap Bindless(&Device, NumThreads * NumPerThread + 1);
+
+	std::vector<std::vector<uint32_t>> Indices(NumThreads);
+	std::vector<std::thread> Threads;
+	for (uint32_t ThreadIndex = 0; ThreadIndex < NumThreads; ++ThreadIndex)
+	{
+		Threads.emplace_back([&Bindless, &Indices, ThreadIndex]()
+		{
+			for (uint32_t i = 0; i < NumPerThread; ++i)
+			{
+				Indices[ThreadIndex].push_back(Bindless.Register({ 0x1000 }));
+			}
+		});
+	}
+
+	for (std::thread& Thread : Threads)
+	{
+		Thread.join();
+	}
+
+	std::set<uint32_t> Unique;
+	for (const std::vector<uint32_t>& ThreadIndices : Indices)
+	{
+		Unique.insert(ThreadIndices.begin(), ThreadIndices.end());
+	}
+	CHECK_EQ(Unique.size(), (size_t)NumThreads * NumPerThread);
+	CHECK(Unique.count(BINDLESS_NULL_INDEX) == 0);
+}
@@ -0,0 +1,457 @@
+#include "HostTest.h"
+#include "BuddyAllocator.h"
+#include <string.h>
+
+namespace
+{
+	// brute force reference for FindBestRun: shortest maximal run of at least Count set bits, the lowest on a tie
+	uint32_t FindBestRunReference(const std::vector<bool>& Bits, uint32_t Count, uint32_t& OutIndex)
+	{
+		uint32_t BestLength = 0;
+		for (uint32_t i = 0; i < Bits.size();)
+		{
+			if (!Bits[i])
+			{
+				++i;
+				continue;
+			}
+
+			uint32_t End = i;
+			while (End < Bits.size() && Bits[End])
+			{
+				++End;
+			}
+
+			const uint32_t Length = End - i;
+			if (Length >= Count && (BestLength == 0 || Length < BestLength))
+			{
+				BestLength = Length;
+				OutIndex = i;
+			}
+			i = End;
+		}
+
+		return BestLength;
+	}
+
+	struct TLiveBlock
+	{
+		TBuddyAllocation Allocation;
+
+		uint64_t Size;
+
+		uint8_t Pattern;
+	};
+
+	// keeps only the size, for pools too large to back with system memory
+	class TSizeOnlyBackingStore
+	{
+	public:
+		void Create(uint64_t PoolSize)
+		{
+			Size = PoolSize;
+		}
+
+		uint64_t Size = 0;
+	};
+}
+
+HOST_TEST(EmptyBitmap)
+{
+	TFreeBlockBitmap Bitmap;
+	Bitmap.Initialize(0);
+
+	CHECK(Bitmap.Empty());
+
+	uint32_t NumSet = 0;
+	Bitmap.ForEachSetBit([&](uint32_t) { ++NumSet; });
+	CHECK_EQ(NumSet, 0u);
+}
+
+HOST_TEST(BitmapMatchesReference)
+{
+	THostRandom Random(1);
+
+	for (uint32_t NumBits : { 1u, 63u, 64u, 65u, 4096u, 4097u, 70000u })
+	{
+		TFreeBlockBitmap Bitmap;
+		Bitmap.Initialize(NumBits);
+		std::vector<bool> Reference(NumBits, false);
+
+		for (uint32_t Step = 0; Step < 20000; ++Step)
+		{
+			const uint32_t Index = Random.Uniform(NumBits);
+			if (Reference[Index])
+			{
+				Bitmap.Clear(Index);
+			}
+			else
+			{
+				Bitmap.Set(Index);
+			}
+			Reference[Index] = !Reference[Index];
+
+			if (Step % 97 != 0)
+			{
+				continue;
+			}
+
+			uint32_t First = 0;
+			while (First < NumBits && !Reference[First])
+			{
+				++First;
+			}
+
+			CHECK_EQ(Bitmap.Empty(), First == NumBits);
+			if (First < NumBits)
+			{
+				CHECK_EQ(Bitmap.FindFirst(), First);
+			}
+
+			uint32_t Count = Random.Range(1, 8);
+			uint32_t ExpectedIndex = 0;
+			uint32_t Index2 = 0;
+			const uint32_t ExpectedLength = FindBestRunReference(Reference, Count, ExpectedIndex);
+			const uint32_t Length = Bitmap.FindBestRun(Count, Index2);
+			CHECK_EQ(Length, ExpectedLength);
+			if (Length != 0)
+			{
+				CHECK_EQ(Index2, ExpectedIndex);
+			}
+		}
+
+		uint32_t Previous = 0;
+		bool bFirst = true;
+		uint32_t NumSet = 0;
+		Bitmap.ForEachSetBit([&](uint32_t Index)
+		{
+			CHECK(Reference[Index]);
+			CHECK(bFirst || Index > Previous);
+			Previous = Index;
+			bFirst = false;
+			++NumSet;
+		});
+
+		uint32_t ExpectedSet = 0;
+		for (bool bSet : Reference)
+		{
+			ExpectedSet += bSet ? 1 : 0;
+		}
+		CHECK_EQ(NumSet, ExpectedSet);
+	}
+}
+
+HOST_TEST(AllocatesLowestOffsetFirst)
+{
+	TBuddyAllocator<THostBackingStore> Allocator(1024, 16, 0);
+
+	CHECK_EQ(Allocator.GetPoolSize(), 1024u);
+	CHECK_EQ(Allocator.GetMaxOrder(), 6u);
+
+	TBuddyAllocation A, B, C;
+	CHECK(Allocator.Allocate(16, 0, A));
+	CHECK(Allocator.Allocate(32, 0, B));
+	CHECK(Allocator.Allocate(16, 0, C));
+
+	CHECK_EQ(A.Offset, 0u);
+	CHECK_EQ(A.Order, 0u);
+	CHECK_EQ(B.Offset, 2u);
+	CHECK_EQ(B.Order, 1u);
+	CHECK_EQ(C.Offset, 1u);
+	CHECK_EQ(Allocator.GetTotalAllocSize(), 64u);
+
+	Allocator.Deallocate(A.Offset, A.Order);
+	Allocator.Deallocate(C.Offset, C.Order);
+	Allocator.Deallocate(B.Offset, B.Order);
+
+	// everything merged back into one block
+	CHECK_EQ(Allocator.GetTotalAllocSize(), 0u);
+	CHECK_EQ(Allocator.GetNumFreeBlocks(6), 1u);
+	CHECK_EQ(Allocator.GetLargestFreeOrder(), 6);
+}
+
+HOST_TEST(SplitTopLevelBlocks)
+{
+	// 10 top level blocks of 256 bytes, they never merge
+	TBuddyAllocator<THostBackingStore> Allocator(2500, 16, 4);
+
+	CHECK_EQ(Allocator.GetPoolSize(), 2560u);
+	CHECK_EQ(Allocator.GetMaxBlockSize(), 256u);
+	CHECK_EQ(Allocator.GetNumFreeBlocks(4), 10u);
+
+	TBuddyAllocation Allocation;
+	CHECK(!Allocator.Allocate(257, 0, Allocation));
+
+	std::vector<TBuddyAllocation> Blocks;
+	while (Allocator.Allocate(256, 0, Allocation))
+	{
+		Blocks.push_back(Allocation);
+	}
+	CHECK_EQ(Blocks.size(), 10u);
+	CHECK_EQ(Allocator.GetLargestFreeOrder(), -1);
+
+	for (const TBuddyAllocation& Block : Blocks)
+	{
+		Allocator.Deallocate(Block.Offset, Block.Order);
+	}
+	CHECK_EQ(Allocator.GetNumFreeBlocks(4), 10u);
+}
+
+// one block over the whole pool: a size that isn't a power of two rounds up to the next one
+HOST_TEST(SingleTopLevelBlockRoundsUp)
+{
+	TBuddyAllocator<TSizeOnlyBackingStore> Allocator(5000, 16, 0);
+
+	CHECK_EQ(Allocator.GetPoolSize(), 8192u);
+	CHECK_EQ(Allocator.GetBackingStore().Size, 8192u);
+	CHECK_EQ(Allocator.GetMaxBlockSize(), 8192u);
+
+	TBuddyAllocation Allocation;
+	CHECK(Allocator.Allocate(5000, 0, Allocation));
+	CHECK_EQ(Allocation.Order, 9u);
+	CHECK(!Allocator.Allocate(8192 - 5000, 0, Allocation));
+}
+
+// byte offsets and sizes past 4GB, the offsets in MinBlockSize units still fit in 32 bits
+HOST_TEST(PoolsLargerThan4GB)
+{
+	const uint64_t GB = (uint64_t)1 << 30;
+
+	// three top level blocks of 2GB in 64KB units
+	TBuddyAllocator<TSizeOnlyBackingStore> Allocator(5 * GB, 65536, 15);
+
+	CHECK_EQ(Allocator.GetPoolSize(), 6 * GB);
+	CHECK_EQ(Allocator.GetBackingStore().Size, 6 * GB);
+	CHECK_EQ(Allocator.GetMaxBlockSize(), 2 * GB);
+	CHECK_EQ(Allocator.GetNumFreeBlocks(15), 3u);
+
+	TBuddyAllocation A, B, C;
+	CHECK(Allocator.Allocate(2 * GB, 0, A));
+	CHECK(Allocator.Allocate(GB + 1, 0, B));
+	CHECK(Allocator.Allocate(65536, 65536, C));
+
+	CHECK_EQ(A.AlignedOffset, 0u);
+	CHECK_EQ(B.AlignedOffset, 2 * GB);
+	CHECK_EQ(C.AlignedOffset, 4 * GB);
+	CHECK_EQ(Allocator.GetTotalAllocSize(), 4 * GB + 65536);
+
+	Allocator.Deallocate(C.Offset, C.Order);
+	Allocator.Deallocate(B.Offset, B.Order);
+	CHECK_EQ(Allocator.GetTotalAllocSize(), 2 * GB);
+	CHECK_EQ(Allocator.GetNumFreeBlocks(15), 2u);
+}
+
+HOST_TEST(AlignmentLargerThanMinBlock)
+{
+	TBuddyAllocator<THostBackingStore> Allocator(1 << 20, 256, 0);
+
+	TBuddyAllocation Small;
+	CHECK(Allocator.Allocate(256, 0, Small));
+
+	// 4KB alignment on a 256 byte block size pads the request
+	TBuddyAllocation Aligned;
+	CHECK(Allocator.Allocate(1000, 4096, Aligned));
+	CHECK_EQ(Aligned.AlignedOffset % 4096, 0u);
+
+	const uint64_t BlockStart = (uint64_t)Aligned.Offset * 256;
+	const uint64_t BlockEnd = BlockStart + ((uint64_t)256 << Aligned.Order);
+	CHECK(Aligned.AlignedOffset >= BlockStart);
+	CHECK(Aligned.AlignedOffset + 1000 <= BlockEnd);
+}
+
+// random churn on system memory: every live block is filled with its own byte,
+// an overlap would overwrite another block's bytes before it is freed
+HOST_TEST(RandomChurnOnHostMemory)
+{
+	THostRandom Random(7);
+
+	TBuddyAllocator<THostBackingStore> Allocator(4 << 20, 256, 0);
+	uint8_t* const Base = Allocator.GetBackingStore().GetBaseAddress();
+	CHECK(Base != nullptr);
+
+	const uint64_t Alignments[] = { 0, 256, 512, 4096, 65536 };
+
+	std::vector<TLiveBlock> Live;
+	uint64_t ExpectedAllocSize = 0;
+	uint32_t NumFailed = 0;
+
+	for (uint32_t Step = 0; Step < 30000; ++Step)
+	{
+		if (Live.empty() || Random.Chance(55))
+		{
+			const uint64_t Size = Random.Range(1, 64 * 1024);
+			const uint64_t Alignment = Alignments[Random.Uniform(5)];
+
+			TLiveBlock Block;
+			if (!Allocator.Allocate(Size, Alignment, Block.Allocation))
+			{
+				++NumFailed;
+				continue;
+			}
+
+			Block.Size = Size;
+			Block.Pattern = (uint8_t)Random.Next();
+
+			CHECK(Alignment == 0 || Block.Allocation.AlignedOffset % Alignment == 0);
+			CHECK(Block.Allocation.AlignedOffset + Size <= Allocator.GetPoolSize());
+
+			memset(Base + Block.Allocation.AlignedOffset, Block.Pattern, (size_t)Size);
+			ExpectedAllocSize += (uint64_t)256 << Block.Allocation.Order;
+			Live.push_back(Block);
+		}
+		else
+		{
+			const uint32_t Index = Random.Uniform((uint32_t)Live.size());
+			const TLiveBlock Block = Live[Index];
+			Live[Index] = Live.back();
+			Live.pop_back();
+
+			const uint8_t* Bytes = Base + Block.Allocation.AlignedOffset;
+			bool bIntact = true;
+			for (uint64_t i = 0; i < Block.Size; ++i)
+			{
+				bIntact &= Bytes[i] == Block.Pattern;
+			}
+			CHECK(bIntact);
+
+			Allocator.Deallocate(Block.Allocation.Offset, Block.Allocation.Order);
+			ExpectedAllocSize -= (uint64_t)256 << Block.Allocation.Order;
+		}
+
+		CHECK_EQ(Allocator.GetTotalAllocSize(), ExpectedAllocSize);
+	}
+
+	// the pool ran full at some point, so the failure path was taken
+	CHECK(NumFailed > 0);
+
+	for (const TLiveBlock& Block : Live)
+	{
+		Allocator.Deallocate(Block.Allocation.Offset, Block.Allocation.Order);
+	}
+
+	CHECK_EQ(Allocator.GetTotalAllocSize(), 0u);
+	CHECK_EQ(Allocator.GetNumFreeBlocks(Allocator.GetMaxOrder()), 1u);
+	for (uint32_t Order = 0; Order < Allocator.GetMaxOrder(); ++Order)
+	{
+		CHECK_EQ(Allocator.GetNumFreeBlocks(Order), 0u);
+	}
+}
+
+HOST_TEST(ForEachFreeBlockCoversTheFreeSpace)
+{
+	THostRandom Random(3);
+
+	TBuddyAllocator<THostBackingStore> Allocator(1 << 20, 64, 0);
+
+	std::vector<TBuddyAllocation> Live;
+	for (uint32_t Step = 0; Step < 2000; ++Step)
+	{
+		TBuddyAllocation Allocation;
+		if (Random.Chance(60) && Allocator.Allocate(Random.Range(1, 4096), 0, Allocation))
+		{
+			Live.push_back(Allocation);
+		}
+		else if (!Live.empty())
+		{
+			const uint32_t Index = Random.Uniform((uint32_t)Live.size());
+			Allocator.Deallocate(Live[Index].Offset, Live[Index].Order);
+			Live[Index] = Live.back();
+			Live.pop_back();
+		}
+	}
+
+	// free and allocated blocks tile the pool exactly once
+	std::vector<uint8_t> Owners((1 << 20) / 64, 0);
+	std::vector<uint32_t> NumFreeBlocks(Allocator.GetMaxOrder() + 1, 0);
+	uint64_t FreeBytes = 0;
+	Allocator.ForEachFreeBlock([&](uint32_t Offset, uint32_t Order)
+	{
+		for (uint32_t i = 0; i < (1u << Order); ++i)
+		{
+			++Owners[Offset + i];
+		}
+		++NumFreeBlocks[Order];
+		FreeBytes += (uint64_t)64 << Order;
+	});
+
+	// the per order counters of the stats agree with the enumeration
+	for (uint32_t Order = 0; Order <= Allocator.GetMaxOrder(); ++Order)
+	{
+		CHECK_EQ(Allocator.GetNumFreeBlocks(Order), NumFreeBlocks[Order]);
+	}
+
+	for (const TBuddyAllocation& Allocation : Live)
+	{
+		for (uint32_t i = 0; i < (1u << Allocation.Order); ++i)
+		{
+			++Owners[Allocation.Offset + i];
+		}
+	}
+
+	bool bTiled = true;
+	for (uint8_t Count : Owners)
+	{
+		bTiled &= Count == 1;
+	}
+	CHECK(bTiled);
+	CHECK_EQ(FreeBytes + Allocator.GetTotalAllocSize(), Allocator.GetPoolSize());
+}
+
+// the index against a scan over every pool: the pool with the smallest sufficient largest free order, the lowest slot on a tie
+HOST_TEST(PoolIndexMatchesScan)
+{
+	THostRandom Random(13);
+
+	const uint32_t NumPools = 300;
+	std::vector<std::unique_ptr<TBuddyAllocator<THostBackingStore>>> Pools;
+	std::vector<std::vector<TBuddyAllocation>> Live(NumPools);
+	TBuddyPoolIndex Index;
+
+	for (uint32_t Slot = 0; Slot < NumPools; ++Slot)
+	{
+		Pools.push_back(std::make_unique<TBuddyAllocator<THostBackingStore>>(64 * 1024, 256, 0));
+		Index.Update(Slot, Pools[Slot]->GetLargestFreeOrder());
+	}
+
+	for (uint32_t Step = 0; Step < 50000; ++Step)
+	{
+		const uint32_t Slot = Random.Uniform(NumPools);
+		TBuddyAllocator<THostBackingStore>& Pool = *Pools[Slot];
+
+		TBuddyAllocation Allocation;
+		if (Random.Chance(55) && Pool.Allocate(Random.Range(1, 16 * 1024), 0, Allocation))
+		{
+			Live[Slot].push_back(Allocation);
+		}
+		else if (!Live[Slot].empty())
+		{
+			const uint32_t Victim = Random.Uniform((uint32_t)Live[Slot].size());
+			Pool.Deallocate(Live[Slot][Victim].Offset, Live[Slot][Victim].Order);
+			Live[Slot][Victim] = Live[Slot].back();
+			Live[Slot].pop_back();
+		}
+		Index.Update(Slot, Pool.GetLargestFreeOrder());
+
+		const uint32_t Order = Random.Uniform(Pool.GetMaxOrder() + 2);
+
+		int32_t ExpectedSlot = -1;
+		int32_t ExpectedOrder = INT32_MAX;
+		for (uint32_t i = 0; i < NumPools; ++i)
+		{
+			const int32_t Largest = Pools[i]->GetLargestFreeOrder();
+			if (Largest >= (int32_t)Order && Largest < ExpectedOrder)
+			{
+				ExpectedOrder = Largest;
+				ExpectedSlot = (int32_t)i;
+			}
+		}
+
+		uint32_t Found = 0;
+		const bool bFound = Index.Find(Order, Found);
+		CHECK_EQ(bFound, ExpectedSlot >= 0);
+		if (bFound && ExpectedSlot >= 0)
+		{
+			CHECK_EQ(Found, (uint32_t)ExpectedSlot);
+		}
+	}
+}
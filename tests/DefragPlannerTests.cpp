@@ -0,0 +1,271 @@
+#include "HostTest.h"
+#include "BuddyDefragPlanner.h"
+#include <string.h>
+
+namespace
+{
+	typedef TBuddyAllocator<THostBackingStore> THostPool;
+	typedef TBuddyDefragPlanner<THostBackingStore> THostPlanner;
+
+	const uint64_t MIN_BLOCK_SIZE = 256;
+
+	struct TTraceBlock
+	{
+		TDefragBlock Block;
+
+		uint8_t Pattern;
+	};
+
+	// a synthetic fragmented heap: every pool is filled, then most blocks are freed at random
+	struct TFragmentedTrace
+	{
+		std::vector<std::unique_ptr<THostPool>> Pools;
+
+		std::vector<TTraceBlock> Live;
+
+		std::vector<THostPool*> GetPools() const
+		{
+			std::vector<THostPool*> Result;
+			for (const auto& Pool : Pools)
+			{
+				Result.push_back(Pool.get());
+			}
+			return Result;
+		}
+
+		std::vector<TDefragBlock> GetBlocks() const
+		{
+			std::vector<TDefragBlock> Result;
+			for (const TTraceBlock& Block : Live)
+			{
+				Result.push_back(Block.Block);
+			}
+			return Result;
+		}
+
+		uint8_t* GetAddress(const TDefragBlock& Block) const
+		{
+			return Pools[Block.Pool]->GetBackingStore().GetBaseAddress() + Block.Offset * MIN_BLOCK_SIZE;
+		}
+	};
+
+	TFragmentedTrace MakeFragmentedTrace(uint64_t Seed, uint32_t NumPools, uint32_t FreePercent, uint32_t PinnedPercent)
+	{
+		THostRandom Random(Seed);
+		TFragmentedTrace Trace;
+
+		for (uint32_t Slot = 0; Slot < NumPools; ++Slot)
+		{
+			Trace.Pools.push_back(std::make_unique<THostPool>(256 * 1024, MIN_BLOCK_SIZE, 0));
+			THostPool& Pool = *Trace.Pools.back();
+
+			while (true)
+			{
+				const uint64_t Size = Random.Range(1, 8 * 1024);
+
+				TBuddyAllocation Allocation;
+				if (!Pool.Allocate(Size, 0, Allocation))
+				{
+					break;
+				}
+
+				TTraceBlock Block;
+				Block.Block.Pool = Slot;
+				Block.Block.Offset = Allocation.Offset;
+				Block.Block.Order = Allocation.Order;
+				Block.Block.Size = Size;
+				Block.Block.bMovable = !Random.Chance(PinnedPercent);
+				Block.Pattern = (uint8_t)Random.Next();
+				Trace.Live.push_back(Block);
+			}
+		}
+
+		for (uint32_t i = 0; i < Trace.Live.size();)
+		{
+			if (Random.Chance(FreePercent))
+			{
+				const TDefragBlock& Block = Trace.Live[i].Block;
+				Trace.Pools[Block.Pool]->Deallocate(Block.Offset, Block.Order);
+				Trace.Live[i] = Trace.Live.back();
+				Trace.Live.pop_back();
+				continue;
+			}
+			++i;
+		}
+
+		for (const TTraceBlock& Block : Trace.Live)
+		{
+			memset(Trace.GetAddress(Block.Block), Block.Pattern, (size_t)Block.Block.Size);
+		}
+
+		return Trace;
+	}
+
+	uint64_t GetSumOfSquaredUsage(const TFragmentedTrace& Trace)
+	{
+		uint64_t Sum = 0;
+		for (const auto& Pool : Trace.Pools)
+		{
+			const uint64_t Used = Pool->GetTotalAllocSize() / MIN_BLOCK_SIZE;
+			Sum += Used * Used;
+		}
+		return Sum;
+	}
+
+	// does what the D3D12 allocator does with a plan: copy, patch the block, free the source
+	void ApplyMoves(TFragmentedTrace& Trace, const std::vector<TDefragMove>& Moves)
+	{
+		for (const TDefragMove& Move : Moves)
+		{
+			TDefragBlock& Block = Trace.Live[Move.BlockIndex].Block;
+
+			TDefragBlock Dst = Block;
+			Dst.Pool = Move.DstPool;
+			Dst.Offset = Move.Dst.Offset;
+			memcpy(Trace.GetAddress(Dst), Trace.GetAddress(Block), (size_t)Block.Size);
+
+			Trace.Pools[Block.Pool]->Deallocate(Block.Offset, Block.Order);
+			Block = Dst;
+		}
+	}
+
+	bool IsIntact(const TFragmentedTrace& Trace)
+	{
+		bool bIntact = true;
+		for (const TTraceBlock& Block : Trace.Live)
+		{
+			const uint8_t* Bytes = Trace.GetAddress(Block.Block);
+			for (uint64_t i = 0; i < Block.Block.Size; ++i)
+			{
+				bIntact &= Bytes[i] == Block.Pattern;
+			}
+		}
+		return bIntact;
+	}
+}
+
+HOST_TEST(NothingToDoForOnePool)
+{
+	TFragmentedTrace Trace = MakeFragmentedTrace(1, 1, 70, 0);
+
+	CHECK(THostPlanner::Plan(Trace.GetPools(), Trace.GetBlocks(), UINT64_MAX).empty());
+}
+
+HOST_TEST(SkipsNullSlotsAndEmptyPools)
+{
+	TFragmentedTrace Trace = MakeFragmentedTrace(2, 4, 70, 0);
+
+	std::vector<THostPool*> Pools = Trace.GetPools();
+	Pools.insert(Pools.begin() + 2, nullptr);
+
+	// the blocks have to follow the slot shift
+	std::vector<TDefragBlock> Blocks = Trace.GetBlocks();
+	for (TDefragBlock& Block : Blocks)
+	{
+		Block.Pool += Block.Pool >= 2 ? 1 : 0;
+	}
+
+	const std::vector<TDefragMove> Moves = THostPlanner::Plan(Pools, Blocks, UINT64_MAX);
+	CHECK(!Moves.empty());
+	for (const TDefragMove& Move : Moves)
+	{
+		CHECK(Move.DstPool != 2);
+	}
+}
+
+// one pass on many fragmented traces: budget kept, pinned blocks stay, one source, data and byte accounting exact
+HOST_TEST(PlanKeepsBudgetAndPinnedBlocks)
+{
+	for (uint64_t Seed = 1; Seed <= 40; ++Seed)
+	{
+		THostRandom Random(Seed * 31);
+		TFragmentedTrace Trace = MakeFragmentedTrace(Seed, Random.Range(2, 24), 70, 10);
+
+		const std::vector<TDefragBlock> Blocks = Trace.GetBlocks();
+		const uint64_t ByteBudget = Random.Range(1, 64 * 1024);
+		const uint64_t SquaredBefore = GetSumOfSquaredUsage(Trace);
+
+		uint64_t LiveBytesBefore = 0;
+		for (const auto& Pool : Trace.Pools)
+		{
+			LiveBytesBefore += Pool->GetTotalAllocSize();
+		}
+
+		const std::vector<TDefragMove> Moves = THostPlanner::Plan(Trace.GetPools(), Blocks, ByteBudget);
+
+		uint64_t BytesMoved = 0;
+		for (const TDefragMove& Move : Moves)
+		{
+			const TDefragBlock& Block = Blocks[Move.BlockIndex];
+
+			CHECK(Block.bMovable);
+			CHECK_EQ(Block.Pool, Blocks[Moves[0].BlockIndex].Pool);
+			CHECK(Move.DstPool != Block.Pool);
+			CHECK_EQ(Move.Dst.Order, Block.Order);
+			BytesMoved += Block.Size;
+		}
+
+		// a single move may exceed the budget so large blocks still move
+		CHECK(Moves.size() <= 1 || BytesMoved <= ByteBudget);
+
+		ApplyMoves(Trace, Moves);
+		CHECK(IsIntact(Trace));
+
+		uint64_t LiveBytesAfter = 0;
+		for (const auto& Pool : Trace.Pools)
+		{
+			LiveBytesAfter += Pool->GetTotalAllocSize();
+		}
+		CHECK_EQ(LiveBytesAfter, LiveBytesBefore);
+
+		// blocks only move into fuller pools
+		CHECK(Moves.empty() || GetSumOfSquaredUsage(Trace) > SquaredBefore);
+	}
+}
+
+// repeated passes converge: no block moves back, pools drain and the data survives every pass
+HOST_TEST(RepeatedPassesDrainPools)
+{
+	TFragmentedTrace Trace = MakeFragmentedTrace(77, 16, 70, 5);
+	const std::vector<TTraceBlock> Original = Trace.Live;
+
+	uint32_t NumEmptyBefore = 0;
+	for (const auto& Pool : Trace.Pools)
+	{
+		NumEmptyBefore += Pool->GetTotalAllocSize() == 0 ? 1 : 0;
+	}
+
+	uint32_t NumPasses = 0;
+	while (NumPasses < 10000)
+	{
+		// Plan already allocates the destination blocks
+		const uint64_t SquaredBefore = GetSumOfSquaredUsage(Trace);
+
+		const std::vector<TDefragMove> Moves = THostPlanner::Plan(Trace.GetPools(), Trace.GetBlocks(), 16 * 1024);
+		if (Moves.empty())
+		{
+			break;
+		}
+
+		ApplyMoves(Trace, Moves);
+		CHECK(GetSumOfSquaredUsage(Trace) > SquaredBefore);
+		++NumPasses;
+	}
+
+	CHECK(NumPasses < 10000);
+	CHECK(IsIntact(Trace));
+
+	uint32_t NumEmptyAfter = 0;
+	for (const auto& Pool : Trace.Pools)
+	{
+		NumEmptyAfter += Pool->GetTotalAllocSize() == 0 ? 1 : 0;
+	}
+	CHECK(NumEmptyAfter > NumEmptyBefore);
+
+	// pinned blocks never moved
+	for (uint32_t i = 0; i < Trace.Live.size(); ++i)
+	{
+		const TDefragBlock& Block = Trace.Live[i].Block;
+		CHECK(Block.bMovable || (Block.Pool == Original[i].Block.Pool && Block.Offset == Original[i].Block.Offset));
+	}
+}
@@ -0,0 +1,157 @@
+#include "HostTest.h"
+#include "D3D12DescriptorCache.h"
+
+namespace
+{
+	// descriptors of the ring, see TD3D12DescriptorCache::MaxCbvSrvUavDescriptorCount
+	const uint32_t RING_SIZE = 16384;
+
+	struct TCacheView
+	{
+		TCacheView(TD3D12DescriptorCache& Cache)
+		{
+			ID3D12DescriptorHeap* Heap = Cache.GetCacheCbvSrvUavDescriptorHeap().Get();
+			CpuStart = Heap->GetCPUDescriptorHandleForHeapStart().ptr;
+			GpuStart = Heap->GetGPUDescriptorHandleForHeapStart().ptr;
+			DescriptorSize = Cache.GetCbvSrvUavDescriptorSize();
+		}
+
+		uint64_t IndexOf(D3D12_GPU_DESCRIPTOR_HANDLE Handle) const
+		{
+			return (Handle.ptr - GpuStart) / DescriptorSize;
+		}
+
+		SIZE_T CpuHandle(uint64_t Index) const
+		{
+			return CpuStart + (SIZE_T)Index * DescriptorSize;
+		}
+
+		SIZE_T CpuStart = 0;
+
+		uint64_t GpuStart = 0;
+
+		uint32_t DescriptorSize = 0;
+	};
+
+	// the source descriptors of a made up texture
+	D3D12_CPU_DESCRIPTOR_HANDLE SourceHandle(uint32_t Texture)
+	{
+		return { 0x40000000 + (SIZE_T)Texture * ID3D12Device::DescriptorSize };
+	}
+}
+
+// tables and ranges land in the shader visible heap, the GPU handle points at the copied descriptors
+HOST_TEST(DescriptorCacheCopiesTables)
+{
+	ID3D12Device Device;
+	TD3D12DescriptorCache Cache(&Device);
+	const TCacheView View(Cache);
+
+	CHECK_EQ(Cache.GetCacheCbvSrvUavDescriptorHeap()->GetDesc().Flags, D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE);
+
+	const std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> Table = { SourceHandle(7), SourceHandle(3) };
+	const uint64_t TableIndex = View.IndexOf(Cache.AppendCbvSrvUavDescriptors(Table));
+	CHECK_EQ(Device.Writes.size(), (size_t)2);
+	CHECK_EQ(Device.Writes[0].Dst, View.CpuHandle(TableIndex));
+	CHECK_EQ(Device.Writes[0].Src, SourceHandle(7).ptr);
+	CHECK_EQ(Device.Writes[1].Dst, View.CpuHandle(TableIndex + 1));
+	CHECK_EQ(Device.Writes[1].Src, SourceHandle(3).ptr);
+
+	const uint64_t RangeIndex = View.IndexOf(Cache.AppendCbvSrvUavDescriptorRange(SourceHandle(10), 3));
+	CHECK_EQ(RangeIndex, TableIndex + 2);
+	CHECK_EQ(Device.Writes.size(), (size_t)5);
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		CHECK_EQ(Device.Writes[2 + i].Dst, View.CpuHandle(RangeIndex + i));
+		CHECK_EQ(Device.Writes[2 + i].Src, SourceHandle(10 + i).ptr);
+	}
+}
+
+// the ring wraps around many times under two frames in flight, no descriptor of an unfinished frame is overwritten
+HOST_TEST(DescriptorCacheRingNeverOverwritesInFlightFrames)
+{
+	ID3D12Device Device;
+	TD3D12DescriptorCache Cache(&Device);
+	const TCacheView View(Cache);
+	THostRandom Random(24);
+
+	const uint64_t FramesInFlight = 2;
+
+	// last frame that wrote each descriptor, 0 when never written
+	std::vector<uint64_t> Owners(RING_SIZE, 0);
+	uint32_t NumOverwritten = 0;
+	uint32_t Texture = 0;
+
+	for (uint64_t Frame = 1; Frame <= 60; ++Frame)
+	{
+		// the GPU completes the frame FramesInFlight behind
+		Cache.CleanUpAllocations(Frame > FramesInFlight ? Frame - FramesInFlight : 0);
+
+		// a bit under a third of the ring per frame, so three frames can't share it
+		uint32_t NumDescriptors = 0;
+		while (NumDescriptors < RING_SIZE / 3 - 64)
+		{
+			const uint32_t Count = Random.Range(1, 8);
+
+			std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> Table;
+			for (uint32_t i = 0; i < Count; ++i)
+			{
+				Table.push_back(SourceHandle(++Texture));
+			}
+
+			const uint64_t Index = Random.Chance(50)
+				? View.IndexOf(Cache.AppendCbvSrvUavDescriptors(Table))
+				: View.IndexOf(Cache.AppendCbvSrvUavDescriptorRange(Table[0], Count));
+			CHECK(Index + Count <= RING_SIZE);
+
+			for (uint32_t i = 0; i < Count && Index + i < RING_SIZE; ++i)
+			{
+				uint64_t& Owner = Owners[Index + i];
+				if (Owner != 0 && Owner + FramesInFlight > Frame)
+				{
+					++NumOverwritten;
+				}
+				Owner = Frame;
+			}
+
+			NumDescriptors += Count;
+		}
+
+		Cache.FinishFrame(Frame);
+	}
+
+	CHECK_EQ(NumOverwritten, 0u);
+}
+
+// draws that share a material get the copy made earlier in the frame, a list and a range of the same descriptors share it too
+HOST_TEST(DescriptorCacheReusesTablesWithinAFrame)
+{
+	ID3D12Device Device;
+	TD3D12DescriptorCache Cache(&Device);
+
+	const std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> Material = { SourceHandle(0), SourceHandle(1), SourceHandle(2) };
+	const std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> Subset = { SourceHandle(0), SourceHandle(2) };
+
+	const uint64_t First = Cache.AppendCbvSrvUavDescriptors(Material).ptr;
+	CHECK_EQ(Cache.AppendCbvSrvUavDescriptorRange(SourceHandle(0), 3).ptr, First);
+	CHECK_EQ(Cache.AppendCbvSrvUavDescriptors(Material).ptr, First);
+
+	// other handles or another length are another table
+	const uint64_t SubsetTable = Cache.AppendCbvSrvUavDescriptors(Subset).ptr;
+	CHECK(SubsetTable != First);
+	const uint64_t Prefix = Cache.AppendCbvSrvUavDescriptorRange(SourceHandle(0), 2).ptr;
+	CHECK(Prefix != First && Prefix != SubsetTable);
+	CHECK_EQ(Cache.AppendCbvSrvUavDescriptors(Subset).ptr, SubsetTable);
+
+	CHECK_EQ(Device.Writes.size(), (size_t)7);
+
+	Cache.FinishFrame(1);
+	const TD3D12DescriptorCacheStats& Stats = Cache.GetLastFrameStats();
+	CHECK_EQ(Stats.NumTableHits, 3u);
+	CHECK_EQ(Stats.NumTableMisses, 3u);
+	CHECK_EQ(Stats.NumCopiedDescriptors, 7u);
+
+	// the next frame copies again, its tables may be rewritten in between
+	CHECK(Cache.AppendCbvSrvUavDescriptors(Material).ptr != First);
+	CHECK_EQ(Device.Writes.size(), (size_t)10);
+}
@@ -0,0 +1,218 @@
+#include "HostTest.h"
+#include "DescriptorSlotIndex.h"
+
+namespace
+{
+	const uint32_t NUM_DESCRIPTORS_PER_HEAP = 128;
+	const uint32_t DESCRIPTOR_SIZE = 32;
+
+	uint64_t HeapBaseHandle(uint32_t HeapIndex)
+	{
+		return 0x10000000ull * (HeapIndex + 1);
+	}
+
+	struct TLiveSlots
+	{
+		TDescriptorSlotIndex::TSlot Slot;
+
+		uint32_t Count = 0;
+	};
+
+	// one owner per descriptor of every heap, 0 when free
+	class TDescriptorOwners
+	{
+	public:
+		// false when a descriptor is already owned or the slot isn't inside its heap
+		bool Claim(const TDescriptorSlotIndex::TSlot& Slot, uint32_t Count, uint32_t Owner)
+		{
+			if (Slot.HeapIndex >= Owners.size())
+			{
+				Owners.resize(Slot.HeapIndex + 1, std::vector<uint32_t>(NUM_DESCRIPTORS_PER_HEAP, 0));
+			}
+
+			const uint64_t Base = HeapBaseHandle(Slot.HeapIndex);
+			if (Slot.Handle < Base || (Slot.Handle - Base) % DESCRIPTOR_SIZE != 0)
+			{
+				return false;
+			}
+
+			const uint64_t Index = (Slot.Handle - Base) / DESCRIPTOR_SIZE;
+			if (Index + Count > NUM_DESCRIPTORS_PER_HEAP)
+			{
+				return false;
+			}
+
+			bool bFree = true;
+			for (uint32_t i = 0; i < Count; ++i)
+			{
+				bFree = bFree && Owners[Slot.HeapIndex][Index + i] == 0;
+				Owners[Slot.HeapIndex][Index + i] = Owner;
+			}
+			return bFree;
+		}
+
+		void Release(const TDescriptorSlotIndex::TSlot& Slot, uint32_t Count)
+		{
+			const uint64_t Index = (Slot.Handle - HeapBaseHandle(Slot.HeapIndex)) / DESCRIPTOR_SIZE;
+			for (uint32_t i = 0; i < Count; ++i)
+			{
+				Owners[Slot.HeapIndex][Index + i] = 0;
+			}
+		}
+
+		uint32_t CountFree(uint32_t HeapIndex) const
+		{
+			uint32_t NumFree = 0;
+			for (uint32_t Owner : Owners[HeapIndex])
+			{
+				NumFree += Owner == 0 ? 1 : 0;
+			}
+			return NumFree;
+		}
+
+	private:
+		std::vector<std::vector<uint32_t>> Owners;
+	};
+
+	void AllocateOrAddHeap(TDescriptorSlotIndex& SlotIndex, uint32_t Count, TDescriptorSlotIndex::TSlot& Slot)
+	{
+		if (!SlotIndex.Allocate(Count, Slot))
+		{
+			SlotIndex.AddHeap(HeapBaseHandle(SlotIndex.GetNumHeaps()));
+			const bool bAllocated = SlotIndex.Allocate(Count, Slot);
+			CHECK(bAllocated);
+		}
+	}
+}
+
+HOST_TEST(SlotIndexNeedsAHeap)
+{
+	TDescriptorSlotIndex SlotIndex(NUM_DESCRIPTORS_PER_HEAP, DESCRIPTOR_SIZE);
+
+	TDescriptorSlotIndex::TSlot Slot;
+	CHECK(!SlotIndex.Allocate(1, Slot));
+
+	SlotIndex.AddHeap(HeapBaseHandle(0));
+	CHECK(SlotIndex.Allocate(1, Slot));
+	CHECK_EQ(Slot.HeapIndex, 0u);
+	CHECK_EQ(Slot.Handle, HeapBaseHandle(0));
+	CHECK_EQ(SlotIndex.GetNumFree(0), NUM_DESCRIPTORS_PER_HEAP - 1);
+}
+
+// single descriptors come from the lowest heap with room, a freed one is handed out again first
+HOST_TEST(SlotIndexSinglesFromTheLowestHeap)
+{
+	TDescriptorSlotIndex SlotIndex(NUM_DESCRIPTORS_PER_HEAP, DESCRIPTOR_SIZE);
+
+	std::vector<TDescriptorSlotIndex::TSlot> Slots(NUM_DESCRIPTORS_PER_HEAP * 3);
+	for (TDescriptorSlotIndex::TSlot& Slot : Slots)
+	{
+		AllocateOrAddHeap(SlotIndex, 1, Slot);
+	}
+	CHECK_EQ(SlotIndex.GetNumHeaps(), 3u);
+
+	const TDescriptorSlotIndex::TSlot Freed = Slots[NUM_DESCRIPTORS_PER_HEAP + 17];
+	SlotIndex.Free(Freed, 1);
+	SlotIndex.Free(Slots.back(), 1);
+
+	TDescriptorSlotIndex::TSlot Slot;
+	CHECK(SlotIndex.Allocate(1, Slot));
+	CHECK_EQ(Slot.HeapIndex, Freed.HeapIndex);
+	CHECK_EQ(Slot.Handle, Freed.Handle);
+}
+
+// random singles and ranges against a brute force owner map, through many heaps added on demand
+HOST_TEST(SlotIndexRandomChurnNeverOverlaps)
+{
+	TDescriptorSlotIndex SlotIndex(NUM_DESCRIPTORS_PER_HEAP, DESCRIPTOR_SIZE);
+	TDescriptorOwners Owners;
+	THostRandom Random(21);
+
+	const uint32_t Counts[] = { 1, 1, 1, 3, 4, 8, 16, 64 };
+
+	std::vector<TLiveSlots> Live(1500);
+	uint32_t Owner = 0;
+	for (uint32_t Step = 0; Step < 40000; ++Step)
+	{
+		TLiveSlots& Entry = Live[Random.Uniform((uint32_t)Live.size())];
+		if (Entry.Count > 0)
+		{
+			Owners.Release(Entry.Slot, Entry.Count);
+			SlotIndex.Free(Entry.Slot, Entry.Count);
+			Entry.Count = 0;
+		}
+
+		if (Random.Chance(70))
+		{
+			Entry.Count = Counts[Random.Uniform(8)];
+			AllocateOrAddHeap(SlotIndex, Entry.Count, Entry.Slot);
+			CHECK(Owners.Claim(Entry.Slot, Entry.Count, ++Owner));
+		}
+	}
+
+	for (uint32_t HeapIndex = 0; HeapIndex < SlotIndex.GetNumHeaps(); ++HeapIndex)
+	{
+		CHECK_EQ(SlotIndex.GetNumFree(HeapIndex), Owners.CountFree(HeapIndex));
+	}
+
+	// past the 64 heaps the bitmap of heaps with room starts with
+	CHECK(SlotIndex.GetNumHeaps() > 64);
+}
+
+// a range goes to the shortest free run that holds it, the long runs stay for long tables
+HOST_TEST(SlotIndexRangesAreBestFit)
+{
+	TDescriptorSlotIndex SlotIndex(NUM_DESCRIPTORS_PER_HEAP, DESCRIPTOR_SIZE);
+	SlotIndex.AddHeap(HeapBaseHandle(0));
+	SlotIndex.AddHeap(HeapBaseHandle(1));
+
+	// heap 0: free runs of 8 at [16, 24) and of 5 at [40, 45), everything else allocated
+	TDescriptorSlotIndex::TSlot Full;
+	CHECK(SlotIndex.Allocate(NUM_DESCRIPTORS_PER_HEAP, Full));
+	CHECK_EQ(Full.HeapIndex, 0u);
+	SlotIndex.Free({ 0, HeapBaseHandle(0) + 16 * DESCRIPTOR_SIZE }, 8);
+	SlotIndex.Free({ 0, HeapBaseHandle(0) + 40 * DESCRIPTOR_SIZE }, 5);
+
+	// heap 1 is empty, the run of 5 in heap 0 is the tightest for 4
+	TDescriptorSlotIndex::TSlot Slot;
+	CHECK(SlotIndex.Allocate(4, Slot));
+	CHECK_EQ(Slot.HeapIndex, 0u);
+	CHECK_EQ(Slot.Handle, HeapBaseHandle(0) + 40 * DESCRIPTOR_SIZE);
+
+	// an exact fit
+	CHECK(SlotIndex.Allocate(8, Slot));
+	CHECK_EQ(Slot.HeapIndex, 0u);
+	CHECK_EQ(Slot.Handle, HeapBaseHandle(0) + 16 * DESCRIPTOR_SIZE);
+
+	// only one descriptor left in heap 0, a pair goes to heap 1
+	CHECK(SlotIndex.Allocate(2, Slot));
+	CHECK_EQ(Slot.HeapIndex, 1u);
+	CHECK_EQ(Slot.Handle, HeapBaseHandle(1));
+}
+
+// freed ranges merge with their free neighbours without a merge step, a table of the combined length fits
+HOST_TEST(SlotIndexFreedRangesCoalesce)
+{
+	TDescriptorSlotIndex SlotIndex(NUM_DESCRIPTORS_PER_HEAP, DESCRIPTOR_SIZE);
+	SlotIndex.AddHeap(HeapBaseHandle(0));
+
+	const uint32_t NumRanges = NUM_DESCRIPTORS_PER_HEAP / 4;
+	std::vector<TDescriptorSlotIndex::TSlot> Ranges(NumRanges);
+	for (TDescriptorSlotIndex::TSlot& Range : Ranges)
+	{
+		CHECK(SlotIndex.Allocate(4, Range));
+	}
+
+	TDescriptorSlotIndex::TSlot Slot;
+	CHECK(!SlotIndex.Allocate(1, Slot));
+
+	// free 3 neighbours out of order, left, right then middle
+	SlotIndex.Free(Ranges[5], 4);
+	SlotIndex.Free(Ranges[7], 4);
+	CHECK(!SlotIndex.Allocate(12, Slot));
+	SlotIndex.Free(Ranges[6], 4);
+
+	CHECK(SlotIndex.Allocate(12, Slot));
+	CHECK_EQ(Slot.Handle, Ranges[5].Handle);
+	CHECK_EQ(SlotIndex.GetNumFree(0), 0u);
+}
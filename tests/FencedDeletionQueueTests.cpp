@@ -0,0 +1,234 @@
+#include "HostTest.h"
+#include "FencedDeletionQueue.h"
+#include "BuddyAllocator.h"
+#include <string.h>
+#include <deque>
+
+namespace
+{
+	// stands in for the D3D12 fence: the CPU signals a value per submitted frame,
+	// the GPU completes them in order some frames later
+	class TSimulatedFence
+	{
+	public:
+		uint64_t Signal()
+		{
+			return ++LastSignaled;
+		}
+
+		void Complete(uint64_t Value)
+		{
+			assert(Value >= Completed && Value <= LastSignaled);
+			Completed = Value;
+		}
+
+		uint64_t GetCompletedValue() const { return Completed; }
+
+		uint64_t GetNextValue() const { return LastSignaled + 1; }
+
+		uint64_t GetLastSignaledValue() const { return LastSignaled; }
+
+	private:
+		uint64_t LastSignaled = 0;
+
+		uint64_t Completed = 0;
+	};
+
+	struct TGpuRead
+	{
+		TBuddyAllocation Allocation;
+
+		uint64_t Size;
+
+		uint8_t Pattern;
+	};
+
+	// what one submitted frame reads when the simulated GPU runs it
+	struct TSubmittedFrame
+	{
+		uint64_t FenceValue;
+
+		std::vector<TGpuRead> Reads;
+	};
+}
+
+HOST_TEST(RetiresInFenceOrder)
+{
+	TFencedDeletionQueue<uint32_t> Queue;
+	CHECK(Queue.Empty());
+
+	Queue.Enqueue(1, 1);
+	Queue.Enqueue(2, 1);
+	Queue.Enqueue(3, 2);
+	Queue.Enqueue(4, 4);
+	CHECK_EQ(Queue.Num(), 4u);
+
+	std::vector<uint32_t> Released;
+	auto Release = [&](uint32_t Item) { Released.push_back(Item); };
+
+	CHECK_EQ(Queue.Retire(0, Release), 0u);
+	CHECK_EQ(Queue.Retire(1, Release), 2u);
+	CHECK_EQ(Queue.Retire(3, Release), 1u);
+	CHECK_EQ(Queue.Num(), 1u);
+
+	// enqueueing behind a partially retired queue keeps the order
+	Queue.Enqueue(5, 4);
+	Queue.Enqueue(6, 5);
+	CHECK_EQ(Queue.Retire(5, Release), 3u);
+	CHECK(Queue.Empty());
+
+	const std::vector<uint32_t> Expected = { 1, 2, 3, 4, 5, 6 };
+	CHECK(Released == Expected);
+}
+
+HOST_TEST(RetireCompactsWithoutLosingItems)
+{
+	TFencedDeletionQueue<uint64_t> Queue;
+	THostRandom Random(11);
+
+	uint64_t NextItem = 0;
+	uint64_t NextExpected = 0;
+	uint64_t Fence = 0;
+	uint64_t Completed = 0;
+
+	for (uint32_t Step = 0; Step < 20000; ++Step)
+	{
+		const uint32_t NumItems = Random.Uniform(8);
+		++Fence;
+		for (uint32_t i = 0; i < NumItems; ++i)
+		{
+			Queue.Enqueue(NextItem++, Fence);
+		}
+
+		if (Random.Chance(70))
+		{
+			Completed = Random.Range((uint32_t)Completed, (uint32_t)Fence);
+			Queue.Retire(Completed, [&](uint64_t Item)
+			{
+				CHECK_EQ(Item, NextExpected);
+				++NextExpected;
+			});
+		}
+	}
+
+	Queue.Retire(Fence, [&](uint64_t Item)
+	{
+		CHECK_EQ(Item, NextExpected);
+		++NextExpected;
+	});
+
+	CHECK(Queue.Empty());
+	CHECK_EQ(NextExpected, NextItem);
+}
+
+// Frames run the way the renderer uses the buddy pools: blocks are allocated and written on the CPU,
+// read by the GPU when the frame executes, and freed through the queue tagged with the next fence value.
+// The GPU lags a random number of frames behind. When a frame executes every block it reads must still
+// hold the bytes written for it, a block handed out again before the fence completed would be overwritten.
+HOST_TEST(DeferredFreesSurviveInFlightFrames)
+{
+	THostRandom Random(5);
+	TSimulatedFence Fence;
+
+	TBuddyAllocator<THostBackingStore> Allocator(1 << 20, 256, 0);
+	uint8_t* const Base = Allocator.GetBackingStore().GetBaseAddress();
+
+	TFencedDeletionQueue<TBuddyAllocation> PendingFrees;
+	std::deque<TSubmittedFrame> InFlight;
+	std::vector<TGpuRead> Live;
+
+	uint32_t NumDeferred = 0;
+	uint32_t NumCorrupted = 0;
+
+	auto ExecuteUpTo = [&](uint64_t Value)
+	{
+		while (!InFlight.empty() && InFlight.front().FenceValue <= Value)
+		{
+			for (const TGpuRead& Read : InFlight.front().Reads)
+			{
+				const uint8_t* Bytes = Base + Read.Allocation.AlignedOffset;
+				for (uint64_t i = 0; i < Read.Size; ++i)
+				{
+					if (Bytes[i] != Read.Pattern)
+					{
+						++NumCorrupted;
+						break;
+					}
+				}
+			}
+
+			Fence.Complete(InFlight.front().FenceValue);
+			InFlight.pop_front();
+		}
+	};
+
+	for (uint32_t Frame = 0; Frame < 3000; ++Frame)
+	{
+		// retire what the GPU is done with, as CleanUpAllocations does at the end of a frame
+		PendingFrees.Retire(Fence.GetCompletedValue(), [&](const TBuddyAllocation& Allocation)
+		{
+			Allocator.Deallocate(Allocation.Offset, Allocation.Order);
+		});
+
+		TSubmittedFrame Submitted;
+
+		const uint32_t NumAllocations = Random.Uniform(12);
+		for (uint32_t i = 0; i < NumAllocations; ++i)
+		{
+			TGpuRead Block;
+			Block.Size = Random.Range(1, 16 * 1024);
+			if (!Allocator.Allocate(Block.Size, 0, Block.Allocation))
+			{
+				continue;
+			}
+
+			Block.Pattern = (uint8_t)Random.Next();
+			memset(Base + Block.Allocation.AlignedOffset, Block.Pattern, (size_t)Block.Size);
+			Live.push_back(Block);
+		}
+
+		// this frame reads a random subset of the live blocks
+		for (const TGpuRead& Block : Live)
+		{
+			if (Random.Chance(30))
+			{
+				Submitted.Reads.push_back(Block);
+			}
+		}
+
+		// free some blocks, the frame just recorded may still read them
+		const uint32_t NumFrees = Random.Uniform(12);
+		for (uint32_t i = 0; i < NumFrees && !Live.empty(); ++i)
+		{
+			const uint32_t Index = Random.Uniform((uint32_t)Live.size());
+			PendingFrees.Enqueue(Live[Index].Allocation, Fence.GetNextValue());
+			Live[Index] = Live.back();
+			Live.pop_back();
+			++NumDeferred;
+		}
+
+		Submitted.FenceValue = Fence.Signal();
+		InFlight.push_back(std::move(Submitted));
+
+		// the GPU keeps at most 3 frames in flight and finishes a random number of them
+		const uint64_t Lag = Random.Uniform(4);
+		const uint64_t Signaled = Fence.GetLastSignaledValue();
+		ExecuteUpTo(Signaled > Lag ? Signaled - Lag : 0);
+	}
+
+	ExecuteUpTo(Fence.GetLastSignaledValue());
+	PendingFrees.Retire(Fence.GetCompletedValue(), [&](const TBuddyAllocation& Allocation)
+	{
+		Allocator.Deallocate(Allocation.Offset, Allocation.Order);
+	});
+
+	CHECK(NumDeferred > 1000);
+	CHECK_EQ(NumCorrupted, 0u);
+	CHECK(PendingFrees.Empty());
+
+	for (const TGpuRead& Block : Live)
+	{
+		Allocator.Deallocate(Block.Allocation.Offset, Block.Allocation.Order);
+	}
+	CHECK_EQ(Allocator.GetTotalAllocSize(), 0u);
+}
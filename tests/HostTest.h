@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+// Minimal harness for the host tests.
+// HOST_TEST registers a test, CHECK logs a failure and keeps going so one run reports everything.
+
+struct THostTest
+{
+	const char* Name;
+
+	void (*Func)();
+};
+
+std::vector<THostTest>& GetHostTests();
+
+void ReportHostTestFailure(const char* File, int Line, const char* Expr);
+
+struct THostTestRegistrar
+{
+	THostTestRegistrar(const char* Name, void (*Func)())
+	{
+		GetHostTests().push_back({ Name, Func });
+	}
+};
+
+#define HOST_TEST(Name) \
+	static void Name(); \
+	static THostTestRegistrar Name##Registrar(#Name, Name); \
+	static void Name()
+
+#define CHECK(Expr) \
+	do { if (!(Expr)) { ReportHostTestFailure(__FILE__, __LINE__, #Expr); } } while (0)
+
+#define CHECK_EQ(A, B) CHECK((A) == (B))
+
+// small deterministic generator, the tests must not depend on the standard library's distributions
+class THostRandom
+{
+public:
+	explicit THostRandom(uint64_t Seed) : State(Seed * 2862933555777941757ull + 3037000493ull) {}
+
+	uint64_t Next()
+	{
+		// splitmix64
+		uint64_t Z = (State += 0x9E3779B97F4A7C15ull);
+		Z = (Z ^ (Z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		Z = (Z ^ (Z >> 27)) * 0x94D049BB133111EBull;
+		return Z ^ (Z >> 31);
+	}
+
+	// uniform in [0, Range)
+	uint32_t Uniform(uint32_t Range)
+	{
+		return (uint32_t)(Next() % Range);
+	}
+
+	// uniform in [Min, Max]
+	uint32_t Range(uint32_t Min, uint32_t Max)
+	{
+		return Min + Uniform(Max - Min + 1);
+	}
+
+	bool Chance(uint32_t Percent)
+	{
+		return Uniform(100) < Percent;
+	}
+
+private:
+	uint64_t State;
+};
@@ -0,0 +1,47 @@
+#include "HostTest.h"
+#include <string.h>
+
+namespace
+{
+	int NumFailures = 0;
+}
+
+std::vector<THostTest>& GetHostTests()
+{
+	static std::vector<THostTest> Tests;
+	return Tests;
+}
+
+void ReportHostTestFailure(const char* File, int Line, const char* Expr)
+{
+	fprintf(stderr, "%s:%d: CHECK failed: %s\n", File, Line, Expr);
+	++NumFailures;
+}
+
+// runs every registered test, or only those whose name contains argv[1]
+int main(int argc, char** argv)
+{
+	const char* Filter = argc > 1 ? argv[1] : nullptr;
+
+	int NumFailedTests = 0;
+	int NumRun = 0;
+	for (const THostTest& Test : GetHostTests())
+	{
+		if (Filter && !strstr(Test.Name, Filter))
+		{
+			continue;
+		}
+
+		const int FailuresBefore = NumFailures;
+		Test.Func();
+		++NumRun;
+
+		const bool bPassed = NumFailures == FailuresBefore;
+		printf("%s %s\n", bPassed ? "[  OK  ]" : "[FAILED]", Test.Name);
+		NumFailedTests += bPassed ? 0 : 1;
+	}
+
+	printf("%d of %d tests passed\n", NumRun - NumFailedTests, NumRun);
+
+	return NumFailedTests == 0 ? 0 : 1;
+}
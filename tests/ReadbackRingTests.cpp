@@ -0,0 +1,164 @@
+#include "HostTest.h"
+#include "ReadbackRing.h"
+#include <algorithm>
+#include <memory>
+
+namespace
+{
+	// the parts of TD3D12ReadbackData the ring touches
+	struct THostReadbackData
+	{
+		const void* Data = nullptr;
+
+		uint64_t Size = 0;
+
+		// which copy this is, checked against the callback order
+		uint32_t Id = 0;
+	};
+
+	typedef TReadbackRing<THostReadbackData> THostReadbackRing;
+
+	// stands in for the GPU copy into the readback heap
+	void WriteCopy(std::vector<uint8_t>& Memory, uint64_t Offset, uint64_t Size, uint32_t Id)
+	{
+		for (uint64_t i = 0; i < Size; ++i)
+		{
+			Memory[Offset + i] = (uint8_t)(Id + i);
+		}
+	}
+
+	bool CopyIsIntact(const THostReadbackData& Data)
+	{
+		bool bIntact = true;
+		for (uint64_t i = 0; i < Data.Size; ++i)
+		{
+			bIntact &= ((const uint8_t*)Data.Data)[i] == (uint8_t)(Data.Id + i);
+		}
+		return bIntact;
+	}
+}
+
+// the callback waits for the fence of its copy and sees the copied bytes, the space is reclaimed only after it ran
+HOST_TEST(ReadbackCallbackWaitsForTheFence)
+{
+	THostReadbackRing Ring(1024);
+	std::vector<uint8_t> Memory(1024);
+
+	uint64_t Offset = 0;
+	CHECK(Ring.Allocate(300, 256, Offset));
+
+	THostReadbackData Data;
+	Data.Size = 300;
+	Data.Id = 7;
+	WriteCopy(Memory, Offset, Data.Size, Data.Id);
+
+	uint32_t NumCalls = 0;
+	Ring.Enqueue(Offset, Data, [&](const THostReadbackData& Result)
+	{
+		CHECK_EQ((const uint8_t*)Result.Data, Memory.data() + Offset);
+		CHECK(CopyIsIntact(Result));
+		CHECK_EQ(Ring.GetUsedSize(), 300u);
+		++NumCalls;
+	}, 3);
+	Ring.FinishFrame(3);
+
+	Ring.Retire(2, Memory.data());
+	CHECK_EQ(NumCalls, 0u);
+	CHECK_EQ(Ring.GetNumPending(), (size_t)1);
+
+	Ring.Retire(3, Memory.data());
+	CHECK_EQ(NumCalls, 1u);
+	CHECK_EQ(Ring.GetNumPending(), (size_t)0);
+	CHECK_EQ(Ring.GetUsedSize(), 0u);
+
+	// runs once, an empty callback is allowed
+	CHECK(Ring.Allocate(16, 0, Offset));
+	Ring.Enqueue(Offset, Data, nullptr, 4);
+	Ring.FinishFrame(4);
+	Ring.Retire(4, Memory.data());
+	CHECK_EQ(NumCalls, 1u);
+	CHECK_EQ(Ring.GetNumPending(), (size_t)0);
+}
+
+// the callbacks release what they captured, a screenshot callback may hold a large buffer
+HOST_TEST(ReadbackCallbackCapturesAreReleased)
+{
+	THostReadbackRing Ring(1024);
+	std::vector<uint8_t> Memory(1024);
+
+	const std::shared_ptr<int> Capture = std::make_shared<int>(0);
+
+	uint64_t Offset = 0;
+	CHECK(Ring.Allocate(64, 0, Offset));
+	Ring.Enqueue(Offset, THostReadbackData(), [Capture](const THostReadbackData&) { ++*Capture; }, 1);
+	CHECK_EQ(Capture.use_count(), 2);
+
+	Ring.FinishFrame(1);
+	Ring.Retire(1, Memory.data());
+	CHECK_EQ(*Capture, 1);
+	CHECK_EQ(Capture.use_count(), 1);
+}
+
+// random copies with up to three frames in flight: every callback runs once, in order, after its fence,
+// and reads its own bytes, a later copy never lands on a range whose callback hasn't run yet
+HOST_TEST(ReadbackRandomFramesNeverOverwritePendingCopies)
+{
+	const uint64_t Capacity = 64 * 1024;
+
+	THostRandom Random(20);
+	THostReadbackRing Ring(Capacity);
+	std::vector<uint8_t> Memory(Capacity);
+
+	uint32_t NextId = 0;
+	uint32_t NextExpectedId = 0;
+	uint32_t NumCorrupted = 0;
+	uint32_t NumFull = 0;
+	uint64_t CompletedFence = 0;
+
+	for (uint64_t Frame = 1; Frame <= 3000; ++Frame)
+	{
+		const uint32_t NumCopies = Random.Uniform(12);
+		for (uint32_t i = 0; i < NumCopies; ++i)
+		{
+			THostReadbackData Data;
+			Data.Size = Random.Chance(80) ? Random.Range(1, 1024) : Random.Range(1024, 8192);
+			Data.Id = NextId;
+
+			// textures are placed at 512 bytes, queries at 8
+			uint64_t Offset = 0;
+			if (!Ring.Allocate(Data.Size, Random.Chance(50) ? 512 : 8, Offset))
+			{
+				++NumFull;
+				continue;
+			}
+
+			CHECK(Offset + Data.Size <= Capacity);
+			WriteCopy(Memory, Offset, Data.Size, Data.Id);
+			++NextId;
+
+			Ring.Enqueue(Offset, Data, [&, Frame](const THostReadbackData& Result)
+			{
+				CHECK(Frame <= CompletedFence);
+				CHECK_EQ(Result.Id, NextExpectedId);
+				NumCorrupted += CopyIsIntact(Result) ? 0 : 1;
+				++NextExpectedId;
+			}, Frame);
+		}
+
+		Ring.FinishFrame(Frame);
+
+		// the GPU completes up to three frames behind, the completed fence never goes back
+		const uint64_t Lag = Random.Uniform(4);
+		CompletedFence = (std::max)(CompletedFence, Frame > Lag ? Frame - Lag : 0);
+		Ring.Retire(CompletedFence, Memory.data());
+	}
+
+	CompletedFence = 3000;
+	Ring.Retire(CompletedFence, Memory.data());
+
+	CHECK_EQ(NumCorrupted, 0u);
+	CHECK_EQ(NextExpectedId, NextId);
+	CHECK(NumFull > 0);
+	CHECK_EQ(Ring.GetNumPending(), (size_t)0);
+	CHECK_EQ(Ring.GetUsedSize(), 0u);
+}
@@ -0,0 +1,216 @@
+#include "HostTest.h"
+#include "ResidencyPolicy.h"
+#include <algorithm>
+
+namespace
+{
+	const uint64_t HEAP_SIZE = 64 * 1024 * 1024;
+
+	// the usage follows the resident heaps, like DXGI does once the evictions have gone through
+	class THostBudgetProvider : public IMemoryBudgetProvider
+	{
+	public:
+		THostBudgetProvider(uint64_t InBudget) : Budget(InBudget) {}
+
+		TMemoryBudget QueryBudget() override
+		{
+			TMemoryBudget Result;
+			Result.Budget = Budget;
+			Result.CurrentUsage = Policy ? Policy->GetResidentSize() + OtherUsage : OtherUsage;
+			return Result;
+		}
+
+		uint64_t Budget;
+
+		// memory that isn't in a registered heap
+		uint64_t OtherUsage = 0;
+
+		const TResidencyPolicy* Policy = nullptr;
+	};
+}
+
+HOST_TEST(ResidencyNothingToDoUnderTheTarget)
+{
+	THostBudgetProvider Provider(10 * HEAP_SIZE);
+	TResidencyPolicy Policy(Provider, 0.9f);
+	Provider.Policy = &Policy;
+
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		Policy.Register(HEAP_SIZE, 1);
+	}
+
+	std::vector<uint32_t> Evict;
+	Policy.Update(UINT64_MAX, Evict);
+	CHECK(Evict.empty());
+	CHECK_EQ(Policy.GetLastBudget().CurrentUsage, 8 * HEAP_SIZE);
+}
+
+// the least recently used heaps go first, just enough of them to get back under the target
+HOST_TEST(ResidencyEvictsLeastRecentlyUsed)
+{
+	THostBudgetProvider Provider(4 * HEAP_SIZE);
+	TResidencyPolicy Policy(Provider, 1.0f);
+	Provider.Policy = &Policy;
+
+	const uint32_t A = Policy.Register(HEAP_SIZE, 1);
+	const uint32_t B = Policy.Register(HEAP_SIZE, 1);
+	const uint32_t C = Policy.Register(HEAP_SIZE, 1);
+	const uint32_t D = Policy.Register(HEAP_SIZE, 2);
+	CHECK(!Policy.MarkUsed(A, 3));
+
+	// a bit over the budget, one heap is enough
+	Provider.OtherUsage = HEAP_SIZE / 2;
+	std::vector<uint32_t> Evict;
+	Policy.Update(3, Evict);
+	CHECK_EQ(Evict.size(), (size_t)1);
+	CHECK_EQ(Evict[0], B);
+	CHECK(!Policy.IsResident(B));
+	CHECK_EQ(Policy.GetResidentSize(), 3 * HEAP_SIZE);
+	CHECK_EQ(Policy.GetEvictedSize(), HEAP_SIZE);
+
+	// two more, in LRU order
+	Provider.OtherUsage = 3 * HEAP_SIZE;
+	Evict.clear();
+	Policy.Update(3, Evict);
+	CHECK_EQ(Evict.size(), (size_t)2);
+	CHECK_EQ(Evict[0], C);
+	CHECK_EQ(Evict[1], D);
+	CHECK(Policy.IsResident(A));
+
+	// using an evicted heap makes it resident again, the caller has to page it in
+	CHECK(Policy.MarkUsed(C, 4));
+	CHECK(Policy.IsResident(C));
+	CHECK_EQ(Policy.GetResidentSize(), 2 * HEAP_SIZE);
+	CHECK_EQ(Policy.GetEvictedSize(), 2 * HEAP_SIZE);
+
+	Policy.Unregister(B);
+	Policy.Unregister(C);
+	CHECK_EQ(Policy.GetResidentSize(), HEAP_SIZE);
+	CHECK_EQ(Policy.GetEvictedSize(), HEAP_SIZE);
+}
+
+// a heap the GPU may still read is kept even when the budget stays exceeded
+HOST_TEST(ResidencyKeepsHeapsInFlight)
+{
+	THostBudgetProvider Provider(HEAP_SIZE);
+	TResidencyPolicy Policy(Provider, 1.0f);
+	Provider.Policy = &Policy;
+
+	const uint32_t Old = Policy.Register(HEAP_SIZE, 5);
+	const uint32_t InFlight = Policy.Register(HEAP_SIZE, 7);
+	Provider.OtherUsage = 4 * HEAP_SIZE;
+
+	std::vector<uint32_t> Evict;
+	Policy.Update(6, Evict);
+	CHECK_EQ(Evict.size(), (size_t)1);
+	CHECK_EQ(Evict[0], Old);
+	CHECK(Policy.IsResident(InFlight));
+
+	Evict.clear();
+	Policy.Update(7, Evict);
+	CHECK_EQ(Evict.size(), (size_t)1);
+	CHECK_EQ(Evict[0], InFlight);
+}
+
+// random registers, uses and updates against a brute force model ordered by last use
+HOST_TEST(ResidencyRandomAgainstReference)
+{
+	THostBudgetProvider Provider(16 * HEAP_SIZE);
+	TResidencyPolicy Policy(Provider, 0.75f);
+	Provider.Policy = &Policy;
+	THostRandom Random(17);
+
+	struct TReferenceHeap
+	{
+		uint32_t Handle = 0;
+		uint64_t Size = 0;
+		bool bResident = true;
+
+		// last use, ties broken by the order of the uses
+		uint64_t LastUsedFence = 0;
+		uint64_t LastUseOrder = 0;
+	};
+
+	std::vector<TReferenceHeap> Heaps;
+	uint64_t UseOrder = 0;
+
+	for (uint64_t Frame = 3; Frame < 3000; ++Frame)
+	{
+		const uint64_t CompletedFence = Frame - 2;
+
+		if (Random.Chance(30) || Heaps.empty())
+		{
+			TReferenceHeap Heap;
+			Heap.Size = (uint64_t)Random.Range(1, 8) * HEAP_SIZE / 4;
+			Heap.Handle = Policy.Register(Heap.Size, Frame);
+			Heap.LastUsedFence = Frame;
+			Heap.LastUseOrder = ++UseOrder;
+			Heaps.push_back(Heap);
+		}
+
+		if (Random.Chance(10))
+		{
+			const uint32_t Index = Random.Uniform((uint32_t)Heaps.size());
+			Policy.Unregister(Heaps[Index].Handle);
+			Heaps[Index] = Heaps.back();
+			Heaps.pop_back();
+		}
+
+		for (uint32_t Use = Random.Uniform(4); Use > 0 && !Heaps.empty(); --Use)
+		{
+			TReferenceHeap& Heap = Heaps[Random.Uniform((uint32_t)Heaps.size())];
+			CHECK_EQ(Policy.MarkUsed(Heap.Handle, Frame), !Heap.bResident);
+			Heap.bResident = true;
+			Heap.LastUsedFence = Frame;
+			Heap.LastUseOrder = ++UseOrder;
+		}
+
+		Provider.OtherUsage = (uint64_t)Random.Uniform(8) * HEAP_SIZE;
+
+		std::vector<uint32_t> Evict;
+		Policy.Update(CompletedFence, Evict);
+
+		// the resident heaps the GPU is done with, least recently used first
+		std::vector<TReferenceHeap*> Candidates;
+		for (TReferenceHeap& Heap : Heaps)
+		{
+			if (Heap.bResident)
+			{
+				Candidates.push_back(&Heap);
+			}
+		}
+		std::sort(Candidates.begin(), Candidates.end(), [](const TReferenceHeap* A, const TReferenceHeap* B)
+		{
+			return A->LastUseOrder < B->LastUseOrder;
+		});
+
+		const TMemoryBudget& Budget = Policy.GetLastBudget();
+		const uint64_t Target = (uint64_t)((double)Budget.Budget * 0.75f);
+		uint64_t BytesToFree = Budget.CurrentUsage > Target ? Budget.CurrentUsage - Target : 0;
+
+		std::vector<uint32_t> Expected;
+		for (TReferenceHeap* Heap : Candidates)
+		{
+			if (BytesToFree == 0 || Heap->LastUsedFence > CompletedFence)
+			{
+				break;
+			}
+
+			Expected.push_back(Heap->Handle);
+			Heap->bResident = false;
+			BytesToFree -= (std::min)(BytesToFree, Heap->Size);
+		}
+		CHECK(Evict == Expected);
+
+		uint64_t ResidentSize = 0;
+		uint64_t EvictedSize = 0;
+		for (const TReferenceHeap& Heap : Heaps)
+		{
+			CHECK_EQ(Policy.IsResident(Heap.Handle), Heap.bResident);
+			(Heap.bResident ? ResidentSize : EvictedSize) += Heap.Size;
+		}
+		CHECK_EQ(Policy.GetResidentSize(), ResidentSize);
+		CHECK_EQ(Policy.GetEvictedSize(), EvictedSize);
+	}
+}
@@ -0,0 +1,234 @@
+#include "HostTest.h"
+#include "RingAllocator.h"
+#include <barrier>
+#include <deque>
+#include <thread>
+
+namespace
+{
+	struct TRingRange
+	{
+		uint64_t Offset;
+
+		uint64_t Size;
+	};
+
+	struct TRingFrame
+	{
+		uint64_t FenceValue;
+
+		std::vector<TRingRange> Ranges;
+	};
+
+	// marks every byte of a range with the frame that owns it, returns false when a byte was still owned
+	bool ClaimRange(std::vector<uint64_t>& Owners, const TRingRange& Range, uint64_t Frame)
+	{
+		bool bFree = true;
+		for (uint64_t i = Range.Offset; i < Range.Offset + Range.Size; ++i)
+		{
+			bFree &= Owners[i] == 0;
+			Owners[i] = Frame;
+		}
+		return bFree;
+	}
+
+	void ReleaseRange(std::vector<uint64_t>& Owners, const TRingRange& Range)
+	{
+		for (uint64_t i = Range.Offset; i < Range.Offset + Range.Size; ++i)
+		{
+			Owners[i] = 0;
+		}
+	}
+}
+
+HOST_TEST(RingRejectsWhatDoesNotFit)
+{
+	TRingAllocator Ring(1024);
+
+	uint64_t Offset = 0;
+	CHECK(!Ring.Allocate(1025, 0, Offset));
+
+	CHECK(Ring.Allocate(600, 0, Offset));
+	CHECK_EQ(Offset, 0u);
+
+	// the rest of the buffer is too small and the start is still in use
+	CHECK(!Ring.Allocate(600, 0, Offset));
+
+	Ring.FinishFrame(1);
+	Ring.Retire(1);
+	CHECK_EQ(Ring.GetUsedSize(), 0u);
+
+	// drained, so the whole capacity is available again from the start
+	CHECK(Ring.Allocate(1024, 0, Offset));
+	CHECK_EQ(Offset, 0u);
+}
+
+HOST_TEST(RingAlignsAndSkipsTheEnd)
+{
+	TRingAllocator Ring(1024);
+
+	uint64_t Offset = 0;
+	CHECK(Ring.Allocate(10, 0, Offset));
+	CHECK(Ring.Allocate(10, 256, Offset));
+	CHECK_EQ(Offset, 256u);
+	Ring.FinishFrame(1);
+
+	CHECK(Ring.Allocate(600, 0, Offset));
+	CHECK_EQ(Offset, 266u);
+	Ring.FinishFrame(2);
+
+	Ring.Retire(1);
+
+	// 158 bytes are left at the end, a 200 byte allocation has to start over at 0
+	CHECK(Ring.Allocate(200, 0, Offset));
+	CHECK_EQ(Offset, 0u);
+}
+
+// frames of random allocations with the GPU a random number of frames behind:
+// no byte may be handed out while a frame that owns it is still in flight
+HOST_TEST(RingNeverOverwritesInFlightFrames)
+{
+	const uint64_t Capacity = 64 * 1024;
+
+	THostRandom Random(9);
+	TRingAllocator Ring(Capacity);
+	std::vector<uint64_t> Owners(Capacity, 0);
+	std::deque<TRingFrame> InFlight;
+
+	uint64_t CompletedFence = 0;
+	uint32_t NumOverlaps = 0;
+	uint32_t NumFull = 0;
+
+	for (uint64_t Frame = 1; Frame <= 5000; ++Frame)
+	{
+		TRingFrame Current;
+		Current.FenceValue = Frame;
+
+		const uint32_t NumAllocations = Random.Uniform(40);
+		for (uint32_t i = 0; i < NumAllocations; ++i)
+		{
+			TRingRange Range;
+			Range.Size = Random.Range(1, 2048);
+			if (!Ring.Allocate(Range.Size, 256, Range.Offset))
+			{
+				++NumFull;
+				continue;
+			}
+
+			CHECK_EQ(Range.Offset % 256, 0u);
+			CHECK(Range.Offset + Range.Size <= Capacity);
+			NumOverlaps += ClaimRange(Owners, Range, Frame) ? 0 : 1;
+			Current.Ranges.push_back(Range);
+		}
+
+		Ring.FinishFrame(Frame);
+		InFlight.push_back(std::move(Current));
+
+		// the GPU completes up to the frame Lag behind the last one
+		const uint64_t Lag = Random.Uniform(3);
+		while (!InFlight.empty() && InFlight.front().FenceValue + Lag <= Frame)
+		{
+			for (const TRingRange& Range : InFlight.front().Ranges)
+			{
+				ReleaseRange(Owners, Range);
+			}
+			CompletedFence = InFlight.front().FenceValue;
+			InFlight.pop_front();
+		}
+
+		Ring.Retire(CompletedFence);
+	}
+
+	CHECK_EQ(NumOverlaps, 0u);
+	CHECK(NumFull > 0);
+
+	Ring.Retire(5000);
+	CHECK_EQ(Ring.GetUsedSize(), 0u);
+}
+
+// loader threads allocate while the render thread retires old frames at the same time:
+// no range may be handed out twice while its frame is in flight
+HOST_TEST(RingConcurrentAllocations)
+{
+	const uint64_t Capacity = 256 * 1024;
+	const uint32_t NumThreads = 4;
+	const uint64_t NumFrames = 400;
+	const uint64_t FramesInFlight = 2;
+
+	TRingAllocator Ring(Capacity);
+	std::vector<uint64_t> Owners(Capacity, 0);
+	std::vector<std::vector<TRingRange>> ThreadRanges(NumThreads);
+	std::vector<std::vector<TRingRange>> FrameRanges(NumFrames + 1);
+
+	std::barrier Start(NumThreads + 1);
+	std::barrier Done(NumThreads + 1);
+
+	std::vector<std::thread> Threads;
+	for (uint32_t ThreadIndex = 0; ThreadIndex < NumThreads; ++ThreadIndex)
+	{
+		Threads.emplace_back([&, ThreadIndex]()
+		{
+			THostRandom Random(100 + ThreadIndex);
+
+			for (uint64_t Frame = 1; Frame <= NumFrames; ++Frame)
+			{
+				Start.arrive_and_wait();
+
+				ThreadRanges[ThreadIndex].clear();
+				for (uint32_t i = 0; i < 64; ++i)
+				{
+					TRingRange Range;
+					Range.Size = Random.Range(1, 512);
+					if (Ring.Allocate(Range.Size, 256, Range.Offset))
+					{
+						ThreadRanges[ThreadIndex].push_back(Range);
+					}
+				}
+
+				Done.arrive_and_wait();
+			}
+		});
+	}
+
+	uint32_t NumOverlaps = 0;
+	uint32_t NumAllocated = 0;
+	for (uint64_t Frame = 1; Frame <= NumFrames; ++Frame)
+	{
+		// the GPU finished the frame FramesInFlight behind, its bytes may be handed out from now on
+		const uint64_t Completed = Frame > FramesInFlight ? Frame - FramesInFlight : 0;
+		if (Completed > 0)
+		{
+			for (const TRingRange& Range : FrameRanges[Completed])
+			{
+				ReleaseRange(Owners, Range);
+			}
+		}
+
+		Start.arrive_and_wait();
+
+		// retire while the loader threads allocate
+		Ring.Retire(Completed);
+
+		Done.arrive_and_wait();
+
+		Ring.FinishFrame(Frame);
+
+		for (const std::vector<TRingRange>& Ranges : ThreadRanges)
+		{
+			for (const TRingRange& Range : Ranges)
+			{
+				NumOverlaps += ClaimRange(Owners, Range, Frame) ? 0 : 1;
+				FrameRanges[Frame].push_back(Range);
+				++NumAllocated;
+			}
+		}
+	}
+
+	for (std::thread& Thread : Threads)
+	{
+		Thread.join();
+	}
+
+	CHECK_EQ(NumOverlaps, 0u);
+	CHECK(NumAllocated > NumFrames * NumThreads * 8);
+}
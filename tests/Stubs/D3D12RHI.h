@@ -0,0 +1,19 @@
+#pragma once
+#include "stdafx.h"
+
+// Host stand-in for src/Graphic/D3D12RHI.h, see stdafx.h.
+// The tests move the fence of g_CommandContext by hand to play the frames
+
+namespace TD3D12RHI
+{
+	class THostCommandContext
+	{
+	public:
+		// value the next ExecuteCommandLists signals
+		uint64_t GetNextFenceValue() const { return NextFenceValue; }
+
+		uint64_t NextFenceValue = 1;
+	};
+
+	inline THostCommandContext g_CommandContext;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "stdafx.h"
+#include <stdexcept>
+
+// Host stand-in for src/Utils/DXSamplerHelper.h, see stdafx.h
+
+using Microsoft::WRL::ComPtr;
+
+class HrException : public std::runtime_error
+{
+public:
+	HrException(HRESULT hr) : std::runtime_error("HRESULT " + std::to_string(hr)), m_hr(hr) {}
+	HRESULT Error() const { return m_hr; }
+private:
+	const HRESULT m_hr;
+};
+
+inline void ThrowIfFailed(HRESULT hr)
+{
+	if (hr < 0)
+	{
+		throw HrException(hr);
+	}
+}
+
+template<typename T, UINT TNameLength>
+inline void SetDebugName(T*, const wchar_t(&)[TNameLength]) noexcept
+{
+}
@@ -0,0 +1,239 @@
+#pragma once
+#include <stdint.h>
+#include <assert.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Host stand-ins for the few D3D12 types and Win32 calls the tested classes use, so their .cpp files build and run in the tests.
+// Heaps hand out made up CPU and GPU addresses and the device records the descriptor copies, nothing reaches a GPU.
+// Only what the tested classes call is declared here, add to it when a test needs more.
+
+#define __forceinline inline
+
+typedef uint32_t UINT;
+typedef size_t SIZE_T;
+typedef long HRESULT;
+
+#define S_OK ((HRESULT)0)
+#define IID_PPV_ARGS(pp) (pp)
+
+inline void OutputDebugStringA(const char*) {}
+
+template<size_t Size, typename... TArgs>
+int sprintf_s(char (&Buffer)[Size], const char* Format, TArgs... Args)
+{
+	return snprintf(Buffer, Size, Format, Args...);
+}
+
+struct D3D12_CPU_DESCRIPTOR_HANDLE
+{
+	SIZE_T ptr;
+};
+
+struct D3D12_GPU_DESCRIPTOR_HANDLE
+{
+	uint64_t ptr;
+};
+
+struct CD3DX12_CPU_DESCRIPTOR_HANDLE : D3D12_CPU_DESCRIPTOR_HANDLE
+{
+	CD3DX12_CPU_DESCRIPTOR_HANDLE() { ptr = 0; }
+
+	CD3DX12_CPU_DESCRIPTOR_HANDLE(D3D12_CPU_DESCRIPTOR_HANDLE Base, int Offset, UINT IncrementSize)
+	{
+		ptr = Base.ptr + (SIZE_T)Offset * IncrementSize;
+	}
+};
+
+struct CD3DX12_GPU_DESCRIPTOR_HANDLE : D3D12_GPU_DESCRIPTOR_HANDLE
+{
+	CD3DX12_GPU_DESCRIPTOR_HANDLE() { ptr = 0; }
+
+	CD3DX12_GPU_DESCRIPTOR_HANDLE(D3D12_GPU_DESCRIPTOR_HANDLE Base, int Offset, UINT IncrementSize)
+	{
+		ptr = Base.ptr + (uint64_t)Offset * IncrementSize;
+	}
+};
+
+enum D3D12_DESCRIPTOR_HEAP_TYPE
+{
+	D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
+	D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER,
+	D3D12_DESCRIPTOR_HEAP_TYPE_RTV,
+	D3D12_DESCRIPTOR_HEAP_TYPE_DSV,
+};
+
+enum D3D12_DESCRIPTOR_HEAP_FLAGS
+{
+	D3D12_DESCRIPTOR_HEAP_FLAG_NONE = 0,
+	D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE = 1,
+};
+
+struct D3D12_DESCRIPTOR_HEAP_DESC
+{
+	D3D12_DESCRIPTOR_HEAP_TYPE Type;
+	UINT NumDescriptors;
+	D3D12_DESCRIPTOR_HEAP_FLAGS Flags;
+	UINT NodeMask;
+};
+
+enum DXGI_FORMAT
+{
+	DXGI_FORMAT_UNKNOWN = 0,
+	DXGI_FORMAT_R8G8B8A8_UNORM = 28,
+};
+
+enum D3D12_SRV_DIMENSION
+{
+	D3D12_SRV_DIMENSION_TEXTURE2D = 4,
+};
+
+#define D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING 5768
+
+struct D3D12_TEX2D_SRV
+{
+	UINT MostDetailedMip;
+	UINT MipLevels;
+	UINT PlaneSlice;
+	float ResourceMinLODClamp;
+};
+
+struct D3D12_SHADER_RESOURCE_VIEW_DESC
+{
+	DXGI_FORMAT Format;
+	D3D12_SRV_DIMENSION ViewDimension;
+	UINT Shader4ComponentMapping;
+	D3D12_TEX2D_SRV Texture2D;
+};
+
+struct ID3D12Resource
+{
+};
+
+struct ID3D12DescriptorHeap
+{
+	D3D12_DESCRIPTOR_HEAP_DESC Desc;
+
+	SIZE_T CpuBase;
+
+	uint64_t GpuBase;
+
+	D3D12_DESCRIPTOR_HEAP_DESC GetDesc() const { return Desc; }
+
+	D3D12_CPU_DESCRIPTOR_HANDLE GetCPUDescriptorHandleForHeapStart() const { return { CpuBase }; }
+
+	D3D12_GPU_DESCRIPTOR_HANDLE GetGPUDescriptorHandleForHeapStart() const { return { GpuBase }; }
+};
+
+namespace Microsoft
+{
+	namespace WRL
+	{
+		// the device owns every object it creates, the pointer only refers to it
+		template<typename T>
+		class ComPtr
+		{
+		public:
+			ComPtr() = default;
+
+			ComPtr(T* InPtr) : Ptr(InPtr) {}
+
+			T* Get() const { return Ptr; }
+
+			T* operator->() const { return Ptr; }
+
+			T** operator&() { return &Ptr; }
+
+			explicit operator bool() const { return Ptr != nullptr; }
+
+			void Reset() { Ptr = nullptr; }
+
+		private:
+			T* Ptr = nullptr;
+		};
+	}
+}
+
+// one descriptor written into a heap, by CopyDescriptors, CopyDescriptorsSimple or CreateShaderResourceView
+struct THostDescriptorWrite
+{
+	SIZE_T Dst;
+
+	// the source descriptor, or the resource of a created view, 0 for a null view
+	SIZE_T Src;
+};
+
+// free threaded like the real device
+struct ID3D12Device
+{
+	// 32 byte descriptors like most hardware, the CPU and GPU addresses of a heap are far apart
+	static const UINT DescriptorSize = 32;
+
+	UINT GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE) const { return DescriptorSize; }
+
+	HRESULT CreateDescriptorHeap(const D3D12_DESCRIPTOR_HEAP_DESC* Desc, ID3D12DescriptorHeap** OutHeap)
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+
+		const SIZE_T CpuBase = 0x100000 * (Heaps.size() + 1);
+
+		Heaps.push_back(std::make_unique<ID3D12DescriptorHeap>(ID3D12DescriptorHeap{ *Desc, CpuBase, (uint64_t)CpuBase << 20 }));
+		*OutHeap = Heaps.back().get();
+
+		return S_OK;
+	}
+
+	void CopyDescriptors(UINT NumDstRanges, const D3D12_CPU_DESCRIPTOR_HANDLE* DstStarts, const UINT* DstSizes,
+		UINT NumSrcRanges, const D3D12_CPU_DESCRIPTOR_HANDLE* SrcStarts, const UINT* SrcSizes, D3D12_DESCRIPTOR_HEAP_TYPE)
+	{
+		// a null size array means ranges of one descriptor
+		std::vector<SIZE_T> Dst;
+		for (UINT Range = 0; Range < NumDstRanges; ++Range)
+		{
+			for (UINT i = 0; i < (DstSizes ? DstSizes[Range] : 1); ++i)
+			{
+				Dst.push_back(DstStarts[Range].ptr + (SIZE_T)i * DescriptorSize);
+			}
+		}
+
+		std::vector<SIZE_T> Src;
+		for (UINT Range = 0; Range < NumSrcRanges; ++Range)
+		{
+			for (UINT i = 0; i < (SrcSizes ? SrcSizes[Range] : 1); ++i)
+			{
+				Src.push_back(SrcStarts[Range].ptr + (SIZE_T)i * DescriptorSize);
+			}
+		}
+
+		std::lock_guard<std::mutex> Lock(Mutex);
+		for (size_t i = 0; i < Dst.size() && i < Src.size(); ++i)
+		{
+			Writes.push_back({ Dst[i], Src[i] });
+		}
+	}
+
+	void CopyDescriptorsSimple(UINT NumDescriptors, D3D12_CPU_DESCRIPTOR_HANDLE DstStart, D3D12_CPU_DESCRIPTOR_HANDLE SrcStart, D3D12_DESCRIPTOR_HEAP_TYPE)
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		for (UINT i = 0; i < NumDescriptors; ++i)
+		{
+			Writes.push_back({ DstStart.ptr + (SIZE_T)i * DescriptorSize, SrcStart.ptr + (SIZE_T)i * DescriptorSize });
+		}
+	}
+
+	void CreateShaderResourceView(ID3D12Resource* Resource, const D3D12_SHADER_RESOURCE_VIEW_DESC*, D3D12_CPU_DESCRIPTOR_HANDLE Dst)
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Writes.push_back({ Dst.ptr, (SIZE_T)Resource });
+	}
+
+	std::vector<std::unique_ptr<ID3D12DescriptorHeap>> Heaps;
+
+	std::vector<THostDescriptorWrite> Writes;
+
+	std::mutex Mutex;
+};
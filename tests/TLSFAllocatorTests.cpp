@@ -0,0 +1,183 @@
+#include "HostTest.h"
+#include "TLSFAllocator.h"
+#include <string.h>
+
+namespace
+{
+	struct TLiveTLSFBlock
+	{
+		TTLSFAllocator::TAllocation Allocation;
+
+		uint64_t Size;
+
+		uint8_t Pattern;
+	};
+
+	// blocks tile the pool in address order and no two free blocks are neighbours
+	bool IsWellFormed(const TTLSFAllocator& TLSF)
+	{
+		bool bWellFormed = true;
+		uint64_t NextOffset = 0;
+		bool bPreviousFree = false;
+
+		TLSF.ForEachBlock([&](uint64_t Offset, uint64_t Size, bool bFree)
+		{
+			bWellFormed &= Offset == NextOffset && Size > 0;
+			bWellFormed &= !(bFree && bPreviousFree);
+			NextOffset = Offset + Size;
+			bPreviousFree = bFree;
+		});
+
+		return bWellFormed && NextOffset == TLSF.GetPoolSize();
+	}
+
+	// the per size class counters and the allocated total agree with the block list
+	bool StatsMatchBlocks(const TTLSFAllocator& TLSF, uint64_t Granularity)
+	{
+		uint32_t NumFreeBlocks[32] = {};
+		uint64_t FreeBytes = 0;
+
+		TLSF.ForEachBlock([&](uint64_t, uint64_t Size, bool bFree)
+		{
+			if (bFree)
+			{
+				++NumFreeBlocks[FindHighestSetBit(Size / Granularity)];
+				FreeBytes += Size;
+			}
+		});
+
+		bool bMatch = FreeBytes + TLSF.GetTotalAllocSize() == TLSF.GetPoolSize();
+		for (uint32_t Log2Size = 0; Log2Size < 32; ++Log2Size)
+		{
+			bMatch &= TLSF.GetNumFreeBlocks(Log2Size) == NumFreeBlocks[Log2Size];
+		}
+
+		return bMatch;
+	}
+}
+
+HOST_TEST(TLSFExactSizes)
+{
+	TTLSFAllocator TLSF(1 << 20, 256);
+
+	TTLSFAllocator::TAllocation A, B;
+	CHECK(TLSF.Allocate(1000, 0, A));
+	CHECK(TLSF.Allocate(256, 0, B));
+
+	// rounded to the granularity only, not to a power of two
+	CHECK_EQ(TLSF.GetBlockSize(A.Block), 1024u);
+	CHECK_EQ(TLSF.GetBlockSize(B.Block), 256u);
+	CHECK_EQ(TLSF.GetTotalAllocSize(), 1280u);
+	CHECK_EQ(B.AlignedOffset, 1024u);
+
+	TLSF.Deallocate(A.Block);
+	TLSF.Deallocate(B.Block);
+	CHECK_EQ(TLSF.GetTotalAllocSize(), 0u);
+	CHECK_EQ(TLSF.GetLargestFreeSize(), TLSF.GetPoolSize());
+}
+
+HOST_TEST(TLSFRejectsOversizedRequests)
+{
+	TTLSFAllocator TLSF(64 * 1024, 256);
+
+	TTLSFAllocator::TAllocation Allocation;
+	CHECK(!TLSF.Allocate(64 * 1024 + 1, 0, Allocation));
+	CHECK(TLSF.Allocate(64 * 1024, 0, Allocation));
+	CHECK(!TLSF.Allocate(1, 0, Allocation));
+	CHECK_EQ(TLSF.GetLargestFreeSize(), 0u);
+}
+
+// random alloc/free with 64KB alignments on host memory: no overlap, alignment, accounting,
+// well formed block list, and everything merges back into one block at the end
+HOST_TEST(TLSFRandomChurn)
+{
+	const uint64_t PoolSize = 16 << 20;
+	const uint64_t Alignments[] = { 0, 256, 4096, 65536 };
+
+	THostRandom Random(17);
+	TTLSFAllocator TLSF(PoolSize, 256);
+	std::vector<uint8_t> Memory(PoolSize);
+
+	std::vector<TLiveTLSFBlock> Live;
+	uint64_t ExpectedAllocSize = 0;
+	uint64_t RequestedSize = 0;
+	uint32_t NumFailed = 0;
+
+	for (uint32_t Step = 0; Step < 20000; ++Step)
+	{
+		if (Live.empty() || Random.Chance(52))
+		{
+			TLiveTLSFBlock Block;
+			Block.Size = Random.Chance(90) ? Random.Range(1, 16 * 1024) : Random.Range(16 * 1024, 1024 * 1024);
+			const uint64_t Alignment = Alignments[Random.Uniform(4)];
+
+			// any request up to the reported lower bound has to succeed
+			const bool bMustFit = Block.Size + Alignment <= TLSF.GetLargestFreeSize();
+			if (!TLSF.Allocate(Block.Size, Alignment, Block.Allocation))
+			{
+				CHECK(!bMustFit);
+				++NumFailed;
+				continue;
+			}
+
+			CHECK(Alignment == 0 || Block.Allocation.AlignedOffset % Alignment == 0);
+			CHECK(Block.Allocation.AlignedOffset + Block.Size <= PoolSize);
+
+			Block.Pattern = (uint8_t)Random.Next();
+			memset(&Memory[Block.Allocation.AlignedOffset], Block.Pattern, (size_t)Block.Size);
+
+			ExpectedAllocSize += TLSF.GetBlockSize(Block.Allocation.Block);
+			RequestedSize += Block.Size;
+			Live.push_back(Block);
+		}
+		else
+		{
+			const uint32_t Index = Random.Uniform((uint32_t)Live.size());
+			const TLiveTLSFBlock Block = Live[Index];
+			Live[Index] = Live.back();
+			Live.pop_back();
+
+			bool bIntact = true;
+			for (uint64_t i = 0; i < Block.Size; ++i)
+			{
+				bIntact &= Memory[Block.Allocation.AlignedOffset + i] == Block.Pattern;
+			}
+			CHECK(bIntact);
+
+			ExpectedAllocSize -= TLSF.GetBlockSize(Block.Allocation.Block);
+			RequestedSize -= Block.Size;
+			TLSF.Deallocate(Block.Allocation.Block);
+		}
+
+		CHECK_EQ(TLSF.GetTotalAllocSize(), ExpectedAllocSize);
+
+		// only the rounding to the granularity is lost inside a block
+		CHECK(ExpectedAllocSize - RequestedSize < 256 * (Live.size() + 1));
+
+		if (Step % 1000 == 0)
+		{
+			CHECK(IsWellFormed(TLSF));
+			CHECK(StatsMatchBlocks(TLSF, 256));
+		}
+	}
+
+	CHECK(NumFailed > 0);
+
+	for (const TLiveTLSFBlock& Block : Live)
+	{
+		TLSF.Deallocate(Block.Allocation.Block);
+	}
+
+	CHECK_EQ(TLSF.GetTotalAllocSize(), 0u);
+	CHECK(IsWellFormed(TLSF));
+	CHECK(StatsMatchBlocks(TLSF, 256));
+
+	uint32_t NumBlocks = 0;
+	TLSF.ForEachBlock([&](uint64_t, uint64_t Size, bool bFree)
+	{
+		CHECK(bFree);
+		CHECK_EQ(Size, PoolSize);
+		++NumBlocks;
+	});
+	CHECK_EQ(NumBlocks, 1u);
+}
@@ -0,0 +1,209 @@
+#include "HostTest.h"
+#include "TilePool.h"
+#include <set>
+
+namespace
+{
+	typedef TTilePool<THostTileStore> THostTilePool;
+
+	const uint32_t TILES_PER_HEAP = 16;
+
+	// 1024x1024 in 128x128 tiles: mips of 8x8, 4x4, 2x2 and 1x1 tiles, the last two mips packed into 2 tiles
+	TTiledTextureLayout MakeLayout(uint32_t ArraySize)
+	{
+		TTiledTextureLayout Layout;
+		for (uint32_t Tiles = 8; Tiles > 0; Tiles /= 2)
+		{
+			TTiledTextureLayout::TMip Mip;
+			Mip.WidthInTiles = Tiles;
+			Mip.HeightInTiles = Tiles;
+			Layout.StandardMips.push_back(Mip);
+		}
+		Layout.NumPackedMips = 2;
+		Layout.NumTilesForPackedMips = 2;
+		Layout.TileWidth = 128;
+		Layout.TileHeight = 128;
+		Layout.ArraySize = ArraySize;
+		return Layout;
+	}
+
+	uint64_t TileKey(const TTileLocation& Location)
+	{
+		return (uint64_t)Location.Heap << 32 | Location.Tile;
+	}
+
+	uint64_t CoordinateKey(const TTileUpdate& Update)
+	{
+		return (uint64_t)Update.Subresource << 48 | (uint64_t)Update.Z << 32 | Update.Y << 16 | Update.X;
+	}
+}
+
+// the tiles touched by the rectangle are mapped once, a second commit of an overlapping region only maps the new ones
+HOST_TEST(TileCommitRegionMapsCoveredTiles)
+{
+	THostTilePool Pool(TILES_PER_HEAP);
+	TTiledTextureMap Map(MakeLayout(1));
+
+	std::vector<TTileUpdate> Updates;
+	Map.CommitRegion(Pool, 0, 0, 100, 0, 200, 128, Updates);
+	CHECK_EQ(Updates.size(), (size_t)3);
+	for (uint32_t i = 0; i < Updates.size(); ++i)
+	{
+		CHECK_EQ(Updates[i].Subresource, 0u);
+		CHECK_EQ(Updates[i].X, i);
+		CHECK_EQ(Updates[i].Y, 0u);
+		CHECK(Updates[i].Location.IsValid());
+	}
+
+	Updates.clear();
+	Map.CommitRegion(Pool, 0, 0, 0, 0, 256, 128, Updates);
+	CHECK(Updates.empty());
+
+	// clamped to the mip, the first row is already mapped
+	Map.CommitRegion(Pool, 0, 0, 0, 0, 100000, 256, Updates);
+	CHECK_EQ(Updates.size(), (size_t)13);
+	CHECK_EQ(Map.GetNumMappedTiles(), 16u);
+	CHECK_EQ(Pool.GetNumUsedTiles(), 16u);
+	CHECK_EQ(Pool.GetBackingStore().NumCreatedHeaps, 1u);
+
+	// a packed mip maps the whole tail, its tiles are addressed by X from the first packed mip
+	Updates.clear();
+	Map.CommitRegion(Pool, 0, 5, 0, 0, 1, 1, Updates);
+	CHECK_EQ(Updates.size(), (size_t)2);
+	CHECK_EQ(Updates[0].Subresource, 4u);
+	CHECK_EQ(Updates[1].Subresource, 4u);
+	CHECK_EQ(Updates[1].X, 1u);
+	CHECK_EQ(Pool.GetBackingStore().NumCreatedHeaps, 2u);
+}
+
+// decommitted tiles go back through the owner, the heaps empty out and can be trimmed
+HOST_TEST(TileDecommitMipFreesItsTiles)
+{
+	THostTilePool Pool(TILES_PER_HEAP);
+	TTiledTextureMap Map(MakeLayout(2));
+
+	std::vector<TTileUpdate> Updates;
+	Map.CommitMip(Pool, 1, 1, Updates);
+	CHECK_EQ(Updates.size(), (size_t)16);
+	CHECK_EQ(Updates[5].Subresource, 1u + 6u);
+
+	std::vector<TTileLocation> Mapped;
+	for (const TTileUpdate& Update : Updates)
+	{
+		Mapped.push_back(Update.Location);
+	}
+
+	Updates.clear();
+	std::vector<TTileLocation> Freed;
+	Map.DecommitMip(1, 1, Updates, Freed);
+	CHECK_EQ(Freed.size(), Mapped.size());
+	CHECK_EQ(Updates.size(), Mapped.size());
+	for (uint32_t i = 0; i < Freed.size(); ++i)
+	{
+		CHECK_EQ(TileKey(Freed[i]), TileKey(Mapped[i]));
+		CHECK(!Updates[i].Location.IsValid());
+	}
+	CHECK_EQ(Map.GetNumMappedTiles(), 0u);
+
+	// the other slice is untouched
+	Updates.clear();
+	Map.DecommitMip(0, 1, Updates, Freed);
+	CHECK(Updates.empty());
+
+	for (const TTileLocation& Location : Freed)
+	{
+		Pool.Free(Location);
+	}
+	CHECK_EQ(Pool.Trim(), (uint64_t)TILES_PER_HEAP * THostTilePool::TILE_SIZE);
+	CHECK_EQ(Pool.GetNumHeaps(), 0u);
+	CHECK_EQ(Pool.GetBackingStore().NumReleasedHeaps, 1u);
+}
+
+// a mip can be sampled once it and every coarser mip are committed in every slice
+HOST_TEST(TileMostDetailedCommittedMip)
+{
+	THostTilePool Pool(TILES_PER_HEAP);
+	TTiledTextureMap Map(MakeLayout(2));
+	const uint32_t NumMips = Map.GetLayout().GetNumMips();
+
+	std::vector<TTileUpdate> Updates;
+	CHECK_EQ(Map.GetMostDetailedCommittedMip(), NumMips);
+
+	Map.CommitMip(Pool, 0, 4, Updates);
+	CHECK_EQ(Map.GetMostDetailedCommittedMip(), NumMips);
+	Map.CommitMip(Pool, 1, 4, Updates);
+	CHECK_EQ(Map.GetMostDetailedCommittedMip(), 4u);
+
+	Map.CommitMip(Pool, 0, 3, Updates);
+	CHECK_EQ(Map.GetMostDetailedCommittedMip(), 4u);
+	Map.CommitMip(Pool, 1, 3, Updates);
+	CHECK_EQ(Map.GetMostDetailedCommittedMip(), 3u);
+
+	// a gap keeps the finer mips out
+	Map.CommitMip(Pool, 0, 1, Updates);
+	Map.CommitMip(Pool, 1, 1, Updates);
+	CHECK_EQ(Map.GetMostDetailedCommittedMip(), 3u);
+	Map.CommitMip(Pool, 0, 2, Updates);
+	Map.CommitMip(Pool, 1, 2, Updates);
+	CHECK_EQ(Map.GetMostDetailedCommittedMip(), 1u);
+
+	// part of a mip isn't enough
+	Map.CommitRegion(Pool, 0, 0, 0, 0, 1024, 1024, Updates);
+	Map.CommitRegion(Pool, 1, 0, 0, 0, 1024, 512, Updates);
+	CHECK_EQ(Map.GetMostDetailedCommittedMip(), 1u);
+	Map.CommitRegion(Pool, 1, 0, 0, 512, 1024, 512, Updates);
+	CHECK_EQ(Map.GetMostDetailedCommittedMip(), 0u);
+
+	std::vector<TTileLocation> Freed;
+	Map.DecommitMip(1, 3, Updates, Freed);
+	CHECK_EQ(Map.GetMostDetailedCommittedMip(), 4u);
+}
+
+// random commits and decommits of two textures sharing a pool: a tile is never mapped twice, a coordinate never holds two tiles
+HOST_TEST(TileRandomCommitsNeverShareTiles)
+{
+	THostTilePool Pool(TILES_PER_HEAP);
+	std::vector<TTiledTextureMap> Maps = { TTiledTextureMap(MakeLayout(1)), TTiledTextureMap(MakeLayout(3)) };
+	THostRandom Random(18);
+
+	// tile of the pool -> texture and coordinate
+	std::set<std::pair<uint64_t, uint64_t>> Live;
+	std::set<uint64_t> LiveTiles;
+
+	for (uint32_t Step = 0; Step < 3000; ++Step)
+	{
+		const uint32_t Texture = Random.Uniform(2);
+		TTiledTextureMap& Map = Maps[Texture];
+		const uint32_t Slice = Random.Uniform(Map.GetLayout().ArraySize);
+		const uint32_t Mip = Random.Uniform(Map.GetLayout().GetNumMips());
+
+		std::vector<TTileUpdate> Updates;
+		if (Random.Chance(70))
+		{
+			Map.CommitRegion(Pool, Slice, Mip, Random.Uniform(1024), Random.Uniform(1024), Random.Range(1, 512), Random.Range(1, 512), Updates);
+
+			for (const TTileUpdate& Update : Updates)
+			{
+				CHECK(Update.Location.IsValid());
+				CHECK(LiveTiles.insert(TileKey(Update.Location)).second);
+				CHECK(Live.insert({ Texture, CoordinateKey(Update) }).second);
+			}
+		}
+		else
+		{
+			std::vector<TTileLocation> Freed;
+			Map.DecommitMip(Slice, Mip, Updates, Freed);
+			CHECK_EQ(Updates.size(), Freed.size());
+
+			for (uint32_t i = 0; i < Freed.size(); ++i)
+			{
+				CHECK_EQ(LiveTiles.erase(TileKey(Freed[i])), (size_t)1);
+				CHECK_EQ(Live.erase({ Texture, CoordinateKey(Updates[i]) }), (size_t)1);
+				Pool.Free(Freed[i]);
+			}
+		}
+
+		CHECK_EQ(Pool.GetNumUsedTiles(), (uint32_t)LiveTiles.size());
+		CHECK_EQ(Maps[0].GetNumMappedTiles() + Maps[1].GetNumMappedTiles(), (uint32_t)LiveTiles.size());
+	}
+}
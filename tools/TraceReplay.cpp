@@ -0,0 +1,175 @@
+#include "AllocationTrace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Replays an allocation trace captured in the application (TD3D12RHI::EndAllocationTrace) with every
+// host allocator variant and prints throughput, peak footprint and fragmentation side by side.
+//
+//   TraceReplay <trace file>
+//   TraceReplay --synthetic <trace file> [frames]    writes a made up streaming trace first, then replays it
+
+namespace
+{
+	// D3D12_HEAP_TYPE values
+	const uint8_t HEAP_TYPE_DEFAULT = 1;
+	const uint8_t HEAP_TYPE_UPLOAD = 2;
+
+	// deterministic LCG, every run writes the same trace
+	class TTraceRandom
+	{
+	public:
+		explicit TTraceRandom(uint64_t Seed) : State(Seed) {}
+
+		uint32_t Uniform(uint32_t Range)
+		{
+			State = State * 6364136223846793005ull + 1442695040888963407ull;
+			return (uint32_t)(State >> 33) % Range;
+		}
+
+	private:
+		uint64_t State;
+	};
+
+	struct TLiveAllocation
+	{
+		uint32_t Id;
+
+		// last frame the allocation is used in
+		uint32_t LastFrame;
+	};
+
+	// Per frame: constant buffers freed at the end of the frame, vertex and index buffers that live a few
+	// hundred frames, and textures streamed in and out. Two frames in flight, the GPU completes frame N - 2
+	std::vector<TAllocationTraceEvent> MakeSyntheticTrace(uint32_t NumFrames)
+	{
+		std::vector<TAllocationTraceEvent> Events;
+		std::vector<TLiveAllocation> Live;
+		TTraceRandom Random(14);
+		uint32_t NextId = 0;
+
+		auto Alloc = [&](uint32_t Frame, uint64_t Size, uint32_t Alignment, uint8_t HeapType, bool bPlaced, uint32_t Lifetime)
+		{
+			TAllocationTraceEvent Event;
+			Event.Type = EAllocationTraceEventType::Alloc;
+			Event.HeapType = HeapType;
+			Event.bPlaced = bPlaced ? 1 : 0;
+			Event.Id = NextId++;
+			Event.Alignment = Alignment;
+			Event.FenceValue = Frame;
+			Event.Size = Size;
+			Events.push_back(Event);
+
+			Live.push_back({ Event.Id, Frame + Lifetime });
+		};
+
+		for (uint32_t Frame = 1; Frame <= NumFrames; ++Frame)
+		{
+			for (uint32_t i = 0; i < 64; ++i)
+			{
+				Alloc(Frame, 256 * (1 + Random.Uniform(16)), 256, HEAP_TYPE_UPLOAD, false, 0);
+			}
+
+			for (uint32_t i = 0; i < 4; ++i)
+			{
+				Alloc(Frame, 1024 * (1 + Random.Uniform(1024)), 256, HEAP_TYPE_DEFAULT, false, 1 + Random.Uniform(400));
+			}
+
+			if (Random.Uniform(4) == 0)
+			{
+				const uint64_t Size = (uint64_t)64 * 1024 << Random.Uniform(8);
+				Alloc(Frame, Size, 64 * 1024, HEAP_TYPE_DEFAULT, true, 1 + Random.Uniform(600));
+			}
+
+			// frees of the allocations last used this frame, the GPU reads them until the frame completes
+			for (size_t i = 0; i < Live.size();)
+			{
+				if (Live[i].LastFrame > Frame)
+				{
+					++i;
+					continue;
+				}
+
+				TAllocationTraceEvent Event;
+				Event.Type = EAllocationTraceEventType::Free;
+				Event.Id = Live[i].Id;
+				Event.FenceValue = Frame;
+				Events.push_back(Event);
+
+				Live[i] = Live.back();
+				Live.pop_back();
+			}
+
+			TAllocationTraceEvent CleanUp;
+			CleanUp.Type = EAllocationTraceEventType::CleanUp;
+			CleanUp.FenceValue = Frame > 2 ? Frame - 2 : 0;
+			Events.push_back(CleanUp);
+		}
+
+		return Events;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const bool bSynthetic = argc >= 3 && strcmp(argv[1], "--synthetic") == 0;
+	if (argc < 2 || (argc >= 3 && !bSynthetic))
+	{
+		printf("usage: TraceReplay <trace file>\n       TraceReplay --synthetic <trace file> [frames]\n");
+		return 2;
+	}
+
+	const char* FileName = bSynthetic ? argv[2] : argv[1];
+
+	if (bSynthetic)
+	{
+		const uint32_t NumFrames = argc >= 4 ? (uint32_t)atoi(argv[3]) : 2000;
+		if (!SaveAllocationTrace(FileName, MakeSyntheticTrace(NumFrames)))
+		{
+			printf("can't write %s\n", FileName);
+			return 1;
+		}
+	}
+
+	std::vector<TAllocationTraceEvent> Events;
+	if (!LoadAllocationTrace(FileName, Events))
+	{
+		printf("can't read %s\n", FileName);
+		return 1;
+	}
+
+	uint32_t NumAllocEvents = 0;
+	for (const TAllocationTraceEvent& Event : Events)
+	{
+		NumAllocEvents += Event.Type == EAllocationTraceEventType::Alloc ? 1 : 0;
+	}
+	printf("%s: %u events, %u allocations\n", FileName, (uint32_t)Events.size(), NumAllocEvents);
+
+	const struct
+	{
+		const char* Name;
+		EReplayAlgorithm Algorithm;
+	} Variants[] = { { "Buddy", EReplayAlgorithm::Buddy }, { "TLSF", EReplayAlgorithm::TLSF }, { "SlabBuddy", EReplayAlgorithm::SlabBuddy } };
+
+	int ExitCode = 0;
+	for (const auto& Variant : Variants)
+	{
+		TAllocationReplaySettings Settings;
+		Settings.Algorithm = Variant.Algorithm;
+
+		const TAllocationReplayResult Result = ReplayAllocationTrace(Events, Settings);
+
+		printf("%-10s %12.0f allocations/s, peak reserved %8.2f MB, allocated %8.2f MB, requested %8.2f MB, fragmentation %.2f (max %.2f)\n",
+			Variant.Name, Result.AllocationsPerSecond, Result.PeakReservedSize / (1024.0 * 1024.0), Result.PeakAllocatedSize / (1024.0 * 1024.0),
+			Result.PeakRequestedSize / (1024.0 * 1024.0), Result.AverageFragmentation, Result.MaxFragmentation);
+
+		// every request is served and a block is never smaller than its request or larger than its pool
+		if (Result.NumAllocations != NumAllocEvents || Result.PeakRequestedSize > Result.PeakAllocatedSize || Result.PeakAllocatedSize > Result.PeakReservedSize)
+		{
+			printf("%-10s inconsistent replay\n", Variant.Name);
+			ExitCode = 1;
+		}
+	}
+
+	return ExitCode;
+}